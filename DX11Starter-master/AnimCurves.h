@@ -1,5 +1,8 @@
 #pragma once
 #include <iostream>
+#include <cmath>
+#include <cfloat>
+#include <DirectXMath.h>
 
 // Which curve type
 #define EASE_IN_SINE 0
@@ -32,6 +35,25 @@
 #define EASE_IN_BOUNCE 27
 #define EASE_OUT_BOUNCE 28
 #define EASE_IN_OUT_BOUNCE 29
+#define EASE_CURVE_COUNT 30
+
+// Intervals a baked curve table splits [0, 1] into
+#define EASE_TABLE_SIZE 256
+
+// How a baked table gets values between its samples - or
+// that it has none, and evaluates the curve itself
+#define EASE_TABLE_EXACT 0
+#define EASE_TABLE_LINEAR 1
+#define EASE_TABLE_CUBIC 2
+
+// Points checked in each interval when measuring a table's error
+#define EASE_TABLE_ERROR_SAMPLES 64
+
+// Padding on a table's measured error, to cover peaks that fall
+// between the points checked (a fraction of the error, which is
+// enough with 64 points) and rounding in the lookup (float ulps)
+#define EASE_TABLE_ERROR_MARGIN (1.0f / 16.0f)
+#define EASE_TABLE_ERROR_ROUNDING (2.0f * FLT_EPSILON)
 
 const float PI = 3.14159265358979323846f;
 
@@ -232,72 +254,562 @@ static float EaseInOutBounce(float x)
 }
 
 
-static float GetCurveByIndex(int curveType, float p)
+
+// --------------------------------------------------------
+// Compile-time curve choice.  Ease<EASE_OUT_BOUNCE>(x) is a
+// direct call to EaseOutBounce(x), so it can be inlined into
+// a loop where a runtime curve index can't.
+// --------------------------------------------------------
+template<int Curve> static float Ease(float x);
+
+template<> inline float Ease<EASE_IN_SINE>(float x) { return EaseInSine(x); }
+template<> inline float Ease<EASE_OUT_SINE>(float x) { return EaseOutSine(x); }
+template<> inline float Ease<EASE_IN_OUT_SINE>(float x) { return EaseInOutSine(x); }
+template<> inline float Ease<EASE_IN_QUAD>(float x) { return EaseInQuad(x); }
+template<> inline float Ease<EASE_OUT_QUAD>(float x) { return EaseOutQuad(x); }
+template<> inline float Ease<EASE_IN_OUT_QUAD>(float x) { return EaseInOutQuad(x); }
+template<> inline float Ease<EASE_IN_CUBIC>(float x) { return EaseInCubic(x); }
+template<> inline float Ease<EASE_OUT_CUBIC>(float x) { return EaseOutCubic(x); }
+template<> inline float Ease<EASE_IN_OUT_CUBIC>(float x) { return EaseInOutCubic(x); }
+template<> inline float Ease<EASE_IN_QUART>(float x) { return EaseInQuart(x); }
+template<> inline float Ease<EASE_OUT_QUART>(float x) { return EaseOutQuart(x); }
+template<> inline float Ease<EASE_IN_OUT_QUART>(float x) { return EaseInOutQuart(x); }
+template<> inline float Ease<EASE_IN_QUINT>(float x) { return EaseInQuint(x); }
+template<> inline float Ease<EASE_OUT_QUINT>(float x) { return EaseOutQuint(x); }
+template<> inline float Ease<EASE_IN_OUT_QUINT>(float x) { return EaseInOutQuint(x); }
+template<> inline float Ease<EASE_IN_EXPO>(float x) { return EaseInExpo(x); }
+template<> inline float Ease<EASE_OUT_EXPO>(float x) { return EaseOutExpo(x); }
+template<> inline float Ease<EASE_IN_OUT_EXPO>(float x) { return EaseInOutExpo(x); }
+template<> inline float Ease<EASE_IN_CIRC>(float x) { return EaseInCirc(x); }
+template<> inline float Ease<EASE_OUT_CIRC>(float x) { return EaseOutCirc(x); }
+template<> inline float Ease<EASE_IN_OUT_CIRC>(float x) { return EaseInOutCirc(x); }
+template<> inline float Ease<EASE_IN_BACK>(float x) { return EaseInBack(x); }
+template<> inline float Ease<EASE_OUT_BACK>(float x) { return EaseOutBack(x); }
+template<> inline float Ease<EASE_IN_OUT_BACK>(float x) { return EaseInOutBack(x); }
+template<> inline float Ease<EASE_IN_ELASTIC>(float x) { return EaseInElastic(x); }
+template<> inline float Ease<EASE_OUT_ELASTIC>(float x) { return EaseOutElastic(x); }
+template<> inline float Ease<EASE_IN_OUT_ELASTIC>(float x) { return EaseInOutElastic(x); }
+template<> inline float Ease<EASE_IN_BOUNCE>(float x) { return EaseInBounce(x); }
+template<> inline float Ease<EASE_OUT_BOUNCE>(float x) { return EaseOutBounce(x); }
+template<> inline float Ease<EASE_IN_OUT_BOUNCE>(float x) { return EaseInOutBounce(x); }
+
+
+// --------------------------------------------------------
+// The same curves, four inputs at a time.  Piecewise curves
+// evaluate every piece and select between them rather than
+// branching, and pow/sin/cos/sqrt become DirectXMath's
+// vector versions (integer powers are just multiplies).
+// --------------------------------------------------------
+template<int Curve> static DirectX::XMVECTOR XM_CALLCONV EaseVector(DirectX::FXMVECTOR x);
+
+// Below where x < 0.5, above elsewhere
+static inline DirectX::XMVECTOR XM_CALLCONV EaseSelectHalves(DirectX::FXMVECTOR x, DirectX::FXMVECTOR below, DirectX::FXMVECTOR above)
 {
-	switch (curveType)
+	using namespace DirectX;
+	return XMVectorSelect(above, below, XMVectorLess(x, XMVectorReplicate(0.5f)));
+}
+
+// Exact 0 and 1 where x is exactly 0 and 1, as the expo and elastic curves do
+static inline DirectX::XMVECTOR XM_CALLCONV EaseSelectEnds(DirectX::FXMVECTOR x, DirectX::FXMVECTOR y)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR result = XMVectorSelect(y, XMVectorZero(), XMVectorEqual(x, XMVectorZero()));
+	return XMVectorSelect(result, one, XMVectorEqual(x, one));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_SINE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	return XMVectorSplatOne() - XMVectorCos(x * (PI / 2.0f));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_SINE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	return XMVectorSin(x * (PI / 2.0f));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_SINE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	return (XMVectorSplatOne() - XMVectorCos(x * PI)) / 2.0f;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_QUAD>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	return x * x;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_QUAD>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = one - x;
+	return one - u * u;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_QUAD>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR u = XMVectorReplicate(2.0f) - x * 2.0f;
+	return EaseSelectHalves(x, x * x * 2.0f, XMVectorSplatOne() - u * u / 2.0f);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_CUBIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	return x * x * x;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_CUBIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = one - x;
+	return one - u * u * u;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_CUBIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR u = XMVectorReplicate(2.0f) - x * 2.0f;
+	return EaseSelectHalves(x, x * x * x * 4.0f, XMVectorSplatOne() - u * u * u / 2.0f);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_QUART>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR x2 = x * x;
+	return x2 * x2;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_QUART>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = one - x;
+	XMVECTOR u2 = u * u;
+	return one - u2 * u2;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_QUART>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR x2 = x * x;
+	XMVECTOR u = XMVectorReplicate(2.0f) - x * 2.0f;
+	XMVECTOR u2 = u * u;
+	return EaseSelectHalves(x, x2 * x2 * 8.0f, XMVectorSplatOne() - u2 * u2 / 2.0f);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_QUINT>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR x2 = x * x;
+	return x2 * x2 * x;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_QUINT>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = one - x;
+	XMVECTOR u2 = u * u;
+	return one - u2 * u2 * u;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_QUINT>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR x2 = x * x;
+	XMVECTOR u = XMVectorReplicate(2.0f) - x * 2.0f;
+	XMVECTOR u2 = u * u;
+	return EaseSelectHalves(x, x2 * x2 * x * 16.0f, XMVectorSplatOne() - u2 * u2 * u / 2.0f);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_EXPO>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR y = XMVectorExp2(x * 10.0f - XMVectorReplicate(10.0f));
+	return XMVectorSelect(y, XMVectorZero(), XMVectorEqual(x, XMVectorZero()));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_EXPO>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR y = one - XMVectorExp2(x * -10.0f);
+	return XMVectorSelect(y, one, XMVectorEqual(x, one));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_EXPO>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR ten = XMVectorReplicate(10.0f);
+	XMVECTOR below = XMVectorExp2(x * 20.0f - ten) / 2.0f;
+	XMVECTOR above = (XMVectorReplicate(2.0f) - XMVectorExp2(ten - x * 20.0f)) / 2.0f;
+	return EaseSelectEnds(x, EaseSelectHalves(x, below, above));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_CIRC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	return one - XMVectorSqrt(one - x * x);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_CIRC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = x - one;
+	return XMVectorSqrt(one - u * u);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_CIRC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR x2 = x * 2.0f;
+	XMVECTOR u = XMVectorReplicate(2.0f) - x2;
+	XMVECTOR below = (one - XMVectorSqrt(one - x2 * x2)) / 2.0f;
+	XMVECTOR above = (XMVectorSqrt(one - u * u) + one) / 2.0f;
+	return EaseSelectHalves(x, below, above);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_BACK>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c1 = 1.70158f;
+	const float c3 = c1 + 1.0f;
+	XMVECTOR x2 = x * x;
+	return x2 * x * c3 - x2 * c1;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_BACK>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c1 = 1.70158f;
+	const float c3 = c1 + 1.0f;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR u = x - one;
+	XMVECTOR u2 = u * u;
+	return one + u2 * u * c3 + u2 * c1;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_BACK>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c2 = 1.70158f * 1.525f;
+	XMVECTOR c2Vector = XMVectorReplicate(c2);
+	XMVECTOR x2 = x * 2.0f;
+	XMVECTOR u = x2 - XMVectorReplicate(2.0f);
+	XMVECTOR below = x2 * x2 * (x2 * (c2 + 1.0f) - c2Vector) / 2.0f;
+	XMVECTOR above = (u * u * (u * (c2 + 1.0f) + c2Vector) + XMVectorReplicate(2.0f)) / 2.0f;
+	return EaseSelectHalves(x, below, above);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_ELASTIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c4 = (2.0f * PI) / 3.0f;
+	XMVECTOR y =
+		XMVectorExp2(x * 10.0f - XMVectorReplicate(10.0f)) *
+		XMVectorSin((x * 10.0f - XMVectorReplicate(10.75f)) * c4);
+	return EaseSelectEnds(x, XMVectorNegate(y));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_ELASTIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c4 = (2.0f * PI) / 3.0f;
+	XMVECTOR y =
+		XMVectorExp2(x * -10.0f) *
+		XMVectorSin((x * 10.0f - XMVectorReplicate(0.75f)) * c4);
+	return EaseSelectEnds(x, y + XMVectorSplatOne());
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_ELASTIC>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float c5 = (2.0f * PI) / 4.5f;
+	XMVECTOR ten = XMVectorReplicate(10.0f);
+	XMVECTOR wave = XMVectorSin((x * 20.0f - XMVectorReplicate(11.125f)) * c5);
+	XMVECTOR below = XMVectorNegate(XMVectorExp2(x * 20.0f - ten) * wave) / 2.0f;
+	XMVECTOR above = XMVectorExp2(ten - x * 20.0f) * wave / 2.0f + XMVectorSplatOne();
+	return EaseSelectEnds(x, EaseSelectHalves(x, below, above));
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_OUT_BOUNCE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	const float n1 = 7.5625f;
+	const float d1 = 2.75f;
+
+	// Which bounce x is on picks the parabola's center and height,
+	// checked from the last bounce back so the earliest one wins
+	XMVECTOR center = XMVectorReplicate(2.625f / d1);
+	XMVECTOR height = XMVectorReplicate(0.984375f);
+	XMVECTOR on = XMVectorLess(x, XMVectorReplicate(2.5f / d1));
+	center = XMVectorSelect(center, XMVectorReplicate(2.25f / d1), on);
+	height = XMVectorSelect(height, XMVectorReplicate(0.9375f), on);
+	on = XMVectorLess(x, XMVectorReplicate(2.0f / d1));
+	center = XMVectorSelect(center, XMVectorReplicate(1.5f / d1), on);
+	height = XMVectorSelect(height, XMVectorReplicate(0.75f), on);
+	on = XMVectorLess(x, XMVectorReplicate(1.0f / d1));
+	center = XMVectorSelect(center, XMVectorZero(), on);
+	height = XMVectorSelect(height, XMVectorZero(), on);
+
+	XMVECTOR u = x - center;
+	return u * u * n1 + height;
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_BOUNCE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	return one - EaseVector<EASE_OUT_BOUNCE>(one - x);
+}
+
+template<> inline DirectX::XMVECTOR XM_CALLCONV EaseVector<EASE_IN_OUT_BOUNCE>(DirectX::FXMVECTOR x)
+{
+	using namespace DirectX;
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR x2 = x * 2.0f;
+	XMVECTOR below = (one - EaseVector<EASE_OUT_BOUNCE>(one - x2)) / 2.0f;
+	XMVECTOR above = (one + EaseVector<EASE_OUT_BOUNCE>(x2 - one)) / 2.0f;
+	return EaseSelectHalves(x, below, above);
+}
+
+// --------------------------------------------------------
+// Evaluates one curve over an array of inputs, four at a
+// time.  The last few inputs are padded out to a full
+// vector, so every result comes from the same math.
+// --------------------------------------------------------
+template<int Curve> static void EaseBatch(const float* x, float* results, unsigned int count)
+{
+	using namespace DirectX;
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4)
 	{
-	case EASE_IN_SINE:
-		return EaseInSine(p);
-	case EASE_OUT_SINE:
-		return EaseOutSine(p);
-	case EASE_IN_OUT_SINE:
-		return EaseInOutSine(p);
-	case EASE_IN_QUAD:
-		return EaseInQuad(p);
-	case EASE_OUT_QUAD:
-		return EaseOutQuad(p);
-	case EASE_IN_OUT_QUAD:
-		return EaseInOutQuad(p);
-	case EASE_IN_CUBIC:
-		return EaseInCubic(p);
-	case EASE_OUT_CUBIC:
-		return EaseOutCubic(p);
-	case EASE_IN_OUT_CUBIC:
-		return EaseInOutCubic(p);
-	case EASE_IN_QUART:
-		return EaseInQuart(p);
-	case EASE_OUT_QUART:
-		return EaseOutQuart(p);
-	case EASE_IN_OUT_QUART:
-		return EaseInOutQuart(p);
-	case EASE_IN_QUINT:
-		return EaseInQuint(p);
-	case EASE_OUT_QUINT:
-		return EaseOutQuint(p);
-	case EASE_IN_OUT_QUINT:
-		return EaseInOutQuint(p);
-	case EASE_IN_EXPO:
-		return EaseInExpo(p);
-	case EASE_OUT_EXPO:
-		return EaseOutExpo(p);
-	case EASE_IN_OUT_EXPO:
-		return EaseInOutExpo(p);
-	case EASE_IN_CIRC:
-		return EaseInCirc(p);
-	case EASE_OUT_CIRC:
-		return EaseOutCirc(p);
-	case EASE_IN_OUT_CIRC:
-		return EaseInOutCirc(p);
-	case EASE_IN_BACK:
-		return EaseInBack(p);
-	case EASE_OUT_BACK:
-		return EaseOutBack(p);
-	case EASE_IN_OUT_BACK:
-		return EaseInOutBack(p);
-	case EASE_IN_ELASTIC:
-		return EaseInElastic(p);
-	case EASE_OUT_ELASTIC:
-		return EaseOutElastic(p);
-	case EASE_IN_OUT_ELASTIC:
-		return EaseInOutElastic(p);
-	case EASE_IN_BOUNCE:
-		return EaseInBounce(p);
-	case EASE_OUT_BOUNCE:
-		return EaseOutBounce(p);
-	case EASE_IN_OUT_BOUNCE:
-		return EaseInOutBounce(p);
-	default:
+		XMVECTOR y = EaseVector<Curve>(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(x + i)));
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(results + i), y);
+	}
+
+	if (i < count)
+	{
+		XMFLOAT4 tail(0.0f, 0.0f, 0.0f, 0.0f);
+		float* lanes = &tail.x;
+		for (unsigned int j = i; j < count; j++)
+			lanes[j - i] = x[j];
+
+		XMStoreFloat4(&tail, EaseVector<Curve>(XMLoadFloat4(&tail)));
+		for (unsigned int j = i; j < count; j++)
+			results[j] = lanes[j - i];
+	}
+}
+
+// Runtime curve choice goes through these, indexed by the EASE_ values
+static float (* const EaseCurves[EASE_CURVE_COUNT])(float) =
+{
+	Ease<EASE_IN_SINE>,
+	Ease<EASE_OUT_SINE>,
+	Ease<EASE_IN_OUT_SINE>,
+	Ease<EASE_IN_QUAD>,
+	Ease<EASE_OUT_QUAD>,
+	Ease<EASE_IN_OUT_QUAD>,
+	Ease<EASE_IN_CUBIC>,
+	Ease<EASE_OUT_CUBIC>,
+	Ease<EASE_IN_OUT_CUBIC>,
+	Ease<EASE_IN_QUART>,
+	Ease<EASE_OUT_QUART>,
+	Ease<EASE_IN_OUT_QUART>,
+	Ease<EASE_IN_QUINT>,
+	Ease<EASE_OUT_QUINT>,
+	Ease<EASE_IN_OUT_QUINT>,
+	Ease<EASE_IN_EXPO>,
+	Ease<EASE_OUT_EXPO>,
+	Ease<EASE_IN_OUT_EXPO>,
+	Ease<EASE_IN_CIRC>,
+	Ease<EASE_OUT_CIRC>,
+	Ease<EASE_IN_OUT_CIRC>,
+	Ease<EASE_IN_BACK>,
+	Ease<EASE_OUT_BACK>,
+	Ease<EASE_IN_OUT_BACK>,
+	Ease<EASE_IN_ELASTIC>,
+	Ease<EASE_OUT_ELASTIC>,
+	Ease<EASE_IN_OUT_ELASTIC>,
+	Ease<EASE_IN_BOUNCE>,
+	Ease<EASE_OUT_BOUNCE>,
+	Ease<EASE_IN_OUT_BOUNCE>
+};
+
+static void (* const EaseBatchCurves[EASE_CURVE_COUNT])(const float*, float*, unsigned int) =
+{
+	EaseBatch<EASE_IN_SINE>,
+	EaseBatch<EASE_OUT_SINE>,
+	EaseBatch<EASE_IN_OUT_SINE>,
+	EaseBatch<EASE_IN_QUAD>,
+	EaseBatch<EASE_OUT_QUAD>,
+	EaseBatch<EASE_IN_OUT_QUAD>,
+	EaseBatch<EASE_IN_CUBIC>,
+	EaseBatch<EASE_OUT_CUBIC>,
+	EaseBatch<EASE_IN_OUT_CUBIC>,
+	EaseBatch<EASE_IN_QUART>,
+	EaseBatch<EASE_OUT_QUART>,
+	EaseBatch<EASE_IN_OUT_QUART>,
+	EaseBatch<EASE_IN_QUINT>,
+	EaseBatch<EASE_OUT_QUINT>,
+	EaseBatch<EASE_IN_OUT_QUINT>,
+	EaseBatch<EASE_IN_EXPO>,
+	EaseBatch<EASE_OUT_EXPO>,
+	EaseBatch<EASE_IN_OUT_EXPO>,
+	EaseBatch<EASE_IN_CIRC>,
+	EaseBatch<EASE_OUT_CIRC>,
+	EaseBatch<EASE_IN_OUT_CIRC>,
+	EaseBatch<EASE_IN_BACK>,
+	EaseBatch<EASE_OUT_BACK>,
+	EaseBatch<EASE_IN_OUT_BACK>,
+	EaseBatch<EASE_IN_ELASTIC>,
+	EaseBatch<EASE_OUT_ELASTIC>,
+	EaseBatch<EASE_IN_OUT_ELASTIC>,
+	EaseBatch<EASE_IN_BOUNCE>,
+	EaseBatch<EASE_OUT_BOUNCE>,
+	EaseBatch<EASE_IN_OUT_BOUNCE>
+};
+
+// Unknown curve types give 1
+static float GetCurveByIndex(int curveType, float p)
+{
+	if (curveType < 0 || curveType >= EASE_CURVE_COUNT)
 		return 1.0f;
-		break;
+	return EaseCurves[curveType](p);
+}
+
+static void GetCurveBatchByIndex(int curveType, const float* p, float* results, unsigned int count)
+{
+	if (curveType < 0 || curveType >= EASE_CURVE_COUNT)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			results[i] = 1.0f;
+		return;
+	}
+	EaseBatchCurves[curveType](p, results, count);
+}
+
+// --------------------------------------------------------
+// A curve baked into evenly spaced samples over [0, 1], so
+// evaluating it is a lookup and a blend rather than pow,
+// sin or sqrt.  Inputs outside [0, 1] (and exact tables)
+// evaluate the curve itself.
+//
+// MaxError bounds the difference from the real curve.  It's
+// the largest difference found when baking, checking
+// EASE_TABLE_ERROR_SAMPLES points per interval, padded by
+// EASE_TABLE_ERROR_MARGIN and EASE_TABLE_ERROR_ROUNDING for
+// what falls between them.  With 256 intervals, cubic tables are:
+//  - Under 1e-6 for sine
+//  - Under 5e-5 for the polynomials (quad to quint) and back -
+//    under 1e-6 for in and out, the rest from in-out's kink at 0.5
+//  - Around 5e-4 for elastic and 1e-3 for expo (their jump at 0 or 1)
+//  - 2e-3 to 7e-3 for bounce (kinks between samples)
+//  - Around 2e-2 for circ (infinite slope at the ends)
+// Linear tables stay under 1e-4 for sine, the polynomials and
+// back, and are up to 1.5 times worse than cubic for the rest.
+//
+// Curves aren't constexpr (they use <cmath>), so tables
+// are baked at runtime, once, and are read-only after.
+// --------------------------------------------------------
+struct EaseTable
+{
+	int Curve;
+	unsigned int Interpolation;
+	float MaxError;
+
+	// The samples at 0 through 1, with one more at each
+	// end (extrapolated) for cubic interpolation
+	float Samples[EASE_TABLE_SIZE + 3];
+};
+
+// The interval x is in, and how far along it
+static inline float EaseTableLookup(const EaseTable& table, float x)
+{
+	float position = x * EASE_TABLE_SIZE;
+	int interval = (int)position;
+	if (interval > EASE_TABLE_SIZE - 1)
+		interval = EASE_TABLE_SIZE - 1;
+	float t = position - (float)interval;
+
+	const float* p = table.Samples + interval;
+	if (table.Interpolation == EASE_TABLE_LINEAR)
+		return p[1] + (p[2] - p[1]) * t;
+
+	// Catmull-Rom through the two samples either side
+	return p[1] + 0.5f * t * (
+		(p[2] - p[0]) + t * (
+		(2.0f * p[0] - 5.0f * p[1] + 4.0f * p[2] - p[3]) + t *
+		(3.0f * (p[1] - p[2]) + p[3] - p[0])));
+}
+
+static float EvaluateEaseTable(const EaseTable& table, float x)
+{
+	if (table.Interpolation == EASE_TABLE_EXACT || !(x >= 0.0f && x <= 1.0f))
+		return GetCurveByIndex(table.Curve, x);
+	return EaseTableLookup(table, x);
+}
+
+static void EvaluateEaseTableBatch(const EaseTable& table, const float* x, float* results, unsigned int count)
+{
+	if (table.Interpolation == EASE_TABLE_EXACT)
+	{
+		GetCurveBatchByIndex(table.Curve, x, results, count);
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		results[i] = x[i] >= 0.0f && x[i] <= 1.0f ?
+			EaseTableLookup(table, x[i]) :
+			GetCurveByIndex(table.Curve, x[i]);
+	}
+}
+
+static void BakeEaseTable(int curveType, unsigned int interpolation, EaseTable& table)
+{
+	table.Curve = curveType;
+	table.Interpolation = interpolation;
+	table.MaxError = 0.0f;
+
+	for (int i = 0; i <= EASE_TABLE_SIZE; i++)
+		table.Samples[i + 1] = GetCurveByIndex(curveType, (float)i / EASE_TABLE_SIZE);
+
+	// The parabola through the last three samples at each end, so end
+	// intervals get slopes as good as everywhere else
+	const float* s = table.Samples;
+	table.Samples[0] = 3.0f * (s[1] - s[2]) + s[3];
+	table.Samples[EASE_TABLE_SIZE + 2] = 3.0f * (s[EASE_TABLE_SIZE + 1] - s[EASE_TABLE_SIZE]) + s[EASE_TABLE_SIZE - 1];
+
+	if (interpolation == EASE_TABLE_EXACT)
+		return;
+
+	// Each interval's ends are checked from just inside it, which
+	// catches a jump at a sample (like expo's exact 0)
+	for (int i = 0; i < EASE_TABLE_SIZE; i++)
+	{
+		for (int j = 0; j <= EASE_TABLE_ERROR_SAMPLES; j++)
+		{
+			float x = (i + (float)j / EASE_TABLE_ERROR_SAMPLES) / EASE_TABLE_SIZE;
+			if (j == 0)
+				x = std::nextafter(x, 1.0f);
+			else if (j == EASE_TABLE_ERROR_SAMPLES)
+				x = std::nextafter(x, 0.0f);
+
+			float error = std::fabs(EaseTableLookup(table, x) - GetCurveByIndex(curveType, x));
+			if (error > table.MaxError)
+				table.MaxError = error;
+		}
 	}
+
+	table.MaxError += table.MaxError * EASE_TABLE_ERROR_MARGIN + EASE_TABLE_ERROR_ROUNDING;
 }
\ No newline at end of file
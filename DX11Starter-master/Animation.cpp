@@ -0,0 +1,184 @@
+#include "Animation.h"
+#include "AnimCurves.h"
+#include "JobSystem.h"
+#include "TransformStore.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+static const char* AnimationChannelNames[ANIMATION_CHANNEL_COUNT] =
+{
+	"position.x", "position.y", "position.z",
+	"scale.x", "scale.y", "scale.z",
+};
+
+// In EASE_ order
+static const char* AnimationCurveNames[ANIMATION_CURVE_COUNT] =
+{
+	"insine", "outsine", "inoutsine",
+	"inquad", "outquad", "inoutquad",
+	"incubic", "outcubic", "inoutcubic",
+	"inquart", "outquart", "inoutquart",
+	"inquint", "outquint", "inoutquint",
+	"inexpo", "outexpo", "inoutexpo",
+	"incirc", "outcirc", "inoutcirc",
+	"inback", "outback", "inoutback",
+	"inelastic", "outelastic", "inoutelastic",
+	"inbounce", "outbounce", "inoutbounce",
+};
+
+unsigned int FindAnimationChannel(const char* name)
+{
+	unsigned int channel = 0;
+	while (channel < ANIMATION_CHANNEL_COUNT && strcmp(name, AnimationChannelNames[channel]) != 0)
+		channel++;
+	return channel;
+}
+
+unsigned int FindAnimationCurve(const char* name)
+{
+	unsigned int curve = 0;
+	while (curve < ANIMATION_CURVE_COUNT && strcmp(name, AnimationCurveNames[curve]) != 0)
+		curve++;
+	return curve;
+}
+
+const char* GetAnimationChannelName(unsigned int channel)
+{
+	return channel < ANIMATION_CHANNEL_COUNT ? AnimationChannelNames[channel] : "";
+}
+
+const char* GetAnimationCurveName(unsigned int curve)
+{
+	return curve < ANIMATION_CURVE_COUNT ? AnimationCurveNames[curve] : "";
+}
+
+// Where one entity's tracks put its transform
+struct AnimationResult
+{
+	XMFLOAT3 Position;
+	XMFLOAT3 Scale;
+};
+
+// Every track in a batch of components, in component order
+struct AnimationBatch
+{
+	std::vector<float> Inputs;
+	std::vector<unsigned int> Curves;
+	std::vector<float*> Targets;
+	std::vector<const AnimationTrack*> Tracks;
+
+	// Inputs regrouped by curve, and each one's spot in the lists above
+	std::vector<float> SortedInputs;
+	std::vector<float> SortedValues;
+	std::vector<unsigned int> Order;
+};
+
+// --------------------------------------------------------
+// Two passes.  Workers evaluate the curves (all the trig
+// and pow) into one result per component, only reading the
+// TransformStore.  Then this thread hands the results to it
+// in order, since setting a transform marks bits that
+// neighbouring transforms share.
+//
+// Within a batch, tracks are grouped by curve so each curve
+// runs over all of its inputs at once with SIMD, instead of
+// picking a curve per track.
+// --------------------------------------------------------
+void UpdateAnimations(const ComponentArray<AnimationComponent>& animations, float totalTime, const EaseTable* curveTables)
+{
+	unsigned int count = animations.GetCount();
+	if (count == 0)
+		return;
+
+	TransformStore& transforms = TransformStore::GetInstance();
+	const AnimationComponent* components = animations.GetData();
+	std::vector<AnimationResult> results(count);
+
+	JobSystem::GetInstance().ParallelFor(count, ANIMATION_ENTITIES_PER_BATCH,
+		[&](unsigned int start, unsigned int end)
+		{
+			AnimationBatch batch;
+			batch.Inputs.reserve((end - start) * ANIMATION_MAX_TRACKS);
+			batch.Curves.reserve((end - start) * ANIMATION_MAX_TRACKS);
+			batch.Targets.reserve((end - start) * ANIMATION_MAX_TRACKS);
+			batch.Tracks.reserve((end - start) * ANIMATION_MAX_TRACKS);
+
+			// Unknown curves share the last group
+			unsigned int curveCounts[ANIMATION_CURVE_COUNT + 1] = {};
+
+			for (unsigned int i = start; i < end; i++)
+			{
+				const AnimationComponent& animation = components[i];
+
+				// Channels without a track keep their current value
+				AnimationResult& result = results[i];
+				result.Position = transforms.GetPosition(animation.TransformIndex);
+				result.Scale = transforms.GetScale(animation.TransformIndex);
+				float* channels[ANIMATION_CHANNEL_COUNT] =
+				{
+					&result.Position.x, &result.Position.y, &result.Position.z,
+					&result.Scale.x, &result.Scale.y, &result.Scale.z,
+				};
+
+				for (unsigned int t = 0; t < animation.TrackCount; t++)
+				{
+					const AnimationTrack& track = animation.Tracks[t];
+					unsigned int curve = track.Curve < ANIMATION_CURVE_COUNT ? track.Curve : ANIMATION_CURVE_COUNT;
+					batch.Inputs.push_back(0.5f + 0.5f * sinf(totalTime * track.Speed) + track.Phase);
+					batch.Curves.push_back(curve);
+					batch.Targets.push_back(channels[track.Channel]);
+					batch.Tracks.push_back(&track);
+					curveCounts[curve]++;
+				}
+			}
+
+			// Counting sort by curve
+			unsigned int trackCount = (unsigned int)batch.Inputs.size();
+			unsigned int curveStarts[ANIMATION_CURVE_COUNT + 2] = {};
+			for (unsigned int curve = 0; curve <= ANIMATION_CURVE_COUNT; curve++)
+				curveStarts[curve + 1] = curveStarts[curve] + curveCounts[curve];
+
+			batch.SortedInputs.resize(trackCount);
+			batch.SortedValues.resize(trackCount);
+			batch.Order.resize(trackCount);
+			unsigned int next[ANIMATION_CURVE_COUNT + 1];
+			for (unsigned int curve = 0; curve <= ANIMATION_CURVE_COUNT; curve++)
+				next[curve] = curveStarts[curve];
+			for (unsigned int t = 0; t < trackCount; t++)
+			{
+				unsigned int position = next[batch.Curves[t]]++;
+				batch.SortedInputs[position] = batch.Inputs[t];
+				batch.Order[position] = t;
+			}
+
+			for (unsigned int curve = 0; curve <= ANIMATION_CURVE_COUNT; curve++)
+			{
+				if (curveCounts[curve] == 0)
+					continue;
+
+				const float* inputs = &batch.SortedInputs[curveStarts[curve]];
+				float* values = &batch.SortedValues[curveStarts[curve]];
+				if (curveTables && curve < ANIMATION_CURVE_COUNT)
+					EvaluateEaseTableBatch(curveTables[curve], inputs, values, curveCounts[curve]);
+				else
+					GetCurveBatchByIndex((int)curve, inputs, values, curveCounts[curve]);
+			}
+
+			// Back in track order (reusing the inputs), so when two
+			// tracks drive one channel the later one still wins
+			for (unsigned int position = 0; position < trackCount; position++)
+				batch.Inputs[batch.Order[position]] = batch.SortedValues[position];
+			for (unsigned int t = 0; t < trackCount; t++)
+				*batch.Targets[t] = batch.Tracks[t]->Offset + batch.Tracks[t]->Amplitude * batch.Inputs[t];
+		});
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		transforms.SetPosition(components[i].TransformIndex, results[i].Position);
+		transforms.SetScale(components[i].TransformIndex, results[i].Scale);
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ComponentArray.h"
+
+struct EaseTable;
+
+// What part of a transform an animation track drives
+#define ANIMATION_CHANNEL_POSITION_X	0
+#define ANIMATION_CHANNEL_POSITION_Y	1
+#define ANIMATION_CHANNEL_POSITION_Z	2
+#define ANIMATION_CHANNEL_SCALE_X		3
+#define ANIMATION_CHANNEL_SCALE_Y		4
+#define ANIMATION_CHANNEL_SCALE_Z		5
+#define ANIMATION_CHANNEL_COUNT			6
+
+// Curves are the EASE_ values from AnimCurves.h
+#define ANIMATION_CURVE_COUNT 30
+
+// Tracks one entity's animation component can hold
+#define ANIMATION_MAX_TRACKS 4
+
+// Animated entities per job system batch
+#define ANIMATION_ENTITIES_PER_BATCH 256
+
+// --------------------------------------------------------
+// One channel following a curve back and forth over time:
+//
+//   Offset + Amplitude * curve(0.5 + 0.5 * sin(time * Speed) + Phase)
+//
+// Phase shifts the curve's input, not the time, so the
+// same sine can land on a different part of the curve.
+// --------------------------------------------------------
+struct AnimationTrack
+{
+	unsigned int Channel;
+	unsigned int Curve;
+	float Amplitude;
+	float Offset;
+	float Phase;
+	float Speed;
+};
+
+struct AnimationComponent
+{
+	unsigned int TransformIndex;	// Slot in the TransformStore
+	unsigned int TrackCount;
+	AnimationTrack Tracks[ANIMATION_MAX_TRACKS];
+};
+
+// Names scene files use for channels and curves, and back.
+// Unknown names give ANIMATION_CHANNEL_COUNT / ANIMATION_CURVE_COUNT.
+unsigned int FindAnimationChannel(const char* name);
+unsigned int FindAnimationCurve(const char* name);
+const char* GetAnimationChannelName(unsigned int channel);
+const char* GetAnimationCurveName(unsigned int curve);
+
+// --------------------------------------------------------
+// Moves every animated transform to where its tracks put it
+// at this time.  Curves are evaluated across the job system
+// and written back in component order, so the result never
+// depends on how many threads there are.
+//
+// Given ANIMATION_CURVE_COUNT baked tables (in curve order),
+// curves are evaluated through them instead.
+// --------------------------------------------------------
+void UpdateAnimations(const ComponentArray<AnimationComponent>& animations, float totalTime, const EaseTable* curveTables = 0);
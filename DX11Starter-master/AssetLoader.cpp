@@ -0,0 +1,197 @@
+#include "AssetLoader.h"
+#include "DX12Helper.h"
+#include "JobSystem.h"
+#include "MeshRegistry.h"
+#include "TextureCooker.h"
+
+#include <climits>
+
+#include "packages/directxtk12_desktop_2019.2024.1.1.1/include/WICTextureLoader.h"
+#include "packages/directxtk12_desktop_2019.2024.1.1.1/include/DDSTextureLoader.h"
+#include "packages/directxtk12_desktop_2019.2024.1.1.1/include/ResourceUploadBatch.h"
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Starts reading (or mapping the cache for) a mesh on a worker
+// --------------------------------------------------------
+unsigned int AssetLoader::QueueMesh(const std::wstring& file)
+{
+	auto existing = meshHandles.find(file);
+	if (existing != meshHandles.end())
+		return existing->second;
+
+	PendingMesh pending;
+	pending.File = file;
+
+	// Already loaded (and uploaded) by someone else
+	pending.Result = MeshRegistry::GetInstance().FindMesh(file);
+	if (!pending.Result)
+		pending.Data = JobSystem::GetInstance().Submit([file]()
+		{
+			std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+			if (!Mesh::LoadData(file.c_str(), *data))
+				return std::shared_ptr<MeshData>();
+			return data;
+		});
+
+	unsigned int handle = (unsigned int)meshes.size();
+	meshes.push_back(std::move(pending));
+	meshHandles[file] = handle;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Starts decoding a texture on a worker, unless it's already
+// in DX12Helper's cache.  The worker also creates the (empty)
+// GPU resource, since resource creation is free-threaded.
+// --------------------------------------------------------
+unsigned int AssetLoader::QueueTexture(const std::wstring& file, bool generateMips)
+{
+	std::wstring key = file + (generateMips ? L"|mips" : L"|nomips");
+	auto existing = textureHandles.find(key);
+	if (existing != textureHandles.end())
+		return existing->second;
+
+	PendingTexture pending;
+	pending.File = file;
+	pending.GenerateMips = generateMips;
+	pending.SRV = {};
+	pending.Done = DX12Helper::GetInstance().AcquireCachedTexture(file.c_str(), generateMips, &pending.SRV);
+
+	if (!pending.Done)
+	{
+		Microsoft::WRL::ComPtr<ID3D12Device> device = DX12Helper::GetInstance().GetDevice();
+		pending.Decoded = JobSystem::GetInstance().Submit([file, generateMips, device]()
+		{
+			std::shared_ptr<DecodedTexture> decoded = std::make_shared<DecodedTexture>();
+
+			// Cooking is a no-op once the cooked file exists
+			std::wstring cooked = GetCookedTexture(file.c_str(), generateMips);
+			HRESULT hr = E_FAIL;
+			if (!cooked.empty())
+			{
+				decoded->CookedFile = std::make_shared<MappedFile>(cooked.c_str());
+				if (DX12Helper::GetInstance().CreateCookedTexture(decoded->CookedFile, UINT_MAX, decoded->Resource, decoded->Subresources))
+				{
+					hr = S_OK;
+				}
+				else
+				{
+					// Not one of ours, so load the whole thing
+					decoded->CookedFile.reset();
+					hr = LoadDDSTextureFromFile(
+						device.Get(),
+						cooked.c_str(),
+						decoded->Resource.GetAddressOf(),
+						decoded->Pixels,
+						decoded->Subresources);
+				}
+			}
+
+			// Couldn't cook it, so decode the source as is
+			if (FAILED(hr))
+			{
+				// WIC is COM based - the job system sets it up on each worker
+				decoded->Subresources.resize(1);
+				hr = LoadWICTextureFromFileEx(
+					device.Get(),
+					file.c_str(),
+					0,
+					D3D12_RESOURCE_FLAG_NONE,
+					generateMips ? WIC_LOADER_MIP_AUTOGEN : WIC_LOADER_DEFAULT,
+					decoded->Resource.GetAddressOf(),
+					decoded->Pixels,
+					decoded->Subresources[0]);
+			}
+
+			if (FAILED(hr))
+				return std::shared_ptr<DecodedTexture>();
+			return decoded;
+		});
+	}
+
+	unsigned int handle = (unsigned int)textures.size();
+	textures.push_back(std::move(pending));
+	textureHandles[key] = handle;
+	return handle;
+}
+
+// --------------------------------------------------------
+// Collects every result.  Texture uploads (and GPU mip
+// generation) all go into one batch that's kicked off before
+// the meshes are created, and is only waited on at the end.
+// --------------------------------------------------------
+void AssetLoader::Finish()
+{
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+	JobSystem& jobs = JobSystem::GetInstance();
+
+	ResourceUploadBatch upload(dx12Helper.GetDevice().Get());
+	upload.Begin();
+
+	// Decoded pixels must stay alive until the batch has been executed
+	std::vector<std::shared_ptr<DecodedTexture>> decodedTextures(textures.size());
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].Done)
+			continue;
+
+		std::shared_ptr<DecodedTexture> decoded = jobs.Wait(textures[i].Decoded);
+		if (!decoded)
+			continue;
+
+		// Same steps DXTK's Create*TextureFromFile take, minus the decode
+		ID3D12Resource* resource = decoded->Resource.Get();
+		upload.Upload(resource, 0, decoded->Subresources.data(), (UINT)decoded->Subresources.size());
+		upload.Transition(resource, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		if (textures[i].GenerateMips && decoded->Subresources.size() == 1 && upload.IsSupportedForGenerateMips(resource->GetDesc().Format))
+			upload.GenerateMips(resource);
+
+		decodedTextures[i] = decoded;
+	}
+	auto finish = upload.End(dx12Helper.GetCommandQueue().Get());
+
+	// Meshes upload (and build their BLAS's) while the texture batch runs
+	for (size_t i = 0; i < meshes.size(); i++)
+	{
+		if (meshes[i].Result)
+			continue;
+
+		// The registry only uploads files (and contents) it hasn't seen
+		std::shared_ptr<MeshData> data = jobs.Wait(meshes[i].Data);
+		meshes[i].Result = MeshRegistry::GetInstance().AddMesh(meshes[i].File, data ? *data : MeshData());
+	}
+
+	// The single wait for every texture
+	finish.wait();
+
+	for (size_t i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].Done)
+			continue;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+		if (decodedTextures[i])
+			resource = decodedTextures[i]->Resource;
+
+		if (resource && decodedTextures[i]->CookedFile)
+			textures[i].SRV = dx12Helper.AddStreamedTexture(textures[i].File.c_str(), textures[i].GenerateMips, resource, decodedTextures[i]->CookedFile);
+		else
+			textures[i].SRV = dx12Helper.AddTexture(textures[i].File.c_str(), textures[i].GenerateMips, resource);
+		textures[i].Done = true;
+	}
+}
+
+std::shared_ptr<Mesh> AssetLoader::GetMesh(unsigned int handle)
+{
+	if (handle >= meshes.size())
+		return nullptr;
+	return meshes[handle].Result;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE AssetLoader::GetTexture(unsigned int handle)
+{
+	if (handle >= textures.size())
+		return D3D12_CPU_DESCRIPTOR_HANDLE{};
+	return textures[handle].SRV;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <future>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "MeshData.h"
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Loads a batch of meshes and textures in parallel.
+//
+// Queue* kicks off the CPU work (file reads, obj parsing or
+// mesh cache mapping, image decoding and cooking) on the job
+// system and returns a handle.  Finish() waits for the
+// results, records every texture into a single upload batch
+// that is fenced once, and creates the meshes.
+//
+// Meshes end up in the MeshRegistry, so a file (or a copy of
+// it) is only ever uploaded once.  Textures are cooked to
+// block compressed .dds files the first time they're seen
+// (see TextureCooker) and end up in DX12Helper's texture
+// cache, so later LoadTexture calls for them are free.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	unsigned int QueueMesh(const std::wstring& file);
+	unsigned int QueueTexture(const std::wstring& file, bool generateMips = true);
+
+	// Blocks until everything queued so far is loaded and on the GPU
+	void Finish();
+
+	// Results by handle - only valid after Finish()
+	std::shared_ptr<Mesh> GetMesh(unsigned int handle);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetTexture(unsigned int handle);
+
+private:
+	// What a worker hands back after decoding an image.  Cooked
+	// textures upload their mip tail straight from the mapped file
+	// and stream the rest, so they skip GPU mip generation.
+	struct DecodedTexture
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		std::unique_ptr<uint8_t[]> Pixels;
+		std::vector<D3D12_SUBRESOURCE_DATA> Subresources;
+		std::shared_ptr<MappedFile> CookedFile;
+	};
+
+	struct PendingMesh
+	{
+		std::wstring File;
+		std::future<std::shared_ptr<MeshData>> Data;
+		std::shared_ptr<Mesh> Result;
+	};
+
+	struct PendingTexture
+	{
+		std::wstring File;
+		bool GenerateMips;
+		std::future<std::shared_ptr<DecodedTexture>> Decoded;
+		D3D12_CPU_DESCRIPTOR_HANDLE SRV;
+		bool Done;
+	};
+
+	std::vector<PendingMesh> meshes;
+	std::vector<PendingTexture> textures;
+
+	// Handles of files already queued, so a batch never loads one twice
+	std::unordered_map<std::wstring, unsigned int> meshHandles;
+	std::unordered_map<std::wstring, unsigned int> textureHandles;
+};
@@ -0,0 +1,448 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+
+// Interpolation weights (out of 64) for BC7's 4-bit indices
+static const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// How many times endpoints are refit to the indices they produced
+static const int RefineIterations = 2;
+
+// --------------------------------------------------------
+// Finds the line through the block's colors with the most
+// spread (principal axis, by power iteration on the
+// covariance) and returns the extremes of the block along it
+// --------------------------------------------------------
+static void FindPrincipalEndpoints(const float pixels[16][4], int channels, float e0[4], float e1[4])
+{
+	float mean[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < channels; c++)
+			mean[c] += pixels[i][c] / 16.0f;
+
+	float covariance[4][4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float d[4] = {};
+		for (int c = 0; c < channels; c++)
+			d[c] = pixels[i][c] - mean[c];
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	// Start from the bounding box diagonal, which is usually close already
+	float axis[4] = { 0, 0, 0, 0 };
+	for (int c = 0; c < channels; c++)
+	{
+		float low = FLT_MAX, high = -FLT_MAX;
+		for (int i = 0; i < 16; i++)
+		{
+			low = std::min(low, pixels[i][c]);
+			high = std::max(high, pixels[i][c]);
+		}
+		axis[c] = high - low;
+	}
+
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = { 0, 0, 0, 0 };
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+
+		float length = 0.0f;
+		for (int c = 0; c < channels; c++)
+			length += next[c] * next[c];
+		length = std::sqrt(length);
+		if (length < 1e-6f)
+			break;
+
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+
+	// Normalize in case the iteration never ran (flat block)
+	float axisLength = 0.0f;
+	for (int c = 0; c < channels; c++)
+		axisLength += axis[c] * axis[c];
+	axisLength = std::sqrt(axisLength);
+	if (axisLength > 0.0f)
+		for (int c = 0; c < channels; c++)
+			axis[c] /= axisLength;
+
+	float minT = FLT_MAX, maxT = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = 0.0f;
+		for (int c = 0; c < channels; c++)
+			t += (pixels[i][c] - mean[c]) * axis[c];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = c < channels ? std::min(std::max(mean[c] + axis[c] * minT, 0.0f), 255.0f) : 255.0f;
+		e1[c] = c < channels ? std::min(std::max(mean[c] + axis[c] * maxT, 0.0f), 255.0f) : 255.0f;
+	}
+}
+
+// --------------------------------------------------------
+// Least squares endpoints for a fixed set of interpolation
+// weights (0 = all e0, 1 = all e1).  Returns false if the
+// weights don't constrain both endpoints.
+// --------------------------------------------------------
+static bool FitEndpoints(const float pixels[16][4], int channels, const float weights[16], float e0[4], float e1[4])
+{
+	float aa = 0, ab = 0, bb = 0;
+	float ax[4] = { 0, 0, 0, 0 };
+	float bx[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		float b = weights[i];
+		float a = 1.0f - b;
+		aa += a * a;
+		ab += a * b;
+		bb += b * b;
+		for (int c = 0; c < channels; c++)
+		{
+			ax[c] += a * pixels[i][c];
+			bx[c] += b * pixels[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	for (int c = 0; c < channels; c++)
+	{
+		e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / determinant, 0.0f), 255.0f);
+		e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / determinant, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+static void LoadBlock(const unsigned char rgba[64], float pixels[16][4])
+{
+	for (int i = 0; i < 16; i++)
+		for (int c = 0; c < 4; c++)
+			pixels[i][c] = rgba[i * 4 + c];
+}
+
+// --------------------------------------------------------
+// Writes the low 'count' bits of value at a bit offset,
+// least significant bit first (the order BCn blocks use)
+// --------------------------------------------------------
+static void WriteBits(unsigned char* block, int& offset, unsigned int value, int count)
+{
+	for (int i = 0; i < count; i++, offset++)
+	{
+		if (value & (1u << i))
+			block[offset >> 3] |= (unsigned char)(1u << (offset & 7));
+	}
+}
+
+// ===================== BC1 =====================
+
+static unsigned short PackRGB565(const float color[4])
+{
+	unsigned int r = (unsigned int)(color[0] * 31.0f / 255.0f + 0.5f);
+	unsigned int g = (unsigned int)(color[1] * 63.0f / 255.0f + 0.5f);
+	unsigned int b = (unsigned int)(color[2] * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+}
+
+static void UnpackRGB565(unsigned short packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Picks indices for two packed endpoints in 4 color mode, returning the total error
+static int SelectBC1Indices(const float pixels[16][4], unsigned short c0, unsigned short c1, unsigned int& indices)
+{
+	int palette[4][3];
+	UnpackRGB565(c0, palette[0]);
+	UnpackRGB565(c1, palette[1]);
+	// Rounded, the way hardware blends them
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+		palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+	}
+
+	indices = 0;
+	int totalError = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		int bestError = INT_MAX;
+		for (int p = 0; p < 4; p++)
+		{
+			int error = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				int d = (int)pixels[i][c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = p;
+			}
+		}
+		indices |= (unsigned int)best << (i * 2);
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+void CompressBlockBC1(const unsigned char rgba[64], unsigned char out[8])
+{
+	float pixels[16][4];
+	LoadBlock(rgba, pixels);
+
+	float e0[4], e1[4];
+	FindPrincipalEndpoints(pixels, 3, e0, e1);
+
+	// Higher endpoint first keeps the block in 4 color (opaque) mode
+	unsigned short bestC0 = std::max(PackRGB565(e0), PackRGB565(e1));
+	unsigned short bestC1 = std::min(PackRGB565(e0), PackRGB565(e1));
+	unsigned int bestIndices = 0;
+	int bestError = SelectBC1Indices(pixels, bestC0, bestC1, bestIndices);
+
+	for (int iteration = 0; iteration < RefineIterations && bestC0 != bestC1; iteration++)
+	{
+		// Palette positions 0..3 sit at 0, 1, 1/3 and 2/3 of the way to c1
+		static const float positions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+			weights[i] = positions[(bestIndices >> (i * 2)) & 3];
+
+		if (!FitEndpoints(pixels, 3, weights, e0, e1))
+			break;
+
+		unsigned short c0 = std::max(PackRGB565(e0), PackRGB565(e1));
+		unsigned short c1 = std::min(PackRGB565(e0), PackRGB565(e1));
+		unsigned int indices = 0;
+		int error = SelectBC1Indices(pixels, c0, c1, indices);
+		if (error >= bestError)
+			break;
+
+		bestC0 = c0;
+		bestC1 = c1;
+		bestIndices = indices;
+		bestError = error;
+	}
+
+	// Equal endpoints would flip the block into 3 color mode, where
+	// index 3 means transparent black - point everything at c0
+	if (bestC0 == bestC1)
+		bestIndices = 0;
+
+	out[0] = (unsigned char)(bestC0 & 0xFF);
+	out[1] = (unsigned char)(bestC0 >> 8);
+	out[2] = (unsigned char)(bestC1 & 0xFF);
+	out[3] = (unsigned char)(bestC1 >> 8);
+	memcpy(out + 4, &bestIndices, 4);
+}
+
+// ===================== BC4 / BC5 =====================
+
+void CompressBlockBC4(const unsigned char values[16], unsigned char out[8])
+{
+	// The 8 value mode (first endpoint higher) covers the block's full range
+	int high = 0, low = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		high = std::max(high, (int)values[i]);
+		low = std::min(low, (int)values[i]);
+	}
+
+	memset(out, 0, 8);
+	out[0] = (unsigned char)high;
+	out[1] = (unsigned char)low;
+	if (high == low)
+		return;
+
+	// Index 0 and 1 are the endpoints, 2-7 step from high to low in
+	// sevenths (rounded, the way hardware blends them)
+	int palette[8];
+	palette[0] = high;
+	palette[1] = low;
+	for (int p = 1; p < 7; p++)
+		palette[p + 1] = ((7 - p) * high + p * low + 3) / 7;
+
+	int offset = 16;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		int bestError = INT_MAX;
+		for (int p = 0; p < 8; p++)
+		{
+			int error = std::abs((int)values[i] - palette[p]);
+			if (error < bestError)
+			{
+				bestError = error;
+				best = p;
+			}
+		}
+		WriteBits(out, offset, (unsigned int)best, 3);
+	}
+}
+
+void CompressBlockBC5(const unsigned char rgba[64], unsigned char out[16])
+{
+	unsigned char red[16], green[16];
+	for (int i = 0; i < 16; i++)
+	{
+		red[i] = rgba[i * 4 + 0];
+		green[i] = rgba[i * 4 + 1];
+	}
+	CompressBlockBC4(red, out);
+	CompressBlockBC4(green, out + 8);
+}
+
+// ===================== BC7 (mode 6) =====================
+
+// --------------------------------------------------------
+// Mode 6 endpoints are 7 bits per channel plus one shared
+// low bit (p-bit) per endpoint, so pick whichever p-bit
+// lands the whole endpoint closest
+// --------------------------------------------------------
+static void QuantizeBC7Endpoint(const float endpoint[4], unsigned int quantized[4], unsigned int& pBit)
+{
+	float bestError = FLT_MAX;
+	for (unsigned int p = 0; p < 2; p++)
+	{
+		unsigned int candidate[4];
+		float error = 0.0f;
+		for (int c = 0; c < 4; c++)
+		{
+			int v = (int)std::floor((endpoint[c] - p) / 2.0f + 0.5f);
+			candidate[c] = (unsigned int)std::min(std::max(v, 0), 127);
+			float d = (float)(candidate[c] * 2 + p) - endpoint[c];
+			error += d * d;
+		}
+		if (error < bestError)
+		{
+			bestError = error;
+			pBit = p;
+			memcpy(quantized, candidate, sizeof(candidate));
+		}
+	}
+}
+
+// Picks the nearest of the 16 interpolated colors for each pixel, returning the total error
+static int SelectBC7Indices(const float pixels[16][4], const int c0[4], const int c1[4], unsigned char indices[16])
+{
+	int palette[16][4];
+	for (int p = 0; p < 16; p++)
+		for (int c = 0; c < 4; c++)
+			palette[p][c] = ((64 - BC7Weights4[p]) * c0[c] + BC7Weights4[p] * c1[c] + 32) >> 6;
+
+	int totalError = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		int bestError = INT_MAX;
+		for (int p = 0; p < 16; p++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int d = (int)pixels[i][c] - palette[p][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = p;
+			}
+		}
+		indices[i] = (unsigned char)best;
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+void CompressBlockBC7(const unsigned char rgba[64], unsigned char out[16])
+{
+	float pixels[16][4];
+	LoadBlock(rgba, pixels);
+
+	float e0[4], e1[4];
+	FindPrincipalEndpoints(pixels, 4, e0, e1);
+
+	unsigned int best0[4], best1[4], bestP0 = 0, bestP1 = 0;
+	unsigned char bestIndices[16];
+	int bestError = INT_MAX;
+
+	for (int iteration = 0; iteration <= RefineIterations; iteration++)
+	{
+		unsigned int q0[4], q1[4], p0 = 0, p1 = 0;
+		QuantizeBC7Endpoint(e0, q0, p0);
+		QuantizeBC7Endpoint(e1, q1, p1);
+
+		int c0[4], c1[4];
+		for (int c = 0; c < 4; c++)
+		{
+			c0[c] = (int)(q0[c] * 2 + p0);
+			c1[c] = (int)(q1[c] * 2 + p1);
+		}
+
+		unsigned char indices[16];
+		int error = SelectBC7Indices(pixels, c0, c1, indices);
+		if (error >= bestError)
+			break;
+
+		memcpy(best0, q0, sizeof(q0));
+		memcpy(best1, q1, sizeof(q1));
+		bestP0 = p0;
+		bestP1 = p1;
+		memcpy(bestIndices, indices, sizeof(indices));
+		bestError = error;
+
+		// Refit the unquantized endpoints to these indices for the next round
+		float weights[16];
+		for (int i = 0; i < 16; i++)
+			weights[i] = BC7Weights4[indices[i]] / 64.0f;
+		if (!FitEndpoints(pixels, 4, weights, e0, e1))
+			break;
+	}
+
+	// The first index is stored with an implied 0 high bit, so
+	// swap the endpoints if it would need it
+	if (bestIndices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(best0[c], best1[c]);
+		std::swap(bestP0, bestP1);
+		for (int i = 0; i < 16; i++)
+			bestIndices[i] = (unsigned char)(15 - bestIndices[i]);
+	}
+
+	memset(out, 0, 16);
+	int offset = 0;
+	WriteBits(out, offset, 1u << 6, 7); // Mode 6
+	for (int c = 0; c < 4; c++)
+	{
+		WriteBits(out, offset, best0[c], 7);
+		WriteBits(out, offset, best1[c], 7);
+	}
+	WriteBits(out, offset, bestP0, 1);
+	WriteBits(out, offset, bestP1, 1);
+	WriteBits(out, offset, bestIndices[0], 3);
+	for (int i = 1; i < 16; i++)
+		WriteBits(out, offset, bestIndices[i], 4);
+}
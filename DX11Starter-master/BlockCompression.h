@@ -0,0 +1,17 @@
+#pragma once
+
+// --------------------------------------------------------
+// CPU encoders for single 4x4 blocks of the BCn formats.
+//
+// Input blocks are 16 pixels in row-major order.  RGBA input
+// is 4 bytes per pixel, single channel input 1 byte per pixel.
+//
+// - BC1: 8 bytes, RGB at 4bpp (alpha ignored)
+// - BC4: 8 bytes, one channel at 4bpp
+// - BC5: 16 bytes, two channels (taken from R and G)
+// - BC7: 16 bytes, RGBA at 8bpp (mode 6 only)
+// --------------------------------------------------------
+void CompressBlockBC1(const unsigned char rgba[64], unsigned char out[8]);
+void CompressBlockBC4(const unsigned char values[16], unsigned char out[8]);
+void CompressBlockBC5(const unsigned char rgba[64], unsigned char out[16]);
+void CompressBlockBC7(const unsigned char rgba[64], unsigned char out[16]);
@@ -23,11 +23,18 @@ struct RaytracingSceneData
 	float pad0;
 };
 
-// Ensure this matches Raytracing shader define!
-#define MAX_INSTANCES_PER_BLAS 100
+// Per hit group (mesh) data for raytracing
 struct RaytracingEntityData
 {
-	DirectX::XMFLOAT4 color[MAX_INSTANCES_PER_BLAS];
-	DirectX::XMFLOAT4 lightHue[MAX_INSTANCES_PER_BLAS];
 	DirectX::XMFLOAT3 hardLightPoint;
+	float pad0;
+};
+
+// Per instance data for raytracing, one entry for every instance in
+// the TLAS and indexed by InstanceIndex().  Ensure this matches the
+// Raytracing shader's struct!
+struct RaytracingInstanceData
+{
+	DirectX::XMFLOAT4 color;
+	DirectX::XMFLOAT4 lightHue;
 };
\ No newline at end of file
@@ -87,7 +87,7 @@ void Camera::Update(float dt)
 void Camera::UpdateViewMatrix()
 {
 	// Setup
-	DirectX::XMFLOAT3 pos = *(transform->GetPosition().get());
+	DirectX::XMFLOAT3 pos = transform->GetPosition();
 	DirectX::XMFLOAT3 fwd = transform->GetForward();
 
 	// Build view and store 
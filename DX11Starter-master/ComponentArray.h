@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+
+// No entity, or no component for one
+#define ENTITY_NONE 0xFFFFFFFF
+
+// Entity IDs are a slot in the low bits and an 8 bit generation in the high
+// ones, so an ID kept after its entity is destroyed doesn't match the slot's
+// next one - until the slot has been reused 256 times and the generation wraps
+#define ENTITY_INDEX_BITS 24
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+
+// --------------------------------------------------------
+// One type of component for any number of entities, kept
+// packed together in a dense array (a "sparse set").
+//
+// Systems walk GetData() and GetEntities() front to back,
+// which touches nothing but the components themselves.
+// Looking one up by entity goes through a slot -> position
+// table instead.  Removing moves the last component into
+// the hole, so the order changes but never has gaps.
+// --------------------------------------------------------
+template<typename T>
+class ComponentArray
+{
+public:
+	// Adds a component to an entity, or replaces the one it has
+	T& Add(unsigned int entity, const T& component)
+	{
+		unsigned int slot = entity & ENTITY_INDEX_MASK;
+		if (slot >= positions.size())
+			positions.resize(slot + 1, ENTITY_NONE);
+
+		unsigned int& position = positions[slot];
+		if (position != ENTITY_NONE)
+		{
+			entities[position] = entity;
+			components[position] = component;
+			return components[position];
+		}
+
+		position = (unsigned int)components.size();
+		components.push_back(component);
+		entities.push_back(entity);
+		return components.back();
+	}
+
+	void Remove(unsigned int entity)
+	{
+		unsigned int slot = entity & ENTITY_INDEX_MASK;
+		if (slot >= positions.size() || positions[slot] == ENTITY_NONE)
+			return;
+
+		// Fill the hole with the last one
+		unsigned int position = positions[slot];
+		unsigned int last = (unsigned int)components.size() - 1;
+		if (position != last)
+		{
+			components[position] = components[last];
+			entities[position] = entities[last];
+			positions[entities[position] & ENTITY_INDEX_MASK] = position;
+		}
+
+		components.pop_back();
+		entities.pop_back();
+		positions[slot] = ENTITY_NONE;
+	}
+
+	// The entity's component, or null if it doesn't have one
+	T* Find(unsigned int entity)
+	{
+		unsigned int slot = entity & ENTITY_INDEX_MASK;
+		if (slot >= positions.size() || positions[slot] == ENTITY_NONE)
+			return 0;
+
+		return &components[positions[slot]];
+	}
+
+	const T* Find(unsigned int entity) const
+	{
+		return const_cast<ComponentArray*>(this)->Find(entity);
+	}
+
+	bool Has(unsigned int entity) const { return Find(entity) != 0; }
+
+	void Clear()
+	{
+		components.clear();
+		entities.clear();
+		positions.clear();
+	}
+
+	// Dense arrays, GetCount() long, in the same order
+	T* GetData() { return components.data(); }
+	const T* GetData() const { return components.data(); }
+	const unsigned int* GetEntities() const { return entities.data(); }
+	unsigned int GetCount() const { return (unsigned int)components.size(); }
+
+private:
+	std::vector<T> components;
+	std::vector<unsigned int> entities;
+
+	// Entity slot -> position in the dense arrays
+	std::vector<unsigned int> positions;
+};
@@ -1,7 +1,12 @@
 #include "DX12Helper.h"
+#include "TextureCooker.h"
 
+#include <cstdlib>
+#include <climits>
+#include <cstdio>
 
 #include "packages/directxtk12_desktop_2019.2024.1.1.1/include/WICTextureLoader.h"
+#include "packages/directxtk12_desktop_2019.2024.1.1.1/include/DDSTextureLoader.h"
 #include "packages/directxtk12_desktop_2019.2024.1.1.1/include/ResourceUploadBatch.h"
 using namespace DirectX;
 
@@ -47,7 +52,8 @@ void DX12Helper::CloseExecuteAndResetCommandList()
 	// Always wait before reseting command allocator, as it should not
 	// be reset while the GPU is processing a command list
 	// See: https://docs.microsoft.com/en-us/windows/desktop/api/d3d12/nf-d3d12-id3d12commandallocator-reset
-	WaitForGPU();
+	FinishFrame();
+	WaitForFence(waitFenceCounter);
 	commandAllocator->Reset();
 	commandList->Reset(commandAllocator.Get(), 0);
 }
@@ -62,17 +68,39 @@ void DX12Helper::WaitForGPU()
 	// and then place that value into the GPU's command queue
 	waitFenceCounter++;
 	commandQueue->Signal(waitFence.Get(), waitFenceCounter);
+	WaitForFence(waitFenceCounter);
+}
+
+// --------------------------------------------------------
+// Waits until the GPU has passed an earlier signal
+// --------------------------------------------------------
+void DX12Helper::WaitForFence(UINT64 fenceValue)
+{
 	// Check to see if the most recently completed fence value
-	// is less than the one we just set.
-	if (waitFence->GetCompletedValue() < waitFenceCounter)
+	// is less than the one we're after.
+	if (waitFence->GetCompletedValue() < fenceValue)
 	{
 		// Tell the fence to let us know when it's hit, and then
 		// sit an wait until that fence is hit.
-		waitFence->SetEventOnCompletion(waitFenceCounter, waitFenceEvent);
+		waitFence->SetEventOnCompletion(fenceValue, waitFenceEvent);
 		WaitForSingleObject(waitFenceEvent, INFINITE);
 	}
 }
 
+// --------------------------------------------------------
+// Signals the fence behind everything submitted so far and
+// ties the constant buffers (and their CBVs) filled since
+// the last call to that value.  Nothing waits here - the
+// space is only reclaimed once the GPU gets past it.
+// --------------------------------------------------------
+void DX12Helper::FinishFrame()
+{
+	waitFenceCounter++;
+	commandQueue->Signal(waitFence.Get(), waitFenceCounter);
+	cbUploadRing.FinishFrame(waitFenceCounter);
+	cbvDescriptorRing.FinishFrame(waitFenceCounter);
+}
+
 // --------------------------------------------------------
 // Helper for creating a static buffer that will get
 // data once and remain immutable
@@ -82,7 +110,7 @@ void DX12Helper::WaitForGPU()
 // data - Pointer to the data itself
 // --------------------------------------------------------
 Microsoft::WRL::ComPtr<ID3D12Resource> DX12Helper::CreateStaticBuffer(
-	unsigned int dataStride, unsigned int dataCount, void* data)
+	unsigned int dataStride, unsigned int dataCount, const void* data)
 {
 	// The overall buffer we'll be creating
 	Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
@@ -156,9 +184,11 @@ Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> DX12Helper::GetCBVSRVDescriptorHeap
 
 
 // --------------------------------------------------------
-// Copies the given data into the next "unused" spot in the CBV upload heap (wrapping at the end, since 
-// we treat it like a ring buffer). Then creates a CBV in the next "unused" spot in the CBV heap that
-// points to the aforementioned spot in the upload heap and returns that CBV (a GPU descriptor handle).
+// Copies the given data into the next unused spot in the CBV upload heap (treated as a ring buffer,
+// only reusing space from frames the GPU has finished). Then creates a CBV in the next unused spot in
+// the CBV heap that points to the aforementioned spot in the upload heap and returns that CBV (a GPU
+// descriptor handle).  The ring holds a full frame (see maxConstantBuffers), so a frame that needs
+// more than all of it is a bug - that aborts rather than overwrite constant buffers it has already bound.
 // 
 // data - The data to copy to the GPU
 // dataSizeInBytes - The byte size of the data to copy
@@ -168,12 +198,20 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 {
 	// How much space will we need? Each CBV must point to a chunk of the upload heap that is
 	// a multiple of 256 bytes, so we need to calculate and reserve that amount.
-	SIZE_T reservationSize = (SIZE_T)dataSizeInBytes;
+	SIZE_T reservationSize = dataSizeInBytes > 0 ? (SIZE_T)dataSizeInBytes : 1;
 	reservationSize = (reservationSize + 255) / 256 * 256; // Integer division trick
-	// Ensure this upload will fit in the remaining space. If not, reset to beginning.
-	if (cbUploadHeapOffsetInBytes + reservationSize >= cbUploadHeapSizeInBytes)
-		cbUploadHeapOffsetInBytes = 0;
-	// Where in the upload heap will this data go?
+	// Where in the upload heap will this data go, and which CBV will point to it?
+	UINT64 cbUploadHeapOffsetInBytes = AllocateFromRing(cbUploadRing, reservationSize, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	UINT64 cbvDescriptorOffset = AllocateFromRing(cbvDescriptorRing, 1, 1);
+	if (cbUploadHeapOffsetInBytes == UPLOAD_RING_NONE || cbvDescriptorOffset == UPLOAD_RING_NONE)
+	{
+		// One frame needs more than the whole ring - raise MAX_EXTRA_CONSTANT_BUFFERS_PER_FRAME
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Constant buffer ring full: one frame needs more than %u constant buffers (or %llu bytes)\n",
+			maxConstantBuffers, (unsigned long long)cbUploadHeapSizeInBytes);
+#endif
+		abort();
+	}
 	D3D12_GPU_VIRTUAL_ADDRESS virtualGPUAddress = cbUploadHeap->GetGPUVirtualAddress() + cbUploadHeapOffsetInBytes;
 	// === Copy data to the upload heap ===
 	{
@@ -183,11 +221,6 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 			(SIZE_T)cbUploadHeapStartAddress + cbUploadHeapOffsetInBytes);
 		// Perform the mem copy to put new data into this part of the heap
 		memcpy(uploadAddress, data, dataSizeInBytes);
-		// Increment the offset and loop back to the beginning if necessary,
-		// allowing us to treat the upload heap like a ring buffer
-		cbUploadHeapOffsetInBytes += reservationSize;
-		if (cbUploadHeapOffsetInBytes >= cbUploadHeapSizeInBytes)
-			cbUploadHeapOffsetInBytes = 0;
 	}
 	// Create a CBV for this section of the heap
 	{
@@ -204,17 +237,33 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::FillNextConstantBufferAndGetGPUDescripto
 		cbvDesc.SizeInBytes = (UINT)reservationSize;
 		// Create the CBV, which is a lightweight operation in DX12
 		device->CreateConstantBufferView(&cbvDesc, cpuHandle);
-		// Increment the offset and loop back to the beginning if necessary
-		// which allows us to treat the descriptor heap as a ring buffer
-		cbvDescriptorOffset++;
-		if (cbvDescriptorOffset >= maxConstantBuffers)
-			cbvDescriptorOffset = 0;
 		// Now that the CBV is ready, we return the GPU handle to it
 		// so it can be set as part of the root signature during drawing
 		return gpuHandle;
 	}
 }
 
+// --------------------------------------------------------
+// Space from one of the constant buffer rings.  When the
+// frames in flight hold too much, waits for the oldest to
+// finish (and then the next, and so on).  If the frame being
+// recorded has filled the ring on its own there's nothing
+// to wait for - everything in it is still bound by commands
+// that haven't run - so this gives back UPLOAD_RING_NONE.
+// --------------------------------------------------------
+UINT64 DX12Helper::AllocateFromRing(UploadRing& ring, UINT64 size, UINT64 alignment)
+{
+	ring.Retire(waitFence->GetCompletedValue());
+	UINT64 offset = ring.Allocate(size, alignment);
+	while (offset == UPLOAD_RING_NONE && ring.GetOldestFenceValue() != 0)
+	{
+		WaitForFence(ring.GetOldestFenceValue());
+		ring.Retire(waitFence->GetCompletedValue());
+		offset = ring.Allocate(size, alignment);
+	}
+	return offset;
+}
+
 // --------------------------------------------------------
 // Creates a single CB upload heap which will store all
 // constant buffer data for the entire program. This
@@ -227,9 +276,9 @@ void DX12Helper::CreateConstantBufferUploadHeap()
 	// We'll support up to the max number of CBs if they're
 	// all 256 bytes or less, or fewer overall CBs if they're larger
 	cbUploadHeapSizeInBytes = maxConstantBuffers * 256;
-	// Assume the first CB will start at the beginning of the heap
-	// This offset changes as we use more CBs, and wraps around when full
-	cbUploadHeapOffsetInBytes = 0;
+	// CBs are handed out from the start of the heap, wrapping around
+	// once the GPU is done with the ones from earlier frames
+	cbUploadRing.Initialize(cbUploadHeapSizeInBytes);
 	// Create the upload heap for our constant buffer
 	D3D12_HEAP_PROPERTIES heapProps = {};
 	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
@@ -282,9 +331,9 @@ void DX12Helper::CreateCBVSRVDescriptorHeap()
 	dhDesc.NumDescriptors = maxConstantBuffers + maxTextureDescriptors; // How many descriptors will we need?
 	dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV; // This heap can store CBVs, SRVs and UAVs
 	device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(cbvSrvDescriptorHeap.GetAddressOf()));
-	// Assume the first CBV will be at the beginning of the heap
-	// This will increase as we use more CBVs and will wrap back to 0
-	cbvDescriptorOffset = 0;
+	// CBVs come from the beginning of the heap, and wrap around
+	// the same way as the upload heap they point into
+	cbvDescriptorRing.Initialize(maxConstantBuffers);
 
 	// Assume the first SRV will be after all possible CBVs
 	srvDescriptorOffset = maxConstantBuffers;
@@ -304,6 +353,24 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::HeapSRVsToDescHeap(UINT numDescriptorsTo
 		cbvSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart();
 	cpuHandle.ptr += (SIZE_T)srvDescriptorOffset * cbvSrvDescriptorHeapIncrementSize;
 	gpuHandle.ptr += (SIZE_T)srvDescriptorOffset * cbvSrvDescriptorHeapIncrementSize;
+	// No texture (one that failed to load) - fill in null SRVs, which read as zero
+	if (firstDescriptorToCopy.ptr == 0)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC nullDesc = {};
+		nullDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		nullDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		nullDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		nullDesc.Texture2D.MipLevels = 1;
+		for (UINT i = 0; i < numDescriptorsToCopy; i++)
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE nullHandle = cpuHandle;
+			nullHandle.ptr += i * cbvSrvDescriptorHeapIncrementSize;
+			device->CreateShaderResourceView(0, &nullDesc, nullHandle);
+		}
+		srvDescriptorOffset += numDescriptorsToCopy;
+		return gpuHandle;
+	}
+
 	// We know where to copy these descriptors, so copy all of them and remember the new offset
 	device->CopyDescriptorsSimple(
 		numDescriptorsToCopy,
@@ -311,30 +378,128 @@ D3D12_GPU_DESCRIPTOR_HANDLE DX12Helper::HeapSRVsToDescHeap(UINT numDescriptorsTo
 		firstDescriptorToCopy,
 		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	srvDescriptorOffset += numDescriptorsToCopy;
+
+	// Streamed textures replace their resource now and then, so
+	// remember where their SRVs ended up to update these copies
+	for (UINT i = 0; i < numDescriptorsToCopy; i++)
+	{
+		auto streamed = streamedTextures.find(firstDescriptorToCopy.ptr + i * cbvSrvDescriptorHeapIncrementSize);
+		if (streamed != streamedTextures.end())
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE copy = cpuHandle;
+			copy.ptr += i * cbvSrvDescriptorHeapIncrementSize;
+			streamed->second->ShaderVisibleCopies.push_back(copy);
+		}
+	}
+
 	// Pass back the GPU handle to the start of this section
 	// in the final CBV/SRV heap so the caller can use it later
 	return gpuHandle;
 }
 
+// --------------------------------------------------------
+// Builds the cache key for a texture file.  Relative paths,
+// ".." segments and letter case are normalized so the same
+// file always maps to the same entry.
+// --------------------------------------------------------
+std::wstring DX12Helper::GetTextureCacheKey(const wchar_t* file, bool generateMips)
+{
+	wchar_t fullPath[MAX_PATH] = {};
+	DWORD length = GetFullPathNameW(file, MAX_PATH, fullPath, 0);
+	std::wstring key = (length > 0 && length < MAX_PATH) ? fullPath : file;
+	CharLowerBuffW(&key[0], (DWORD)key.size());
+
+	// Same file with and without mips are different textures
+	key += generateMips ? L"|mips" : L"|nomips";
+	return key;
+}
+
+// --------------------------------------------------------
+// Loads a texture and creates an SRV for it on a CPU-side
+// heap.  Files that are already loaded are not decoded or
+// uploaded again - the existing SRV is returned instead.
+// --------------------------------------------------------
 D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(const wchar_t* file, bool generateMips)
 {
+	D3D12_CPU_DESCRIPTOR_HANDLE cachedSRV = {};
+	if (AcquireCachedTexture(file, generateMips, &cachedSRV))
+		return cachedSRV;
+
 	// Helper function from DXTK for uploading a resource
 	// (like a texture) to the appropriate GPU memory
 	ResourceUploadBatch upload(device.Get());
 	upload.Begin();
-	// Attempt to create the texture
+	// Attempt to create the texture, preferring the cooked (block
+	// compressed, pre-mipped) copy and falling back to the source image
 	Microsoft::WRL::ComPtr<ID3D12Resource> texture;
-	CreateWICTextureFromFile(device.Get(), upload, file, texture.GetAddressOf(),
-		generateMips);
+	std::wstring cooked = GetCookedTexture(file, generateMips);
+
+	// Our own cooked files stream, starting with only the mip tail
+	std::shared_ptr<MappedFile> cookedFile;
+	std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+	if (!cooked.empty())
+	{
+		cookedFile = std::make_shared<MappedFile>(cooked.c_str());
+		if (CreateCookedTexture(cookedFile, UINT_MAX, texture, subresources))
+		{
+			upload.Upload(texture.Get(), 0, subresources.data(), (UINT)subresources.size());
+			upload.Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		}
+		else
+		{
+			cookedFile.reset();
+		}
+	}
+
+	if (!texture && (cooked.empty() ||
+		FAILED(CreateDDSTextureFromFile(device.Get(), upload, cooked.c_str(), texture.GetAddressOf()))))
+	{
+		CreateWICTextureFromFile(device.Get(), upload, file, texture.GetAddressOf(),
+			generateMips);
+	}
 	// Perform the upload and wait for it to finish before returning the texture
 	auto finish = upload.End(commandQueue.Get());
 	finish.wait();
 
-	// Now that we have the texture, add to our list and make a CPU-side descriptor heap
-	// just for this texture's SRV. Note that it would probably be better to put all
-	// texture SRVs into the same descriptor heap, but we don't know how many we'll need
-	// until they're all loaded and this is a quick and dirty implementation!
-	textures.push_back(texture);
+	if (cookedFile)
+		return AddStreamedTexture(file, generateMips, texture, cookedFile);
+	return AddTexture(file, generateMips, texture);
+}
+
+// --------------------------------------------------------
+// Adds a reference to an already loaded texture, if there is one
+// --------------------------------------------------------
+bool DX12Helper::AcquireCachedTexture(const wchar_t* file, bool generateMips, D3D12_CPU_DESCRIPTOR_HANDLE* srv)
+{
+	auto cached = textureCache.find(GetTextureCacheKey(file, generateMips));
+	if (cached == textureCache.end())
+		return false;
+
+	cached->second.RefCount++;
+	*srv = cached->second.SRV;
+	return true;
+}
+
+// --------------------------------------------------------
+// Takes ownership of a freshly uploaded texture, creates its
+// SRV and adds it to the cache with a single reference.  A
+// null texture (a failed load) gives back an empty handle.
+// --------------------------------------------------------
+D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::AddTexture(const wchar_t* file, bool generateMips, Microsoft::WRL::ComPtr<ID3D12Resource> texture)
+{
+	// Someone beat us to it (the same file under a different path) - use theirs
+	D3D12_CPU_DESCRIPTOR_HANDLE cachedSRV = {};
+	if (AcquireCachedTexture(file, generateMips, &cachedSRV))
+		return cachedSRV;
+
+	// Failed to load - nothing to cache, so a later attempt can try again
+	if (!texture)
+		return D3D12_CPU_DESCRIPTOR_HANDLE{};
+
+	// Make a CPU-side descriptor heap just for this texture's SRV. Note that it
+	// would probably be better to put all texture SRVs into the same descriptor
+	// heap, but we don't know how many we'll need until they're all loaded
+	// and this is a quick and dirty implementation!
 	// Create the CPU-SIDE descriptor heap for our descriptor
 	D3D12_DESCRIPTOR_HEAP_DESC dhDesc = {};
 	dhDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE; // Non-shader visible for CPU-side-only desc heap
@@ -344,17 +509,270 @@ D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::LoadTexture(const wchar_t* file, bool ge
 	dhDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> descHeap;
 	device->CreateDescriptorHeap(&dhDesc, IID_PPV_ARGS(descHeap.GetAddressOf()));
-	cpuSideTextureDescriptorHeaps.push_back(descHeap);
 
 	// Create the SRV on this descriptor heap
 	// Note: Using a null description results in the "default" SRV (same format, all mips, all array slices, etc.)
 	D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = descHeap->GetCPUDescriptorHandleForHeapStart();
 	device->CreateShaderResourceView(texture.Get(), 0, cpuHandle);
+
+	// Remember it for anyone else asking for the same file
+	CachedTexture entry = {};
+	entry.Resource = texture;
+	entry.DescriptorHeap = descHeap;
+	entry.SRV = cpuHandle;
+	entry.RefCount = 1;
+	entry.ResidencyID = TEXTURE_RESIDENCY_NONE;
+	textureCache[GetTextureCacheKey(file, generateMips)] = entry;
+
 	// Return the CPU descriptor handle, which can be used to
 	// copy the descriptor to a shader-visible heap later
 	return cpuHandle;
 }
 
+// --------------------------------------------------------
+// Adds a reference to the texture behind this SRV, for
+// anyone holding on to an SRV they didn't load themselves
+// --------------------------------------------------------
+void DX12Helper::AddTextureReference(D3D12_CPU_DESCRIPTOR_HANDLE srv)
+{
+	for (auto it = textureCache.begin(); it != textureCache.end(); it++)
+	{
+		if (it->second.SRV.ptr == srv.ptr)
+		{
+			it->second.RefCount++;
+			return;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Drops one reference to the texture behind this SRV.  The
+// texture stays loaded (so reloading it is free) until
+// EvictUnusedTextures() is called.
+// --------------------------------------------------------
+void DX12Helper::ReleaseTexture(D3D12_CPU_DESCRIPTOR_HANDLE srv)
+{
+	for (auto it = textureCache.begin(); it != textureCache.end(); it++)
+	{
+		if (it->second.SRV.ptr == srv.ptr)
+		{
+			if (it->second.RefCount > 0)
+				it->second.RefCount--;
+			return;
+		}
+	}
+}
+
+// --------------------------------------------------------
+// Frees every texture nobody holds a reference to anymore.
+// Descriptors copied to the shader-visible heap may still be
+// referenced by in-flight command lists, so this waits for
+// the GPU before letting go of anything.
+// --------------------------------------------------------
+unsigned int DX12Helper::EvictUnusedTextures()
+{
+	bool anyUnused = false;
+	for (auto it = textureCache.begin(); it != textureCache.end() && !anyUnused; it++)
+		anyUnused = it->second.RefCount == 0;
+	if (!anyUnused)
+		return 0;
+
+	WaitForGPU();
+
+	unsigned int evicted = 0;
+	for (auto it = textureCache.begin(); it != textureCache.end();)
+	{
+		if (it->second.RefCount == 0)
+		{
+			streamedTextures.erase(it->second.SRV.ptr);
+			textureResidency.RemoveTexture(it->second.ResidencyID);
+			it = textureCache.erase(it);
+			evicted++;
+		}
+		else
+		{
+			it++;
+		}
+	}
+	return evicted;
+}
+
+
+// --------------------------------------------------------
+// Creates a texture holding mips [firstMip, end) of a cooked
+// .dds, along with subresource data pointing into the mapped
+// file.  Asking for a mip past the tail starts at the tail.
+// Only touches the device, so it's safe on any thread.
+// --------------------------------------------------------
+bool DX12Helper::CreateCookedTexture(
+	std::shared_ptr<MappedFile> cookedFile,
+	unsigned int firstMip,
+	Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+	std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+	unsigned int* loadedMip)
+{
+	CookedTextureLayout layout = {};
+	if (!cookedFile || !cookedFile->IsValid() ||
+		!ReadCookedTextureLayout(cookedFile->GetData(), cookedFile->GetSize(), layout))
+		return false;
+
+	// Block compressed textures need a top level that's a multiple of 4
+	firstMip = min(firstMip, TextureResidency::GetTailMip(layout.Width, layout.Height, layout.MipCount));
+	while (firstMip > 0 && (((layout.Width >> firstMip) % 4) != 0 || ((layout.Height >> firstMip) % 4) != 0))
+		firstMip--;
+	if ((layout.Width >> firstMip) % 4 != 0 || (layout.Height >> firstMip) % 4 != 0)
+		return false;
+
+	D3D12_HEAP_PROPERTIES heapProps = {};
+	heapProps.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+	heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+	heapProps.CreationNodeMask = 1;
+	heapProps.VisibleNodeMask = 1;
+
+	D3D12_RESOURCE_DESC desc = {};
+	desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+	desc.Width = layout.Width >> firstMip;
+	desc.Height = layout.Height >> firstMip;
+	desc.DepthOrArraySize = 1;
+	desc.MipLevels = (UINT16)(layout.MipCount - firstMip);
+	desc.Format = (DXGI_FORMAT)layout.DXGIFormat;
+	desc.SampleDesc.Count = 1;
+	desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> created;
+	if (FAILED(device->CreateCommittedResource(
+		&heapProps,
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		0,
+		IID_PPV_ARGS(created.GetAddressOf()))))
+		return false;
+
+	subresources.resize(desc.MipLevels);
+	for (unsigned int i = 0; i < desc.MipLevels; i++)
+	{
+		unsigned int mip = firstMip + i;
+		subresources[i].pData = cookedFile->GetData() + layout.MipOffsets[mip];
+		subresources[i].RowPitch = layout.MipRowPitches[mip];
+		subresources[i].SlicePitch = (LONG_PTR)layout.MipSizes[mip];
+	}
+
+	texture = created;
+	if (loadedMip)
+		*loadedMip = firstMip;
+	return true;
+}
+
+// --------------------------------------------------------
+// Adds a texture made by CreateCookedTexture() to the cache
+// and hands it to the residency manager
+// --------------------------------------------------------
+D3D12_CPU_DESCRIPTOR_HANDLE DX12Helper::AddStreamedTexture(const wchar_t* file, bool generateMips, Microsoft::WRL::ComPtr<ID3D12Resource> texture, std::shared_ptr<MappedFile> cookedFile)
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE srv = AddTexture(file, generateMips, texture);
+	if (srv.ptr == 0)
+		return srv;
+
+	// Already loaded under another path - that copy is the one that streams
+	CachedTexture& entry = textureCache[GetTextureCacheKey(file, generateMips)];
+	if (entry.Resource != texture)
+		return srv;
+
+	CookedTextureLayout layout = {};
+	if (!texture || !ReadCookedTextureLayout(cookedFile->GetData(), cookedFile->GetSize(), layout))
+		return srv;
+
+	unsigned long long mipBytes[TEXTURE_COOK_MAX_MIPS] = {};
+	for (unsigned int i = 0; i < layout.MipCount; i++)
+		mipBytes[i] = layout.MipSizes[i];
+
+	unsigned int residentMip = layout.MipCount - texture->GetDesc().MipLevels;
+	entry.CookedFile = cookedFile;
+	entry.ResidencyID = textureResidency.AddTexture(layout.Width, layout.Height, layout.MipCount, mipBytes, residentMip);
+	streamedTextures[srv.ptr] = &entry;
+	return srv;
+}
+
+// --------------------------------------------------------
+// Feedback for streaming: roughly how many pixels across the
+// texture behind this SRV covers this frame
+// --------------------------------------------------------
+void DX12Helper::ReportTextureCoverage(D3D12_CPU_DESCRIPTOR_HANDLE srv, float pixelsAcross)
+{
+	auto it = streamedTextures.find(srv.ptr);
+	if (it != streamedTextures.end())
+		textureResidency.ReportCoverage(it->second->ResidencyID, pixelsAcross);
+}
+
+// --------------------------------------------------------
+// Applies this frame's residency decisions.  Each changed
+// texture is rebuilt with its new set of mips (straight from
+// the mapped cooked file) and its SRVs are repointed.
+//
+// Repointing is only safe while the GPU isn't using them, so
+// this relies on being called after Draw()'s per-frame
+// WaitForGPU().  The uploads go out as one batch on the main
+// queue, ahead of this frame's command list, so nothing waits
+// on them here - the next call (a frame later) collects them.
+// --------------------------------------------------------
+void DX12Helper::UpdateTextureStreaming()
+{
+	// Last frame's batch is done by now; this frees its staging memory
+	if (streamingUpload.valid())
+		streamingUpload.wait();
+
+	std::vector<TextureResidencyChange> changes;
+	textureResidency.Update(changes);
+	if (changes.empty())
+		return;
+
+	ResourceUploadBatch upload(device.Get());
+	upload.Begin();
+
+	std::vector<std::pair<CachedTexture*, Microsoft::WRL::ComPtr<ID3D12Resource>>> rebuilt;
+	for (auto& streamed : streamedTextures)
+	{
+		CachedTexture& entry = *streamed.second;
+		for (TextureResidencyChange& change : changes)
+		{
+			if (change.Texture != entry.ResidencyID)
+				continue;
+
+			// The mip actually loaded can differ from the one asked for (block
+			// compression needs a top level that's a multiple of 4), and a failed
+			// load keeps the old resource - either way, tell the residency manager
+			Microsoft::WRL::ComPtr<ID3D12Resource> texture;
+			std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+			unsigned int loadedMip = change.OldMip;
+			if (CreateCookedTexture(entry.CookedFile, change.NewMip, texture, subresources, &loadedMip))
+			{
+				upload.Upload(texture.Get(), 0, subresources.data(), (UINT)subresources.size());
+				upload.Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				rebuilt.push_back(std::make_pair(&entry, texture));
+			}
+			if (loadedMip != change.NewMip)
+				textureResidency.SetResidentMip(change.Texture, loadedMip);
+			break;
+		}
+	}
+
+	streamingUpload = upload.End(commandQueue.Get());
+
+	// Swap in the new resources - the GPU is idle, so the old ones are freed right here
+	for (auto& r : rebuilt)
+	{
+		CachedTexture& entry = *r.first;
+		entry.Resource = r.second;
+		device->CreateShaderResourceView(entry.Resource.Get(), 0, entry.SRV);
+		for (D3D12_CPU_DESCRIPTOR_HANDLE copy : entry.ShaderVisibleCopies)
+			device->CopyDescriptorsSimple(1, copy, entry.SRV, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	}
+}
+
+TextureResidency& DX12Helper::GetTextureResidency() { return textureResidency; }
+
 
 // ======== Function Bodies =========
 
@@ -433,3 +851,13 @@ Microsoft::WRL::ComPtr<ID3D12CommandAllocator> DX12Helper::GetDefaultAllocator()
 {
 	return commandAllocator;
 }
+
+Microsoft::WRL::ComPtr<ID3D12Device> DX12Helper::GetDevice()
+{
+	return device;
+}
+
+Microsoft::WRL::ComPtr<ID3D12CommandQueue> DX12Helper::GetCommandQueue()
+{
+	return commandQueue;
+}
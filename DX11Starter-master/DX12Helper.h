@@ -3,8 +3,24 @@
 #include <d3d12.h>
 #include <wrl/client.h>
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <future>
 
+#include "MappedFile.h"
+#include "TextureResidency.h"
+#include "UploadRing.h"
 
+// Most hit groups in the raytracing shader table, each of which
+// corresponds to a unique combination of geometry & hit shader
+// (effectively the maximum number of unique mesh BLAS's).  Each
+// one needs its own constant buffer every frame.
+#define MAX_HIT_GROUPS_IN_SHADER_TABLE 1000
+
+// Constant buffers a frame uses on top of the hit groups' (the
+// raytracing scene data, plus room to grow)
+#define MAX_EXTRA_CONSTANT_BUFFERS_PER_FRAME 24
 
 class DX12Helper
 {
@@ -45,13 +61,17 @@ public:
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateStaticBuffer(
 		unsigned int dataStride,
 		unsigned int dataCount,
-		void* data);
+		const void* data);
 
 	// Command list & synchronization
 	void CloseExecuteAndResetCommandList();
 
 	void WaitForGPU();
 
+	// Call once a frame's command lists have been executed - the constant
+	// buffers it filled are reused once the GPU is past this point
+	void FinishFrame();
+
 private:
 	// Overall device
 	Microsoft::WRL::ComPtr<ID3D12Device> device;
@@ -70,6 +90,8 @@ private:
 	HANDLE waitFenceEvent;
 	unsigned long waitFenceCounter;
 
+	void WaitForFence(UINT64 fenceValue);
+
 public:
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> GetCBVSRVDescriptorHeap();
 	D3D12_GPU_DESCRIPTOR_HANDLE FillNextConstantBufferAndGetGPUDescriptorHandle(
@@ -80,27 +102,50 @@ private:
 
 	// Maximum number of constant buffers, assuming each buffer
 	// is 256 bytes or less. Larger buffers are fine, but will
-	// result in fewer buffers in use at any time
-	const unsigned int maxConstantBuffers = 1000;
+	// result in fewer buffers in use at any time.  One frame
+	// must fit, and a full shader table needs one per hit group.
+	const unsigned int maxConstantBuffers = MAX_HIT_GROUPS_IN_SHADER_TABLE + MAX_EXTRA_CONSTANT_BUFFERS_PER_FRAME;
 
-	// GPU-side constant buffer upload heap
+	// GPU-side constant buffer upload heap, handed out a frame at a time
 	Microsoft::WRL::ComPtr<ID3D12Resource> cbUploadHeap;
 	UINT64 cbUploadHeapSizeInBytes;
-	UINT64 cbUploadHeapOffsetInBytes;
+	UploadRing cbUploadRing;
 
 	void* cbUploadHeapStartAddress;
 
-	// GPU-side CBV/SRV descriptor heap
+	// GPU-side CBV/SRV descriptor heap - the first maxConstantBuffers
+	// descriptors are CBVs, handed out alongside the upload heap
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> cbvSrvDescriptorHeap;
 	SIZE_T cbvSrvDescriptorHeapIncrementSize;
-
-	unsigned int cbvDescriptorOffset;
+	UploadRing cbvDescriptorRing;
 
 	void CreateConstantBufferUploadHeap();
 	void CreateCBVSRVDescriptorHeap();
+	UINT64 AllocateFromRing(UploadRing& ring, UINT64 size, UINT64 alignment);
 
 public:
+	// Loads a texture, or hands back the existing SRV if this file was already
+	// loaded (each call adds a reference that ReleaseTexture() removes)
 	D3D12_CPU_DESCRIPTOR_HANDLE LoadTexture(const wchar_t* file, bool generateMips = true);
+	void AddTextureReference(D3D12_CPU_DESCRIPTOR_HANDLE srv);
+	void ReleaseTexture(D3D12_CPU_DESCRIPTOR_HANDLE srv);
+	// Cache access for loaders that upload textures themselves
+	bool AcquireCachedTexture(const wchar_t* file, bool generateMips, D3D12_CPU_DESCRIPTOR_HANDLE* srv);
+	D3D12_CPU_DESCRIPTOR_HANDLE AddTexture(const wchar_t* file, bool generateMips, Microsoft::WRL::ComPtr<ID3D12Resource> texture);
+	// Frees textures with no references left (waits for the GPU first)
+	unsigned int EvictUnusedTextures();
+	// Texture streaming - cooked textures start out with just their mip tail
+	// and gain (or lose) finer mips as their coverage on screen changes
+	bool CreateCookedTexture(
+		std::shared_ptr<MappedFile> cookedFile,
+		unsigned int firstMip,
+		Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+		unsigned int* loadedMip = 0);
+	D3D12_CPU_DESCRIPTOR_HANDLE AddStreamedTexture(const wchar_t* file, bool generateMips, Microsoft::WRL::ComPtr<ID3D12Resource> texture, std::shared_ptr<MappedFile> cookedFile);
+	void ReportTextureCoverage(D3D12_CPU_DESCRIPTOR_HANDLE srv, float pixelsAcross);
+	void UpdateTextureStreaming();
+	TextureResidency& GetTextureResidency();
 	D3D12_GPU_DESCRIPTOR_HANDLE CopySRVsToDescriptorHeapAndGetGPUDescriptorHandle(
 		D3D12_CPU_DESCRIPTOR_HANDLE firstDescriptorToCopy,
 		unsigned int numDescriptorsToCopy);
@@ -116,9 +161,35 @@ private:
 	// constant ensures we (hopefully) never run out of room.
 	const unsigned int maxTextureDescriptors = 1000;
 	unsigned int srvDescriptorOffset;
-	// Texture resources we need to keep alive
-	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> textures;
-	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> cpuSideTextureDescriptorHeaps;
+
+	// A loaded texture and the CPU-side heap holding its SRV
+	struct CachedTexture
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> DescriptorHeap;
+		D3D12_CPU_DESCRIPTOR_HANDLE SRV;
+		unsigned int RefCount;
+
+		// Streamed textures only: where the mips come from, and every
+		// shader visible copy of the SRV to fix up when the resource changes
+		std::shared_ptr<MappedFile> CookedFile;
+		unsigned int ResidencyID;
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> ShaderVisibleCopies;
+	};
+
+	// Texture resources we need to keep alive, keyed by full path (and mip option)
+	std::unordered_map<std::wstring, CachedTexture> textureCache;
+	std::wstring GetTextureCacheKey(const wchar_t* file, bool generateMips);
+
+	// Decides which mips of each streamed texture are loaded
+	TextureResidency textureResidency;
+
+	// Streamed textures by SRV (its ptr), so per-frame coverage reports
+	// don't have to search the whole cache
+	std::unordered_map<SIZE_T, CachedTexture*> streamedTextures;
+
+	// Last streaming upload, which finishes ahead of the frame using it
+	std::future<void> streamingUpload;
 
 public:
 	Microsoft::WRL::ComPtr<ID3D12Resource> CreateBuffer(
@@ -133,6 +204,8 @@ public:
 		D3D12_GPU_DESCRIPTOR_HANDLE* reservedGPUHandle);
 
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> GetDefaultAllocator();
+	Microsoft::WRL::ComPtr<ID3D12Device> GetDevice();
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> GetCommandQueue();
 
 };
 
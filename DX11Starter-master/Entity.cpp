@@ -1,29 +1,38 @@
 #include "Entity.h"
 
-Entity::Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
-	mesh(mesh), material(material)
+Entity::Entity(std::shared_ptr<EntityStore> store, std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
+	store(store)
 {
-	transform = std::make_shared<Transform>();
+	id = store->Create();
+	store->SetRenderable(id, mesh, material);
 }
 
-Entity::~Entity() {};
+Entity::~Entity()
+{
+	store->Destroy(id);
+}
 
 
 #pragma region GETTERS
 
+unsigned int Entity::GetID()
+{
+	return id;
+}
+
 std::shared_ptr<Mesh> Entity::GetMesh()
 {
-	return mesh;
+	return store->GetMesh(id);
 }
 
 std::shared_ptr<Transform> Entity::GetTransform()
 {
-	return transform;
+	return store->GetTransform(id);
 }
 
 std::shared_ptr<Material> Entity::GetMaterial()
 {
-	return material;
+	return store->GetMaterial(id);
 }
 
 #pragma endregion 
@@ -32,12 +41,12 @@ std::shared_ptr<Material> Entity::GetMaterial()
 
 void Entity::SetMesh(std::shared_ptr<Mesh> mesh)
 {
-	this->mesh = mesh;
+	store->SetRenderable(id, mesh, GetMaterial());
 }
 
 void Entity::SetMaterial(std::shared_ptr<Material> material)
 {
-	this->material = material;
+	store->SetRenderable(id, GetMesh(), material);
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
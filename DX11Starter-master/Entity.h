@@ -1,16 +1,24 @@
 #pragma once
-#include "Mesh.h"
-#include "Transform.h"
-#include "Material.h"
+#include "EntityStore.h"
 
+// --------------------------------------------------------
+// A handle to one entity in an EntityStore, which holds its
+// transform, mesh and material.  The entity lives as long
+// as the handle does.
+// --------------------------------------------------------
 class Entity
 {
 public:
 	// Constructor and Destructor 
-	Entity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	Entity(std::shared_ptr<EntityStore> store, std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
 	~Entity();
 
+	// Each handle owns its entity, so they can't be copied
+	Entity(Entity const&) = delete;
+	void operator=(Entity const&) = delete;
+
 	// Getters 
+	unsigned int GetID();
 	std::shared_ptr<Mesh> GetMesh();
 	std::shared_ptr<Transform> GetTransform();
 	std::shared_ptr<Material> GetMaterial();
@@ -19,10 +27,8 @@ public:
 	void SetMesh(std::shared_ptr<Mesh>);
 	void SetMaterial(std::shared_ptr<Material> material);
 private:
-	// Mesh pointer and transform
-	// Mesh must be specified on constructor 
-	std::shared_ptr<Mesh> mesh;
-	std::shared_ptr<Material> material;
-	std::shared_ptr<Transform> transform;
+	// Where the entity actually lives
+	std::shared_ptr<EntityStore> store;
+	unsigned int id;
 };
 
@@ -0,0 +1,315 @@
+#include "EntityStore.h"
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+EntityStore::EntityStore() :
+	count(0)
+{
+}
+
+// --------------------------------------------------------
+// Reuses a destroyed entity's slot when there is one.  The
+// slot's generation moved on when it was freed, so the new
+// ID differs from the old one.
+// --------------------------------------------------------
+unsigned int EntityStore::Create()
+{
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)generations.size();
+		generations.push_back(0);
+		transforms.push_back(0);
+		meshes.push_back(0);
+		materials.push_back(0);
+		clips.push_back(0);
+	}
+
+	transforms[slot] = std::make_shared<Transform>();
+	count++;
+	return ((unsigned int)generations[slot] << ENTITY_INDEX_BITS) | slot;
+}
+
+void EntityStore::Destroy(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	unsigned int slot = entity & ENTITY_INDEX_MASK;
+	renderables.Remove(entity);
+	bounds.Remove(entity);
+	animations.Remove(entity);
+	keyframes.Remove(entity);
+	transforms[slot].reset();
+	meshes[slot].reset();
+	materials[slot].reset();
+	clips[slot].reset();
+
+	generations[slot]++;
+	freeSlots.push_back(slot);
+	count--;
+}
+
+bool EntityStore::IsAlive(unsigned int entity)
+{
+	unsigned int slot = entity & ENTITY_INDEX_MASK;
+	return
+		slot < generations.size() &&
+		transforms[slot] &&
+		generations[slot] == (entity >> ENTITY_INDEX_BITS);
+}
+
+unsigned int EntityStore::GetCount()
+{
+	return count;
+}
+
+std::shared_ptr<Transform> EntityStore::GetTransform(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return 0;
+
+	return transforms[entity & ENTITY_INDEX_MASK];
+}
+
+void EntityStore::SetRenderable(unsigned int entity, std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material)
+{
+	if (!IsAlive(entity) || !mesh)
+		return;
+
+	unsigned int slot = entity & ENTITY_INDEX_MASK;
+	meshes[slot] = mesh;
+	materials[slot] = material;
+
+	RenderComponent component = {};
+	component.TransformIndex = transforms[slot]->GetIndex();
+	component.RenderMesh = mesh.get();
+	component.RenderMaterial = material.get();
+	renderables.Add(entity, component);
+
+	// One version behind the transform, so the world bounds get built
+	BoundsComponent box = {};
+	box.TransformIndex = component.TransformIndex;
+	box.TransformVersion = TransformStore::GetInstance().GetVersion(box.TransformIndex) - 1;
+	box.LocalBox = mesh->GetBounds();
+	box.LocalSphere = mesh->GetBoundingSphere();
+	bounds.Add(entity, box);
+}
+
+void EntityStore::RemoveRenderable(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	unsigned int slot = entity & ENTITY_INDEX_MASK;
+	renderables.Remove(entity);
+	bounds.Remove(entity);
+	meshes[slot].reset();
+	materials[slot].reset();
+}
+
+std::shared_ptr<Mesh> EntityStore::GetMesh(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return 0;
+
+	return meshes[entity & ENTITY_INDEX_MASK];
+}
+
+std::shared_ptr<Material> EntityStore::GetMaterial(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return 0;
+
+	return materials[entity & ENTITY_INDEX_MASK];
+}
+
+bool EntityStore::AddAnimationTrack(unsigned int entity, const AnimationTrack& track)
+{
+	// Unknown names from a scene file come through as the counts
+	if (!IsAlive(entity) || track.Channel >= ANIMATION_CHANNEL_COUNT || track.Curve >= ANIMATION_CURVE_COUNT)
+		return false;
+
+	AnimationComponent* animation = animations.Find(entity);
+	if (!animation)
+	{
+		AnimationComponent component = {};
+		component.TransformIndex = transforms[entity & ENTITY_INDEX_MASK]->GetIndex();
+		animation = &animations.Add(entity, component);
+	}
+
+	if (animation->TrackCount >= ANIMATION_MAX_TRACKS)
+		return false;
+
+	animation->Tracks[animation->TrackCount++] = track;
+	return true;
+}
+
+void EntityStore::RemoveAnimation(unsigned int entity)
+{
+	animations.Remove(entity);
+}
+
+void EntityStore::PlayKeyframeClip(unsigned int entity, std::shared_ptr<KeyframeClip> clip, float startTime, float speed, bool loop)
+{
+	if (!IsAlive(entity) || !clip)
+		return;
+
+	unsigned int slot = entity & ENTITY_INDEX_MASK;
+	clips[slot] = clip;
+
+	KeyframeComponent component = {};
+	component.TransformIndex = transforms[slot]->GetIndex();
+	component.Clip = clip.get();
+	component.StartTime = startTime;
+	component.Speed = speed;
+	component.Loop = loop ? 1 : 0;
+	keyframes.Add(entity, component);
+}
+
+void EntityStore::StopKeyframeClip(unsigned int entity)
+{
+	if (!IsAlive(entity))
+		return;
+
+	keyframes.Remove(entity);
+	clips[entity & ENTITY_INDEX_MASK].reset();
+}
+
+// --------------------------------------------------------
+// Brings every transform up to date first, which leaves
+// GetWorldMatrix() a plain read that's safe from the job
+// system.  The box is the local one's center moved into the
+// world, with extents summed from the absolute values of the
+// matrix's rows (Arvo's method), so no corners are needed.
+// --------------------------------------------------------
+void EntityStore::UpdateBounds()
+{
+	TransformStore& transforms = TransformStore::GetInstance();
+	transforms.UpdateWorldMatrices();
+
+	BoundsComponent* data = bounds.GetData();
+	JobSystem::GetInstance().ParallelFor(bounds.GetCount(), ENTITY_BOUNDS_PER_BATCH,
+		[&transforms, data](unsigned int start, unsigned int end)
+	{
+		for (unsigned int i = start; i < end; i++)
+		{
+			BoundsComponent& component = data[i];
+			unsigned int version = transforms.GetVersion(component.TransformIndex);
+			if (version == component.TransformVersion)
+				continue;
+
+			XMMATRIX world = XMLoadFloat4x4(&transforms.GetWorldMatrix(component.TransformIndex));
+			XMVECTOR extents = XMLoadFloat3(&component.LocalBox.Extents);
+			XMVECTOR worldExtents = XMVectorMultiply(XMVectorAbs(world.r[0]), XMVectorSplatX(extents));
+			worldExtents = XMVectorMultiplyAdd(XMVectorAbs(world.r[1]), XMVectorSplatY(extents), worldExtents);
+			worldExtents = XMVectorMultiplyAdd(XMVectorAbs(world.r[2]), XMVectorSplatZ(extents), worldExtents);
+
+			XMStoreFloat3(&component.WorldBox.Center, XMVector3Transform(XMLoadFloat3(&component.LocalBox.Center), world));
+			XMStoreFloat3(&component.WorldBox.Extents, worldExtents);
+			component.LocalSphere.Transform(component.WorldSphere, world);
+			component.TransformVersion = version;
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Each query checks the sphere first, since it's cheaper,
+// and only tests the tighter box when that doesn't decide it
+// --------------------------------------------------------
+void EntityStore::QueryFrustum(const BoundingFrustum& frustum, std::vector<unsigned int>& results)
+{
+	UpdateBounds();
+	results.clear();
+
+	const BoundsComponent* data = bounds.GetData();
+	const unsigned int* owners = bounds.GetEntities();
+	for (unsigned int i = 0; i < bounds.GetCount(); i++)
+	{
+		ContainmentType sphere = frustum.Contains(data[i].WorldSphere);
+		if (sphere == DISJOINT)
+			continue;
+
+		if (sphere == CONTAINS || frustum.Intersects(data[i].WorldBox))
+			results.push_back(owners[i]);
+	}
+}
+
+void EntityStore::QuerySphere(const BoundingSphere& sphere, std::vector<unsigned int>& results)
+{
+	UpdateBounds();
+	results.clear();
+
+	const BoundsComponent* data = bounds.GetData();
+	const unsigned int* owners = bounds.GetEntities();
+	for (unsigned int i = 0; i < bounds.GetCount(); i++)
+	{
+		if (sphere.Intersects(data[i].WorldSphere) && sphere.Intersects(data[i].WorldBox))
+			results.push_back(owners[i]);
+	}
+}
+
+void EntityStore::QueryRay(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, std::vector<EntityRayHit>& results)
+{
+	UpdateBounds();
+	results.clear();
+
+	XMVECTOR rayOrigin = XMLoadFloat3(&origin);
+	XMVECTOR rayDirection = XMVector3Normalize(XMLoadFloat3(&direction));
+
+	const BoundsComponent* data = bounds.GetData();
+	const unsigned int* owners = bounds.GetEntities();
+	for (unsigned int i = 0; i < bounds.GetCount(); i++)
+	{
+		// The sphere gives its exit distance when the origin is inside, so it
+		// only rules hits out; the box's entry distance is negative then
+		float distance = 0.0f;
+		if (!data[i].WorldSphere.Intersects(rayOrigin, rayDirection, distance) ||
+			!data[i].WorldBox.Intersects(rayOrigin, rayDirection, distance))
+			continue;
+
+		distance = max(distance, 0.0f);
+		if (distance > maxDistance)
+			continue;
+
+		EntityRayHit hit = { owners[i], distance };
+		results.push_back(hit);
+	}
+
+	std::sort(results.begin(), results.end(),
+		[](const EntityRayHit& a, const EntityRayHit& b) { return a.Distance < b.Distance; });
+}
+
+ComponentArray<RenderComponent>& EntityStore::GetRenderComponents()
+{
+	return renderables;
+}
+
+const ComponentArray<RenderComponent>& EntityStore::GetRenderComponents() const
+{
+	return renderables;
+}
+
+const ComponentArray<BoundsComponent>& EntityStore::GetBoundsComponents() const
+{
+	return bounds;
+}
+
+const ComponentArray<AnimationComponent>& EntityStore::GetAnimationComponents() const
+{
+	return animations;
+}
+
+ComponentArray<KeyframeComponent>& EntityStore::GetKeyframeComponents()
+{
+	return keyframes;
+}
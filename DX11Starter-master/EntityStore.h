@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <DirectXCollision.h>
+
+#include "ComponentArray.h"
+#include "Animation.h"
+#include "KeyframeAnimation.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "Transform.h"
+
+// What drawing (or tracing) an entity needs, with plain
+// pointers so systems walking these don't touch refcounts
+struct RenderComponent
+{
+	unsigned int TransformIndex;	// Slot in the TransformStore
+	Mesh* RenderMesh;
+	Material* RenderMaterial;
+};
+
+// Entities per job system batch when refreshing world bounds
+#define ENTITY_BOUNDS_PER_BATCH 1024
+
+// --------------------------------------------------------
+// A renderable's mesh bounds, in its own space and in the
+// world.  The world ones are only rebuilt when the transform's
+// version says its world matrix has changed since.
+// --------------------------------------------------------
+struct BoundsComponent
+{
+	unsigned int TransformIndex;	// Slot in the TransformStore
+	unsigned int TransformVersion;	// Its version when the world bounds were built
+	DirectX::BoundingBox LocalBox;
+	DirectX::BoundingSphere LocalSphere;
+	DirectX::BoundingBox WorldBox;
+	DirectX::BoundingSphere WorldSphere;
+};
+
+// An entity whose bounds a ray hits, and how far along the ray
+struct EntityRayHit
+{
+	unsigned int Entity;
+	float Distance;
+};
+
+// --------------------------------------------------------
+// The entities of one scene and their components.
+//
+// Every entity has a Transform.  Everything else lives in
+// a ComponentArray per type, so systems (TLAS building,
+// texture streaming, animation, culling) each walk only
+// the dense array they need.
+//
+// IDs stay valid until the entity is destroyed, and are
+// never mistaken for a later entity in the same slot.
+// Main thread only, apart from systems reading or writing
+// components across the job system.
+// --------------------------------------------------------
+class EntityStore
+{
+public:
+	EntityStore();
+
+	// The store owns its entities, so it can't be copied
+	EntityStore(EntityStore const&) = delete;
+	void operator=(EntityStore const&) = delete;
+
+	// A new entity with an identity transform and no other components
+	unsigned int Create();
+	void Destroy(unsigned int entity);
+	bool IsAlive(unsigned int entity);
+	unsigned int GetCount();
+
+	std::shared_ptr<Transform> GetTransform(unsigned int entity);
+
+	// Adds (or changes) the entity's render component - there has to be a mesh
+	void SetRenderable(unsigned int entity, std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
+	void RemoveRenderable(unsigned int entity);
+	std::shared_ptr<Mesh> GetMesh(unsigned int entity);
+	std::shared_ptr<Material> GetMaterial(unsigned int entity);
+
+	// Adds a track to the entity's animation component (making one if needed),
+	// or returns false if it already has the most it can hold or the track's
+	// channel or curve is unknown
+	bool AddAnimationTrack(unsigned int entity, const AnimationTrack& track);
+	void RemoveAnimation(unsigned int entity);
+
+	// Plays a keyframe clip on the entity from startTime (in the time
+	// UpdateKeyframeAnimations() is given), replacing any it was playing
+	void PlayKeyframeClip(unsigned int entity, std::shared_ptr<KeyframeClip> clip, float startTime, float speed = 1.0f, bool loop = true);
+	void StopKeyframeClip(unsigned int entity);
+
+	// Rebuilds the world bounds of every renderable whose transform has
+	// changed since they were last built (updating transforms first)
+	void UpdateBounds();
+
+	// Renderables whose world bounds touch a shape, as of now.  Results
+	// replace what the vector held; ray hits are nearest first, and the
+	// ray's origin inside the bounds counts as a hit at distance 0.
+	void QueryFrustum(const DirectX::BoundingFrustum& frustum, std::vector<unsigned int>& results);
+	void QuerySphere(const DirectX::BoundingSphere& sphere, std::vector<unsigned int>& results);
+	void QueryRay(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, std::vector<EntityRayHit>& results);
+
+	// Dense component arrays, for systems.  Bounds are kept in step
+	// with the render components (same entities in the same order),
+	// and are current as of the last UpdateBounds() or query.
+	ComponentArray<RenderComponent>& GetRenderComponents();
+	const ComponentArray<RenderComponent>& GetRenderComponents() const;
+	const ComponentArray<BoundsComponent>& GetBoundsComponents() const;
+	const ComponentArray<AnimationComponent>& GetAnimationComponents() const;
+	ComponentArray<KeyframeComponent>& GetKeyframeComponents();
+
+private:
+	// Per slot: current generation (wrapping at 256, see ENTITY_INDEX_BITS),
+	// and the transform every entity has
+	std::vector<unsigned char> generations;
+	std::vector<std::shared_ptr<Transform>> transforms;
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+
+	ComponentArray<RenderComponent> renderables;
+	ComponentArray<BoundsComponent> bounds;
+	ComponentArray<AnimationComponent> animations;
+	ComponentArray<KeyframeComponent> keyframes;
+
+	// Per slot: what keeps the renderable's mesh and material alive
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<std::shared_ptr<Material>> materials;
+
+	// Per slot: what keeps the keyframe clip alive
+	std::vector<std::shared_ptr<KeyframeClip>> clips;
+};
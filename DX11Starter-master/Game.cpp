@@ -9,6 +9,20 @@
 #include <d3dcompiler.h>
 
 #include "DX12Helper.h"
+#include "JobSystem.h"
+#include "AssetLoader.h"
+#include "MeshRegistry.h"
+#include "SpatialHash.h"
+#include "SceneGenerator.h"
+#include "TransformStore.h"
+
+// For the benchmark's process memory numbers
+#include <psapi.h>
+
+// For the spatial benchmark's random motion
+#include <algorithm>
+#include <cfloat>
+#include <random>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -59,7 +73,9 @@ Game::~Game()
 	// We need to wait here until the GPU
 	// is actually done with its work
 	DX12Helper::GetInstance().WaitForGPU();
+	delete& MeshRegistry::GetInstance();
 	delete& RaytracingHelper::GetInstance();
+	delete& JobSystem::GetInstance();
 }
 
 // --------------------------------------------------------
@@ -78,9 +94,29 @@ void Game::Init()
 		FixPath(L"Raytracing.cso"));
 
 	CreateRootSigAndPipelineState();
+
+	// Everything that's drawn comes from the scene file
+	if (!LoadScene(FixPath(L"../../Assets/Scenes/default.scene").c_str(), scene))
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Couldn't load the scene\n");
+#endif
+	}
+
 	CreateCamera();
 	CreateGeometry();
 	CreateLights();
+
+	// Curves that bake closely enough become lookups - the ones that
+	// don't (bounce, circ) are cheap without pow or sin anyway
+	for (int curve = 0; curve < EASE_CURVE_COUNT; curve++)
+	{
+		EaseTable table;
+		BakeEaseTable(curve, EASE_TABLE_CUBIC, table);
+		if (table.MaxError > CURVE_TABLE_MAX_ERROR)
+			BakeEaseTable(curve, EASE_TABLE_EXACT, table);
+		curveTables.push_back(table);
+	}
 }
 
 // --------------------------------------------------------
@@ -256,191 +292,143 @@ void Game::CreateRootSigAndPipelineState()
 }
 
 // --------------------------------------------------------
-// Creates the perspective camera and stores it 
+// Creates the perspective camera and stores it, placed
+// where the scene asks if it has a camera
 // --------------------------------------------------------
 void Game::CreateCamera()
 {
+	SceneCamera start = {};
+	start.Position = XMFLOAT3(0.0f, 0.0f, -10.0f);
+	start.FOV = fov;
+	start.MoveSpeed = 1.0f;
+	start.SprintSpeed = 20.0f;
+	start.LookSpeed = 0.1f;
+	start.NearClip = 0.01f;
+	start.FarClip = 1000.0f;
+	if (scene.HasCamera)
+		start = scene.Camera;
+
+	fov = start.FOV;
 	camera = std::make_shared<Camera>(
-		0.0f, 0.0f, -10.0f,							// Origin
-		1.0f,										// Move Speed 
-		20.0f,										// Sprint Move Speed
-		0.1f,										// Mouse Look Speed 
+		start.Position.x, start.Position.y, start.Position.z,	// Origin
+		start.MoveSpeed,							// Move Speed 
+		start.SprintSpeed,							// Sprint Move Speed
+		start.LookSpeed,							// Mouse Look Speed 
 		fov,										// FOV
-		(float)windowWidth / (float)windowHeight	// Aspect Ratio
+		(float)windowWidth / (float)windowHeight,	// Aspect Ratio
+		start.NearClip,
+		start.FarClip
 	);
+	camera->GetTransform()->SetEulerRotation(start.Rotation);
+	camera->UpdateViewMatrix();
 }
 
 // --------------------------------------------------------
-// Creates the geometry we're going to draw 
+// Creates the scene's meshes, materials and entities 
 // --------------------------------------------------------
 void Game::CreateGeometry()
 {
-	DX12Helper& dx12Helper = DX12Helper::GetInstance();
-	// rootSig.pStaticSamplers[0];
-
-
-	std::shared_ptr<Mesh> sphere = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str());
-	std::shared_ptr<Mesh> helix = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str());
-	std::shared_ptr<Mesh> torus = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/torus.obj").c_str());
-	std::shared_ptr<Mesh> cylinder = std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cylinder.obj").c_str());
-
-	double spawnRange = 10.0f;
-	srand(time(0));
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<std::shared_ptr<Material>> materials;
+	LoadSceneAssets(scene, meshes, materials);
+	entityStore = std::make_shared<EntityStore>();
+	CreateEntities(scene, meshes, materials);
+
+	// Meshes build their BLAS's the first time an instance uses them, which this does
+	if (!entities.empty())
+		RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(*entityStore);
+}
 
-	
-	// Torus's
-	for (int i = 0; i < 3; i++)
+// --------------------------------------------------------
+// Loads a scene's meshes and textures and builds its
+// materials, in the same order as the scene's tables
+// --------------------------------------------------------
+void Game::LoadSceneAssets(
+	const SceneData& sceneData,
+	std::vector<std::shared_ptr<Mesh>>& meshes,
+	std::vector<std::shared_ptr<Material>>& materials)
+{
+	// Scene paths are relative to the scene file
+	std::wstring sceneFolder = FixPath(L"../../Assets/Scenes/");
+
+	// Parse/decode every asset across the job system at once, rather than one
+	// after the other. The textures land in the helper's cache, so the
+	// materials below just pick up their descriptors.
+	AssetLoader loader;
+	std::vector<unsigned int> meshHandles(sceneData.MeshCount);
+	for (unsigned int i = 0; i < sceneData.MeshCount; i++)
+		meshHandles[i] = loader.QueueMesh(sceneFolder + NarrowToWide(sceneData.GetMeshPath(i)));
+
+	std::vector<unsigned int> textureHandles(sceneData.TextureCount);
+	for (unsigned int i = 0; i < sceneData.TextureCount; i++)
+		textureHandles[i] = loader.QueueTexture(sceneFolder + NarrowToWide(sceneData.GetTexturePath(i)));
+	loader.Finish();
+
+	meshes.resize(sceneData.MeshCount);
+	for (unsigned int i = 0; i < sceneData.MeshCount; i++)
+		meshes[i] = loader.GetMesh(meshHandles[i]);
+
+	materials.resize(sceneData.MaterialCount);
+	for (unsigned int i = 0; i < sceneData.MaterialCount; i++)
 	{
-		std::shared_ptr<Material> basicMat = std::make_shared<Material>(
+		const SceneMaterial& m = sceneData.Materials[i];
+		materials[i] = std::make_shared<Material>(
 			pipelineState,
-			DirectX::XMFLOAT4(((double)rand()) / RAND_MAX * 10.0, ((double)rand()) / RAND_MAX * 10.0, ((double)rand()) / RAND_MAX * 10.0, ((double)rand()) / RAND_MAX), // Color
-			DirectX::XMFLOAT2(1.0f, 1.0f),
-			DirectX::XMFLOAT2(0.0f, 0.0f),
-			XMFLOAT4(1.0, 1.0, 1.0, 0.0)); // Set to light sources 
-
-
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Color.jpg").c_str()), 0);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_NormalDX.jpg").c_str()), 1);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Roughness.jpg").c_str()), 2);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Metalness.jpg").c_str()), 3);
-
-		basicMat->FinalizeMaterial();
+			m.ColorTint,
+			m.UVScale,
+			m.UVOffset,
+			m.LightHue);
 
-		double xRand = ((double)rand()) / RAND_MAX;
-		double x = -spawnRange + (spawnRange - -spawnRange) * xRand;
-
-		double zRand = ((double)rand()) / RAND_MAX;
-		double z = -spawnRange + (spawnRange - -spawnRange) * zRand;
-
-		// Set meshes to entities 
-		entities.push_back(std::make_shared<Entity>(torus, basicMat));
-		entities[entities.size() - 1]->GetTransform()->SetPosition(x, 0.0f, z);
-		entities[entities.size() - 1]->GetTransform()->SetEulerRotation(
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX,
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX,
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX);
+		// The shader reads all four slots, so empty ones reuse the first texture
+		for (unsigned int slot = 0; slot < SCENE_MATERIAL_TEXTURES; slot++)
+		{
+			unsigned int texture = m.Textures[slot] != SCENE_NO_TEXTURE ? m.Textures[slot] : m.Textures[0];
+			if (texture != SCENE_NO_TEXTURE)
+				materials[i]->AddTexture(loader.GetTexture(textureHandles[texture]), slot);
+		}
 
+		materials[i]->FinalizeMaterial();
 	}
 
-	// Spheres 
-	for (int i = 0; i < 2; i++)
-	{
-		std::shared_ptr<Material> basicMat = std::make_shared<Material>(
-			pipelineState,
-			DirectX::XMFLOAT4(((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX), // Color
-			DirectX::XMFLOAT2(1.0f, 1.0f),
-			DirectX::XMFLOAT2(0.0f, 0.0f),
-			XMFLOAT4(0.0, 0.0, 0.0, 0.0));
-
-
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Color.jpg").c_str()), 0);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_NormalDX.jpg").c_str()), 1);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Roughness.jpg").c_str()), 2);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Metalness.jpg").c_str()), 3);
-
-		basicMat->FinalizeMaterial();
-
-		double xRand = ((double)rand()) / RAND_MAX;
-		double x = -spawnRange + (spawnRange - -spawnRange) * xRand;
-
-		double zRand = ((double)rand()) / RAND_MAX;
-		double z = -spawnRange + (spawnRange - -spawnRange) * zRand;
-
-		// Set meshes to entities 
-		entities.push_back(std::make_shared<Entity>(sphere, basicMat));
-		entities[entities.size() - 1]->GetTransform()->SetPosition(x, 0.0f, z);
-	}
+	// The materials hold their own references now, so the textures go away
+	// (on eviction) along with them.  The loader took one per distinct file.
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+	std::sort(textureHandles.begin(), textureHandles.end());
+	textureHandles.erase(std::unique(textureHandles.begin(), textureHandles.end()), textureHandles.end());
+	for (unsigned int handle : textureHandles)
+		dx12Helper.ReleaseTexture(loader.GetTexture(handle));
+}
 
-	// Cylinders 
-	for (int i = 0; i < 2; i++)
+// --------------------------------------------------------
+// Adds an entity to the entity store for each of the
+// scene's instances
+// --------------------------------------------------------
+void Game::CreateEntities(
+	const SceneData& sceneData,
+	const std::vector<std::shared_ptr<Mesh>>& meshes,
+	const std::vector<std::shared_ptr<Material>>& materials)
+{
+	entities.reserve(entities.size() + sceneData.InstanceCount);
+	for (unsigned int i = 0; i < sceneData.InstanceCount; i++)
 	{
-		std::shared_ptr<Material> basicMat = std::make_shared<Material>(
-			pipelineState,
-			DirectX::XMFLOAT4(((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX), // Color
-			DirectX::XMFLOAT2(1.0f, 1.0f),
-			DirectX::XMFLOAT2(0.0f, 0.0f),
-			XMFLOAT4(0.0, 0.0, 0.0, 0.0));
-
-
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Color.jpg").c_str()), 0);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_NormalDX.jpg").c_str()), 1);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Roughness.jpg").c_str()), 2);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Metalness.jpg").c_str()), 3);
-
-		basicMat->FinalizeMaterial();
-
-		double xRand = ((double)rand()) / RAND_MAX;
-		double x = -spawnRange + (spawnRange - -spawnRange) * xRand;
-
-		double zRand = ((double)rand()) / RAND_MAX;
-		double z = -spawnRange + (spawnRange - -spawnRange) * zRand;
-
-		// Set meshes to entities 
-		entities.push_back(std::make_shared<Entity>(cylinder, basicMat));
-		entities[entities.size() - 1]->GetTransform()->SetPosition(x, 0.0f, z);
+		const SceneInstance& instance = sceneData.Instances[i];
+		unsigned int entity = entityStore->Create();
+		entityStore->SetRenderable(entity, meshes[instance.Mesh], materials[instance.Material]);
+
+		std::shared_ptr<Transform> transform = entityStore->GetTransform(entity);
+		transform->SetPosition(instance.Position);
+		transform->SetEulerRotation(instance.Rotation);
+		transform->SetScale(instance.Scale);
+		entities.push_back(entity);
 	}
 
-	
-	// Helix 
-	for (int i = 0; i < 5; i++)
+	// Animations refer to instances by index, which this call's entities started at
+	unsigned int firstEntity = (unsigned int)entities.size() - sceneData.InstanceCount;
+	for (unsigned int i = 0; i < sceneData.AnimationCount; i++)
 	{
-		std::shared_ptr<Material> basicMat = std::make_shared<Material>(
-			pipelineState,
-			DirectX::XMFLOAT4(((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX), // Color
-			DirectX::XMFLOAT2(1.0f, 1.0f),
-			DirectX::XMFLOAT2(0.0f, 0.0f),
-			XMFLOAT4(0.0, 0.0, 0.0, 0.0));
-
-
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Color.jpg").c_str()), 0);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_NormalDX.jpg").c_str()), 1);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Roughness.jpg").c_str()), 2);
-		basicMat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Metalness.jpg").c_str()), 3);
-
-		basicMat->FinalizeMaterial();
-
-		double xRand = ((double)rand()) / RAND_MAX;
-		double x = -spawnRange + (spawnRange - -spawnRange) * xRand;
-
-		double zRand = ((double)rand()) / RAND_MAX;
-		double z = -spawnRange + (spawnRange - -spawnRange) * zRand;
-
-		// Set meshes to entities 
-		entities.push_back(std::make_shared<Entity>(helix, basicMat));
-		entities[entities.size() - 1]->GetTransform()->SetPosition(x, 0.0f, z);
-		entities[entities.size() - 1]->GetTransform()->SetEulerRotation(
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX,
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX,
-			-5.0 + (5.0 - -5.0) * ((double)rand()) / RAND_MAX);
-
+		const SceneAnimation& animation = sceneData.Animations[i];
+		entityStore->AddAnimationTrack(entities[firstEntity + animation.Instance], animation.Track);
 	}
-
-	
-
-	// Ground
-	std::shared_ptr<Material> mat = std::make_shared<Material>(
-		pipelineState,
-		DirectX::XMFLOAT4(((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, ((double)rand()) / RAND_MAX, 0.0f), // Color
-		DirectX::XMFLOAT2(1.0f, 1.0f),
-		DirectX::XMFLOAT2(0.0f, 0.0f),
-		XMFLOAT4(0.0, 0.0, 0.0, 0.0));
-
-
-	mat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Color.jpg").c_str()), 0);
-	mat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_NormalDX.jpg").c_str()), 1);
-	mat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Roughness.jpg").c_str()), 2);
-	mat->AddTexture(dx12Helper.LoadTexture(FixPath(L"../../Assets/Textures/Foil002_4K-JPG_Metalness.jpg").c_str()), 3);
-
-	mat->FinalizeMaterial();
-
-
-	// Set meshes to entities 
-	entities.push_back(std::make_shared<Entity>(cylinder, mat));
-	entities[entities.size() - 1]->GetTransform()->SetPosition(0.0f, -3.0f, 0.0f);
-	entities[entities.size() - 1]->GetTransform()->SetScale(1000.0f, 1.0f, 1000.0f);
-
-	// Meshes create their own BLAS's; we just need to create the TLAS for the scene here
-	RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(entities);
 }
 
 // --------------------------------------------------------
@@ -448,49 +436,8 @@ void Game::CreateGeometry()
 // --------------------------------------------------------
 void Game::CreateLights()
 {
-	/*
-		DirectX::XMFLOAT3 directiton;
-		float range;
-		DirectX::XMFLOAT3 position;
-		float intensity;
-		DirectX::XMFLOAT3 color;
-		float spotFalloff;
-		DirectX::XMFLOAT3 padding;
-	*/
-
-	Light light1 = {};
-	light1.type = LIGHT_POINT;
-	light1.position = XMFLOAT3(5.0f, 0.0f, 0.0f);
-	light1.color = XMFLOAT3(1.0f, 0.5f, 0.0f);
-	light1.range = 20.0f;
-	light1.spotFalloff = 0.3f;
-	light1.intensity = 5.0f;
-
-	Light light2 = {};
-	light2.type = LIGHT_DIRECTION;
-	light2.color = XMFLOAT3(0.0f, 0.5f, 0.5f);
-	light2.directiton = XMFLOAT3(0.1f, -1.0f, 0.0f);
-	light2.spotFalloff = 0.3f;
-	light2.intensity = 5.0f;
-
-	Light light3 = {};
-	light3.type = LIGHT_DIRECTION;
-	light3.color = XMFLOAT3(0.1f, 0.8f, 0.5f);
-	light3.directiton = XMFLOAT3(0.0f, 1.0f, 0.2f);
-	light3.spotFalloff = 0.3f;
-	light3.intensity = 5.0f;
-
-	Light light4 = {};
-	light4.type = LIGHT_DIRECTION;
-	light4.color = XMFLOAT3(1.0f, 1.0f, 1.0f);
-	light4.directiton = XMFLOAT3(0.0f, -1.0f, 0.2f);
-	light4.spotFalloff = 0.3f;
-	light4.intensity = 10.0f;
-
-	lights.push_back(light1);
-	lights.push_back(light2);
-	lights.push_back(light3);
-	lights.push_back(light4);
+	unsigned int lightCount = min(scene.LightCount, (unsigned int)MAX_LIGHTS);
+	lights.assign(scene.Lights, scene.Lights + lightCount);
 }
 
 
@@ -517,18 +464,74 @@ void Game::Update(float deltaTime, float totalTime)
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
 
+	// Measure how things scale with generated scenes, then come back to this one
+	if (Input::GetInstance().KeyPress('B'))
+	{
+		RunScalingBenchmark();
+
+		// Anything the benchmark was the last to use can go now
+		DX12Helper::GetInstance().EvictUnusedTextures();
+		MeshRegistry::GetInstance().ReleaseUnusedMeshes();
+	}
+	if (Input::GetInstance().KeyPress('N'))
+		RunSpatialBenchmark();
+
 	camera->Update(deltaTime);
 
-	// Temporary animations of entities 
-	float lerp = InverseLerp(-1.0f, 1.0f, sin(totalTime));
-	entities[0]->GetTransform()->SetPosition(0.0f, GetCurveByIndex(EASE_IN_BOUNCE, lerp) * 2.0f - 1.0f, 0.0f);
-	entities[0]->GetTransform()->SetScale(GetCurveByIndex(EASE_IN_OUT_BOUNCE, lerp) + 0.5f, GetCurveByIndex(EASE_IN_OUT_BOUNCE, lerp) + 0.25f, 1.0f );
+	// Everything with an animation or keyframe component, across the job system
+	UpdateAnimations(entityStore->GetAnimationComponents(), totalTime, &curveTables[0]);
+	UpdateKeyframeAnimations(entityStore->GetKeyframeComponents(), totalTime);
 
-	entities[1]->GetTransform()->SetPosition(5.0f, GetCurveByIndex(EASE_IN_OUT_CUBIC, lerp) * 2.0f - 1.0f, 0.0f);
-	entities[1]->GetTransform()->SetScale(1.0f, GetCurveByIndex(EASE_IN_OUT_CUBIC, lerp + 0.5f) , 1.0f);
+	// Then tweens, which win over both
+	tweens.Update(totalTime, &curveTables[0]);
 
-	entities[2]->GetTransform()->SetPosition(-5.0f, GetCurveByIndex(EASE_IN_OUT_ELASTIC, lerp) * 2.0f - 1.0f, 0.0f);
-	entities[2]->GetTransform()->SetScale(1.0f, GetCurveByIndex(EASE_IN_OUT_ELASTIC, lerp) + 0.1f, 1.0f);
+	// Report what's under the cursor
+	if (Input::GetInstance().MouseRightPress())
+		PickEntity();
+}
+
+// --------------------------------------------------------
+// A ray from the camera through a point on the screen, in
+// pixels from the top left, reaching the far clip plane
+// --------------------------------------------------------
+RaycastRay Game::CreateScreenRay(float pixelX, float pixelY)
+{
+	XMFLOAT4X4 proj = *camera->GetProjMatrix();
+	XMMATRIX inverseView = XMMatrixInverse(0, XMLoadFloat4x4(camera->GetViewMatrix().get()));
+
+	// Through the pixel on the plane one unit in front of the camera
+	float ndcX = pixelX / windowWidth * 2.0f - 1.0f;
+	float ndcY = 1.0f - pixelY / windowHeight * 2.0f;
+	XMVECTOR direction = XMVector3TransformNormal(
+		XMVectorSet(ndcX / proj._11, ndcY / proj._22, 1.0f, 0.0f),
+		inverseView);
+
+	RaycastRay ray = {};
+	ray.Origin = camera->GetTransform()->GetPosition();
+	XMStoreFloat3(&ray.Direction, direction);
+	ray.MaxDistance = camera->GetFarClip();
+	return ray;
+}
+
+// --------------------------------------------------------
+// Casts a ray through the cursor on the CPU - no waiting
+// on the GPU - and prints what it hit (in debug builds)
+// --------------------------------------------------------
+void Game::PickEntity()
+{
+	raycaster.Build(*entityStore);
+
+	Input& input = Input::GetInstance();
+	RaycastRay ray = CreateScreenRay((float)input.GetMouseX(), (float)input.GetMouseY());
+	RaycastHit hit;
+	bool picked = raycaster.RaycastScene(ray.Origin, ray.Direction, ray.MaxDistance, hit);
+#if defined(DEBUG) || defined(_DEBUG)
+	if (picked)
+		printf("Picked entity %u: triangle %u at distance %.3f (barycentrics %.3f, %.3f)\n",
+			hit.Entity, hit.Triangle, hit.Distance, hit.Barycentrics.x, hit.Barycentrics.y);
+	else
+		printf("Picked nothing\n");
+#endif
 }
 
 // --------------------------------------------------------
@@ -547,13 +550,21 @@ void Game::Draw(float deltaTime, float totalTime)
 	commandAllocator->Reset();
 	commandList->Reset(commandAllocator.Get(), 0);
 
+	// Rebuild the matrices (and world bounds) of everything that moved
+	// this frame in one batch, rather than one at a time as they're asked for below
+	entityStore->UpdateBounds();
+
+	// Stream texture mips in (or out) to match this frame's view
+	ReportTextureCoverage();
+	dx12Helper.UpdateTextureStreaming();
+
 	// Grab the current back buffer for this frame
 	Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer = backBuffers[currentSwapBuffer];
 
 	// Raytracing here!
 	{
-		// Update raytracing accel structure
-		RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(entities);
+		// Update raytracing accel structure, picking mesh LODs for this camera
+		RaytracingHelper::GetInstance().CreateTopLevelAccelerationStructureForScene(*entityStore, camera);
 
 		// Perform raytrace
 		RaytracingHelper::GetInstance().Raytrace(camera, backBuffers[currentSwapBuffer]);
@@ -567,6 +578,9 @@ void Game::Draw(float deltaTime, float totalTime)
 			vsyncNecessary ? 1 : 0,
 			vsyncNecessary ? 0 : DXGI_PRESENT_ALLOW_TEARING);
 
+		// The frame's constant buffers can be reused once the GPU gets this far
+		dx12Helper.FinishFrame();
+
 		// Wait to proceed to the next frame until the associated buffer is ready
 		currentSwapBuffer++;
 		if (currentSwapBuffer >= numBackBuffers)
@@ -574,6 +588,345 @@ void Game::Draw(float deltaTime, float totalTime)
 	}
 }
 
+// --------------------------------------------------------
+// Tells the texture streamer how big each material is on
+// screen: the entity's bounding sphere projected to pixels,
+// divided by how many times its UVs repeat across it
+// --------------------------------------------------------
+void Game::ReportTextureCoverage()
+{
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+
+	float pixelsPerUnitAtOne = camera->GetProjMatrix()->_22 * windowHeight * 0.5f;
+	XMFLOAT3 cameraPos = camera->GetTransform()->GetPosition();
+	XMVECTOR cameraPosition = XMLoadFloat3(&cameraPos);
+
+	// Bounds are in step with the renderables, and current as of Draw()'s update
+	const RenderComponent* renderables = entityStore->GetRenderComponents().GetData();
+	const BoundsComponent* bounds = entityStore->GetBoundsComponents().GetData();
+	unsigned int renderableCount = entityStore->GetRenderComponents().GetCount();
+	for (unsigned int i = 0; i < renderableCount; i++)
+	{
+		XMVECTOR center = XMLoadFloat3(&bounds[i].WorldSphere.Center);
+		float radius = bounds[i].WorldSphere.Radius;
+
+		// Inside the sphere means it fills the screen
+		float distance = XMVectorGetX(XMVector3Length(center - cameraPosition));
+		float pixelsAcross = distance > radius ?
+			2.0f * radius * pixelsPerUnitAtOne / distance :
+			(float)max(windowWidth, windowHeight);
+
+		Material* material = renderables[i].RenderMaterial;
+		XMFLOAT2 uvScale = material->GetuvScale();
+		float repeats = max(1.0f, max(fabsf(uvScale.x), fabsf(uvScale.y)));
+
+		for (int slot = 0; slot < 4; slot++)
+			dx12Helper.ReportTextureCoverage(material->GetTextureSRV(slot), pixelsAcross / repeats);
+	}
+}
+
+
+// --------------------------------------------------------
+// Generates scenes of 10 to BENCHMARK_MAX_INSTANCES instances
+// in each distribution and prints, for each one:
+//  - Full TLAS build time (CPU side and GPU side)
+//  - TLAS refit time (GPU side)
+//  - Trace throughput, in primary rays per second
+//  - CPU raycaster build time, and time for a batch of CPU rays
+//  - Acceleration structure and process memory
+// GPU times come from timestamp queries around each step.
+// --------------------------------------------------------
+void Game::RunScalingBenchmark()
+{
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+	RaytracingHelper& raytracingHelper = RaytracingHelper::GetInstance();
+
+	// Two timestamps, before and after each step
+	Microsoft::WRL::ComPtr<ID3D12QueryHeap> queryHeap;
+	D3D12_QUERY_HEAP_DESC queryDesc = {};
+	queryDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+	queryDesc.Count = 2;
+	device->CreateQueryHeap(&queryDesc, IID_PPV_ARGS(queryHeap.GetAddressOf()));
+	Microsoft::WRL::ComPtr<ID3D12Resource> queryReadback = dx12Helper.CreateBuffer(
+		sizeof(UINT64) * 2,
+		D3D12_HEAP_TYPE_READBACK,
+		D3D12_RESOURCE_STATE_COPY_DEST);
+	UINT64 timestampFrequency = 1;
+	commandQueue->GetTimestampFrequency(&timestampFrequency);
+
+	// Milliseconds between the two timestamps of the work just executed
+	auto ReadGPUTime = [&]()
+	{
+		UINT64* timestamps = 0;
+		queryReadback->Map(0, 0, (void**)&timestamps);
+		double ms = (double)(timestamps[1] - timestamps[0]) * 1000.0 / timestampFrequency;
+		queryReadback->Unmap(0, 0);
+		return ms;
+	};
+
+	// The list was closed by the last frame
+	dx12Helper.WaitForGPU();
+	commandAllocator->Reset();
+	commandList->Reset(commandAllocator.Get(), 0);
+
+	// Every generated scene has the same meshes and materials, so they're
+	// made the first time and kept (materials use up descriptors for good)
+	SceneData generated;
+	GenerateScene(SceneGeneratorSettings(), generated);
+	if (benchmarkMaterials.empty())
+		LoadSceneAssets(generated, benchmarkMeshes, benchmarkMaterials);
+	const std::vector<std::shared_ptr<Mesh>>& meshes = benchmarkMeshes;
+	const std::vector<std::shared_ptr<Material>>& materials = benchmarkMaterials;
+
+	std::shared_ptr<EntityStore> sceneStore = entityStore;
+	std::vector<unsigned int> sceneEntities;
+	sceneEntities.swap(entities);
+	std::shared_ptr<Camera> sceneCamera = camera;
+
+	const char* distributionNames[] = { "uniform", "clustered", "grid" };
+	printf("\n%-10s %9s %10s %10s %10s %12s %10s %10s %10s %10s %10s\n",
+		"layout", "instances", "build cpu", "build gpu", "refit gpu", "Mrays/sec", "ray bvh", "cpu rays", "TLAS MB", "BLAS MB", "process MB");
+
+	for (unsigned int distribution = SCENE_DISTRIBUTION_UNIFORM; distribution <= SCENE_DISTRIBUTION_GRID; distribution++)
+	{
+		for (unsigned int count = 10; count <= BENCHMARK_MAX_INSTANCES; count *= 10)
+		{
+			SceneGeneratorSettings settings;
+			settings.InstanceCount = count;
+			settings.Distribution = distribution;
+			settings.EmissiveFraction = 0.05f;
+			GenerateScene(settings, generated);
+
+			entityStore = std::make_shared<EntityStore>();
+			entities.clear();
+			CreateEntities(generated, meshes, materials);
+			entityStore->UpdateBounds();
+			const SceneCamera& c = generated.Camera;
+			camera = std::make_shared<Camera>(
+				c.Position.x, c.Position.y, c.Position.z,
+				c.MoveSpeed, c.SprintSpeed, c.LookSpeed,
+				c.FOV, (float)windowWidth / (float)windowHeight,
+				c.NearClip, c.FarClip);
+			camera->GetTransform()->SetEulerRotation(c.Rotation);
+			camera->UpdateViewMatrix();
+
+			// Warm up, so any BLAS (and LOD) builds are out of the way
+			raytracingHelper.SetTopLevelRefitEnabled(false);
+			raytracingHelper.CreateTopLevelAccelerationStructureForScene(*entityStore, camera);
+			dx12Helper.CloseExecuteAndResetCommandList();
+
+			// Full build
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+			LARGE_INTEGER cpuStart = {}, cpuEnd = {}, cpuFrequency = {};
+			QueryPerformanceFrequency(&cpuFrequency);
+			QueryPerformanceCounter(&cpuStart);
+			raytracingHelper.CreateTopLevelAccelerationStructureForScene(*entityStore, camera);
+			QueryPerformanceCounter(&cpuEnd);
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+			commandList->ResolveQueryData(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, queryReadback.Get(), 0);
+			dx12Helper.CloseExecuteAndResetCommandList();
+			double buildCPU = (double)(cpuEnd.QuadPart - cpuStart.QuadPart) * 1000.0 / cpuFrequency.QuadPart;
+			double buildGPU = ReadGPUTime();
+
+			// Refit of the same instances
+			raytracingHelper.SetTopLevelRefitEnabled(true);
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+			raytracingHelper.CreateTopLevelAccelerationStructureForScene(*entityStore, camera);
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+			commandList->ResolveQueryData(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, queryReadback.Get(), 0);
+			dx12Helper.CloseExecuteAndResetCommandList();
+			double refitGPU = ReadGPUTime();
+
+			// Trace (without presenting)
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+			raytracingHelper.Raytrace(camera, backBuffers[currentSwapBuffer], false);
+			commandList->EndQuery(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+			commandList->ResolveQueryData(queryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, queryReadback.Get(), 0);
+			dx12Helper.CloseExecuteAndResetCommandList();
+			double traceGPU = ReadGPUTime();
+			double primaryRays = (double)windowWidth * windowHeight * BENCHMARK_RAYS_PER_PIXEL;
+
+			// CPU ray queries: building the raycaster, then a grid of rays across the screen in one batch
+			QueryPerformanceCounter(&cpuStart);
+			raycaster.Build(*entityStore);
+			QueryPerformanceCounter(&cpuEnd);
+			double raycasterBuild = (double)(cpuEnd.QuadPart - cpuStart.QuadPart) * 1000.0 / cpuFrequency.QuadPart;
+
+			std::vector<RaycastRay> rays;
+			rays.reserve(BENCHMARK_CPU_RAYS_ACROSS * BENCHMARK_CPU_RAYS_ACROSS);
+			for (unsigned int y = 0; y < BENCHMARK_CPU_RAYS_ACROSS; y++)
+				for (unsigned int x = 0; x < BENCHMARK_CPU_RAYS_ACROSS; x++)
+					rays.push_back(CreateScreenRay(
+						(x + 0.5f) * windowWidth / BENCHMARK_CPU_RAYS_ACROSS,
+						(y + 0.5f) * windowHeight / BENCHMARK_CPU_RAYS_ACROSS));
+			std::vector<RaycastHit> hits(rays.size());
+
+			QueryPerformanceCounter(&cpuStart);
+			raycaster.RaycastBatch(&rays[0], (unsigned int)rays.size(), &hits[0]);
+			QueryPerformanceCounter(&cpuEnd);
+			double raycastCPU = (double)(cpuEnd.QuadPart - cpuStart.QuadPart) * 1000.0 / cpuFrequency.QuadPart;
+
+			RaytracingStats stats = raytracingHelper.GetStats();
+			PROCESS_MEMORY_COUNTERS memory = {};
+			GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory));
+
+			printf("%-10s %9u %8.2fms %8.2fms %8.2fms %12.1f %8.2fms %8.2fms %10.1f %10.1f %10.1f\n",
+				distributionNames[distribution],
+				count,
+				buildCPU,
+				buildGPU,
+				refitGPU,
+				traceGPU > 0.0 ? primaryRays / (traceGPU * 1000.0) : 0.0,
+				raycasterBuild,
+				raycastCPU,
+				(stats.TLASBytes + stats.TLASScratchBytes + stats.InstanceBufferBytes) / (1024.0 * 1024.0),
+				stats.BLASBytes / (1024.0 * 1024.0),
+				memory.WorkingSetSize / (1024.0 * 1024.0));
+		}
+	}
+
+	// Back to the real scene, leaving the list closed like a frame does
+	entityStore = sceneStore;
+	raycaster.Build(*entityStore);
+	entities.swap(sceneEntities);
+	camera = sceneCamera;
+	raytracingHelper.CreateTopLevelAccelerationStructureForScene(*entityStore, camera);
+	dx12Helper.CloseExecuteAndResetCommandList();
+	commandList->Close();
+}
+
+// --------------------------------------------------------
+// Moves BENCHMARK_SPATIAL_ENTITIES entities every frame and
+// prints the average time per frame to move them, rebuild
+// their bounds and update the spatial hash, then the time
+// per range and nearest query - with the linear
+// EntityStore::QuerySphere() alongside for comparison.
+// The entities use the scene's meshes, and nothing here
+// touches the GPU.
+// --------------------------------------------------------
+void Game::RunSpatialBenchmark()
+{
+	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::vector<std::shared_ptr<Material>> materials;
+	for (unsigned int entity : entities)
+	{
+		std::shared_ptr<Mesh> mesh = entityStore->GetMesh(entity);
+		if (!mesh)
+			continue;
+		meshes.push_back(mesh);
+		materials.push_back(entityStore->GetMaterial(entity));
+	}
+	if (meshes.empty())
+		return;
+
+	std::mt19937 random(0);
+	std::uniform_real_distribution<float> area(-BENCHMARK_SPATIAL_EXTENT, BENCHMARK_SPATIAL_EXTENT);
+	std::uniform_real_distribution<float> speed(-5.0f, 5.0f);
+
+	EntityStore store;
+	SpatialHash hash;
+	std::vector<std::shared_ptr<Transform>> transforms(BENCHMARK_SPATIAL_ENTITIES);
+	std::vector<XMFLOAT3> positions(BENCHMARK_SPATIAL_ENTITIES);
+	std::vector<XMFLOAT3> velocities(BENCHMARK_SPATIAL_ENTITIES);
+	for (unsigned int i = 0; i < BENCHMARK_SPATIAL_ENTITIES; i++)
+	{
+		unsigned int entity = store.Create();
+		store.SetRenderable(entity, meshes[i % meshes.size()], materials[i % materials.size()]);
+		transforms[i] = store.GetTransform(entity);
+		positions[i] = XMFLOAT3(area(random), area(random), area(random));
+		velocities[i] = XMFLOAT3(speed(random), speed(random), speed(random));
+		transforms[i]->SetPosition(positions[i]);
+	}
+
+	LARGE_INTEGER start = {}, end = {}, frequency = {};
+	QueryPerformanceFrequency(&frequency);
+	auto Milliseconds = [&]() { return (double)(end.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart; };
+
+	// First fill, with every entity new to the hash
+	store.UpdateBounds();
+	QueryPerformanceCounter(&start);
+	hash.Update(store);
+	QueryPerformanceCounter(&end);
+	double fill = Milliseconds();
+
+	// Everything moves every frame, bouncing off the sides of the cube
+	double move = 0.0, bounds = 0.0, update = 0.0;
+	const float frameTime = 1.0f / 60.0f;
+	for (unsigned int frame = 0; frame < BENCHMARK_SPATIAL_FRAMES; frame++)
+	{
+		QueryPerformanceCounter(&start);
+		for (unsigned int i = 0; i < BENCHMARK_SPATIAL_ENTITIES; i++)
+		{
+			float* position = &positions[i].x;
+			float* velocity = &velocities[i].x;
+			for (int a = 0; a < 3; a++)
+			{
+				position[a] += velocity[a] * frameTime;
+				if (fabsf(position[a]) > BENCHMARK_SPATIAL_EXTENT)
+					velocity[a] = -velocity[a];
+			}
+			transforms[i]->SetPosition(positions[i]);
+		}
+		QueryPerformanceCounter(&end);
+		move += Milliseconds();
+
+		QueryPerformanceCounter(&start);
+		store.UpdateBounds();
+		QueryPerformanceCounter(&end);
+		bounds += Milliseconds();
+
+		QueryPerformanceCounter(&start);
+		hash.Update(store);
+		QueryPerformanceCounter(&end);
+		update += Milliseconds();
+	}
+
+	std::vector<XMFLOAT3> points(BENCHMARK_SPATIAL_QUERIES);
+	for (XMFLOAT3& point : points)
+		point = XMFLOAT3(area(random), area(random), area(random));
+
+	// Range queries, against the hash and then a walk over every entity
+	std::vector<unsigned int> results;
+	size_t hashFound = 0, linearFound = 0;
+	QueryPerformanceCounter(&start);
+	for (const XMFLOAT3& point : points)
+	{
+		hash.QuerySphere(BoundingSphere(point, BENCHMARK_SPATIAL_QUERY_RADIUS), results);
+		hashFound += results.size();
+	}
+	QueryPerformanceCounter(&end);
+	double hashRange = Milliseconds();
+
+	QueryPerformanceCounter(&start);
+	for (const XMFLOAT3& point : points)
+	{
+		store.QuerySphere(BoundingSphere(point, BENCHMARK_SPATIAL_QUERY_RADIUS), results);
+		linearFound += results.size();
+	}
+	QueryPerformanceCounter(&end);
+	double linearRange = Milliseconds();
+
+	std::vector<SpatialNeighbor> neighbors;
+	QueryPerformanceCounter(&start);
+	for (const XMFLOAT3& point : points)
+		hash.QueryNearest(point, BENCHMARK_SPATIAL_NEIGHBORS, FLT_MAX, neighbors);
+	QueryPerformanceCounter(&end);
+	double nearest = Milliseconds();
+
+	// The linear query also checks boxes, so it can find fewer
+	printf("\nSpatial hash, %u moving entities over %u frames\n", BENCHMARK_SPATIAL_ENTITIES, BENCHMARK_SPATIAL_FRAMES);
+	printf("  first fill      %8.2fms\n", fill);
+	printf("  move            %8.2fms per frame\n", move / BENCHMARK_SPATIAL_FRAMES);
+	printf("  update bounds   %8.2fms per frame\n", bounds / BENCHMARK_SPATIAL_FRAMES);
+	printf("  update hash     %8.2fms per frame\n", update / BENCHMARK_SPATIAL_FRAMES);
+	printf("  range (hash)    %8.2fus per query, %.1f found\n",
+		hashRange * 1000.0 / BENCHMARK_SPATIAL_QUERIES, (double)hashFound / BENCHMARK_SPATIAL_QUERIES);
+	printf("  range (linear)  %8.2fus per query, %.1f found\n",
+		linearRange * 1000.0 / BENCHMARK_SPATIAL_QUERIES, (double)linearFound / BENCHMARK_SPATIAL_QUERIES);
+	printf("  %u nearest       %8.2fus per query\n",
+		BENCHMARK_SPATIAL_NEIGHBORS, nearest * 1000.0 / BENCHMARK_SPATIAL_QUERIES);
+}
+
 float Game::InverseLerp(float a, float b, float v)
 {
 	return (v - a) / (b - a);
@@ -6,9 +6,33 @@
 #include <memory>
 
 #include "Camera.h"
-#include "Entity.h"
+#include "EntityStore.h"
+#include "SceneRaycaster.h"
+#include "TweenScheduler.h"
 #include "Lights.h"
 #include "BufferStructs.h"
+#include "SceneFile.h"
+
+// Largest generated scene the scaling benchmark builds
+#define BENCHMARK_MAX_INSTANCES 1000000
+
+// Rays the ray generation shader traces per pixel (see Raytracing.hlsl)
+#define BENCHMARK_RAYS_PER_PIXEL 5
+
+// The benchmark's CPU ray queries are a grid this many rays across the screen
+#define BENCHMARK_CPU_RAYS_ACROSS 100
+
+// The spatial benchmark moves this many entities around a cube this far
+// across each way, for this many frames, with this many queries of each kind
+#define BENCHMARK_SPATIAL_ENTITIES 100000
+#define BENCHMARK_SPATIAL_EXTENT 250.0f
+#define BENCHMARK_SPATIAL_FRAMES 60
+#define BENCHMARK_SPATIAL_QUERIES 1000
+#define BENCHMARK_SPATIAL_QUERY_RADIUS 10.0f
+#define BENCHMARK_SPATIAL_NEIGHBORS 8
+
+// Animation curves whose baked tables are off by more than this are evaluated exactly
+#define CURVE_TABLE_MAX_ERROR 0.002f
 
 #include "AnimCurves.h"
 #include <algorithm>
@@ -35,6 +59,19 @@ private:
 	void CreateCamera();
 	void CreateGeometry();
 	void CreateLights();
+	void LoadSceneAssets(
+		const SceneData& sceneData,
+		std::vector<std::shared_ptr<Mesh>>& meshes,
+		std::vector<std::shared_ptr<Material>>& materials);
+	void CreateEntities(
+		const SceneData& sceneData,
+		const std::vector<std::shared_ptr<Mesh>>& meshes,
+		const std::vector<std::shared_ptr<Material>>& materials);
+	void RunScalingBenchmark();
+	void RunSpatialBenchmark();
+	void ReportTextureCoverage();
+	RaycastRay CreateScreenRay(float pixelX, float pixelY);
+	void PickEntity();
 
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
@@ -51,9 +88,27 @@ private:
 	std::shared_ptr<Camera> camera;
 	float fov;
 
-	std::vector<std::shared_ptr<Entity>> entities;
+	// Everything in the scene, and its entities' IDs in scene order
+	std::shared_ptr<EntityStore> entityStore;
+	std::vector<unsigned int> entities;
 	std::vector<Light> lights;
 
+	// One per animation curve, cubic or exact (see CURVE_TABLE_MAX_ERROR)
+	std::vector<EaseTable> curveTables;
+
+	// Fire-and-forget transform tweens, stepped after the other animation
+	TweenScheduler tweens;
+
+	// CPU ray queries against the scene, rebuilt when they're needed
+	SceneRaycaster raycaster;
+
+	// The scaling benchmark's meshes and materials, built the first time it runs
+	std::vector<std::shared_ptr<Mesh>> benchmarkMeshes;
+	std::vector<std::shared_ptr<Material>> benchmarkMaterials;
+
+	// What CreateCamera/Geometry/Lights build from
+	SceneData scene;
+
 	// Following variables are purely for assignment 2 
 	float InverseLerp(float a, float b, float v);
 };
@@ -0,0 +1,163 @@
+#include "JobSystem.h"
+
+#include <atomic>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+// Singleton requirement
+JobSystem* JobSystem::instance;
+
+// --------------------------------------------------------
+// Spins up one worker per hardware thread, minus the main
+// thread which participates in any work it waits on
+// --------------------------------------------------------
+JobSystem::JobSystem() :
+	shuttingDown(false)
+{
+	unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	unsigned int workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+
+	for (unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(std::thread(&JobSystem::WorkerLoop, this));
+}
+
+// --------------------------------------------------------
+// Lets the workers drain and joins them
+// --------------------------------------------------------
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		shuttingDown = true;
+	}
+	queueCondition.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+unsigned int JobSystem::GetWorkerCount()
+{
+	return (unsigned int)workers.size();
+}
+
+// --------------------------------------------------------
+// Each worker sleeps until there's something in the queue.
+// Tasks may use COM (WIC decodes images), so each worker
+// joins the multithreaded apartment for its whole life -
+// which also covers the main thread when it helps out.
+// --------------------------------------------------------
+void JobSystem::WorkerLoop()
+{
+#ifdef _WIN32
+	HRESULT com = CoInitializeEx(0, COINIT_MULTITHREADED);
+#endif
+
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return shuttingDown || !queue.empty(); });
+			if (queue.empty())
+				break;
+
+			task = std::move(queue.front());
+			queue.pop_front();
+		}
+		task();
+	}
+
+#ifdef _WIN32
+	if (SUCCEEDED(com))
+		CoUninitialize();
+#endif
+}
+
+// --------------------------------------------------------
+// Pops and runs a single task on the calling thread, if
+// one is available.  Used so waiting threads stay busy.
+// --------------------------------------------------------
+bool JobSystem::RunOneQueuedTask()
+{
+	std::function<void()> task;
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		if (queue.empty())
+			return false;
+
+		task = std::move(queue.front());
+		queue.pop_front();
+	}
+	task();
+	return true;
+}
+
+// --------------------------------------------------------
+// Splits [0, count) into at most one batch per thread (workers
+// plus the caller), queues all but the first, runs the first
+// here and then helps with the queue until everything is done.
+// --------------------------------------------------------
+void JobSystem::ParallelFor(
+	unsigned int count,
+	unsigned int minBatchSize,
+	const std::function<void(unsigned int start, unsigned int end)>& job)
+{
+	if (count == 0)
+		return;
+
+	minBatchSize = (std::max)(minBatchSize, 1u);
+	unsigned int maxBatches = (count + minBatchSize - 1) / minBatchSize;
+	unsigned int batchCount = (std::min)(maxBatches, GetWorkerCount() + 1);
+
+	// Not worth the hand-off
+	if (batchCount <= 1)
+	{
+		job(0, count);
+		return;
+	}
+
+	unsigned int batchSize = (count + batchCount - 1) / batchCount;
+	std::atomic<unsigned int> remaining(batchCount - 1);
+	std::mutex doneMutex;
+	std::condition_variable doneCondition;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (unsigned int b = 1; b < batchCount; b++)
+		{
+			unsigned int start = b * batchSize;
+			unsigned int end = (std::min)(start + batchSize, count);
+			queue.push_back([&, start, end]()
+			{
+				if (start < end)
+					job(start, end);
+
+				// Last one out wakes the caller
+				std::lock_guard<std::mutex> doneLock(doneMutex);
+				if (remaining.fetch_sub(1) == 1)
+					doneCondition.notify_one();
+			});
+		}
+	}
+	queueCondition.notify_all();
+
+	// First batch runs right here
+	job(0, (std::min)(batchSize, count));
+
+	// Help drain the queue (this also keeps nested ParallelFor calls from stalling)
+	while (remaining.load() > 0)
+	{
+		if (!RunOneQueuedTask())
+		{
+			std::unique_lock<std::mutex> lock(doneMutex);
+			doneCondition.wait(lock, [&] { return remaining.load() == 0; });
+		}
+	}
+
+	// The last batch may still be holding the lock it signalled under
+	std::lock_guard<std::mutex> lock(doneMutex);
+}
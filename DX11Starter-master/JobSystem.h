@@ -0,0 +1,99 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <future>
+#include <memory>
+#include <chrono>
+
+// --------------------------------------------------------
+// A small shared pool of worker threads.
+// 
+// ParallelFor splits a range into contiguous batches whose
+// boundaries depend only on the range and worker count, and
+// the calling thread helps out until every batch is done.
+//
+// Submit queues a single task and hands back a future for
+// its result; Wait blocks on one while helping the queue.
+// --------------------------------------------------------
+class JobSystem
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static JobSystem& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new JobSystem();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	JobSystem(JobSystem const&) = delete;
+	void operator=(JobSystem const&) = delete;
+
+private:
+	static JobSystem* instance;
+	JobSystem();
+#pragma endregion
+
+public:
+	~JobSystem();
+
+	// Number of background threads (the caller of ParallelFor also works)
+	unsigned int GetWorkerCount();
+
+	// Runs job(start, end) over [0, count) in batches of at least minBatchSize,
+	// returning once all of them have finished
+	void ParallelFor(
+		unsigned int count,
+		unsigned int minBatchSize,
+		const std::function<void(unsigned int start, unsigned int end)>& job);
+
+	// Queues task() on a worker and returns a future for whatever it returns
+	template<typename Task>
+	auto Submit(Task task) -> std::future<decltype(task())>
+	{
+		typedef decltype(task()) Result;
+
+		// std::function needs something copyable, so share the packaged task
+		std::shared_ptr<std::packaged_task<Result()>> packaged =
+			std::make_shared<std::packaged_task<Result()>>(std::move(task));
+		std::future<Result> future = packaged->get_future();
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back([packaged]() { (*packaged)(); });
+		}
+		queueCondition.notify_one();
+		return future;
+	}
+
+	// Runs queued tasks on this thread until the future is ready, then returns its result
+	template<typename Result>
+	Result Wait(std::future<Result>& future)
+	{
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!RunOneQueuedTask())
+				future.wait();
+		}
+		return future.get();
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> queue;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool shuttingDown;
+
+	void WorkerLoop();
+	bool RunOneQueuedTask();
+};
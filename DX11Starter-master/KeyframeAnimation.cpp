@@ -0,0 +1,387 @@
+#include "KeyframeAnimation.h"
+#include "AnimCurves.h"
+#include "JobSystem.h"
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// A key as Build() works with it: plain floats, rotations normalized and aligned
+struct KeyframeValue
+{
+	float Time;
+	float Value[4];
+	unsigned int Curve;
+};
+
+// Where every channel's sampled values go before they're written back
+struct KeyframeResult
+{
+	XMFLOAT4 Values[KEYFRAME_CHANNEL_COUNT];
+};
+
+static void NormalizeRotation(float* rotation)
+{
+	float length = sqrtf(
+		rotation[0] * rotation[0] + rotation[1] * rotation[1] +
+		rotation[2] * rotation[2] + rotation[3] * rotation[3]);
+	if (length > 0.0f)
+	{
+		for (unsigned int c = 0; c < 4; c++)
+			rotation[c] /= length;
+	}
+}
+
+// --------------------------------------------------------
+// Moves from a toward b by t (already eased).  Rotations
+// are renormalized, which makes this an nlerp - keys are
+// always on the same side, so it takes the short way.
+// --------------------------------------------------------
+static void BlendKeyframes(const float* a, const float* b, float t, unsigned int components, float* result)
+{
+	for (unsigned int c = 0; c < components; c++)
+		result[c] = a[c] + (b[c] - a[c]) * t;
+
+	if (components == 4)
+		NormalizeRotation(result);
+}
+
+static float EaseKeyframe(unsigned int curve, float t)
+{
+	return curve == KEYFRAME_CURVE_LINEAR ? t : GetCurveByIndex(curve, t);
+}
+
+static float GetKeyframeError(const float* a, const float* b, unsigned int components)
+{
+	float error = 0.0f;
+	for (unsigned int c = 0; c < components; c++)
+		error = std::max(error, fabsf(a[c] - b[c]));
+	return error;
+}
+
+// --------------------------------------------------------
+// Whether one segment from the (quantized) key at first to
+// the one at last stays within tolerance of the authored
+// keys between them, and of the authored segments halfway
+// along.  Only Build() uses this.
+// --------------------------------------------------------
+static bool KeyframeSegmentFits(
+	const std::vector<KeyframeValue>& authored,
+	const std::vector<KeyframeValue>& quantized,
+	unsigned int first,
+	unsigned int last,
+	unsigned int components,
+	float tolerance)
+{
+	const KeyframeValue& start = quantized[first];
+	const KeyframeValue& end = quantized[last];
+	float length = end.Time - start.Time;
+
+	float fitted[4];
+	float expected[4];
+	for (unsigned int i = first; i < last; i++)
+	{
+		// The authored key (the first is exact, being one of the two kept)
+		if (i > first)
+		{
+			BlendKeyframes(start.Value, end.Value, EaseKeyframe(start.Curve, (quantized[i].Time - start.Time) / length), components, fitted);
+			if (GetKeyframeError(fitted, authored[i].Value, components) > tolerance)
+				return false;
+		}
+
+		// And halfway to the next one
+		float time = (quantized[i].Time + quantized[i + 1].Time) * 0.5f;
+		BlendKeyframes(start.Value, end.Value, EaseKeyframe(start.Curve, (time - start.Time) / length), components, fitted);
+		BlendKeyframes(authored[i].Value, authored[i + 1].Value, EaseKeyframe(authored[i].Curve, 0.5f), components, expected);
+		if (GetKeyframeError(fitted, expected, components) > tolerance)
+			return false;
+	}
+
+	return true;
+}
+
+KeyframeClip::KeyframeClip() :
+	duration(0.0f)
+{
+	for (unsigned int channel = 0; channel < KEYFRAME_CHANNEL_COUNT; channel++)
+		tracks[channel] = KeyframeTrack();
+}
+
+// --------------------------------------------------------
+// Per channel: quantize the times over the last key's time
+// and the values over their range, then walk the keys,
+// keeping one only when the segment from the last kept key
+// can't reach past it.
+// --------------------------------------------------------
+bool KeyframeClip::Build(const std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT], float tolerance)
+{
+	for (unsigned int channel = 0; channel < KEYFRAME_CHANNEL_COUNT; channel++)
+		tracks[channel] = KeyframeTrack();
+	duration = 0.0f;
+	times.clear();
+	curves.clear();
+	values.clear();
+
+	for (unsigned int channel = 0; channel < KEYFRAME_CHANNEL_COUNT; channel++)
+	{
+		const std::vector<Keyframe>& channelKeys = keys[channel];
+		if (channelKeys.empty())
+			continue;
+
+		unsigned int components = channel == KEYFRAME_CHANNEL_ROTATION ? 4 : 3;
+		float lastTime = channelKeys.back().Time;
+		float timeStep = lastTime / KEYFRAME_QUANTIZED_MAX;
+
+		// Authored keys as floats, one per quantized time (the last one wins)
+		std::vector<KeyframeValue> authored;
+		std::vector<unsigned short> keyTimes;
+		for (size_t k = 0; k < channelKeys.size(); k++)
+		{
+			const Keyframe& key = channelKeys[k];
+			bool valid =
+				key.Time >= 0.0f &&
+				(key.Curve < EASE_CURVE_COUNT || key.Curve == KEYFRAME_CURVE_LINEAR) &&
+				(k == 0 || key.Time >= channelKeys[k - 1].Time);
+			if (!valid)
+			{
+				*this = KeyframeClip();
+				return false;
+			}
+
+			KeyframeValue value = {};
+			value.Time = key.Time;
+			value.Curve = key.Curve;
+			memcpy(value.Value, &key.Value.x, sizeof(value.Value));
+
+			if (components == 4)
+			{
+				NormalizeRotation(value.Value);
+				if (!authored.empty())
+				{
+					const float* previous = authored.back().Value;
+					float dot = 0.0f;
+					for (unsigned int c = 0; c < 4; c++)
+						dot += previous[c] * value.Value[c];
+					if (dot < 0.0f)
+					{
+						for (unsigned int c = 0; c < 4; c++)
+							value.Value[c] = -value.Value[c];
+					}
+				}
+			}
+
+			unsigned short time = lastTime > 0.0f ?
+				(unsigned short)(key.Time / lastTime * KEYFRAME_QUANTIZED_MAX + 0.5f) :
+				0;
+			if (!keyTimes.empty() && keyTimes.back() == time)
+			{
+				authored.back() = value;
+				continue;
+			}
+
+			authored.push_back(value);
+			keyTimes.push_back(time);
+		}
+
+		// Each component's range, in 16-bit steps
+		KeyframeTrack& track = tracks[channel];
+		float* valueMin = &track.ValueMin.x;
+		float* valueStep = &track.ValueStep.x;
+		for (unsigned int c = 0; c < components; c++)
+		{
+			float low = authored[0].Value[c];
+			float high = low;
+			for (const KeyframeValue& value : authored)
+			{
+				low = std::min(low, value.Value[c]);
+				high = std::max(high, value.Value[c]);
+			}
+			valueMin[c] = low;
+			valueStep[c] = (high - low) / KEYFRAME_QUANTIZED_MAX;
+		}
+
+		// Everything as it will play back
+		unsigned int keyCount = (unsigned int)authored.size();
+		std::vector<KeyframeValue> quantized(keyCount);
+		std::vector<unsigned short> keyValues(keyCount * components);
+		for (unsigned int k = 0; k < keyCount; k++)
+		{
+			quantized[k].Time = keyTimes[k] * timeStep;
+			quantized[k].Curve = authored[k].Curve;
+			for (unsigned int c = 0; c < components; c++)
+			{
+				unsigned short value = valueStep[c] > 0.0f ?
+					(unsigned short)((authored[k].Value[c] - valueMin[c]) / valueStep[c] + 0.5f) :
+					0;
+				keyValues[k * components + c] = value;
+				quantized[k].Value[c] = valueMin[c] + valueStep[c] * value;
+			}
+		}
+
+		// Greedy curve fit: stretch each segment until it misses a key it skips
+		std::vector<unsigned int> kept(1, 0);
+		for (unsigned int k = 2; k < keyCount; k++)
+		{
+			if (!KeyframeSegmentFits(authored, quantized, kept.back(), k, components, tolerance))
+				kept.push_back(k - 1);
+		}
+		if (keyCount > 1)
+			kept.push_back(keyCount - 1);
+
+		track.FirstKey = (unsigned int)times.size();
+		track.FirstValue = (unsigned int)values.size();
+		track.KeyCount = (unsigned int)kept.size();
+		track.Components = components;
+		track.TimeStep = timeStep;
+		for (unsigned int k : kept)
+		{
+			times.push_back(keyTimes[k]);
+			curves.push_back((unsigned char)authored[k].Curve);
+			values.insert(values.end(), keyValues.begin() + k * components, keyValues.begin() + (k + 1) * components);
+		}
+
+		duration = std::max(duration, lastTime);
+	}
+
+	return true;
+}
+
+// --------------------------------------------------------
+// Playing forward, the cursor is already on the right
+// segment or a step or two short of it.  Anything else (a
+// loop back to the start, a seek) is a binary search.
+// --------------------------------------------------------
+XMFLOAT4 KeyframeClip::Sample(unsigned int channel, float time, unsigned int& cursor) const
+{
+	XMFLOAT4 result(0.0f, 0.0f, 0.0f, 0.0f);
+	if (channel >= KEYFRAME_CHANNEL_COUNT || tracks[channel].KeyCount == 0)
+		return result;
+
+	const KeyframeTrack& track = tracks[channel];
+	const unsigned short* keyTimes = &times[track.FirstKey];
+	const unsigned short* keyValues = &values[track.FirstValue];
+	const float* valueMin = &track.ValueMin.x;
+	const float* valueStep = &track.ValueStep.x;
+	float* output = &result.x;
+	unsigned int last = track.KeyCount - 1;
+
+	// In quantized steps, where keys are
+	float step = track.TimeStep > 0.0f ? time / track.TimeStep : 0.0f;
+
+	// Before the first key or after the last, hold it
+	unsigned int held = last + 1;
+	if (last == 0 || step <= keyTimes[0])
+		held = 0;
+	else if (step >= keyTimes[last])
+		held = last;
+	if (held <= last)
+	{
+		cursor = held == 0 ? 0 : last - 1;
+		for (unsigned int c = 0; c < track.Components; c++)
+			output[c] = valueMin[c] + valueStep[c] * keyValues[held * track.Components + c];
+		if (track.Components == 4)
+			NormalizeRotation(output);
+		return result;
+	}
+
+	if (cursor >= last)
+		cursor = 0;
+	for (unsigned int s = 0; s < KEYFRAME_CURSOR_STEPS && step >= keyTimes[cursor + 1]; s++)
+		cursor++;
+	if (step < keyTimes[cursor] || step >= keyTimes[cursor + 1])
+		cursor = (unsigned int)(std::upper_bound(keyTimes, keyTimes + track.KeyCount, step) - keyTimes) - 1;
+
+	float a[4];
+	float b[4];
+	for (unsigned int c = 0; c < track.Components; c++)
+	{
+		a[c] = valueMin[c] + valueStep[c] * keyValues[cursor * track.Components + c];
+		b[c] = valueMin[c] + valueStep[c] * keyValues[(cursor + 1) * track.Components + c];
+	}
+
+	float t = (step - keyTimes[cursor]) / (float)(keyTimes[cursor + 1] - keyTimes[cursor]);
+	BlendKeyframes(a, b, EaseKeyframe(curves[track.FirstKey + cursor], t), track.Components, output);
+	return result;
+}
+
+bool KeyframeClip::HasChannel(unsigned int channel) const
+{
+	return channel < KEYFRAME_CHANNEL_COUNT && tracks[channel].KeyCount > 0;
+}
+
+float KeyframeClip::GetDuration() const
+{
+	return duration;
+}
+
+unsigned int KeyframeClip::GetKeyCount() const
+{
+	return (unsigned int)times.size();
+}
+
+size_t KeyframeClip::GetSizeInBytes() const
+{
+	return
+		sizeof(KeyframeClip) +
+		times.size() * sizeof(unsigned short) +
+		curves.size() * sizeof(unsigned char) +
+		values.size() * sizeof(unsigned short);
+}
+
+// --------------------------------------------------------
+// Two passes, like UpdateAnimations(): workers sample into
+// one result per component (each moving only its own
+// cursors), then this thread writes them to the store.
+// --------------------------------------------------------
+void UpdateKeyframeAnimations(ComponentArray<KeyframeComponent>& keyframes, float totalTime)
+{
+	unsigned int count = keyframes.GetCount();
+	if (count == 0)
+		return;
+
+	KeyframeComponent* components = keyframes.GetData();
+	std::vector<KeyframeResult> results(count);
+
+	JobSystem::GetInstance().ParallelFor(count, KEYFRAME_ENTITIES_PER_BATCH,
+		[&](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++)
+			{
+				KeyframeComponent& keyframe = components[i];
+				const KeyframeClip* clip = keyframe.Clip;
+
+				float time = (totalTime - keyframe.StartTime) * keyframe.Speed;
+				float duration = clip->GetDuration();
+				if (keyframe.Loop && duration > 0.0f)
+				{
+					time = fmodf(time, duration);
+					if (time < 0.0f)
+						time += duration;
+				}
+
+				for (unsigned int channel = 0; channel < KEYFRAME_CHANNEL_COUNT; channel++)
+				{
+					if (clip->HasChannel(channel))
+						results[i].Values[channel] = clip->Sample(channel, time, keyframe.Cursors[channel]);
+				}
+			}
+		});
+
+	TransformStore& transforms = TransformStore::GetInstance();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const KeyframeClip* clip = components[i].Clip;
+		unsigned int index = components[i].TransformIndex;
+		const XMFLOAT4* values = results[i].Values;
+
+		if (clip->HasChannel(KEYFRAME_CHANNEL_POSITION))
+			transforms.SetPosition(index, XMFLOAT3(values[KEYFRAME_CHANNEL_POSITION].x, values[KEYFRAME_CHANNEL_POSITION].y, values[KEYFRAME_CHANNEL_POSITION].z));
+		if (clip->HasChannel(KEYFRAME_CHANNEL_ROTATION))
+			transforms.SetRotation(index, values[KEYFRAME_CHANNEL_ROTATION]);
+		if (clip->HasChannel(KEYFRAME_CHANNEL_SCALE))
+			transforms.SetScale(index, XMFLOAT3(values[KEYFRAME_CHANNEL_SCALE].x, values[KEYFRAME_CHANNEL_SCALE].y, values[KEYFRAME_CHANNEL_SCALE].z));
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "ComponentArray.h"
+
+// What part of a transform a keyframe track drives
+#define KEYFRAME_CHANNEL_POSITION	0
+#define KEYFRAME_CHANNEL_ROTATION	1
+#define KEYFRAME_CHANNEL_SCALE		2
+#define KEYFRAME_CHANNEL_COUNT		3
+
+// Times and value components are stored as 16-bit steps between a track's extremes
+#define KEYFRAME_QUANTIZED_MAX 65535
+
+// Curves are the EASE_ values from AnimCurves.h, or this for a plain
+// linear blend (what sampled or exported animation usually wants)
+#define KEYFRAME_CURVE_LINEAR 30
+
+// Segments a cursor steps forward before giving up and searching
+#define KEYFRAME_CURSOR_STEPS 4
+
+// Keyframed entities per job system batch
+#define KEYFRAME_ENTITIES_PER_BATCH 256
+
+// --------------------------------------------------------
+// One key as authored.  Value is xyz for position and
+// scale, or a quaternion for rotation.  Curve eases the
+// segment from this key to the next.
+// --------------------------------------------------------
+struct Keyframe
+{
+	float Time;
+	DirectX::XMFLOAT4 Value;
+	unsigned int Curve;
+};
+
+// One channel's keys within its clip's arrays
+struct KeyframeTrack
+{
+	unsigned int FirstKey;			// Into the clip's times and curves
+	unsigned int FirstValue;		// Into its values, Components per key
+	unsigned int KeyCount;			// 0 when the clip doesn't drive the channel
+	unsigned int Components;		// 3, or 4 for rotation
+	float TimeStep;					// Seconds per quantized time step
+	DirectX::XMFLOAT4 ValueMin;		// Values are ValueMin + ValueStep * quantized
+	DirectX::XMFLOAT4 ValueStep;
+};
+
+// --------------------------------------------------------
+// Keyframed position, rotation and scale, compressed.
+//
+// Build() quantizes every key to 16 bits per time and per
+// value component, then drops each key the ones around it
+// reproduce within the tolerance (compared at the authored
+// keys and halfway between them, after quantization).  All
+// channels share one set of arrays, so a clip is a handful
+// of allocations however many keys it has.
+//
+// Rotations are normalized, flipped onto the same side as
+// the key before them, and blended as normalized lerps, so
+// the rotation tolerance is in quaternion components
+// (roughly half the angle, in radians).
+//
+// Sampling takes a cursor - the segment the last sample was
+// in - and steps forward from it, so playing forward costs
+// the same however many keys there are.  Jumps back (like
+// looping) or far ahead fall back to a binary search.
+// Clips are read-only once built and can be shared.
+// --------------------------------------------------------
+class KeyframeClip
+{
+public:
+	KeyframeClip();
+
+	// Replaces the clip with these keys (any channel may be empty).  False,
+	// leaving the clip empty, if keys are out of order, before time 0 or use
+	// an unknown curve.
+	bool Build(const std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT], float tolerance);
+
+	// The channel's value at a time, clamped to its first and last keys.
+	// The cursor is where to start looking, and is left on the segment used.
+	DirectX::XMFLOAT4 Sample(unsigned int channel, float time, unsigned int& cursor) const;
+
+	bool HasChannel(unsigned int channel) const;
+	float GetDuration() const;
+	unsigned int GetKeyCount() const;
+	size_t GetSizeInBytes() const;
+
+private:
+	KeyframeTrack tracks[KEYFRAME_CHANNEL_COUNT];
+	float duration;
+
+	std::vector<unsigned short> times;
+	std::vector<unsigned char> curves;
+	std::vector<unsigned short> values;
+};
+
+// --------------------------------------------------------
+// An entity playing a clip, starting at StartTime (in the
+// same time as UpdateKeyframeAnimations() is given).  The
+// cursors are per channel, and belong to the system.
+// --------------------------------------------------------
+struct KeyframeComponent
+{
+	unsigned int TransformIndex;	// Slot in the TransformStore
+	const KeyframeClip* Clip;		// Kept alive by the EntityStore
+	float StartTime;
+	float Speed;
+	unsigned int Loop;
+	unsigned int Cursors[KEYFRAME_CHANNEL_COUNT];
+};
+
+// --------------------------------------------------------
+// Samples every playing clip across the job system, then
+// writes the channels each one drives straight into the
+// TransformStore, in component order.
+// --------------------------------------------------------
+void UpdateKeyframeAnimations(ComponentArray<KeyframeComponent>& keyframes, float totalTime);
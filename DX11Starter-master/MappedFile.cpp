@@ -0,0 +1,58 @@
+#include "MappedFile.h"
+
+// --------------------------------------------------------
+// Opens and maps the whole file.  On any failure the mapping
+// is left invalid (check IsValid) rather than throwing.
+// --------------------------------------------------------
+MappedFile::MappedFile(const wchar_t* file) :
+	fileHandle(INVALID_HANDLE_VALUE),
+	mappingHandle(0),
+	data(0),
+	size(0)
+{
+	fileHandle = CreateFileW(
+		file,
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		0,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+		0);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+		return;
+
+	// Mapping objects can't be created for empty files, hence the check above
+	mappingHandle = CreateFileMappingW(fileHandle, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mappingHandle)
+		return;
+
+	data = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (data)
+		size = (unsigned long long)fileSize.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+}
+
+bool MappedFile::IsValid()
+{
+	return data != 0;
+}
+
+const unsigned char* MappedFile::GetData()
+{
+	return data;
+}
+
+unsigned long long MappedFile::GetSize()
+{
+	return size;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// Read-only memory mapping of an entire file.  The OS pages
+// the contents in on demand, so readers can hand the pointer
+// straight to memcpy (or an upload heap) without a staging copy.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+	MappedFile(const wchar_t* file);
+	~MappedFile();
+
+	// Mappings own OS handles, so they can't be copied
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	bool IsValid();
+	const unsigned char* GetData();
+	unsigned long long GetSize();
+
+private:
+	HANDLE fileHandle;
+	HANDLE mappingHandle;
+	const unsigned char* data;
+	unsigned long long size;
+};
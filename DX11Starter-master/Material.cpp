@@ -6,17 +6,45 @@ Material::Material(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState, XM
 {
 	finalized = false;
 
-	//textureSRVsBySlot[4];
+	for (int slot = 0; slot < 4; slot++)
+		textureSRVsBySlot[slot] = D3D12_CPU_DESCRIPTOR_HANDLE{};
+}
+
+// --------------------------------------------------------
+// Lets go of the textures, so DX12Helper can evict any
+// that no other material uses
+// --------------------------------------------------------
+Material::~Material()
+{
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+	for (int slot = 0; slot < 4; slot++)
+	{
+		if (textureSRVsBySlot[slot].ptr != 0)
+			dx12Helper.ReleaseTexture(textureSRVsBySlot[slot]);
+	}
 }
 
 void Material::AddTexture(D3D12_CPU_DESCRIPTOR_HANDLE srv, int slot)
 {
-	if (slot < 0 || slot >= 4)
+	// Out of range, or a texture that failed to load (the slot reads as zero)
+	if (slot < 0 || slot >= 4 || srv.ptr == 0)
 		return;
 
+	DX12Helper& dx12Helper = DX12Helper::GetInstance();
+	dx12Helper.AddTextureReference(srv);
+	if (textureSRVsBySlot[slot].ptr != 0)
+		dx12Helper.ReleaseTexture(textureSRVsBySlot[slot]);
 	textureSRVsBySlot[slot] = srv;
 }
 
+D3D12_CPU_DESCRIPTOR_HANDLE Material::GetTextureSRV(int slot)
+{
+	if (slot < 0 || slot >= 4)
+		return D3D12_CPU_DESCRIPTOR_HANDLE{};
+
+	return textureSRVsBySlot[slot];
+}
+
 void Material::FinalizeMaterial()
 {
 	if (finalized)
@@ -23,6 +23,7 @@ private:
 
 public: 
 	Material(Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState, XMFLOAT4 colorTint, XMFLOAT2 uvScale, XMFLOAT2 uvOffset, XMFLOAT4 lightHue);
+	~Material();
 
 	XMFLOAT4 GetColorTint();
 	XMFLOAT2 GetuvScale();
@@ -32,6 +33,8 @@ public:
 	Microsoft::WRL::ComPtr<ID3D12PipelineState> GetPipelineState();
 	D3D12_GPU_DESCRIPTOR_HANDLE GetFinalGPUHandleForTextures();
 
+	// Holds a reference to each texture until it's replaced or the material goes away
 	void AddTexture(D3D12_CPU_DESCRIPTOR_HANDLE srv, int slot);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetTextureSRV(int slot);
 	void FinalizeMaterial();
 };
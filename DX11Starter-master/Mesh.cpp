@@ -1,6 +1,14 @@
 #include "Mesh.h"
 #include "DX12Helper.h"
 #include "RaytracingHelper.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshCache.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 using namespace DirectX;
 
 Mesh::Mesh(Vertex vertices[], unsigned int indices[], int vertexCount, int indexCount, bool constructTangents)
@@ -8,10 +16,82 @@ Mesh::Mesh(Vertex vertices[], unsigned int indices[], int vertexCount, int index
 {
 	if(constructTangents)
 		CalculateTangents(&vertices[0], vertexCount, &indices[0], indexCount);
-	ContructVIBuffers(vertices, indices, vertexCount, indexCount);
+	BoundingBox::CreateFromPoints(bounds, vertexCount, &vertices[0].Position, sizeof(Vertex));
+	BoundingSphere::CreateFromPoints(sphere, vertexCount, &vertices[0].Position, sizeof(Vertex));
+
+	// Clustering reorders triangles, so upload the reordered copy
+	std::vector<unsigned int> clustered(indices, indices + indexCount);
+	BuildMeshlets(vertices, vertexCount, clustered, meshlets, meshletNodes);
+	BuildMeshletTrianglePackets(vertices, clustered.empty() ? indices : &clustered[0], meshlets, trianglePackets, meshletFirstPackets);
+	ContructVIBuffers(vertices, clustered.empty() ? indices : &clustered[0], vertexCount, indexCount);
 }
 
 Mesh::Mesh(const wchar_t* objFile)
+{
+	vertexCount = 0;
+	indicesCount = 0;
+
+	MeshData data;
+	if (LoadData(objFile, data))
+		CreateFromData(data);
+}
+
+Mesh::Mesh(const MeshData& data)
+{
+	vertexCount = 0;
+	indicesCount = 0;
+
+	if (data.VertexCount > 0 && data.IndexCount > 0)
+		CreateFromData(data);
+}
+
+// --------------------------------------------------------
+// Fills in the mesh data for an obj file, skipping the text
+// import entirely if this exact file has been cached before
+// --------------------------------------------------------
+bool Mesh::LoadData(const wchar_t* objFile, MeshData& data, unsigned long long sourceHash)
+{
+	if (sourceHash == 0)
+		sourceHash = HashFileContents(objFile);
+
+	if (LoadMeshCache(sourceHash, data))
+	{
+		data.SourceHash = sourceHash;
+		return true;
+	}
+
+	if (!ImportObj(objFile, data))
+		return false;
+
+	data.SourceHash = sourceHash;
+	WriteMeshCache(sourceHash, data);
+	return true;
+}
+
+// --------------------------------------------------------
+// Copies what the mesh keeps on the CPU and uploads the rest
+// --------------------------------------------------------
+void Mesh::CreateFromData(const MeshData& data)
+{
+	indicesCount = (int)data.IndexCount;
+	vertexCount = (int)data.VertexCount;
+	bounds = data.Bounds;
+	sphere = data.Sphere;
+	meshlets.assign(data.Meshlets, data.Meshlets + data.MeshletCount);
+	meshletNodes.assign(data.MeshletNodes, data.MeshletNodes + data.MeshletNodeCount);
+	BuildMeshletTrianglePackets(data.Vertices, data.Indices, meshlets, trianglePackets, meshletFirstPackets);
+
+	// When the data came from the cache this uploads straight out of the mapped file
+	ContructVIBuffers(data.Vertices, data.Indices, data.VertexCount, data.IndexCount);
+	for (unsigned int i = 0; i < data.LODCount; i++)
+		CreateLOD(data.LODs[i].Indices, data.LODs[i].IndexCount, data.LODs[i].Error);
+}
+
+// --------------------------------------------------------
+// Parses an OBJ file and runs the full import pipeline
+// (welding, reordering, tangents, bounds) on the result
+// --------------------------------------------------------
+bool Mesh::ImportObj(const wchar_t* objFile, MeshData& data)
 {
 	// Author: Chris Cascioli
 // Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
@@ -22,16 +102,12 @@ Mesh::Mesh(const wchar_t* objFile)
 //
 // - NOTE: You'll need to #include <fstream>
 
-	vertexCount = 0;
-	indicesCount = 0;
-
-
 // File input object
 	std::ifstream obj(objFile);
 
 	// Check for successful open
 	if (!obj.is_open())
-		return;
+		return false;
 
 	// Variables used while reading the file
 	std::vector<DirectX::XMFLOAT3> positions;	// Positions from the file
@@ -227,15 +303,81 @@ Mesh::Mesh(const wchar_t* objFile)
 	// - "vertCounter" is the number of vertices
 	// - "indexCounter" is the number of indices
 	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
+	//    an index buffer isn't doing much for us until the duplicates are welded below
+
+	// Weld duplicate corners, then reorder triangles for the post-transform
+	// cache, group them into meshlets, and reorder vertices for fetch
+	// locality before anything gets uploaded.  Debug builds measure the
+	// cache hit rate along the way; it costs a pass over the indices each time.
+#if defined(DEBUG) || defined(_DEBUG)
+	float rawACMR = CalculateACMR(indices, vertCounter);
+#endif
+	WeldVertices(verts, indices);
+#if defined(DEBUG) || defined(_DEBUG)
+	float weldedACMR = CalculateACMR(indices, (unsigned int)verts.size());
+#endif
+	OptimizeVertexCache(indices, (unsigned int)verts.size());
+	BuildMeshlets(verts.empty() ? 0 : &verts[0], (unsigned int)verts.size(), indices, data.MeshletStorage, data.MeshletNodeStorage);
+	OptimizeVertexFetch(verts, indices);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	float optimizedACMR = CalculateACMR(indices, (unsigned int)verts.size());
+	printf("Mesh %ls: %d -> %zu verts, ACMR %.3f (raw) %.3f (welded) %.3f (optimized), %zu meshlets\n",
+		objFile, vertCounter, verts.size(), rawACMR, weldedACMR, optimizedACMR, data.MeshletStorage.size());
+#endif
+
+	if (verts.empty() || indices.empty())
+		return false;
+
+	CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+	data.VertexStorage.swap(verts);
+	data.IndexStorage.swap(indices);
+	data.UseStorage();
+	BoundingBox::CreateFromPoints(data.Bounds, data.VertexCount, &data.Vertices[0].Position, sizeof(Vertex));
+	BoundingSphere::CreateFromPoints(data.Sphere, data.VertexCount, &data.Vertices[0].Position, sizeof(Vertex));
+	GenerateLODs(data);
+	return true;
+}
 
-	indicesCount = indexCounter;
-	vertexCount = vertCounter;
+// --------------------------------------------------------
+// Builds the simplified index lists for each coarser level.
+// Every level is simplified from the full mesh (rather than
+// the previous level) so its reported error is exact.
+// --------------------------------------------------------
+void Mesh::GenerateLODs(MeshData& data)
+{
+	data.LODCount = 0;
+	unsigned int previousCount = data.IndexCount;
+
+	for (unsigned int lod = 1; lod < MESH_MAX_LODS; lod++)
+	{
+		// Aim for half the triangles of the level before
+		unsigned int target = (data.IndexCount >> lod) / 3 * 3;
+		float error = 0.0f;
+		std::vector<unsigned int> indices = SimplifyMesh(
+			data.Vertices, data.VertexCount,
+			data.Indices, data.IndexCount,
+			target, MESH_LOD_MAX_ERROR, &error);
+
+		// Not worth another BLAS if it barely got any simpler
+		if (indices.empty() || indices.size() > previousCount * 3 / 4)
+			break;
+
+		OptimizeVertexCache(indices, data.VertexCount);
+		previousCount = (unsigned int)indices.size();
+
+		data.LODIndexStorage[data.LODCount].swap(indices);
+		data.LODs[data.LODCount].Error = error;
+		data.LODCount++;
+	}
 
-	CalculateTangents(&verts[0], vertexCount, &indices[0], indicesCount);
-	ContructVIBuffers(&(verts[0]), &(indices[0]), verts.size(), indices.size());
+	data.UseStorage();
+
+#if defined(DEBUG) || defined(_DEBUG)
+	for (unsigned int i = 0; i < data.LODCount; i++)
+		printf("  LOD %u: %u tris, error %.4f\n", i + 1, data.LODs[i].IndexCount / 3, data.LODs[i].Error);
+#endif
 }
 
 Mesh::~Mesh()
@@ -243,10 +385,9 @@ Mesh::~Mesh()
 
 }
 
-void Mesh::ContructVIBuffers(Vertex vertices[], unsigned int indices[], unsigned int vertexCount, unsigned int indexCount)
+void Mesh::ContructVIBuffers(const Vertex vertices[], const unsigned int indices[], unsigned int vertexCount, unsigned int indexCount)
 {
 	DX12Helper& dx12Helper = DX12Helper::GetInstance();
-	RaytracingHelper& rayHelper = RaytracingHelper::GetInstance();
 
 	// Create a VERTEX BUFFER
 		// - This buffer is created on the GPU, which is where the data needs to
@@ -273,7 +414,34 @@ void Mesh::ContructVIBuffers(Vertex vertices[], unsigned int indices[], unsigned
 		ibView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
 	}
 
-	raytracingData = rayHelper.CreateBottomLevelAccelerationStructureForMesh(this);
+	// The full mesh is always the first level.  Its BLAS (like
+	// every LOD's) waits until an instance actually uses it.
+	MeshLOD full = {};
+	full.IndexBuffer = indexBuffer;
+	full.IBView = ibView;
+	full.IndexCount = indexCount;
+	full.Error = 0.0f;
+	lods.clear();
+	lods.push_back(full);
+}
+
+// --------------------------------------------------------
+// Uploads a simplified index list that shares this mesh's
+// vertex buffer (its BLAS is built on first use)
+// --------------------------------------------------------
+void Mesh::CreateLOD(const unsigned int indices[], unsigned int indexCount, float error)
+{
+	if (indexCount == 0)
+		return;
+
+	MeshLOD lod = {};
+	lod.IndexBuffer = DX12Helper::GetInstance().CreateStaticBuffer(sizeof(unsigned int), indexCount, indices);
+	lod.IBView.Format = DXGI_FORMAT_R32_UINT;
+	lod.IBView.SizeInBytes = sizeof(unsigned int) * indexCount;
+	lod.IBView.BufferLocation = lod.IndexBuffer->GetGPUVirtualAddress();
+	lod.IndexCount = indexCount;
+	lod.Error = error;
+	lods.push_back(lod);
 }
 
 // --------------------------------------------------------
@@ -286,65 +454,152 @@ void Mesh::ContructVIBuffers(Vertex vertices[], unsigned int indices[], unsigned
 // contain an XMFLOAT3 called Tangent
 //
 // - Be sure to call this BEFORE creating your D3D vertex/index buffers
+//
+// - Runs on the job system in three steps, none of which
+// need atomics: per-triangle tangents, a vertex -> triangle
+// adjacency table, then a per-vertex gather that also does
+// the Gram-Schmidt pass eight vertices at a time.
 // --------------------------------------------------------
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = DirectX::XMFLOAT3(0, 0, 0);
-	}
+	if (numVerts <= 0 || numIndices < 3)
+		return;
+
+	JobSystem& jobs = JobSystem::GetInstance();
+	unsigned int triCount = (unsigned int)numIndices / 3;
+
 	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
+	std::vector<XMFLOAT3> triangleTangents(triCount);
+	jobs.ParallelFor(triCount, 4096, [&](unsigned int start, unsigned int end)
 	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
+		for (unsigned int t = start; t < end; t++)
+		{
+			// Grab indices and vertices of this triangle
+			const Vertex* v1 = &verts[indices[t * 3 + 0]];
+			const Vertex* v2 = &verts[indices[t * 3 + 1]];
+			const Vertex* v3 = &verts[indices[t * 3 + 2]];
+			// Calculate vectors relative to triangle positions
+			float x1 = v2->Position.x - v1->Position.x;
+			float y1 = v2->Position.y - v1->Position.y;
+			float z1 = v2->Position.z - v1->Position.z;
+			float x2 = v3->Position.x - v1->Position.x;
+			float y2 = v3->Position.y - v1->Position.y;
+			float z2 = v3->Position.z - v1->Position.z;
+			// Do the same for vectors relative to triangle uv's
+			float s1 = v2->UV.x - v1->UV.x;
+			float t1 = v2->UV.y - v1->UV.y;
+			float s2 = v3->UV.x - v1->UV.x;
+			float t2 = v3->UV.y - v1->UV.y;
+			// Degenerate uvs (all in a line or a point) would give an infinite
+			// tangent, so those triangles simply don't contribute
+			float det = s1 * t2 - s2 * t1;
+			if (!(std::fabs(det) > 1e-12f))
+			{
+				triangleTangents[t] = XMFLOAT3(0, 0, 0);
+				continue;
+			}
+			// Create vectors for tangent calculation
+			float r = 1.0f / det;
+			triangleTangents[t] = XMFLOAT3(
+				(t2 * x1 - t1 * x2) * r,
+				(t2 * y1 - t1 * y2) * r,
+				(t2 * z1 - t1 * z2) * r);
+		}
+	});
+
+	// Vertex -> triangle adjacency, so each vertex can gather its own sum
+	std::vector<unsigned int> adjacencyOffsets(numVerts + 1, 0);
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (int v = 0; v < numVerts; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<unsigned int> adjacency(triCount * 3);
 	{
-		// Grab the two vectors
-		DirectX::XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		DirectX::XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = DirectX::XMVector3Normalize(
-			tangent - normal * DirectX::XMVector3Dot(normal, tangent)); // Value is repeated for each componenent apparently 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int i = 0; i < triCount * 3; i++)
+			adjacency[fill[indices[i]]++] = i / 3;
 	}
+
+	// Gather and orthonormalize in blocks of 8 vertices, stored as
+	// structure-of-arrays so each SIMD lane handles one vertex
+	unsigned int blockCount = ((unsigned int)numVerts + 7) / 8;
+	jobs.ParallelFor(blockCount, 256, [&](unsigned int start, unsigned int end)
+	{
+		XMFLOAT4A nx[2], ny[2], nz[2], tx[2], ty[2], tz[2];
+		for (unsigned int block = start; block < end; block++)
+		{
+			unsigned int first = block * 8;
+			unsigned int count = std::min(8u, (unsigned int)numVerts - first);
+
+			// Sum each vertex's triangle tangents (unused lanes stay zero)
+			float* lanes[6] = { &nx[0].x, &ny[0].x, &nz[0].x, &tx[0].x, &ty[0].x, &tz[0].x };
+			for (int a = 0; a < 6; a++)
+				memset(lanes[a], 0, sizeof(float) * 8);
+
+			for (unsigned int lane = 0; lane < count; lane++)
+			{
+				unsigned int v = first + lane;
+				XMFLOAT3 sum(0, 0, 0);
+				for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+				{
+					const XMFLOAT3& t = triangleTangents[adjacency[a]];
+					sum.x += t.x;
+					sum.y += t.y;
+					sum.z += t.z;
+				}
+				lanes[0][lane] = verts[v].Normal.x;
+				lanes[1][lane] = verts[v].Normal.y;
+				lanes[2][lane] = verts[v].Normal.z;
+				lanes[3][lane] = sum.x;
+				lanes[4][lane] = sum.y;
+				lanes[5][lane] = sum.z;
+			}
+
+			for (int half = 0; half < 2; half++)
+			{
+				XMVECTOR NX = XMLoadFloat4A(&nx[half]);
+				XMVECTOR NY = XMLoadFloat4A(&ny[half]);
+				XMVECTOR NZ = XMLoadFloat4A(&nz[half]);
+				XMVECTOR TX = XMLoadFloat4A(&tx[half]);
+				XMVECTOR TY = XMLoadFloat4A(&ty[half]);
+				XMVECTOR TZ = XMLoadFloat4A(&tz[half]);
+
+				// Use Gram-Schmidt orthonormalize to ensure
+				// the normal and tangent are exactly 90 degrees apart
+				XMVECTOR dot = NX * TX + NY * TY + NZ * TZ;
+				TX -= NX * dot;
+				TY -= NY * dot;
+				TZ -= NZ * dot;
+
+				// Vertices whose triangles were all degenerate (or cancelled out) get
+				// any tangent perpendicular to their normal instead of a NaN
+				XMVECTOR zero = XMVectorZero();
+				XMVECTOR useXAxis = XMVectorLess(XMVectorAbs(NX), XMVectorReplicate(0.9f));
+				XMVECTOR fallbackX = XMVectorSelect(NZ, zero, useXAxis);  // cross(Y, n) or cross(X, n)
+				XMVECTOR fallbackY = XMVectorSelect(zero, -NZ, useXAxis);
+				XMVECTOR fallbackZ = XMVectorSelect(-NX, NY, useXAxis);
+
+				XMVECTOR lengthSq = TX * TX + TY * TY + TZ * TZ;
+				XMVECTOR degenerate = XMVectorLess(lengthSq, XMVectorReplicate(1e-12f));
+				TX = XMVectorSelect(TX, fallbackX, degenerate);
+				TY = XMVectorSelect(TY, fallbackY, degenerate);
+				TZ = XMVectorSelect(TZ, fallbackZ, degenerate);
+
+				lengthSq = TX * TX + TY * TY + TZ * TZ;
+				XMVECTOR invLength = XMVectorReciprocalSqrt(XMVectorMax(lengthSq, XMVectorReplicate(1e-24f)));
+				XMStoreFloat4A(&tx[half], TX * invLength);
+				XMStoreFloat4A(&ty[half], TY * invLength);
+				XMStoreFloat4A(&tz[half], TZ * invLength);
+			}
+
+			// Store the tangents
+			for (unsigned int lane = 0; lane < count; lane++)
+			{
+				verts[first + lane].Tangent = XMFLOAT3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+			}
+		}
+	});
 }
 
 
@@ -380,6 +635,67 @@ int Mesh::GetIndexCount()
 	return indicesCount;
 }
 
+/// <summary>
+/// Get the local space bounding box of this mesh
+/// </summary>
+/// <returns></returns>
+DirectX::BoundingBox Mesh::GetBounds()
+{
+	return bounds;
+}
+
+/// <summary>
+/// Get the local space bounding sphere of this mesh, fit to
+/// its vertices (so usually tighter than the box's corners)
+/// </summary>
+/// <returns></returns>
+DirectX::BoundingSphere Mesh::GetBoundingSphere()
+{
+	return sphere;
+}
+
+unsigned int Mesh::GetLODCount()
+{
+	return (unsigned int)lods.size();
+}
+
+// --------------------------------------------------------
+// BLAS's are built the first time a level is asked for, so
+// meshes (and levels) no instance uses never get one.  This
+// executes and waits on the command list, so call it before
+// recording anything else for the frame.
+// --------------------------------------------------------
+MeshRaytracingData Mesh::GetLODRaytracingData(unsigned int lod)
+{
+	if (lods.empty())
+		return MeshRaytracingData{};
+
+	MeshLOD& level = lods[std::min(lod, (unsigned int)lods.size() - 1)];
+	if (!level.RaytracingData.BLAS)
+	{
+		level.RaytracingData = RaytracingHelper::GetInstance().CreateBottomLevelAccelerationStructure(
+			vertexBuffer, vertexCount, level.IndexBuffer, level.IndexCount);
+	}
+	return level.RaytracingData;
+}
+
+// --------------------------------------------------------
+// LOD errors are stored relative to the bounding radius, so
+// multiplying by the on-screen radius gives the error in pixels
+// --------------------------------------------------------
+unsigned int Mesh::SelectLOD(float projectedRadiusInPixels)
+{
+	unsigned int selected = 0;
+	for (unsigned int i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].Error * projectedRadiusInPixels > MESH_LOD_PIXEL_ERROR)
+			break;
+
+		selected = i;
+	}
+	return selected;
+}
+
 void Mesh::Draw()
 {
 	// DRAW geometry
@@ -8,13 +8,37 @@
 #include <fstream>
 #include <vector>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 
 #include "MeshRaytracingData.h"
+#include "MeshData.h"
+
+// How far (in pixels) a LOD's simplification error may project
+// on screen before the next more detailed level is used instead
+#define MESH_LOD_PIXEL_ERROR 1.0f
+
+// Largest error (as a fraction of the bounding radius) a generated LOD may have
+#define MESH_LOD_MAX_ERROR 0.05f
+
+// One level of detail - shares the mesh's vertex buffer, but
+// has its own index buffer and (once it's first used) BLAS
+struct MeshLOD
+{
+	Microsoft::WRL::ComPtr<ID3D12Resource> IndexBuffer;
+	D3D12_INDEX_BUFFER_VIEW IBView;
+	unsigned int IndexCount;
+	float Error;
+	MeshRaytracingData RaytracingData;
+};
 
 class Mesh
 {
 private:
-	void ContructVIBuffers(Vertex vertices[], unsigned int indices[], unsigned int vertexCount, unsigned int indexCount);
+	void ContructVIBuffers(const Vertex vertices[], const unsigned int indices[], unsigned int vertexCount, unsigned int indexCount);
+	void CreateFromData(const MeshData& data);
+	static bool ImportObj(const wchar_t* objFile, MeshData& data);
+	static void GenerateLODs(MeshData& data);
+	void CreateLOD(const unsigned int indices[], unsigned int indexCount, float error);
 
 	// Buffers that connect data to the GPU 
 	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer;
@@ -24,8 +48,20 @@ private:
 
 	int indicesCount;
 	int vertexCount;
+	DirectX::BoundingBox bounds;
+	DirectX::BoundingSphere sphere;
+
+	// Index 0 is the full mesh, each one after is coarser
+	std::vector<MeshLOD> lods;
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	// CPU copies of the full mesh's clusters and the BVH over them,
+	// plus their triangles packed for ray queries
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshletBVHNode> meshletNodes;
+	std::vector<MeshletTrianglePacket> trianglePackets;
+	std::vector<unsigned int> meshletFirstPackets;
+
+	static void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
 
 public:
 	/// <summary>
@@ -36,6 +72,16 @@ public:
 	/// Create a mesh based on a given obj file 
 	/// </summary>
 	Mesh(const wchar_t* file);
+	/// <summary>
+	/// Create a mesh from data already loaded with LoadData (uploads only)
+	/// </summary>
+	Mesh(const MeshData& data);
+	/// <summary>
+	/// The CPU half of loading an obj file (cache lookup or full import).
+	/// Touches no GPU state, so it's safe to run on a worker thread.
+	/// Pass the file's contents hash if it's already known.
+	/// </summary>
+	static bool LoadData(const wchar_t* file, MeshData& data, unsigned long long sourceHash = 0);
 	~Mesh();
 
 	//Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
@@ -45,6 +91,8 @@ public:
 
 	int GetVertexCount();
 	int GetIndexCount();
+	DirectX::BoundingBox GetBounds();
+	DirectX::BoundingSphere GetBoundingSphere();
 
 	void Draw();
 
@@ -53,8 +101,32 @@ public:
 	D3D12_INDEX_BUFFER_VIEW GetIBView() { return ibView; } // Renamed
 	Microsoft::WRL::ComPtr<ID3D12Resource> GetVBResource() { return vertexBuffer; }
 	Microsoft::WRL::ComPtr<ID3D12Resource> GetIBResource() { return indexBuffer; }
-	MeshRaytracingData GetRaytracingData() { return raytracingData; }
-private:
-	MeshRaytracingData raytracingData;
+	MeshRaytracingData GetRaytracingData() { return GetLODRaytracingData(0); }
+
+	/// <summary>
+	/// How many levels of detail this mesh has (always at least 1)
+	/// </summary>
+	unsigned int GetLODCount();
+	MeshRaytracingData GetLODRaytracingData(unsigned int lod);
+	/// <summary>
+	/// Picks the coarsest LOD whose error stays under MESH_LOD_PIXEL_ERROR
+	/// for a mesh whose bounding sphere covers this many pixels of radius
+	/// </summary>
+	unsigned int SelectLOD(float projectedRadiusInPixels);
+
+	/// <summary>
+	/// Clusters of the full-detail triangles - each is a contiguous range of the index buffer
+	/// </summary>
+	const std::vector<Meshlet>& GetMeshlets() { return meshlets; }
+	/// <summary>
+	/// Local space BVH whose leaves are ranges of GetMeshlets()
+	/// </summary>
+	const std::vector<MeshletBVHNode>& GetMeshletBVH() { return meshletNodes; }
+	/// <summary>
+	/// Every meshlet's triangles, four to a packet - meshlet m's
+	/// packets run from GetMeshletFirstPackets()[m] up to [m + 1]
+	/// </summary>
+	const std::vector<MeshletTrianglePacket>& GetTrianglePackets() { return trianglePackets; }
+	const std::vector<unsigned int>& GetMeshletFirstPackets() { return meshletFirstPackets; }
 };
 
@@ -0,0 +1,172 @@
+#include "MeshCache.h"
+#include "PathHelpers.h"
+
+#include <fstream>
+#include <cstring>
+
+static const char MeshCacheMagic[4] = { 'R', 'T', 'M', 'C' };
+
+// Rounds up to the alignment used for each section of the file
+#define MESH_CACHE_ALIGN(value) (((value) + 15) / 16 * 16)
+
+// --------------------------------------------------------
+// 64-bit FNV-1a over the whole file.  The file is mapped
+// rather than streamed, so this runs at page-in speed.
+// --------------------------------------------------------
+unsigned long long HashFileContents(const wchar_t* file)
+{
+	MappedFile source(file);
+	if (!source.IsValid())
+		return 0;
+
+	const unsigned char* bytes = source.GetData();
+	unsigned long long size = source.GetSize();
+
+	unsigned long long hash = 14695981039346656037ull;
+	for (unsigned long long i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// --------------------------------------------------------
+// Builds the path for a given source hash, making sure the
+// cache folder exists first
+// --------------------------------------------------------
+std::wstring GetMeshCachePath(unsigned long long sourceHash)
+{
+	std::wstring folder = FixPath(L"MeshCache");
+	CreateDirectoryW(folder.c_str(), 0); // Fails harmlessly if it already exists
+
+	wchar_t name[32] = {};
+	swprintf_s(name, L"%016llx.mesh", sourceHash);
+	return folder + L"\\" + name;
+}
+
+// --------------------------------------------------------
+// Maps the cache file for this hash and validates it.  On
+// success the data's pointers reference the mapped file
+// directly - nothing is parsed or copied.
+// --------------------------------------------------------
+bool LoadMeshCache(unsigned long long sourceHash, MeshData& data)
+{
+	if (sourceHash == 0)
+		return false;
+
+	std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(GetMeshCachePath(sourceHash).c_str());
+	if (!mapping->IsValid() || mapping->GetSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	// Reject anything written by a different version or for a different source
+	const MeshCacheHeader* header = (const MeshCacheHeader*)mapping->GetData();
+	if (memcmp(header->Magic, MeshCacheMagic, sizeof(MeshCacheMagic)) != 0 ||
+		header->Version != MESH_CACHE_VERSION ||
+		header->SourceHash != sourceHash ||
+		header->VertexStride != sizeof(Vertex) ||
+		header->LODCount > MESH_MAX_LODS - 1)
+		return false;
+
+	// Make sure a truncated write can't send us past the end of the mapping
+	unsigned long long vertexBytes = (unsigned long long)header->VertexCount * sizeof(Vertex);
+	unsigned long long indexBytes = (unsigned long long)header->IndexCount * sizeof(unsigned int);
+	if (header->VertexOffset + vertexBytes > mapping->GetSize() ||
+		header->IndexOffset + indexBytes > mapping->GetSize())
+		return false;
+
+	for (unsigned int i = 0; i < header->LODCount; i++)
+	{
+		unsigned long long lodBytes = (unsigned long long)header->LODIndexCounts[i] * sizeof(unsigned int);
+		if (header->LODIndexOffsets[i] + lodBytes > mapping->GetSize())
+			return false;
+	}
+
+	unsigned long long meshletBytes = (unsigned long long)header->MeshletCount * sizeof(Meshlet);
+	unsigned long long nodeBytes = (unsigned long long)header->MeshletNodeCount * sizeof(MeshletBVHNode);
+	if (header->MeshletOffset + meshletBytes > mapping->GetSize() ||
+		header->MeshletNodeOffset + nodeBytes > mapping->GetSize())
+		return false;
+
+	data.Vertices = (const Vertex*)(mapping->GetData() + header->VertexOffset);
+	data.Indices = (const unsigned int*)(mapping->GetData() + header->IndexOffset);
+	data.VertexCount = header->VertexCount;
+	data.IndexCount = header->IndexCount;
+	data.Bounds = DirectX::BoundingBox(header->BoundsCenter, header->BoundsExtents);
+	data.Sphere = DirectX::BoundingSphere(header->SphereCenter, header->SphereRadius);
+	data.LODCount = header->LODCount;
+	for (unsigned int i = 0; i < header->LODCount; i++)
+	{
+		data.LODs[i].Indices = (const unsigned int*)(mapping->GetData() + header->LODIndexOffsets[i]);
+		data.LODs[i].IndexCount = header->LODIndexCounts[i];
+		data.LODs[i].Error = header->LODErrors[i];
+	}
+	data.Meshlets = (const Meshlet*)(mapping->GetData() + header->MeshletOffset);
+	data.MeshletNodes = (const MeshletBVHNode*)(mapping->GetData() + header->MeshletNodeOffset);
+	data.MeshletCount = header->MeshletCount;
+	data.MeshletNodeCount = header->MeshletNodeCount;
+	data.Mapping = mapping;
+	return true;
+}
+
+// --------------------------------------------------------
+// Writes the header and each section at its aligned offset
+// --------------------------------------------------------
+bool WriteMeshCache(unsigned long long sourceHash, const MeshData& data)
+{
+	if (sourceHash == 0 || data.VertexCount == 0 || data.IndexCount == 0)
+		return false;
+
+	MeshCacheHeader header = {};
+	memcpy(header.Magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+	header.Version = MESH_CACHE_VERSION;
+	header.SourceHash = sourceHash;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = data.VertexCount;
+	header.IndexCount = data.IndexCount;
+	header.BoundsCenter = data.Bounds.Center;
+	header.BoundsExtents = data.Bounds.Extents;
+	header.SphereCenter = data.Sphere.Center;
+	header.SphereRadius = data.Sphere.Radius;
+	header.VertexOffset = MESH_CACHE_ALIGN(sizeof(MeshCacheHeader));
+	header.IndexOffset = MESH_CACHE_ALIGN(header.VertexOffset + (unsigned long long)data.VertexCount * sizeof(Vertex));
+	header.LODCount = data.LODCount;
+
+	unsigned long long end = header.IndexOffset + (unsigned long long)data.IndexCount * sizeof(unsigned int);
+	for (unsigned int i = 0; i < data.LODCount; i++)
+	{
+		header.LODIndexCounts[i] = data.LODs[i].IndexCount;
+		header.LODErrors[i] = data.LODs[i].Error;
+		header.LODIndexOffsets[i] = MESH_CACHE_ALIGN(end);
+		end = header.LODIndexOffsets[i] + (unsigned long long)data.LODs[i].IndexCount * sizeof(unsigned int);
+	}
+	header.MeshletCount = data.MeshletCount;
+	header.MeshletNodeCount = data.MeshletNodeCount;
+	header.MeshletOffset = MESH_CACHE_ALIGN(end);
+	header.MeshletNodeOffset = MESH_CACHE_ALIGN(header.MeshletOffset + (unsigned long long)data.MeshletCount * sizeof(Meshlet));
+
+	std::ofstream out(GetMeshCachePath(sourceHash), std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
+
+	const char padding[16] = {};
+	out.write((const char*)&header, sizeof(header));
+	out.write(padding, header.VertexOffset - sizeof(header));
+	out.write((const char*)data.Vertices, (std::streamsize)data.VertexCount * sizeof(Vertex));
+	out.write(padding, header.IndexOffset - (header.VertexOffset + data.VertexCount * sizeof(Vertex)));
+	out.write((const char*)data.Indices, (std::streamsize)data.IndexCount * sizeof(unsigned int));
+
+	end = header.IndexOffset + (unsigned long long)data.IndexCount * sizeof(unsigned int);
+	for (unsigned int i = 0; i < data.LODCount; i++)
+	{
+		out.write(padding, header.LODIndexOffsets[i] - end);
+		out.write((const char*)data.LODs[i].Indices, (std::streamsize)data.LODs[i].IndexCount * sizeof(unsigned int));
+		end = header.LODIndexOffsets[i] + (unsigned long long)data.LODs[i].IndexCount * sizeof(unsigned int);
+	}
+
+	out.write(padding, header.MeshletOffset - end);
+	out.write((const char*)data.Meshlets, (std::streamsize)data.MeshletCount * sizeof(Meshlet));
+	out.write(padding, header.MeshletNodeOffset - (header.MeshletOffset + data.MeshletCount * sizeof(Meshlet)));
+	out.write((const char*)data.MeshletNodes, (std::streamsize)data.MeshletNodeCount * sizeof(MeshletBVHNode));
+	return out.good();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include "MeshData.h"
+
+// Bump whenever the file layout or the import pipeline that
+// produces the cached geometry changes, so old caches are ignored
+#define MESH_CACHE_VERSION 4
+
+// --------------------------------------------------------
+// Layout of a cached mesh file:
+//  - This header
+//  - VertexCount vertices, starting at VertexOffset
+//  - IndexCount 32-bit indices, starting at IndexOffset
+//  - LODCount simplified index lists, each at its own offset
+//  - MeshletCount meshlets, then MeshletNodeCount BVH nodes
+// Offsets are 16-byte aligned so the mapped data can be
+// handed directly to the upload path.
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char Magic[4];
+	unsigned int Version;
+	unsigned long long SourceHash;
+	unsigned int VertexStride;
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	unsigned int Pad;
+	DirectX::XMFLOAT3 BoundsCenter;
+	DirectX::XMFLOAT3 BoundsExtents;
+	DirectX::XMFLOAT3 SphereCenter;
+	float SphereRadius;
+	unsigned long long VertexOffset;
+	unsigned long long IndexOffset;
+	unsigned int LODCount;
+	unsigned int LODIndexCounts[MESH_MAX_LODS - 1];
+	float LODErrors[MESH_MAX_LODS - 1];
+	unsigned long long LODIndexOffsets[MESH_MAX_LODS - 1];
+	unsigned int MeshletCount;
+	unsigned int MeshletNodeCount;
+	unsigned long long MeshletOffset;
+	unsigned long long MeshletNodeOffset;
+};
+
+// Hash of a source file's bytes, used as the cache key (0 if unreadable)
+unsigned long long HashFileContents(const wchar_t* file);
+
+// Cache files live next to the executable, named by source hash
+std::wstring GetMeshCachePath(unsigned long long sourceHash);
+
+// Maps a cache file for this source hash into the given data (false on miss)
+bool LoadMeshCache(unsigned long long sourceHash, MeshData& data);
+
+// Writes the given data out so the next run can skip the import
+bool WriteMeshCache(unsigned long long sourceHash, const MeshData& data);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <DirectXCollision.h>
+
+#include "Vertex.h"
+#include "MappedFile.h"
+#include "MeshletBuilder.h"
+
+// Most detail levels a mesh can have, counting the full-detail one
+#define MESH_MAX_LODS 4
+
+// A simplified index buffer over the mesh's shared vertices
+struct MeshDataLOD
+{
+	const unsigned int* Indices = 0;
+	unsigned int IndexCount = 0;
+	float Error = 0.0f; // Relative to the bounding radius
+};
+
+// --------------------------------------------------------
+// CPU-side geometry for a mesh, ready to upload.
+// 
+// The pointers either reference the storage vectors (after
+// an import) or the mapped cache file (after a cache hit);
+// whichever backs them is kept alive by this struct.
+// --------------------------------------------------------
+struct MeshData
+{
+	const Vertex* Vertices = 0;
+	const unsigned int* Indices = 0;
+	unsigned int VertexCount = 0;
+	unsigned int IndexCount = 0;
+	DirectX::BoundingBox Bounds;
+	DirectX::BoundingSphere Sphere;
+
+	// Contents hash of the file this came from (0 if it wasn't loaded from one)
+	unsigned long long SourceHash = 0;
+
+	// Simplified levels after the full-detail one, coarsest last
+	MeshDataLOD LODs[MESH_MAX_LODS - 1];
+	unsigned int LODCount = 0;
+
+	// Clusters of the full-detail triangles, and the BVH over them
+	const Meshlet* Meshlets = 0;
+	const MeshletBVHNode* MeshletNodes = 0;
+	unsigned int MeshletCount = 0;
+	unsigned int MeshletNodeCount = 0;
+
+	std::vector<Vertex> VertexStorage;
+	std::vector<unsigned int> IndexStorage;
+	std::vector<unsigned int> LODIndexStorage[MESH_MAX_LODS - 1];
+	std::vector<Meshlet> MeshletStorage;
+	std::vector<MeshletBVHNode> MeshletNodeStorage;
+	std::shared_ptr<MappedFile> Mapping;
+
+	// Points the views at the storage vectors once they're filled
+	void UseStorage()
+	{
+		Vertices = VertexStorage.empty() ? 0 : &VertexStorage[0];
+		Indices = IndexStorage.empty() ? 0 : &IndexStorage[0];
+		VertexCount = (unsigned int)VertexStorage.size();
+		IndexCount = (unsigned int)IndexStorage.size();
+		Meshlets = MeshletStorage.empty() ? 0 : &MeshletStorage[0];
+		MeshletNodes = MeshletNodeStorage.empty() ? 0 : &MeshletNodeStorage[0];
+		MeshletCount = (unsigned int)MeshletStorage.size();
+		MeshletNodeCount = (unsigned int)MeshletNodeStorage.size();
+		for (unsigned int i = 0; i < LODCount; i++)
+		{
+			LODs[i].Indices = LODIndexStorage[i].empty() ? 0 : &LODIndexStorage[i][0];
+			LODs[i].IndexCount = (unsigned int)LODIndexStorage[i].size();
+		}
+	}
+};
@@ -0,0 +1,313 @@
+#include "MeshOptimizer.h"
+
+#include <unordered_map>
+#include <cmath>
+#include <cstring>
+
+// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+// --------------------------------------------------------
+// Hashing helpers for welding.  Only the attributes read
+// from the file take part - tangents are calculated after
+// welding, so they are still zero at this point.
+// --------------------------------------------------------
+struct WeldKeyHash
+{
+	size_t operator()(const Vertex& v) const
+	{
+		// FNV-1a over the raw bytes of each attribute
+		size_t hash = 2166136261u;
+		const unsigned char* parts[3] = {
+			(const unsigned char*)&v.Position,
+			(const unsigned char*)&v.Normal,
+			(const unsigned char*)&v.UV };
+		const size_t sizes[3] = { sizeof(v.Position), sizeof(v.Normal), sizeof(v.UV) };
+		for (int p = 0; p < 3; p++)
+		{
+			for (size_t i = 0; i < sizes[p]; i++)
+			{
+				hash ^= parts[p][i];
+				hash *= 16777619u;
+			}
+		}
+		return hash;
+	}
+};
+
+struct WeldKeyEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return
+			memcmp(&a.Position, &b.Position, sizeof(a.Position)) == 0 &&
+			memcmp(&a.Normal, &b.Normal, sizeof(a.Normal)) == 0 &&
+			memcmp(&a.UV, &b.UV, sizeof(a.UV)) == 0;
+	}
+};
+
+// --------------------------------------------------------
+// Merges vertices that share the exact same position, normal
+// and uv, rewriting the index buffer to point at the survivors.
+// OBJ files index each attribute separately, so the loader
+// emits one vertex per face corner - this undoes that.
+// --------------------------------------------------------
+void WeldVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::unordered_map<Vertex, unsigned int, WeldKeyHash, WeldKeyEqual> unique;
+	unique.reserve(verts.size());
+
+	std::vector<Vertex> welded;
+	welded.reserve(verts.size());
+
+	// Where each original vertex ended up
+	std::vector<unsigned int> remap(verts.size());
+	for (size_t i = 0; i < verts.size(); i++)
+	{
+		auto result = unique.insert(std::make_pair(verts[i], (unsigned int)welded.size()));
+		if (result.second)
+			welded.push_back(verts[i]);
+
+		remap[i] = result.first->second;
+	}
+
+	for (size_t i = 0; i < indices.size(); i++)
+		indices[i] = remap[indices[i]];
+
+	verts.swap(welded);
+}
+
+// --------------------------------------------------------
+// Scores a vertex based on where it sits in the simulated
+// cache and how many triangles still need it
+// --------------------------------------------------------
+static float ScoreVertex(int cachePosition, unsigned int remainingValence)
+{
+	// No triangles left to use this vertex
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// Used by the last triangle - a fixed score so that the
+			// order within the last triangle doesn't matter
+			score = LastTriScore;
+		}
+		else
+		{
+			// Points for being high in the cache
+			float scaler = 1.0f / (MESH_OPTIMIZER_CACHE_SIZE - 3);
+			score = 1.0f - (cachePosition - 3) * scaler;
+			score = std::pow(score, CacheDecayPower);
+		}
+	}
+
+	// Bonus for having few triangles left, so lone vertices get finished off
+	score += ValenceBoostScale * std::pow((float)remainingValence, -ValenceBoostPower);
+	return score;
+}
+
+// --------------------------------------------------------
+// Reorders triangles so that neighbouring triangles reuse
+// vertices that are still in the post-transform cache.
+// Since the greedy walk always continues from the triangles
+// around the most recent vertices, triangles that are close
+// in the index buffer also end up close in space.
+// --------------------------------------------------------
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+	unsigned int triCount = (unsigned int)(indices.size() / 3);
+	if (triCount == 0 || vertexCount == 0)
+		return;
+
+	// Build vertex -> triangle adjacency in a single flat array
+	std::vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triCount * 3; i++)
+		liveTriangles[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+	std::vector<unsigned int> adjacency(triCount * 3);
+	{
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int t = 0; t < triCount; t++)
+			for (int c = 0; c < 3; c++)
+				adjacency[fill[indices[t * 3 + c]]++] = t;
+	}
+
+	// Initial scores
+	std::vector<float> vertexScores(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScores[v] = ScoreVertex(-1, liveTriangles[v]);
+
+	std::vector<float> triangleScores(triCount);
+	std::vector<bool> emitted(triCount, false);
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		triangleScores[t] =
+			vertexScores[indices[t * 3 + 0]] +
+			vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+	}
+
+	// Start with the best scoring triangle overall
+	int bestTriangle = 0;
+	for (unsigned int t = 1; t < triCount; t++)
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+
+	std::vector<unsigned int> output;
+	output.reserve(triCount * 3);
+
+	// Cache holds a few extra slots for the vertices that get pushed out
+	std::vector<unsigned int> cache;
+	std::vector<unsigned int> nextCache;
+	cache.reserve(MESH_OPTIMIZER_CACHE_SIZE + 3);
+	nextCache.reserve(MESH_OPTIMIZER_CACHE_SIZE + 3);
+
+	unsigned int scanCursor = 0;
+	for (unsigned int emittedCount = 0; emittedCount < triCount; emittedCount++)
+	{
+		// Nothing useful in the cache, so fall back to the next unused triangle
+		if (bestTriangle < 0)
+		{
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTriangle = scanCursor;
+		}
+
+		unsigned int tri = (unsigned int)bestTriangle;
+		const unsigned int* triVerts = &indices[tri * 3];
+		output.push_back(triVerts[0]);
+		output.push_back(triVerts[1]);
+		output.push_back(triVerts[2]);
+		emitted[tri] = true;
+
+		// This triangle no longer counts towards its vertices' valence
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = triVerts[c];
+			unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int i = 0; i < liveTriangles[v]; i++)
+			{
+				if (list[i] == tri)
+				{
+					list[i] = list[liveTriangles[v] - 1];
+					list[liveTriangles[v] - 1] = tri;
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		nextCache.clear();
+		nextCache.push_back(triVerts[0]);
+		nextCache.push_back(triVerts[1]);
+		nextCache.push_back(triVerts[2]);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			if (v != triVerts[0] && v != triVerts[1] && v != triVerts[2])
+				nextCache.push_back(v);
+		}
+		cache.swap(nextCache);
+
+		// Rescore everything touched, keeping triangle scores in sync
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			unsigned int v = cache[i];
+			int position = i < MESH_OPTIMIZER_CACHE_SIZE ? (int)i : -1;
+
+			float newScore = ScoreVertex(position, liveTriangles[v]);
+			float delta = newScore - vertexScores[v];
+			vertexScores[v] = newScore;
+
+			const unsigned int* list = &adjacency[adjacencyOffsets[v]];
+			for (unsigned int a = 0; a < liveTriangles[v]; a++)
+			{
+				unsigned int t = list[a];
+				triangleScores[t] += delta;
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		// Anything past the real cache size has now been evicted
+		if (cache.size() > MESH_OPTIMIZER_CACHE_SIZE)
+			cache.resize(MESH_OPTIMIZER_CACHE_SIZE);
+	}
+
+	indices.swap(output);
+}
+
+// --------------------------------------------------------
+// Reorders the vertex buffer so vertices appear in the order
+// the index buffer first references them.  This keeps vertex
+// fetches (and the hit shader's byte address loads) walking
+// forward through memory.  Unreferenced vertices are dropped.
+// --------------------------------------------------------
+void OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	const unsigned int unassigned = 0xFFFFFFFF;
+	std::vector<unsigned int> remap(verts.size(), unassigned);
+
+	std::vector<Vertex> ordered;
+	ordered.reserve(verts.size());
+
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int& target = remap[indices[i]];
+		if (target == unassigned)
+		{
+			target = (unsigned int)ordered.size();
+			ordered.push_back(verts[indices[i]]);
+		}
+		indices[i] = target;
+	}
+
+	verts.swap(ordered);
+}
+
+// --------------------------------------------------------
+// Simulates a FIFO post-transform cache and returns the
+// number of cache misses (vertex shader runs) per triangle
+// --------------------------------------------------------
+float CalculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize)
+{
+	unsigned int triCount = (unsigned int)(indices.size() / 3);
+	if (triCount == 0)
+		return 0.0f;
+
+	// Each vertex remembers when it entered the cache
+	std::vector<unsigned int> entryTime(vertexCount, 0);
+	unsigned int clock = cacheSize + 1;
+	unsigned int misses = 0;
+
+	for (size_t i = 0; i < triCount * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (clock - entryTime[v] > cacheSize)
+		{
+			entryTime[v] = clock;
+			clock++;
+			misses++;
+		}
+	}
+
+	return (float)misses / triCount;
+}
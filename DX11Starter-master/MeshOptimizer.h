@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Size of the simulated post-transform cache used when reordering
+// triangles and when measuring the average cache miss ratio (ACMR)
+#define MESH_OPTIMIZER_CACHE_SIZE 32
+
+// Helpers for cleaning up CPU-side geometry before it is uploaded
+// - Call these in order: weld, reorder indices, then reorder vertices
+void WeldVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+void OptimizeVertexCache(std::vector<unsigned int>& indices, unsigned int vertexCount);
+void OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+// Average number of vertex shader invocations per triangle (lower is better, 0.5 is ideal)
+float CalculateACMR(const std::vector<unsigned int>& indices, unsigned int vertexCount, unsigned int cacheSize = MESH_OPTIMIZER_CACHE_SIZE);
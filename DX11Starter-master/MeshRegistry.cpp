@@ -0,0 +1,120 @@
+#include "MeshRegistry.h"
+#include "DX12Helper.h"
+
+#include <cwctype>
+#include <unordered_set>
+
+// Singleton requirement
+MeshRegistry* MeshRegistry::instance;
+
+// --------------------------------------------------------
+// Relative paths, ".." segments and letter case are
+// normalized, same as DX12Helper's texture cache keys
+// --------------------------------------------------------
+std::wstring MeshRegistry::GetPathKey(const std::wstring& file)
+{
+	wchar_t fullPath[MAX_PATH] = {};
+	DWORD length = GetFullPathNameW(file.c_str(), MAX_PATH, fullPath, 0);
+	std::wstring key = (length > 0 && length < MAX_PATH) ? fullPath : file;
+	for (wchar_t& c : key)
+		c = (wchar_t)towlower(c);
+	return key;
+}
+
+std::shared_ptr<Mesh> MeshRegistry::FindMesh(const std::wstring& file)
+{
+	auto existing = meshesByPath.find(GetPathKey(file));
+	if (existing == meshesByPath.end())
+		return nullptr;
+	return existing->second;
+}
+
+// --------------------------------------------------------
+// Creates (uploads) the mesh only if neither the path nor
+// the contents have been seen before.  Failed loads still
+// get an (empty) mesh so callers always get something back,
+// but it isn't kept, so the next load tries the file again.
+// --------------------------------------------------------
+std::shared_ptr<Mesh> MeshRegistry::AddMesh(const std::wstring& file, const MeshData& data)
+{
+	std::wstring key = GetPathKey(file);
+	auto existing = meshesByPath.find(key);
+	if (existing != meshesByPath.end())
+		return existing->second;
+
+	if (data.SourceHash != 0)
+	{
+		auto sameContents = meshesByHash.find(data.SourceHash);
+		if (sameContents != meshesByHash.end())
+		{
+			meshesByPath[key] = sameContents->second;
+			return sameContents->second;
+		}
+	}
+
+	std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(data);
+	if (data.VertexCount == 0)
+		return mesh;
+
+	meshesByPath[key] = mesh;
+	if (data.SourceHash != 0)
+		meshesByHash[data.SourceHash] = mesh;
+	return mesh;
+}
+
+// --------------------------------------------------------
+// A mesh is unused when every reference to it belongs to the
+// registry itself.  Its buffers may still be referenced by
+// in-flight command lists, so this waits for the GPU first.
+// --------------------------------------------------------
+unsigned int MeshRegistry::ReleaseUnusedMeshes()
+{
+	// Count the registry's own references to each mesh
+	struct References { long Registry; long Total; };
+	std::unordered_map<Mesh*, References> references;
+	for (auto& entry : meshesByPath)
+	{
+		References& r = references[entry.second.get()];
+		r.Registry++;
+		r.Total = entry.second.use_count();
+	}
+	for (auto& entry : meshesByHash)
+		references[entry.second.get()].Registry++;
+
+	// Decide everything up front, since erasing changes the counts
+	std::unordered_map<Mesh*, bool> unused;
+	for (auto& entry : references)
+	{
+		if (entry.second.Total == entry.second.Registry)
+			unused[entry.first] = true;
+	}
+	if (unused.empty())
+		return 0;
+
+	DX12Helper::GetInstance().WaitForGPU();
+
+	for (auto it = meshesByPath.begin(); it != meshesByPath.end();)
+	{
+		if (unused.count(it->second.get()))
+			it = meshesByPath.erase(it);
+		else
+			it++;
+	}
+	for (auto it = meshesByHash.begin(); it != meshesByHash.end();)
+	{
+		if (unused.count(it->second.get()))
+			it = meshesByHash.erase(it);
+		else
+			it++;
+	}
+	return (unsigned int)unused.size();
+}
+
+unsigned int MeshRegistry::GetMeshCount()
+{
+	// Every mesh has at least one path, but not necessarily a hash
+	std::unordered_set<Mesh*> distinct;
+	for (auto& entry : meshesByPath)
+		distinct.insert(entry.second.get());
+	return (unsigned int)distinct.size();
+}
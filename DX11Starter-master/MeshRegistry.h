@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "MeshData.h"
+
+// --------------------------------------------------------
+// The one place meshes loaded from files live.
+//
+// Every path maps to a single shared Mesh, and files with
+// identical contents (copies under different names) share
+// one too, so their buffers are uploaded once and their
+// BLAS's (which Mesh builds on first use) are built once.
+//
+// Main thread only - AssetLoader does the file work on
+// workers and registers the results here.
+// --------------------------------------------------------
+class MeshRegistry
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static MeshRegistry& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new MeshRegistry();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	MeshRegistry(MeshRegistry const&) = delete;
+	void operator=(MeshRegistry const&) = delete;
+
+private:
+	static MeshRegistry* instance;
+	MeshRegistry() {};
+#pragma endregion
+
+public:
+	// The mesh for a file if it's already registered, null otherwise
+	std::shared_ptr<Mesh> FindMesh(const std::wstring& file);
+
+	// Registers data loaded elsewhere under a file, reusing the
+	// existing mesh if the path or contents are already known
+	// (failed loads get an empty mesh that isn't registered)
+	std::shared_ptr<Mesh> AddMesh(const std::wstring& file, const MeshData& data);
+
+	// Drops meshes nothing outside the registry holds anymore
+	unsigned int ReleaseUnusedMeshes();
+
+	// Distinct meshes, however many paths lead to each
+	unsigned int GetMeshCount();
+
+private:
+	// Full, lower case path -> mesh
+	std::unordered_map<std::wstring, std::shared_ptr<Mesh>> meshesByPath;
+
+	// File contents hash -> mesh
+	std::unordered_map<unsigned long long, std::shared_ptr<Mesh>> meshesByHash;
+
+	std::wstring GetPathKey(const std::wstring& file);
+};
@@ -0,0 +1,351 @@
+#include "MeshSimplifier.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Collapses that turn a surrounding triangle further than this
+// (cosine of the angle between old and new normals) are rejected
+static const double MinNormalAgreement = 0.25;
+
+// --------------------------------------------------------
+// Symmetric 4x4 plane quadric, plus the total area of the
+// planes that went into it so errors can be averaged
+// --------------------------------------------------------
+struct Quadric
+{
+	double a2, ab, ac, ad;
+	double b2, bc, bd;
+	double c2, cd;
+	double d2;
+	double weight;
+
+	void AddPlane(double a, double b, double c, double d, double w)
+	{
+		a2 += w * a * a; ab += w * a * b; ac += w * a * c; ad += w * a * d;
+		b2 += w * b * b; bc += w * b * c; bd += w * b * d;
+		c2 += w * c * c; cd += w * c * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& q)
+	{
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	// Weighted sum of squared distances from the point to every plane
+	double Evaluate(double x, double y, double z) const
+	{
+		return
+			a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+			b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+			c2 * z * z + 2 * cd * z +
+			d2;
+	}
+};
+
+struct Collapse
+{
+	unsigned int source;
+	unsigned int target;
+	double cost;
+};
+
+// Hashes a position by its exact bits so coincident vertices can be grouped
+struct PositionHash
+{
+	size_t operator()(const DirectX::XMFLOAT3& p) const
+	{
+		unsigned int bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+	}
+};
+
+struct PositionEqual
+{
+	bool operator()(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) const
+	{
+		return memcmp(&a, &b, sizeof(a)) == 0;
+	}
+};
+
+static void Cross(const double a[3], const double b[3], double out[3])
+{
+	out[0] = a[1] * b[2] - a[2] * b[1];
+	out[1] = a[2] * b[0] - a[0] * b[2];
+	out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Unnormalized normal of the triangle p0, p1, p2
+static void TriangleNormal(const double* p0, const double* p1, const double* p2, double out[3])
+{
+	double e0[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	double e1[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	Cross(e0, e1, out);
+}
+
+std::vector<unsigned int> SimplifyMesh(
+	const Vertex* verts,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int targetIndexCount,
+	float targetError,
+	float* resultError)
+{
+	std::vector<unsigned int> tris(indices, indices + indexCount);
+	if (resultError) *resultError = 0.0f;
+	if (vertexCount == 0 || indexCount < 3)
+		return tris;
+
+	// Positions in double precision for the quadric math
+	std::vector<double> positions(vertexCount * 3);
+	double boundsMin[3] = { verts[0].Position.x, verts[0].Position.y, verts[0].Position.z };
+	double boundsMax[3] = { boundsMin[0], boundsMin[1], boundsMin[2] };
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		double* p = &positions[v * 3];
+		p[0] = verts[v].Position.x;
+		p[1] = verts[v].Position.y;
+		p[2] = verts[v].Position.z;
+		for (int a = 0; a < 3; a++)
+		{
+			boundsMin[a] = std::min(boundsMin[a], p[a]);
+			boundsMax[a] = std::max(boundsMax[a], p[a]);
+		}
+	}
+
+	// Errors are measured relative to the bounding radius so callers don't need to know the scale
+	double radius = 0.5 * std::sqrt(
+		(boundsMax[0] - boundsMin[0]) * (boundsMax[0] - boundsMin[0]) +
+		(boundsMax[1] - boundsMin[1]) * (boundsMax[1] - boundsMin[1]) +
+		(boundsMax[2] - boundsMin[2]) * (boundsMax[2] - boundsMin[2]));
+	if (radius <= 0.0)
+		return tris;
+	double maxError = targetError * radius;
+
+	// Group vertices that share a position - each group shares one quadric
+	std::vector<unsigned int> groups(vertexCount);
+	std::vector<unsigned int> groupSizes;
+	{
+		std::unordered_map<DirectX::XMFLOAT3, unsigned int, PositionHash, PositionEqual> unique;
+		unique.reserve(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			auto result = unique.insert(std::make_pair(verts[v].Position, (unsigned int)groupSizes.size()));
+			if (result.second)
+				groupSizes.push_back(0);
+
+			groups[v] = result.first->second;
+			groupSizes[groups[v]]++;
+		}
+	}
+
+	// Find open edges (used by one triangle), keyed by position group
+	std::vector<bool> groupOnBorder(groupSizes.size(), false);
+	{
+		std::unordered_map<unsigned long long, unsigned int> edgeUses;
+		edgeUses.reserve(indexCount);
+		for (unsigned int i = 0; i < indexCount; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned long long g0 = groups[tris[i + e]];
+				unsigned long long g1 = groups[tris[i + (e + 1) % 3]];
+				if (g0 > g1) std::swap(g0, g1);
+				edgeUses[(g0 << 32) | g1]++;
+			}
+		}
+		for (auto it = edgeUses.begin(); it != edgeUses.end(); it++)
+		{
+			if (it->second == 1)
+			{
+				groupOnBorder[(unsigned int)(it->first >> 32)] = true;
+				groupOnBorder[(unsigned int)(it->first & 0xFFFFFFFF)] = true;
+			}
+		}
+	}
+
+	// Border and seam vertices stay put (they can still be collapse targets)
+	std::vector<bool> locked(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		locked[v] = groupSizes[groups[v]] > 1 || groupOnBorder[groups[v]];
+
+	// Area weighted plane quadrics
+	std::vector<Quadric> quadrics(groupSizes.size());
+	memset(&quadrics[0], 0, sizeof(Quadric) * quadrics.size());
+	for (unsigned int i = 0; i < indexCount; i += 3)
+	{
+		const double* p0 = &positions[tris[i + 0] * 3];
+		double n[3];
+		TriangleNormal(p0, &positions[tris[i + 1] * 3], &positions[tris[i + 2] * 3], n);
+		double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+
+		n[0] /= length; n[1] /= length; n[2] /= length;
+		double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+		double area = length * 0.5;
+		for (int c = 0; c < 3; c++)
+			quadrics[groups[tris[i + c]]].AddPlane(n[0], n[1], n[2], d, area);
+	}
+
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	double reachedError = 0.0;
+
+	// Each pass collapses a batch of independent edges, cheapest first
+	while (tris.size() > targetIndexCount)
+	{
+		unsigned int triCount = (unsigned int)tris.size() / 3;
+
+		// Vertex -> triangle adjacency for the current triangles
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (size_t i = 0; i < tris.size(); i++)
+			adjacencyOffsets[tris[i] + 1]++;
+		for (unsigned int v = 0; v < vertexCount; v++)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(tris.size());
+		{
+			std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < tris.size(); i++)
+				adjacency[fill[tris[i]]++] = (unsigned int)(i / 3);
+		}
+
+		// Score every directed edge whose source is allowed to move
+		collapses.clear();
+		for (size_t i = 0; i < tris.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = tris[i + e];
+				unsigned int b = tris[i + (e + 1) % 3];
+				for (int direction = 0; direction < 2; direction++)
+				{
+					unsigned int source = direction == 0 ? a : b;
+					unsigned int target = direction == 0 ? b : a;
+					if (locked[source])
+						continue;
+
+					Quadric q = quadrics[groups[source]];
+					q.Add(quadrics[groups[target]]);
+					const double* p = &positions[target * 3];
+					double cost = q.weight > 0.0 ? std::max(q.Evaluate(p[0], p[1], p[2]), 0.0) / q.weight : 0.0;
+
+					Collapse c = { source, target, cost };
+					collapses.push_back(c);
+				}
+			}
+		}
+		if (collapses.empty())
+			break;
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+		{
+			if (a.cost != b.cost) return a.cost < b.cost;
+			if (a.source != b.source) return a.source < b.source;
+			return a.target < b.target;
+		});
+
+		// Each interior collapse removes two triangles; don't overshoot the target by much
+		unsigned int targetTriCount = targetIndexCount / 3;
+		unsigned int collapseBudget = (triCount - std::min(triCount, targetTriCount)) / 2 + 1;
+		unsigned int collapsed = 0;
+
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			remap[v] = v;
+			touched[v] = false;
+		}
+
+		for (size_t c = 0; c < collapses.size() && collapsed < collapseBudget; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			double error = std::sqrt(collapse.cost);
+			if (error > maxError)
+				break;
+
+			unsigned int source = collapse.source;
+			unsigned int target = collapse.target;
+			if (touched[source] || touched[target])
+				continue;
+
+			// Reject the collapse if any surviving triangle around the source would flip
+			bool flips = false;
+			const double* targetPos = &positions[target * 3];
+			for (unsigned int a = adjacencyOffsets[source]; a < adjacencyOffsets[source + 1] && !flips; a++)
+			{
+				const unsigned int* tri = &tris[adjacency[a] * 3];
+				if (groups[tri[0]] == groups[target] || groups[tri[1]] == groups[target] || groups[tri[2]] == groups[target])
+					continue; // This one disappears
+
+				const double* p[3];
+				const double* moved[3];
+				for (int k = 0; k < 3; k++)
+				{
+					p[k] = &positions[tri[k] * 3];
+					moved[k] = tri[k] == source ? targetPos : p[k];
+				}
+
+				double before[3], after[3];
+				TriangleNormal(p[0], p[1], p[2], before);
+				TriangleNormal(moved[0], moved[1], moved[2], after);
+				double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+				double lengths = std::sqrt(
+					(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+					(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+				if (dot <= MinNormalAgreement * lengths)
+					flips = true;
+			}
+			if (flips)
+				continue;
+
+			// Commit, and freeze the one-ring so later collapses this pass see valid geometry
+			remap[source] = target;
+			quadrics[groups[target]].Add(quadrics[groups[source]]);
+			reachedError = std::max(reachedError, error);
+			collapsed++;
+
+			for (unsigned int a = adjacencyOffsets[source]; a < adjacencyOffsets[source + 1]; a++)
+			{
+				const unsigned int* tri = &tris[adjacency[a] * 3];
+				touched[tri[0]] = true;
+				touched[tri[1]] = true;
+				touched[tri[2]] = true;
+			}
+		}
+
+		if (collapsed == 0)
+			break;
+
+		// Rewrite the triangles and drop the ones that collapsed to a line
+		size_t write = 0;
+		for (size_t i = 0; i < tris.size(); i += 3)
+		{
+			unsigned int t0 = remap[tris[i + 0]];
+			unsigned int t1 = remap[tris[i + 1]];
+			unsigned int t2 = remap[tris[i + 2]];
+			if (groups[t0] == groups[t1] || groups[t1] == groups[t2] || groups[t0] == groups[t2])
+				continue;
+
+			tris[write++] = t0;
+			tris[write++] = t1;
+			tris[write++] = t2;
+		}
+		tris.resize(write);
+	}
+
+	if (resultError)
+		*resultError = (float)(reachedError / radius);
+	return tris;
+}
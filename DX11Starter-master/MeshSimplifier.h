@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Quadric error metric simplification (Garland & Heckbert)
+// using half-edge collapses, so the result is a new index
+// buffer over the SAME vertex buffer - LODs can share it.
+//
+// Vertices on open borders and on attribute seams (uv or
+// normal splits at one position) are never moved, which
+// keeps silhouettes and texture seams intact.
+//
+// targetIndexCount - Stop once the result is this small
+// targetError      - Largest allowed error, as a fraction of the mesh's bounding radius
+// resultError      - (Optional) Error actually reached, in the same units
+// --------------------------------------------------------
+std::vector<unsigned int> SimplifyMesh(
+	const Vertex* verts,
+	unsigned int vertexCount,
+	const unsigned int* indices,
+	unsigned int indexCount,
+	unsigned int targetIndexCount,
+	float targetError,
+	float* resultError = 0);
@@ -0,0 +1,395 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+// Normal cones wider than this (cosine to the axis) can't be culled
+static const float MinConeAgreement = 0.1f;
+
+// --------------------------------------------------------
+// Fills in the bounds and normal cone of a finished meshlet
+// from the triangles in its index range
+// --------------------------------------------------------
+static void CalculateMeshletBounds(const Vertex* verts, const unsigned int* indices, Meshlet& meshlet)
+{
+	const unsigned int* tris = indices + meshlet.IndexOffset;
+	unsigned int count = meshlet.TriangleCount * 3;
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const DirectX::XMFLOAT3& p = verts[tris[i]].Position;
+		boundsMin[0] = std::min(boundsMin[0], p.x); boundsMax[0] = std::max(boundsMax[0], p.x);
+		boundsMin[1] = std::min(boundsMin[1], p.y); boundsMax[1] = std::max(boundsMax[1], p.y);
+		boundsMin[2] = std::min(boundsMin[2], p.z); boundsMax[2] = std::max(boundsMax[2], p.z);
+	}
+
+	meshlet.Center = DirectX::XMFLOAT3(
+		(boundsMin[0] + boundsMax[0]) * 0.5f,
+		(boundsMin[1] + boundsMax[1]) * 0.5f,
+		(boundsMin[2] + boundsMax[2]) * 0.5f);
+	meshlet.Extents = DirectX::XMFLOAT3(
+		(boundsMax[0] - boundsMin[0]) * 0.5f,
+		(boundsMax[1] - boundsMin[1]) * 0.5f,
+		(boundsMax[2] - boundsMin[2]) * 0.5f);
+
+	// Sphere around the box center that holds every vertex
+	float radiusSquared = 0.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const DirectX::XMFLOAT3& p = verts[tris[i]].Position;
+		float dx = p.x - meshlet.Center.x;
+		float dy = p.y - meshlet.Center.y;
+		float dz = p.z - meshlet.Center.z;
+		radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+	}
+	meshlet.Radius = std::sqrt(radiusSquared);
+
+	// Average the unit face normals for the cone axis
+	std::vector<DirectX::XMFLOAT3> normals;
+	normals.reserve(meshlet.TriangleCount);
+	float axis[3] = { 0, 0, 0 };
+	for (unsigned int i = 0; i < count; i += 3)
+	{
+		const DirectX::XMFLOAT3& p0 = verts[tris[i + 0]].Position;
+		const DirectX::XMFLOAT3& p1 = verts[tris[i + 1]].Position;
+		const DirectX::XMFLOAT3& p2 = verts[tris[i + 2]].Position;
+		float e0[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		float e1[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		float n[3] = {
+			e0[1] * e1[2] - e0[2] * e1[1],
+			e0[2] * e1[0] - e0[0] * e1[2],
+			e0[0] * e1[1] - e0[1] * e1[0] };
+
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0f)
+			continue;
+
+		normals.push_back(DirectX::XMFLOAT3(n[0] / length, n[1] / length, n[2] / length));
+		axis[0] += normals.back().x;
+		axis[1] += normals.back().y;
+		axis[2] += normals.back().z;
+	}
+
+	meshlet.ConeAxis = DirectX::XMFLOAT3(0, 0, 0);
+	meshlet.ConeCutoff = 2.0f;
+	float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	if (axisLength <= 0.0f)
+		return;
+
+	meshlet.ConeAxis = DirectX::XMFLOAT3(axis[0] / axisLength, axis[1] / axisLength, axis[2] / axisLength);
+
+	// The widest normal decides the cone's half angle
+	float minDot = 1.0f;
+	for (size_t i = 0; i < normals.size(); i++)
+	{
+		float d =
+			normals[i].x * meshlet.ConeAxis.x +
+			normals[i].y * meshlet.ConeAxis.y +
+			normals[i].z * meshlet.ConeAxis.z;
+		minDot = std::min(minDot, d);
+	}
+
+	// Viewed within 90 degrees minus the half angle of the axis, the whole
+	// cluster faces away - store the sine of the half angle for that test
+	if (minDot > MinConeAgreement)
+		meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// --------------------------------------------------------
+// Builds a BVH over the meshlets by splitting at the median
+// centroid along the longest axis.  Meshlets are reordered
+// so every leaf covers a contiguous range.
+// --------------------------------------------------------
+static void BuildMeshletBVH(std::vector<Meshlet>& meshlets, std::vector<MeshletBVHNode>& nodes)
+{
+	nodes.clear();
+	if (meshlets.empty())
+		return;
+
+	// Each node still to process, as [node, first meshlet, meshlet count]
+	struct BuildTask { unsigned int Node, First, Count; };
+	std::vector<BuildTask> stack;
+	stack.push_back({ 0, 0, (unsigned int)meshlets.size() });
+	nodes.push_back(MeshletBVHNode());
+
+	while (!stack.empty())
+	{
+		BuildTask task = stack.back();
+		stack.pop_back();
+
+		// Bounds of every meshlet box, and of their centers for picking a split
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (unsigned int i = task.First; i < task.First + task.Count; i++)
+		{
+			const float* c = &meshlets[i].Center.x;
+			const float* e = &meshlets[i].Extents.x;
+			for (int a = 0; a < 3; a++)
+			{
+				boundsMin[a] = std::min(boundsMin[a], c[a] - e[a]);
+				boundsMax[a] = std::max(boundsMax[a], c[a] + e[a]);
+				centerMin[a] = std::min(centerMin[a], c[a]);
+				centerMax[a] = std::max(centerMax[a], c[a]);
+			}
+		}
+
+		MeshletBVHNode& node = nodes[task.Node];
+		node.Min = DirectX::XMFLOAT3(boundsMin[0], boundsMin[1], boundsMin[2]);
+		node.Max = DirectX::XMFLOAT3(boundsMax[0], boundsMax[1], boundsMax[2]);
+
+		if (task.Count <= MESHLET_BVH_LEAF_SIZE)
+		{
+			node.First = task.First;
+			node.Count = task.Count;
+			continue;
+		}
+
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+			if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+				axis = a;
+
+		unsigned int half = task.Count / 2;
+		std::nth_element(
+			meshlets.begin() + task.First,
+			meshlets.begin() + task.First + half,
+			meshlets.begin() + task.First + task.Count,
+			[axis](const Meshlet& a, const Meshlet& b) { return (&a.Center.x)[axis] < (&b.Center.x)[axis]; });
+
+		// Children are allocated as a pair ('node' is invalid after this)
+		unsigned int firstChild = (unsigned int)nodes.size();
+		node.First = firstChild;
+		node.Count = 0;
+		nodes.push_back(MeshletBVHNode());
+		nodes.push_back(MeshletBVHNode());
+
+		stack.push_back({ firstChild + 1, task.First + half, task.Count - half });
+		stack.push_back({ firstChild, task.First, half });
+	}
+}
+
+// --------------------------------------------------------
+// Greedily grows meshlets one triangle at a time, always
+// taking the neighbouring triangle that adds the fewest new
+// vertices (ties go to the one closest to the meshlet's
+// center) until a vertex or triangle limit is reached
+// --------------------------------------------------------
+void BuildMeshlets(
+	const Vertex* verts,
+	unsigned int vertexCount,
+	std::vector<unsigned int>& indices,
+	std::vector<Meshlet>& meshlets,
+	std::vector<MeshletBVHNode>& nodes)
+{
+	meshlets.clear();
+	nodes.clear();
+
+	unsigned int triCount = (unsigned int)(indices.size() / 3);
+	if (triCount == 0 || vertexCount == 0)
+		return;
+
+	// Vertex -> triangle adjacency in a single flat array
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (unsigned int v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<unsigned int> adjacency(triCount * 3);
+	{
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int t = 0; t < triCount; t++)
+			for (int c = 0; c < 3; c++)
+				adjacency[fill[indices[t * 3 + c]]++] = t;
+	}
+
+	// Triangle centroids for the distance tie break
+	std::vector<DirectX::XMFLOAT3> centroids(triCount);
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		const DirectX::XMFLOAT3& p0 = verts[indices[t * 3 + 0]].Position;
+		const DirectX::XMFLOAT3& p1 = verts[indices[t * 3 + 1]].Position;
+		const DirectX::XMFLOAT3& p2 = verts[indices[t * 3 + 2]].Position;
+		centroids[t] = DirectX::XMFLOAT3(
+			(p0.x + p1.x + p2.x) / 3.0f,
+			(p0.y + p1.y + p2.y) / 3.0f,
+			(p0.z + p1.z + p2.z) / 3.0f);
+	}
+
+	// Which meshlet each vertex was last added to
+	const unsigned int none = 0xFFFFFFFF;
+	std::vector<unsigned int> vertexMeshlet(vertexCount, none);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<unsigned int> candidates;
+
+	std::vector<unsigned int> output;
+	output.reserve(triCount * 3);
+
+	unsigned int scanCursor = 0;
+	unsigned int emittedCount = 0;
+	while (emittedCount < triCount)
+	{
+		Meshlet meshlet = {};
+		meshlet.IndexOffset = (unsigned int)output.size();
+		unsigned int id = (unsigned int)meshlets.size();
+		float centroidSum[3] = { 0, 0, 0 };
+		candidates.clear();
+
+		// Seed with the next unused triangle - the index buffer is already
+		// in cache order, so this one is near the previous meshlet
+		while (emitted[scanCursor])
+			scanCursor++;
+		unsigned int tri = scanCursor;
+
+		while (true)
+		{
+			// Add the triangle and queue up its neighbours
+			emitted[tri] = true;
+			emittedCount++;
+			meshlet.TriangleCount++;
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[tri * 3 + c];
+				output.push_back(v);
+				if (vertexMeshlet[v] != id)
+				{
+					vertexMeshlet[v] = id;
+					meshlet.VertexCount++;
+					for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+						if (!emitted[adjacency[a]])
+							candidates.push_back(adjacency[a]);
+				}
+			}
+			centroidSum[0] += centroids[tri].x;
+			centroidSum[1] += centroids[tri].y;
+			centroidSum[2] += centroids[tri].z;
+
+			if (meshlet.TriangleCount == MESHLET_MAX_TRIANGLES)
+				break;
+
+			// Pick the best neighbour that still fits, dropping used ones as we go
+			float center[3] = {
+				centroidSum[0] / meshlet.TriangleCount,
+				centroidSum[1] / meshlet.TriangleCount,
+				centroidSum[2] / meshlet.TriangleCount };
+			unsigned int best = none;
+			unsigned int bestNewVerts = 4;
+			float bestDistance = FLT_MAX;
+			size_t write = 0;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				unsigned int t = candidates[i];
+				if (emitted[t])
+					continue;
+				candidates[write++] = t;
+
+				unsigned int newVerts = 0;
+				for (int c = 0; c < 3; c++)
+					if (vertexMeshlet[indices[t * 3 + c]] != id)
+						newVerts++;
+				if (meshlet.VertexCount + newVerts > MESHLET_MAX_VERTICES)
+					continue;
+
+				float dx = centroids[t].x - center[0];
+				float dy = centroids[t].y - center[1];
+				float dz = centroids[t].z - center[2];
+				float distance = dx * dx + dy * dy + dz * dz;
+				if (newVerts < bestNewVerts || (newVerts == bestNewVerts && distance < bestDistance))
+				{
+					best = t;
+					bestNewVerts = newVerts;
+					bestDistance = distance;
+				}
+			}
+			candidates.resize(write);
+
+			if (best == none)
+				break;
+			tri = best;
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	for (size_t m = 0; m < meshlets.size(); m++)
+		CalculateMeshletBounds(verts, &output[0], meshlets[m]);
+
+	BuildMeshletBVH(meshlets, nodes);
+
+	// Lay the index buffer out in leaf order so neighbouring leaves are neighbours in memory too
+	indices.clear();
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		unsigned int start = meshlets[m].IndexOffset;
+		meshlets[m].IndexOffset = (unsigned int)indices.size();
+		indices.insert(indices.end(), output.begin() + start, output.begin() + start + meshlets[m].TriangleCount * 3);
+	}
+}
+
+// --------------------------------------------------------
+// Every meshlet gets whole packets to itself, so its last
+// one may have up to three empty lanes
+// --------------------------------------------------------
+void BuildMeshletTrianglePackets(
+	const Vertex* verts,
+	const unsigned int* indices,
+	const std::vector<Meshlet>& meshlets,
+	std::vector<MeshletTrianglePacket>& packets,
+	std::vector<unsigned int>& firstPackets)
+{
+	packets.clear();
+	firstPackets.resize(meshlets.size() + 1);
+
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		firstPackets[m] = (unsigned int)packets.size();
+
+		const unsigned int* tris = indices + meshlets[m].IndexOffset;
+		for (unsigned int first = 0; first < meshlets[m].TriangleCount; first += 4)
+		{
+			MeshletTrianglePacket packet = {};
+			for (unsigned int lane = 0; lane < 4 && first + lane < meshlets[m].TriangleCount; lane++)
+			{
+				const float* p0 = &verts[tris[(first + lane) * 3 + 0]].Position.x;
+				const float* p1 = &verts[tris[(first + lane) * 3 + 1]].Position.x;
+				const float* p2 = &verts[tris[(first + lane) * 3 + 2]].Position.x;
+				for (int a = 0; a < 3; a++)
+				{
+					(&packet.Corner[a].x)[lane] = p0[a];
+					(&packet.Edge1[a].x)[lane] = p1[a] - p0[a];
+					(&packet.Edge2[a].x)[lane] = p2[a] - p0[a];
+				}
+			}
+			packets.push_back(packet);
+		}
+	}
+
+	firstPackets[meshlets.size()] = (unsigned int)packets.size();
+}
+
+// --------------------------------------------------------
+// Cone test against the meshlet's bounding sphere, so it is
+// conservative for every point inside the cluster
+// --------------------------------------------------------
+bool IsMeshletBackfacing(const Meshlet& meshlet, const DirectX::XMFLOAT3& viewPosition)
+{
+	if (meshlet.ConeCutoff > 1.0f)
+		return false;
+
+	float toCenter[3] = {
+		meshlet.Center.x - viewPosition.x,
+		meshlet.Center.y - viewPosition.y,
+		meshlet.Center.z - viewPosition.z };
+	float distance = std::sqrt(toCenter[0] * toCenter[0] + toCenter[1] * toCenter[1] + toCenter[2] * toCenter[2]);
+	float d =
+		toCenter[0] * meshlet.ConeAxis.x +
+		toCenter[1] * meshlet.ConeAxis.y +
+		toCenter[2] * meshlet.ConeAxis.z;
+
+	return d >= meshlet.ConeCutoff * distance + meshlet.Radius;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// Limits for a single cluster of triangles (the same limits a
+// mesh shader would use, so the clusters could be drawn directly)
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// Most meshlets referenced by one leaf of the cluster BVH
+#define MESHLET_BVH_LEAF_SIZE 4
+
+// --------------------------------------------------------
+// A spatially coherent cluster of triangles.  Each meshlet
+// is a contiguous range of the mesh's index buffer.
+//
+// ConeAxis/ConeCutoff bound the normals of every triangle
+// in the cluster.  A cutoff above 1 means the normals are
+// too spread out to ever be culled as a group.
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int IndexOffset;
+	unsigned int TriangleCount;
+	unsigned int VertexCount;
+	float Radius;					// Bounding sphere around Center
+	DirectX::XMFLOAT3 Center;
+	float ConeCutoff;
+	DirectX::XMFLOAT3 Extents;		// Box around Center
+	float Pad;
+	DirectX::XMFLOAT3 ConeAxis;
+	float Pad2;
+};
+
+// --------------------------------------------------------
+// Node of a per-mesh BVH whose leaves are meshlets.
+// Interior nodes (Count == 0) have their two children at
+// First and First + 1.  Leaves cover Count meshlets
+// starting at index First.
+// --------------------------------------------------------
+struct MeshletBVHNode
+{
+	DirectX::XMFLOAT3 Min;
+	unsigned int First;
+	DirectX::XMFLOAT3 Max;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Four of a meshlet's triangles stored lane by lane (each
+// XMFLOAT4 holds one coordinate of all four), so a ray can
+// be tested against all of them at once.  A triangle is its
+// first vertex and the edges to the other two.  Lanes past
+// the meshlet's last triangle are degenerate and never hit.
+// --------------------------------------------------------
+struct MeshletTrianglePacket
+{
+	DirectX::XMFLOAT4 Corner[3];
+	DirectX::XMFLOAT4 Edge1[3];
+	DirectX::XMFLOAT4 Edge2[3];
+};
+
+// Splits the triangles into meshlets and builds the cluster BVH over them.
+// Indices are rewritten so each meshlet (in BVH leaf order) is one
+// contiguous range - run OptimizeVertexFetch afterwards to match.
+void BuildMeshlets(
+	const Vertex* verts,
+	unsigned int vertexCount,
+	std::vector<unsigned int>& indices,
+	std::vector<Meshlet>& meshlets,
+	std::vector<MeshletBVHNode>& nodes);
+
+// Packs each meshlet's triangles four at a time.  Meshlet m's packets
+// start at firstPackets[m] and end where meshlet m + 1's start.
+void BuildMeshletTrianglePackets(
+	const Vertex* verts,
+	const unsigned int* indices,
+	const std::vector<Meshlet>& meshlets,
+	std::vector<MeshletTrianglePacket>& packets,
+	std::vector<unsigned int>& firstPackets);
+
+// True if every triangle in the meshlet faces away from the given point
+bool IsMeshletBackfacing(const Meshlet& meshlet, const DirectX::XMFLOAT3& viewPosition);
@@ -98,7 +98,9 @@ float4 main(VertexToPixel input) : SV_TARGET
 	float3 albedo = Albedo.Sample(texSampler, input.uv).rgb;
 	float3 specColor = GetSpec(input, albedo, metalness);
 
-	float3 unpackedNormal = NormalMap.Sample(texSampler, input.uv).rgb * 2 - 1;
+	// Normal maps may be two channel (BC5), so rebuild z from x and y
+	float2 normalXY = NormalMap.Sample(texSampler, input.uv).rg * 2 - 1;
+	float3 unpackedNormal = float3(normalXY, sqrt(saturate(1 - dot(normalXY, normalXY))));
 	unpackedNormal = normalize(unpackedNormal);
 
 	// Simplifications include not re-normalizing the same vector more than once!
@@ -40,15 +40,18 @@ cbuffer SceneData : register(b0)
 };
 
 
-// Ensure this matches C++ buffer struct define!
-#define MAX_INSTANCES_PER_BLAS 100
 cbuffer ObjectData : register(b1)
 {
-	float4 entityColor[MAX_INSTANCES_PER_BLAS];
-	float4 lightHue[MAX_INSTANCES_PER_BLAS];
     float3 hardLightPoint;
 };
 
+// Ensure this matches C++ buffer struct!
+struct InstanceData
+{
+	float4 color;
+	float4 lightHue;
+};
+
 
 // === Resources ===
 
@@ -62,6 +65,9 @@ RaytracingAccelerationStructure SceneTLAS	: register(t0);
 ByteAddressBuffer IndexBuffer        		: register(t1);
 ByteAddressBuffer VertexBuffer				: register(t2);
 
+// Color and hue of every instance in the TLAS, by InstanceIndex()
+StructuredBuffer<InstanceData> Instances	: register(t3);
+
 
 static const float indexOfRefraction = 1.5;
 
@@ -299,19 +305,19 @@ void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes
 	Vertex interpolatedVert = InterpolateVertices(triangleIndex, barycentricData);
 
 	// Get the data for this entity
-	uint instanceID = InstanceID();
+	InstanceData instance = Instances[InstanceIndex()];
 
 	/*if (isLightSource[instanceID] == true)
 	{
-		payload.color += entityColor[instanceID].rgb;
+		payload.color += instance.color.rgb;
 	}
 	else
 	{
-		payload.color *= entityColor[instanceID].rgb;
+		payload.color *= instance.color.rgb;
 	}*/
 
-	payload.color += lightHue[instanceID].rgb;
-	payload.color *= entityColor[instanceID].rgb;
+	payload.color += instance.lightHue.rgb;
+	payload.color *= instance.color.rgb;
 
 	// Create another recurssive ray 
 	float2 uv = (float2)DispatchRaysIndex() / (float2)DispatchRaysDimensions();
@@ -320,7 +326,7 @@ void ClosestHit(inout RayPayload payload, BuiltInTriangleIntersectionAttributes
 
 	float3 randBounce = RandomCosineWeightedHemisphere(rand(rng), rand(rng.yx), interpolatedVert.normal);
 	float3 refl = reflect(WorldRayDirection(), interpolatedVert.normal);
-	float3 dir = normalize(lerp(refl, randBounce, entityColor[instanceID].a));
+	float3 dir = normalize(lerp(refl, randBounce, instance.color.a));
 	
     float3 origin = WorldRayOrigin() + WorldRayDirection() * RayTCurrent();
 
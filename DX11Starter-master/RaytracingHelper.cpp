@@ -1,9 +1,11 @@
 #include "RaytracingHelper.h"
 #include "DX12Helper.h"
 #include "BufferStructs.h"
+#include "TransformStore.h"
 
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -108,7 +110,7 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 
 		// Set up the root parameters for the global signature (of which there are four)
 		// These need to match the shader(s) we'll be using
-		D3D12_ROOT_PARAMETER rootParams[3] = {};
+		D3D12_ROOT_PARAMETER rootParams[4] = {};
 		{
 			// First param is the UAV range for the output texture
 			rootParams[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
@@ -127,6 +129,12 @@ void RaytracingHelper::CreateRaytracingRootSignatures()
 			rootParams[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
 			rootParams[2].DescriptorTable.NumDescriptorRanges = 1;
 			rootParams[2].DescriptorTable.pDescriptorRanges = &cbufferRange;
+
+			// Fourth is an SRV for the per instance data (as root SRV, like the accel structure)
+			rootParams[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+			rootParams[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+			rootParams[3].Descriptor.ShaderRegister = 3;
+			rootParams[3].Descriptor.RegisterSpace = 0;
 		}
 
 		// Create the global root signature
@@ -538,19 +546,38 @@ void RaytracingHelper::ResizeOutputUAV(unsigned int screenWidth, unsigned int sc
 // stored along with the associated mesh.
 // --------------------------------------------------------
 MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMesh(Mesh* mesh)
+{
+	return CreateBottomLevelAccelerationStructure(
+		mesh->GetVBResource(),
+		(unsigned int)mesh->GetVertexCount(),
+		mesh->GetIBResource(),
+		(unsigned int)mesh->GetIndexCount());
+}
+
+
+// --------------------------------------------------------
+// Creates a BLAS (and the matching hit group record) for a
+// vertex/index buffer pair.  Mesh LODs share one vertex
+// buffer, so each level comes through here with its own IB.
+// --------------------------------------------------------
+MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructure(
+	Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer,
+	unsigned int vertexCount,
+	Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer,
+	unsigned int indexCount)
 {
 	MeshRaytracingData raytracingData = {};
 
 	// Describe the geometry data we intend to store in this BLAS
 	D3D12_RAYTRACING_GEOMETRY_DESC geometryDesc = {};
 	geometryDesc.Type = D3D12_RAYTRACING_GEOMETRY_TYPE_TRIANGLES;
-	geometryDesc.Triangles.VertexBuffer.StartAddress = mesh->GetVBResource()->GetGPUVirtualAddress();
-	geometryDesc.Triangles.VertexBuffer.StrideInBytes = mesh->GetVBView().StrideInBytes;
-	geometryDesc.Triangles.VertexCount = static_cast<UINT>(mesh->GetVertexCount());
+	geometryDesc.Triangles.VertexBuffer.StartAddress = vertexBuffer->GetGPUVirtualAddress();
+	geometryDesc.Triangles.VertexBuffer.StrideInBytes = sizeof(Vertex);
+	geometryDesc.Triangles.VertexCount = vertexCount;
 	geometryDesc.Triangles.VertexFormat = DXGI_FORMAT_R32G32B32_FLOAT;
-	geometryDesc.Triangles.IndexBuffer = mesh->GetIBResource()->GetGPUVirtualAddress();
-	geometryDesc.Triangles.IndexFormat = mesh->GetIBView().Format;
-	geometryDesc.Triangles.IndexCount = static_cast<UINT>(mesh->GetIndexCount());
+	geometryDesc.Triangles.IndexBuffer = indexBuffer->GetGPUVirtualAddress();
+	geometryDesc.Triangles.IndexFormat = DXGI_FORMAT_R32_UINT;
+	geometryDesc.Triangles.IndexCount = indexCount;
 	geometryDesc.Triangles.Transform3x4 = 0;
 	geometryDesc.Flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE; // Performance boost when dealing with opaque geometry
 
@@ -584,6 +611,7 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
 		D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 		max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT));
+	blasSizeInBytes += accelStructPrebuildInfo.ResultDataMaxSizeInBytes;
 
 	// Describe the final BLAS and set up the build
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc = {};
@@ -613,9 +641,9 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 	indexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 	indexSRVDesc.Buffer.StructureByteStride = 0;
 	indexSRVDesc.Buffer.FirstElement = 0;
-	indexSRVDesc.Buffer.NumElements = mesh->GetIndexCount();
+	indexSRVDesc.Buffer.NumElements = indexCount;
 	indexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	dxrDevice->CreateShaderResourceView(mesh->GetIBResource().Get(), &indexSRVDesc, ib_cpu);
+	dxrDevice->CreateShaderResourceView(indexBuffer.Get(), &indexSRVDesc, ib_cpu);
 
 	// Vertex buffer SRV
 	D3D12_SHADER_RESOURCE_VIEW_DESC vertexSRVDesc = {};
@@ -624,9 +652,9 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 	vertexSRVDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 	vertexSRVDesc.Buffer.StructureByteStride = 0;
 	vertexSRVDesc.Buffer.FirstElement = 0;
-	vertexSRVDesc.Buffer.NumElements = (mesh->GetVertexCount() * sizeof(Vertex)) / sizeof(float); // How many floats total?
+	vertexSRVDesc.Buffer.NumElements = (vertexCount * sizeof(Vertex)) / sizeof(float); // How many floats total?
 	vertexSRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	dxrDevice->CreateShaderResourceView(mesh->GetVBResource().Get(), &vertexSRVDesc, vb_cpu);
+	dxrDevice->CreateShaderResourceView(vertexBuffer.Get(), &vertexSRVDesc, vb_cpu);
 
 	// All done - execute, wait and reset command list
 	dxrCommandList->Close();
@@ -658,79 +686,127 @@ MeshRaytracingData RaytracingHelper::CreateBottomLevelAccelerationStructureForMe
 
 
 // --------------------------------------------------------
-// Creates the top level accel structure for a vector of
-// game entities (a "scene"), using the meshes and transforms
-// of each entity for the BLAS instances.
+// Creates the top level accel structure for a scene's
+// entities, using the meshes and transforms of each one's
+// render component for the BLAS instances.
 // --------------------------------------------------------
-void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<std::shared_ptr<Entity>> scene)
+void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(EntityStore& scene, std::shared_ptr<Camera> camera)
 {
-	if (scene.size() == 0)
+	const RenderComponent* renderables = scene.GetRenderComponents().GetData();
+	unsigned int renderableCount = scene.GetRenderComponents().GetCount();
+	if (renderableCount == 0)
 		return;
 
-	// Create vector of instance descriptions
+	// Only the entities that moved since the last build have theirs redone
+	scene.UpdateBounds();
+	const BoundsComponent* bounds = scene.GetBoundsComponents().GetData();
+
+	TransformStore& transforms = TransformStore::GetInstance();
+
+	// Converts a world space radius at a given distance into pixels:
+	// proj._22 is 1 / tan(fov / 2), and half the screen height spans that
+	float pixelsPerUnitAtOne = 0.0f;
+	XMVECTOR cameraPosition = XMVectorZero();
+	if (camera)
+	{
+		pixelsPerUnitAtOne = camera->GetProjMatrix()->_22 * screenHeight * 0.5f;
+		XMFLOAT3 cameraPos = camera->GetTransform()->GetPosition();
+		cameraPosition = XMLoadFloat3(&cameraPos);
+	}
+
+	// Pick each instance's level of detail first.  Building a BLAS for
+	// a level nobody has used yet executes the command list and adds a
+	// hit group, so it all has to happen before anything is recorded.
+	std::vector<MeshRaytracingData> instanceLODs(renderableCount);
+	for (unsigned int i = 0; i < renderableCount; i++)
+	{
+		// Pick a level of detail from how big the mesh's bounding sphere is on screen
+		Mesh* mesh = renderables[i].RenderMesh;
+		unsigned int lod = 0;
+		if (camera && mesh->GetLODCount() > 1)
+		{
+			// Cached world space sphere (bounds are in step with the renderables)
+			XMVECTOR center = XMLoadFloat3(&bounds[i].WorldSphere.Center);
+			float radius = bounds[i].WorldSphere.Radius;
+
+			// Inside the sphere means it fills the screen, so keep full detail
+			float distance = XMVectorGetX(XMVector3Length(center - cameraPosition));
+			if (distance > radius)
+				lod = mesh->SelectLOD(radius * pixelsPerUnitAtOne / distance);
+		}
+
+		instanceLODs[i] = mesh->GetLODRaytracingData(lod);
+	}
+
+	// Create vector of instance descriptions, and the color data for each one
 	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> instanceDescs;
+	std::vector<RaytracingInstanceData> instanceData;
+	instanceDescs.reserve(renderableCount);
+	instanceData.reserve(renderableCount);
 
-	// Create a vector of instance IDs
-	std::vector<unsigned int> instanceIDs;
+	// One set of per mesh data for each BLAS (hit group)
 	std::vector<RaytracingEntityData> entityData;
-	instanceIDs.resize(blasCount); // One per BLAS (mesh) - all starting at zero due to resize()
 	entityData.resize(blasCount);
 
 	// Create an instance description for each entity
-	for (size_t i = 0; i < scene.size(); i++)
+	for (unsigned int i = 0; i < renderableCount; i++)
 	{
+		// Meshes that failed to load have no geometry to trace
+		MeshRaytracingData lodData = instanceLODs[i];
+		if (!lodData.BLAS)
+			continue;
+
 		// Grab this entity's transform and transpose to column major
-		DirectX::XMFLOAT4X4 transform = scene[i]->GetTransform()->GetWorldMatrix();
-		XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&transform)));
+		const DirectX::XMFLOAT4X4& world = transforms.GetWorldMatrix(renderables[i].TransformIndex);
+		DirectX::XMFLOAT4X4 transform;
+		XMStoreFloat4x4(&transform, XMMatrixTranspose(XMLoadFloat4x4(&world)));
 
-		// Grab this mesh's index in the shader table
-		std::shared_ptr<Mesh> mesh = scene[i]->GetMesh();
-		unsigned int meshBlasIndex = mesh->GetRaytracingData().HitGroupIndex;
+		// Grab this LOD's index in the shader table
+		unsigned int meshBlasIndex = lodData.HitGroupIndex;
 
 		// Create this description and add to our overall set of descriptions
 		D3D12_RAYTRACING_INSTANCE_DESC id = {};
 		id.InstanceContributionToHitGroupIndex = meshBlasIndex;
-		id.InstanceID = instanceIDs[meshBlasIndex];
+		id.InstanceID = (unsigned int)instanceDescs.size();
 		id.InstanceMask = 0xFF;
 		memcpy(&id.Transform, &transform, sizeof(float) * 3 * 4); // Copy first [3][4] elements
-		id.AccelerationStructure = mesh->GetRaytracingData().BLAS->GetGPUVirtualAddress();
+		id.AccelerationStructure = lodData.BLAS->GetGPUVirtualAddress();
 		id.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
 		instanceDescs.push_back(id);
 
-		// Set up the entity data for this entity, too
-		// - mesh index tells us which cbuffer
-		// - instance ID tells us which instance in that cbuffer
-		XMFLOAT4 c = scene[i]->GetMaterial()->GetColorTint();
-		XMFLOAT4 lightHue = scene[i]->GetMaterial()->GetLightHue();
+		// Set up the instance data for this entity, too, at the same
+		// index as its description so the shader finds it by InstanceIndex()
+		RaytracingInstanceData data = {};
+		data.color = renderables[i].RenderMaterial->GetColorTint(); // Using alpha channel as "roughness"
+		data.lightHue = renderables[i].RenderMaterial->GetLightHue();
+		instanceData.push_back(data);
 
-		/*if (isLight == false)
-		{
-			printf("Found light source: %i \n", i);
-		}*/
-
-		entityData[meshBlasIndex].color[id.InstanceID] = c; // Using alpha channel as "roughness"
-		entityData[meshBlasIndex].lightHue[id.InstanceID] = lightHue;
 		entityData[meshBlasIndex].hardLightPoint = XMFLOAT3(0, 5.0, 0);
-
-		// On to the next instance for this mesh
-		instanceIDs[meshBlasIndex]++;
 	}
 
-	// Is our current description buffer too small?
+	if (instanceDescs.empty())
+		return;
+
+	// Are our current description and instance data buffers too small?
 	if (sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size() > tlasInstanceDataSizeInBytes)
 	{
-		// Create a new buffer to hold instance descriptions, since they
-		// need to actually be on the GPU
+		// Create new buffers to hold instance descriptions and data, since
+		// they need to actually be on the GPU
 		tlasInstanceDescBuffer.Reset();
+		tlasInstanceDataBuffer.Reset();
 		tlasInstanceDataSizeInBytes = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size();
 
 		tlasInstanceDescBuffer = DX12Helper::GetInstance().CreateBuffer(
 			tlasInstanceDataSizeInBytes,
 			D3D12_HEAP_TYPE_UPLOAD,
 			D3D12_RESOURCE_STATE_GENERIC_READ);
+		tlasInstanceDataBuffer = DX12Helper::GetInstance().CreateBuffer(
+			sizeof(RaytracingInstanceData) * instanceDescs.size(),
+			D3D12_HEAP_TYPE_UPLOAD,
+			D3D12_RESOURCE_STATE_GENERIC_READ);
 	}
 
-	// Copy the descriptions into the buffer
+	// Copy the descriptions and data into their buffers
 	// NOTE: This may be a spot where a small ringbuffer would be useful
 	//       if we're working multiple frames ahead of the GPU
 	unsigned char* mapped = 0;
@@ -738,16 +814,36 @@ void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<s
 	memcpy(mapped, &instanceDescs[0], sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * instanceDescs.size());
 	tlasInstanceDescBuffer->Unmap(0, 0);
 
+	tlasInstanceDataBuffer->Map(0, 0, (void**)&mapped);
+	memcpy(mapped, &instanceData[0], sizeof(RaytracingInstanceData) * instanceData.size());
+	tlasInstanceDataBuffer->Unmap(0, 0);
+
 	// Describe our overall input so we can get sizing info
 	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS accelStructInputs = {};
 	accelStructInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
 	accelStructInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
 	accelStructInputs.InstanceDescs = tlasInstanceDescBuffer->GetGPUVirtualAddress();
 	accelStructInputs.NumDescs = (unsigned int)instanceDescs.size();
-	accelStructInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+	accelStructInputs.Flags =
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE |
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE;
+
+	// With the same number of instances, the last TLAS can be refit (updated)
+	// in place rather than rebuilt, which is much cheaper.  Refits don't
+	// reorganize anything, so the tree gets looser as instances move and is
+	// rebuilt from scratch every so often.
+	bool refit =
+		tlasRefitEnabled &&
+		topLevelAccelerationStructure &&
+		tlasInstanceCount == instanceDescs.size() &&
+		tlasRefitCount < TLAS_MAX_REFITS_BEFORE_REBUILD;
+	if (refit)
+		accelStructInputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
 
 	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO accelStructPrebuildInfo = {};
 	dxrDevice->GetRaytracingAccelerationStructurePrebuildInfo(&accelStructInputs, &accelStructPrebuildInfo);
+	if (refit)
+		accelStructPrebuildInfo.ScratchDataSizeInBytes = accelStructPrebuildInfo.UpdateScratchDataSizeInBytes;
 
 	// Handle alignment requirements ourselves
 	accelStructPrebuildInfo.ScratchDataSizeInBytes = ALIGN(accelStructPrebuildInfo.ScratchDataSizeInBytes, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
@@ -788,8 +884,14 @@ void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<s
 	buildDesc.Inputs = accelStructInputs;
 	buildDesc.ScratchAccelerationStructureData = tlasScratchBuffer->GetGPUVirtualAddress();
 	buildDesc.DestAccelerationStructureData = topLevelAccelerationStructure->GetGPUVirtualAddress();
+	if (refit)
+		buildDesc.SourceAccelerationStructureData = buildDesc.DestAccelerationStructureData;
 	dxrCommandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, 0);
 
+	tlasInstanceCount = (unsigned int)instanceDescs.size();
+	tlasRefitCount = refit ? tlasRefitCount + 1 : 0;
+	tlasWasRefit = refit;
+
 	// Set up a barrier to wait until the TLAS is actually built to proceed
 	D3D12_RESOURCE_BARRIER tlasBarrier = {};
 	tlasBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
@@ -816,6 +918,30 @@ void RaytracingHelper::CreateTopLevelAccelerationStructureForScene(std::vector<s
 }
 
 
+// --------------------------------------------------------
+// Refits are on by default - turning them off forces a full
+// TLAS build every time (handy for measuring either one)
+// --------------------------------------------------------
+void RaytracingHelper::SetTopLevelRefitEnabled(bool enabled)
+{
+	tlasRefitEnabled = enabled;
+}
+
+RaytracingStats RaytracingHelper::GetStats()
+{
+	RaytracingStats stats = {};
+	stats.TLASInstanceCount = tlasInstanceCount;
+	stats.TLASWasRefit = tlasWasRefit;
+	stats.TLASBytes = tlasBufferSizeInBytes;
+	stats.TLASScratchBytes = tlasScratchSizeInBytes;
+	stats.InstanceBufferBytes = tlasInstanceDataSizeInBytes / sizeof(D3D12_RAYTRACING_INSTANCE_DESC) *
+		(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) + sizeof(RaytracingInstanceData));
+	stats.BLASBytes = blasSizeInBytes;
+	stats.BLASCount = blasCount;
+	return stats;
+}
+
+
 // --------------------------------------------------------
 // Performs the actual raytracing work
 // --------------------------------------------------------
@@ -844,7 +970,7 @@ void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::
 
 	// Grab and fill a constant buffer
 	RaytracingSceneData sceneData = {};
-	sceneData.cameraPosition = *camera->GetTransform()->GetPosition();
+	sceneData.cameraPosition = camera->GetTransform()->GetPosition();
 	
 	DirectX::XMFLOAT4X4 view = *camera->GetViewMatrix();
 	DirectX::XMFLOAT4X4 proj = *camera->GetProjMatrix();
@@ -870,6 +996,7 @@ void RaytracingHelper::Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::
 		dxrCommandList->SetComputeRootDescriptorTable(0, raytracingOutputUAV_GPU);	// First table is just output UAV
 		dxrCommandList->SetComputeRootShaderResourceView(1, topLevelAccelerationStructure->GetGPUVirtualAddress());		// Second is SRV for accel structure (as root SRV, no table needed)
 		dxrCommandList->SetComputeRootDescriptorTable(2, cbuffer);					// Third is CBV
+		dxrCommandList->SetComputeRootShaderResourceView(3, tlasInstanceDataBuffer->GetGPUVirtualAddress());	// Fourth is per instance data
 
 		// Dispatch rays
 		D3D12_DISPATCH_RAYS_DESC dispatchDesc = {};
@@ -8,10 +8,25 @@
 
 #include "Mesh.h"
 #include "Camera.h"
-#include "Entity.h"
+#include "EntityStore.h"
 
 #include "BufferStructs.h"
 
+// Most refits in a row before the TLAS is rebuilt to tighten it back up
+#define TLAS_MAX_REFITS_BEFORE_REBUILD 60
+
+// What the helper has allocated, and what the last TLAS update did
+struct RaytracingStats
+{
+	unsigned int TLASInstanceCount;
+	bool TLASWasRefit;
+	UINT64 TLASBytes;
+	UINT64 TLASScratchBytes;
+	UINT64 InstanceBufferBytes; // Instance descriptions and per instance data
+	UINT64 BLASBytes;
+	unsigned int BLASCount;
+};
+
 class RaytracingHelper
 {
 #pragma region Singleton
@@ -43,8 +58,13 @@ private:
 		tlasBufferSizeInBytes(0),
 		tlasScratchSizeInBytes(0),
 		tlasInstanceDataSizeInBytes(0),
+		tlasInstanceCount(0),
+		tlasRefitCount(0),
+		tlasRefitEnabled(true),
+		tlasWasRefit(false),
 		shaderTableRecordSize(0),
-		blasCount(0)
+		blasCount(0),
+		blasSizeInBytes(0)
 	{};
 #pragma endregion
 
@@ -66,7 +86,15 @@ public:
 
 	// Setup process requiring data from outside the helper
 	MeshRaytracingData CreateBottomLevelAccelerationStructureForMesh(Mesh* mesh);
-	void CreateTopLevelAccelerationStructureForScene(std::vector<std::shared_ptr<Entity>> scene);
+	MeshRaytracingData CreateBottomLevelAccelerationStructure(
+		Microsoft::WRL::ComPtr<ID3D12Resource> vertexBuffer,
+		unsigned int vertexCount,
+		Microsoft::WRL::ComPtr<ID3D12Resource> indexBuffer,
+		unsigned int indexCount);
+	// Pass a camera to pick each instance's mesh LOD by its size on screen
+	void CreateTopLevelAccelerationStructureForScene(EntityStore& scene, std::shared_ptr<Camera> camera = 0);
+	void SetTopLevelRefitEnabled(bool enabled);
+	RaytracingStats GetStats();
 
 	// Actual work
 	void Raytrace(std::shared_ptr<Camera> camera, Microsoft::WRL::ComPtr<ID3D12Resource> currentBackBuffer, bool executeCommandList = true);
@@ -81,13 +109,6 @@ private:
 	bool dxrAvailable;
 	bool helperInitialized;
 
-	// This represents the maximum number of hit groups
-	// in our shader table, each of which corresponds to
-	// a unique combination of geometry & hit shader.
-	// In a simple demo, this is effectively the maximum
-	// number of unique mesh BLAS's.
-	const unsigned int MAX_HIT_GROUPS_IN_SHADER_TABLE = 1000;
-
 	// Command queue for processing raytracing commands
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> commandQueue;
 
@@ -111,8 +132,9 @@ private:
 	UINT64 shaderTableRecordSize;
 	UINT64 shaderTableSize;
 
-	// How many BLAS we've created
+	// How many BLAS we've created, and their total size
 	UINT blasCount;
+	UINT64 blasSizeInBytes;
 
 	// Accel structure requirements
 	UINT64 tlasBufferSizeInBytes;
@@ -120,6 +142,13 @@ private:
 	UINT64 tlasInstanceDataSizeInBytes;
 	Microsoft::WRL::ComPtr<ID3D12Resource> tlasScratchBuffer; 
 	Microsoft::WRL::ComPtr<ID3D12Resource> tlasInstanceDescBuffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> tlasInstanceDataBuffer;
+
+	// Instances in the last TLAS and how many refits it's had since a full build
+	unsigned int tlasInstanceCount;
+	unsigned int tlasRefitCount;
+	bool tlasRefitEnabled;
+	bool tlasWasRefit;
 	Microsoft::WRL::ComPtr<ID3D12Resource> topLevelAccelerationStructure;
 
 	// Actual output resource
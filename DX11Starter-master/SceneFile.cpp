@@ -0,0 +1,565 @@
+#include "SceneFile.h"
+#include "MeshCache.h"
+#include "PathHelpers.h"
+
+#include <unordered_map>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const char SceneFileMagic[4] = { 'R', 'T', 'S', 'C' };
+
+// Rounds up to the alignment used for each section of the file
+#define SCENE_FILE_ALIGN(value) (((value) + 15) / 16 * 16)
+
+// --------------------------------------------------------
+// Splits one line into whitespace separated tokens, keeping
+// "quoted strings" (paths with spaces) together and stopping
+// at a # comment
+// --------------------------------------------------------
+static void TokenizeSceneLine(const char* start, const char* end, std::vector<std::string>& tokens)
+{
+	tokens.clear();
+	const char* c = start;
+	while (c < end)
+	{
+		while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+			c++;
+		if (c >= end || *c == '#')
+			return;
+
+		const char* tokenStart = c;
+		if (*c == '"')
+		{
+			tokenStart = ++c;
+			while (c < end && *c != '"')
+				c++;
+			tokens.push_back(std::string(tokenStart, c));
+			if (c < end)
+				c++;
+		}
+		else
+		{
+			while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+				c++;
+			tokens.push_back(std::string(tokenStart, c));
+		}
+	}
+}
+
+// Reads count floats following tokens[index], advancing index past them
+static bool ReadSceneFloats(const std::vector<std::string>& tokens, size_t& index, unsigned int count, float* out)
+{
+	if (index + count >= tokens.size())
+		return false;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const char* token = tokens[index + 1 + i].c_str();
+		char* parsedEnd = 0;
+		out[i] = strtof(token, &parsedEnd);
+		if (parsedEnd == token)
+			return false;
+	}
+	index += count;
+	return true;
+}
+
+static unsigned int AddSceneString(SceneData& scene, const std::string& str)
+{
+	unsigned int offset = (unsigned int)scene.StringStorage.size();
+	scene.StringStorage.insert(scene.StringStorage.end(), str.begin(), str.end());
+	scene.StringStorage.push_back('\0');
+	return offset;
+}
+
+// --------------------------------------------------------
+// One statement per line; meshes, textures and materials are
+// declared with a name that later lines refer to them by.
+// Properties after the names are optional and in any order.
+// --------------------------------------------------------
+bool ParseSceneText(const char* text, size_t length, SceneData& scene)
+{
+	scene = SceneData();
+
+	std::unordered_map<std::string, unsigned int> meshNames;
+	std::unordered_map<std::string, unsigned int> textureNames;
+	std::unordered_map<std::string, unsigned int> materialNames;
+	std::vector<std::string> tokens;
+
+	const char* end = text + length;
+	const char* lineStart = text;
+	unsigned int lineNumber = 0;
+	bool valid = true;
+
+	while (lineStart < end && valid)
+	{
+		const char* lineEnd = (const char*)memchr(lineStart, '\n', end - lineStart);
+		if (!lineEnd)
+			lineEnd = end;
+		lineNumber++;
+
+		TokenizeSceneLine(lineStart, lineEnd, tokens);
+		lineStart = lineEnd + 1;
+		if (tokens.empty())
+			continue;
+
+		const std::string& keyword = tokens[0];
+		if (keyword == "version")
+		{
+			valid = tokens.size() == 2 && atoi(tokens[1].c_str()) <= SCENE_FILE_VERSION;
+		}
+		else if (keyword == "mesh" || keyword == "texture")
+		{
+			valid = tokens.size() == 3;
+			if (!valid)
+				break;
+
+			bool isMesh = keyword == "mesh";
+			std::vector<unsigned int>& paths = isMesh ? scene.MeshPathStorage : scene.TexturePathStorage;
+			(isMesh ? meshNames : textureNames)[tokens[1]] = (unsigned int)paths.size();
+			paths.push_back(AddSceneString(scene, tokens[2]));
+		}
+		else if (keyword == "material")
+		{
+			valid = tokens.size() >= 2;
+			SceneMaterial material = {};
+			material.ColorTint = DirectX::XMFLOAT4(1, 1, 1, 1);
+			material.UVScale = DirectX::XMFLOAT2(1, 1);
+			for (unsigned int t = 0; t < SCENE_MATERIAL_TEXTURES; t++)
+				material.Textures[t] = SCENE_NO_TEXTURE;
+
+			for (size_t i = 2; i < tokens.size() && valid; i++)
+			{
+				if (tokens[i] == "color") valid = ReadSceneFloats(tokens, i, 4, &material.ColorTint.x);
+				else if (tokens[i] == "hue") valid = ReadSceneFloats(tokens, i, 4, &material.LightHue.x);
+				else if (tokens[i] == "uvscale") valid = ReadSceneFloats(tokens, i, 2, &material.UVScale.x);
+				else if (tokens[i] == "uvoffset") valid = ReadSceneFloats(tokens, i, 2, &material.UVOffset.x);
+				else if (tokens[i] == "textures")
+				{
+					// One name per slot, "-" for none
+					valid = i + SCENE_MATERIAL_TEXTURES < tokens.size();
+					for (unsigned int t = 0; t < SCENE_MATERIAL_TEXTURES && valid; t++)
+					{
+						const std::string& name = tokens[i + 1 + t];
+						if (name == "-")
+							continue;
+						auto found = textureNames.find(name);
+						valid = found != textureNames.end();
+						if (valid)
+							material.Textures[t] = found->second;
+					}
+					i += SCENE_MATERIAL_TEXTURES;
+				}
+				else valid = false;
+			}
+
+			if (valid)
+			{
+				materialNames[tokens[1]] = (unsigned int)scene.MaterialStorage.size();
+				scene.MaterialStorage.push_back(material);
+			}
+		}
+		else if (keyword == "instance")
+		{
+			valid = tokens.size() >= 3;
+			if (!valid)
+				break;
+
+			auto mesh = meshNames.find(tokens[1]);
+			auto material = materialNames.find(tokens[2]);
+			valid = mesh != meshNames.end() && material != materialNames.end();
+
+			SceneInstance instance = {};
+			instance.Scale = DirectX::XMFLOAT3(1, 1, 1);
+			for (size_t i = 3; i < tokens.size() && valid; i++)
+			{
+				if (tokens[i] == "position") valid = ReadSceneFloats(tokens, i, 3, &instance.Position.x);
+				else if (tokens[i] == "rotation") valid = ReadSceneFloats(tokens, i, 3, &instance.Rotation.x);
+				else if (tokens[i] == "scale")
+				{
+					// Either all three axes or one uniform value
+					if (!ReadSceneFloats(tokens, i, 3, &instance.Scale.x))
+					{
+						valid = ReadSceneFloats(tokens, i, 1, &instance.Scale.x);
+						instance.Scale.y = instance.Scale.z = instance.Scale.x;
+					}
+				}
+				else valid = false;
+			}
+
+			if (valid)
+			{
+				instance.Mesh = mesh->second;
+				instance.Material = material->second;
+				scene.InstanceStorage.push_back(instance);
+			}
+		}
+		else if (keyword == "animate")
+		{
+			// A track on the instance just before it
+			valid = tokens.size() >= 3 && !scene.InstanceStorage.empty();
+			if (!valid)
+				break;
+
+			SceneAnimation animation = {};
+			animation.Instance = (unsigned int)scene.InstanceStorage.size() - 1;
+			animation.Track.Channel = FindAnimationChannel(tokens[1].c_str());
+			animation.Track.Curve = FindAnimationCurve(tokens[2].c_str());
+			animation.Track.Amplitude = 1.0f;
+			animation.Track.Speed = 1.0f;
+			valid =
+				animation.Track.Channel < ANIMATION_CHANNEL_COUNT &&
+				animation.Track.Curve < ANIMATION_CURVE_COUNT;
+
+			for (size_t i = 3; i < tokens.size() && valid; i++)
+			{
+				if (tokens[i] == "amplitude") valid = ReadSceneFloats(tokens, i, 1, &animation.Track.Amplitude);
+				else if (tokens[i] == "offset") valid = ReadSceneFloats(tokens, i, 1, &animation.Track.Offset);
+				else if (tokens[i] == "phase") valid = ReadSceneFloats(tokens, i, 1, &animation.Track.Phase);
+				else if (tokens[i] == "speed") valid = ReadSceneFloats(tokens, i, 1, &animation.Track.Speed);
+				else valid = false;
+			}
+
+			if (valid)
+				scene.AnimationStorage.push_back(animation);
+		}
+		else if (keyword == "light")
+		{
+			valid = tokens.size() >= 2 && (tokens[1] == "point" || tokens[1] == "directional");
+			Light light = {};
+			light.type = tokens.size() >= 2 && tokens[1] == "directional" ? LIGHT_DIRECTION : LIGHT_POINT;
+			light.directiton = DirectX::XMFLOAT3(0, -1, 0);
+			light.color = DirectX::XMFLOAT3(1, 1, 1);
+			light.range = 10.0f;
+			light.intensity = 1.0f;
+
+			for (size_t i = 2; i < tokens.size() && valid; i++)
+			{
+				if (tokens[i] == "position") valid = ReadSceneFloats(tokens, i, 3, &light.position.x);
+				else if (tokens[i] == "direction") valid = ReadSceneFloats(tokens, i, 3, &light.directiton.x);
+				else if (tokens[i] == "color") valid = ReadSceneFloats(tokens, i, 3, &light.color.x);
+				else if (tokens[i] == "range") valid = ReadSceneFloats(tokens, i, 1, &light.range);
+				else if (tokens[i] == "intensity") valid = ReadSceneFloats(tokens, i, 1, &light.intensity);
+				else if (tokens[i] == "falloff") valid = ReadSceneFloats(tokens, i, 1, &light.spotFalloff);
+				else valid = false;
+			}
+
+			if (valid)
+				scene.LightStorage.push_back(light);
+		}
+		else if (keyword == "camera")
+		{
+			// Same defaults Game uses without a scene
+			SceneCamera camera = {};
+			camera.Position = DirectX::XMFLOAT3(0, 0, -10);
+			camera.FOV = 1.0f;
+			camera.MoveSpeed = 1.0f;
+			camera.SprintSpeed = 20.0f;
+			camera.LookSpeed = 0.1f;
+			camera.NearClip = 0.01f;
+			camera.FarClip = 1000.0f;
+
+			for (size_t i = 1; i < tokens.size() && valid; i++)
+			{
+				if (tokens[i] == "position") valid = ReadSceneFloats(tokens, i, 3, &camera.Position.x);
+				else if (tokens[i] == "rotation") valid = ReadSceneFloats(tokens, i, 3, &camera.Rotation.x);
+				else if (tokens[i] == "fov") valid = ReadSceneFloats(tokens, i, 1, &camera.FOV);
+				else if (tokens[i] == "speed") valid = ReadSceneFloats(tokens, i, 1, &camera.MoveSpeed);
+				else if (tokens[i] == "sprint") valid = ReadSceneFloats(tokens, i, 1, &camera.SprintSpeed);
+				else if (tokens[i] == "look") valid = ReadSceneFloats(tokens, i, 1, &camera.LookSpeed);
+				else if (tokens[i] == "near") valid = ReadSceneFloats(tokens, i, 1, &camera.NearClip);
+				else if (tokens[i] == "far") valid = ReadSceneFloats(tokens, i, 1, &camera.FarClip);
+				else valid = false;
+			}
+
+			scene.Camera = camera;
+			scene.HasCamera = valid;
+		}
+		else
+		{
+			valid = false;
+		}
+	}
+
+	if (!valid)
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Scene: can't parse line %u\n", lineNumber);
+#endif
+		return false;
+	}
+
+	scene.UseStorage();
+	return true;
+}
+
+// --------------------------------------------------------
+// Full float precision, so text -> binary -> text is lossless
+// --------------------------------------------------------
+void WriteSceneText(const SceneData& scene, std::string& text)
+{
+	char line[512];
+	text.clear();
+	text.reserve(64 + (size_t)scene.InstanceCount * 96);
+
+	snprintf(line, sizeof(line), "version %d\n", SCENE_FILE_VERSION);
+	text += line;
+
+	for (unsigned int i = 0; i < scene.MeshCount; i++)
+	{
+		snprintf(line, sizeof(line), "mesh m%u \"%s\"\n", i, scene.Strings + scene.MeshPaths[i]);
+		text += line;
+	}
+	for (unsigned int i = 0; i < scene.TextureCount; i++)
+	{
+		snprintf(line, sizeof(line), "texture t%u \"%s\"\n", i, scene.Strings + scene.TexturePaths[i]);
+		text += line;
+	}
+
+	for (unsigned int i = 0; i < scene.MaterialCount; i++)
+	{
+		const SceneMaterial& m = scene.Materials[i];
+		snprintf(line, sizeof(line), "material mat%u color %.9g %.9g %.9g %.9g hue %.9g %.9g %.9g %.9g uvscale %.9g %.9g uvoffset %.9g %.9g textures",
+			i, m.ColorTint.x, m.ColorTint.y, m.ColorTint.z, m.ColorTint.w,
+			m.LightHue.x, m.LightHue.y, m.LightHue.z, m.LightHue.w,
+			m.UVScale.x, m.UVScale.y, m.UVOffset.x, m.UVOffset.y);
+		text += line;
+		for (unsigned int t = 0; t < SCENE_MATERIAL_TEXTURES; t++)
+		{
+			if (m.Textures[t] == SCENE_NO_TEXTURE)
+				snprintf(line, sizeof(line), " -");
+			else
+				snprintf(line, sizeof(line), " t%u", m.Textures[t]);
+			text += line;
+		}
+		text += "\n";
+	}
+
+	// Animations are in instance order, and each follows its instance
+	unsigned int animation = 0;
+	for (unsigned int i = 0; i < scene.InstanceCount; i++)
+	{
+		const SceneInstance& s = scene.Instances[i];
+		snprintf(line, sizeof(line), "instance m%u mat%u position %.9g %.9g %.9g rotation %.9g %.9g %.9g scale %.9g %.9g %.9g\n",
+			s.Mesh, s.Material,
+			s.Position.x, s.Position.y, s.Position.z,
+			s.Rotation.x, s.Rotation.y, s.Rotation.z,
+			s.Scale.x, s.Scale.y, s.Scale.z);
+		text += line;
+
+		for (; animation < scene.AnimationCount && scene.Animations[animation].Instance == i; animation++)
+		{
+			const AnimationTrack& t = scene.Animations[animation].Track;
+			snprintf(line, sizeof(line), "animate %s %s amplitude %.9g offset %.9g phase %.9g speed %.9g\n",
+				GetAnimationChannelName(t.Channel), GetAnimationCurveName(t.Curve),
+				t.Amplitude, t.Offset, t.Phase, t.Speed);
+			text += line;
+		}
+	}
+
+	for (unsigned int i = 0; i < scene.LightCount; i++)
+	{
+		const Light& l = scene.Lights[i];
+		snprintf(line, sizeof(line), "light %s position %.9g %.9g %.9g direction %.9g %.9g %.9g color %.9g %.9g %.9g range %.9g intensity %.9g falloff %.9g\n",
+			l.type == LIGHT_DIRECTION ? "directional" : "point",
+			l.position.x, l.position.y, l.position.z,
+			l.directiton.x, l.directiton.y, l.directiton.z,
+			l.color.x, l.color.y, l.color.z,
+			l.range, l.intensity, l.spotFalloff);
+		text += line;
+	}
+
+	if (scene.HasCamera)
+	{
+		const SceneCamera& c = scene.Camera;
+		snprintf(line, sizeof(line), "camera position %.9g %.9g %.9g rotation %.9g %.9g %.9g fov %.9g speed %.9g sprint %.9g look %.9g near %.9g far %.9g\n",
+			c.Position.x, c.Position.y, c.Position.z,
+			c.Rotation.x, c.Rotation.y, c.Rotation.z,
+			c.FOV, c.MoveSpeed, c.SprintSpeed, c.LookSpeed, c.NearClip, c.FarClip);
+		text += line;
+	}
+}
+
+// --------------------------------------------------------
+// Header, then each section at a 16-byte aligned offset
+// --------------------------------------------------------
+void WriteSceneBinary(const SceneData& scene, unsigned long long sourceHash, std::vector<unsigned char>& bytes)
+{
+	SceneFileHeader header = {};
+	memcpy(header.Magic, SceneFileMagic, sizeof(SceneFileMagic));
+	header.Version = SCENE_FILE_VERSION;
+	header.SourceHash = sourceHash;
+	header.StringBytes = scene.StringBytes;
+	header.MeshCount = scene.MeshCount;
+	header.TextureCount = scene.TextureCount;
+	header.MaterialCount = scene.MaterialCount;
+	header.InstanceCount = scene.InstanceCount;
+	header.LightCount = scene.LightCount;
+	header.HasCamera = scene.HasCamera ? 1 : 0;
+	header.AnimationCount = scene.AnimationCount;
+	header.Camera = scene.Camera;
+
+	unsigned long long offset = SCENE_FILE_ALIGN(sizeof(SceneFileHeader));
+	header.StringOffset = offset; offset = SCENE_FILE_ALIGN(offset + scene.StringBytes);
+	header.MeshOffset = offset; offset = SCENE_FILE_ALIGN(offset + scene.MeshCount * sizeof(unsigned int));
+	header.TextureOffset = offset; offset = SCENE_FILE_ALIGN(offset + scene.TextureCount * sizeof(unsigned int));
+	header.MaterialOffset = offset; offset = SCENE_FILE_ALIGN(offset + scene.MaterialCount * sizeof(SceneMaterial));
+	header.InstanceOffset = offset; offset = SCENE_FILE_ALIGN(offset + (unsigned long long)scene.InstanceCount * sizeof(SceneInstance));
+	header.LightOffset = offset; offset = SCENE_FILE_ALIGN(offset + scene.LightCount * sizeof(Light));
+	header.AnimationOffset = offset; offset = SCENE_FILE_ALIGN(offset + (unsigned long long)scene.AnimationCount * sizeof(SceneAnimation));
+
+	bytes.assign((size_t)offset, 0);
+	memcpy(&bytes[0], &header, sizeof(header));
+	if (scene.StringBytes) memcpy(&bytes[(size_t)header.StringOffset], scene.Strings, scene.StringBytes);
+	if (scene.MeshCount) memcpy(&bytes[(size_t)header.MeshOffset], scene.MeshPaths, scene.MeshCount * sizeof(unsigned int));
+	if (scene.TextureCount) memcpy(&bytes[(size_t)header.TextureOffset], scene.TexturePaths, scene.TextureCount * sizeof(unsigned int));
+	if (scene.MaterialCount) memcpy(&bytes[(size_t)header.MaterialOffset], scene.Materials, scene.MaterialCount * sizeof(SceneMaterial));
+	if (scene.InstanceCount) memcpy(&bytes[(size_t)header.InstanceOffset], scene.Instances, (size_t)scene.InstanceCount * sizeof(SceneInstance));
+	if (scene.LightCount) memcpy(&bytes[(size_t)header.LightOffset], scene.Lights, scene.LightCount * sizeof(Light));
+	if (scene.AnimationCount) memcpy(&bytes[(size_t)header.AnimationOffset], scene.Animations, (size_t)scene.AnimationCount * sizeof(SceneAnimation));
+}
+
+// --------------------------------------------------------
+// Validates the header and every index before handing out
+// pointers, so a truncated or stale file can't send the game
+// off the end of the mapping
+// --------------------------------------------------------
+bool ReadSceneBinary(const unsigned char* bytes, unsigned long long size, SceneData& scene, unsigned long long* sourceHash)
+{
+	if (!bytes || size < sizeof(SceneFileHeader))
+		return false;
+
+	const SceneFileHeader* header = (const SceneFileHeader*)bytes;
+	if (memcmp(header->Magic, SceneFileMagic, sizeof(SceneFileMagic)) != 0 ||
+		header->Version != SCENE_FILE_VERSION)
+		return false;
+
+	if (header->StringOffset + header->StringBytes > size ||
+		header->MeshOffset + header->MeshCount * sizeof(unsigned int) > size ||
+		header->TextureOffset + header->TextureCount * sizeof(unsigned int) > size ||
+		header->MaterialOffset + header->MaterialCount * sizeof(SceneMaterial) > size ||
+		header->InstanceOffset + (unsigned long long)header->InstanceCount * sizeof(SceneInstance) > size ||
+		header->LightOffset + header->LightCount * sizeof(Light) > size ||
+		header->AnimationOffset + (unsigned long long)header->AnimationCount * sizeof(SceneAnimation) > size)
+		return false;
+
+	const char* strings = (const char*)(bytes + header->StringOffset);
+	const unsigned int* meshPaths = (const unsigned int*)(bytes + header->MeshOffset);
+	const unsigned int* texturePaths = (const unsigned int*)(bytes + header->TextureOffset);
+	const SceneMaterial* materials = (const SceneMaterial*)(bytes + header->MaterialOffset);
+	const SceneInstance* instances = (const SceneInstance*)(bytes + header->InstanceOffset);
+	const SceneAnimation* animations = (const SceneAnimation*)(bytes + header->AnimationOffset);
+
+	// Every path must start inside the string table, which must end with a terminator
+	if (header->StringBytes > 0 && strings[header->StringBytes - 1] != '\0')
+		return false;
+	for (unsigned int i = 0; i < header->MeshCount; i++)
+		if (meshPaths[i] >= header->StringBytes) return false;
+	for (unsigned int i = 0; i < header->TextureCount; i++)
+		if (texturePaths[i] >= header->StringBytes) return false;
+	for (unsigned int i = 0; i < header->MaterialCount; i++)
+		for (unsigned int t = 0; t < SCENE_MATERIAL_TEXTURES; t++)
+			if (materials[i].Textures[t] != SCENE_NO_TEXTURE && materials[i].Textures[t] >= header->TextureCount) return false;
+	for (unsigned int i = 0; i < header->InstanceCount; i++)
+		if (instances[i].Mesh >= header->MeshCount || instances[i].Material >= header->MaterialCount) return false;
+	for (unsigned int i = 0; i < header->AnimationCount; i++)
+	{
+		const SceneAnimation& a = animations[i];
+		if (a.Instance >= header->InstanceCount ||
+			(i > 0 && a.Instance < animations[i - 1].Instance) ||
+			a.Track.Channel >= ANIMATION_CHANNEL_COUNT ||
+			a.Track.Curve >= ANIMATION_CURVE_COUNT)
+			return false;
+	}
+
+	scene = SceneData();
+	scene.Strings = strings;
+	scene.MeshPaths = meshPaths;
+	scene.TexturePaths = texturePaths;
+	scene.Materials = materials;
+	scene.Instances = instances;
+	scene.Lights = (const Light*)(bytes + header->LightOffset);
+	scene.Animations = animations;
+	scene.StringBytes = header->StringBytes;
+	scene.MeshCount = header->MeshCount;
+	scene.TextureCount = header->TextureCount;
+	scene.MaterialCount = header->MaterialCount;
+	scene.InstanceCount = header->InstanceCount;
+	scene.LightCount = header->LightCount;
+	scene.AnimationCount = header->AnimationCount;
+	scene.Camera = header->Camera;
+	scene.HasCamera = header->HasCamera != 0;
+
+	if (sourceHash)
+		*sourceHash = header->SourceHash;
+	return true;
+}
+
+// --------------------------------------------------------
+// Compiled scenes are keyed by the text's contents, the
+// same way the mesh cache is
+// --------------------------------------------------------
+static std::wstring GetSceneCachePath(unsigned long long sourceHash)
+{
+	std::wstring folder = FixPath(L"SceneCache");
+	CreateDirectoryW(folder.c_str(), 0); // Fails harmlessly if it already exists
+
+	wchar_t name[32] = {};
+	swprintf_s(name, L"%016llx.scenebin", sourceHash);
+	return folder + L"\\" + name;
+}
+
+// Maps a compiled scene, keeping the mapping alive in the scene
+static bool MapSceneBinary(const wchar_t* file, SceneData& scene, unsigned long long expectedHash)
+{
+	std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>(file);
+	unsigned long long sourceHash = 0;
+	if (!mapping->IsValid() || !ReadSceneBinary(mapping->GetData(), mapping->GetSize(), scene, &sourceHash))
+		return false;
+	if (expectedHash != 0 && sourceHash != expectedHash)
+		return false;
+
+	scene.Mapping = mapping;
+	return true;
+}
+
+bool LoadScene(const wchar_t* file, SceneData& scene)
+{
+	std::wstring path(file);
+	if (path.size() > 9 && _wcsicmp(path.c_str() + path.size() - 9, L".scenebin") == 0)
+		return MapSceneBinary(file, scene, 0);
+
+	unsigned long long sourceHash = HashFileContents(file);
+	if (sourceHash == 0)
+		return false;
+
+	std::wstring cachePath = GetSceneCachePath(sourceHash);
+	if (MapSceneBinary(cachePath.c_str(), scene, sourceHash))
+		return true;
+
+	// First time seeing this text - parse it and compile it for next time
+	{
+		MappedFile text(file);
+		if (!text.IsValid() || !ParseSceneText((const char*)text.GetData(), (size_t)text.GetSize(), scene))
+			return false;
+	}
+
+	// Written under a temporary name and then moved into place, so a
+	// half written cache is never mapped.  The scene itself is loaded
+	// either way - without a cache it's just parsed again next time.
+	std::vector<unsigned char> bytes;
+	WriteSceneBinary(scene, sourceHash, bytes);
+	std::wstring tempPath = cachePath + L".tmp";
+	bool written = false;
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		out.write((const char*)bytes.data(), bytes.size());
+		written = (bool)out;
+	}
+
+	if (!written || !MoveFileExW(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+		DeleteFileW(tempPath.c_str());
+	return true;
+}
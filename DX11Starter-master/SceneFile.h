@@ -0,0 +1,166 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <DirectXMath.h>
+
+#include "Lights.h"
+#include "MappedFile.h"
+#include "Animation.h"
+
+// Bump whenever the binary layout changes, so old compiled scenes are ignored
+#define SCENE_FILE_VERSION 2
+
+#define SCENE_MATERIAL_TEXTURES 4
+#define SCENE_NO_TEXTURE 0xFFFFFFFF
+
+// Everything a Material is made from, textures by index into the scene's texture list
+struct SceneMaterial
+{
+	DirectX::XMFLOAT4 ColorTint;
+	DirectX::XMFLOAT4 LightHue;
+	DirectX::XMFLOAT2 UVScale;
+	DirectX::XMFLOAT2 UVOffset;
+	unsigned int Textures[SCENE_MATERIAL_TEXTURES];
+};
+
+// One entity - mesh and material by index, rotation as pitch/yaw/roll
+struct SceneInstance
+{
+	DirectX::XMFLOAT3 Position;
+	unsigned int Mesh;
+	DirectX::XMFLOAT3 Rotation;
+	unsigned int Material;
+	DirectX::XMFLOAT3 Scale;
+	unsigned int Pad;
+};
+
+// One animation track on an instance, by index
+struct SceneAnimation
+{
+	unsigned int Instance;
+	AnimationTrack Track;
+	unsigned int Pad;
+};
+
+struct SceneCamera
+{
+	DirectX::XMFLOAT3 Position;
+	float FOV;
+	DirectX::XMFLOAT3 Rotation;
+	float MoveSpeed;
+	float SprintSpeed;
+	float LookSpeed;
+	float NearClip;
+	float FarClip;
+};
+
+// --------------------------------------------------------
+// Layout of a compiled (binary) scene file:
+//  - This header
+//  - StringBytes of null terminated UTF-8 paths
+//  - MeshCount, then TextureCount, 32-bit offsets into the strings
+//  - MaterialCount SceneMaterials
+//  - InstanceCount SceneInstances
+//  - LightCount Lights
+//  - AnimationCount SceneAnimations, in instance order
+// Offsets are 16-byte aligned, and everything is used in
+// place once the file is mapped - nothing is parsed.
+// --------------------------------------------------------
+struct SceneFileHeader
+{
+	char Magic[4];
+	unsigned int Version;
+	unsigned long long SourceHash;
+	unsigned int StringBytes;
+	unsigned int MeshCount;
+	unsigned int TextureCount;
+	unsigned int MaterialCount;
+	unsigned int InstanceCount;
+	unsigned int LightCount;
+	unsigned int HasCamera;
+	unsigned int AnimationCount;
+	unsigned long long StringOffset;
+	unsigned long long MeshOffset;
+	unsigned long long TextureOffset;
+	unsigned long long MaterialOffset;
+	unsigned long long InstanceOffset;
+	unsigned long long LightOffset;
+	unsigned long long AnimationOffset;
+	SceneCamera Camera;
+};
+
+// --------------------------------------------------------
+// A loaded scene.  Like MeshData, the pointers either view
+// the storage vectors (after parsing text) or the mapped
+// compiled file, and this keeps whichever it is alive.
+// Paths are relative to the scene file's folder.
+// --------------------------------------------------------
+struct SceneData
+{
+	const char* Strings = 0;
+	const unsigned int* MeshPaths = 0;
+	const unsigned int* TexturePaths = 0;
+	const SceneMaterial* Materials = 0;
+	const SceneInstance* Instances = 0;
+	const Light* Lights = 0;
+	const SceneAnimation* Animations = 0;
+	unsigned int StringBytes = 0;
+	unsigned int MeshCount = 0;
+	unsigned int TextureCount = 0;
+	unsigned int MaterialCount = 0;
+	unsigned int InstanceCount = 0;
+	unsigned int LightCount = 0;
+	unsigned int AnimationCount = 0;
+
+	SceneCamera Camera = {};
+	bool HasCamera = false;
+
+	std::vector<char> StringStorage;
+	std::vector<unsigned int> MeshPathStorage;
+	std::vector<unsigned int> TexturePathStorage;
+	std::vector<SceneMaterial> MaterialStorage;
+	std::vector<SceneInstance> InstanceStorage;
+	std::vector<Light> LightStorage;
+	std::vector<SceneAnimation> AnimationStorage;
+	std::shared_ptr<MappedFile> Mapping;
+
+	const char* GetMeshPath(unsigned int mesh) const { return Strings + MeshPaths[mesh]; }
+	const char* GetTexturePath(unsigned int texture) const { return Strings + TexturePaths[texture]; }
+
+	// Points the views at the storage vectors once they're filled
+	void UseStorage()
+	{
+		Strings = StringStorage.empty() ? 0 : &StringStorage[0];
+		MeshPaths = MeshPathStorage.empty() ? 0 : &MeshPathStorage[0];
+		TexturePaths = TexturePathStorage.empty() ? 0 : &TexturePathStorage[0];
+		Materials = MaterialStorage.empty() ? 0 : &MaterialStorage[0];
+		Instances = InstanceStorage.empty() ? 0 : &InstanceStorage[0];
+		Lights = LightStorage.empty() ? 0 : &LightStorage[0];
+		Animations = AnimationStorage.empty() ? 0 : &AnimationStorage[0];
+		StringBytes = (unsigned int)StringStorage.size();
+		MeshCount = (unsigned int)MeshPathStorage.size();
+		TextureCount = (unsigned int)TexturePathStorage.size();
+		MaterialCount = (unsigned int)MaterialStorage.size();
+		InstanceCount = (unsigned int)InstanceStorage.size();
+		LightCount = (unsigned int)LightStorage.size();
+		AnimationCount = (unsigned int)AnimationStorage.size();
+	}
+};
+
+// Parses the text form (see Assets/Scenes/default.scene for the syntax)
+bool ParseSceneText(const char* text, size_t length, SceneData& scene);
+
+// Writes the text form back out, naming things by index
+void WriteSceneText(const SceneData& scene, std::string& text);
+
+// Lays out the compiled form
+void WriteSceneBinary(const SceneData& scene, unsigned long long sourceHash, std::vector<unsigned char>& bytes);
+
+// Points the scene's views into a compiled file's bytes (which must outlive it)
+bool ReadSceneBinary(const unsigned char* bytes, unsigned long long size, SceneData& scene, unsigned long long* sourceHash = 0);
+
+// Loads a .scene (text) or .scenebin (compiled) file.  Text scenes are
+// compiled to SceneCache the first time, and mapped from there after.
+bool LoadScene(const wchar_t* file, SceneData& scene);
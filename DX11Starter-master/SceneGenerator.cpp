@@ -0,0 +1,163 @@
+#include "SceneGenerator.h"
+
+#include <random>
+#include <cmath>
+#include <cstring>
+
+// Ground area per instance when the extent isn't given, so bigger
+// scenes spread out rather than piling up
+#define SCENE_GENERATOR_AREA_PER_INSTANCE 9.0f
+
+static const char* GeneratedMeshes[] =
+{
+	"../Models/torus.obj",
+	"../Models/helix.obj",
+	"../Models/sphere.obj",
+	"../Models/cylinder.obj",
+};
+
+static const char* GeneratedTextures[] =
+{
+	"../Textures/Foil002_4K-JPG_Color.jpg",
+	"../Textures/Foil002_4K-JPG_NormalDX.jpg",
+	"../Textures/Foil002_4K-JPG_Roughness.jpg",
+	"../Textures/Foil002_4K-JPG_Metalness.jpg",
+};
+
+#define GENERATED_CYLINDER_MESH 3
+#define GENERATED_GROUND_MATERIAL (SCENE_GENERATOR_SOLID_MATERIALS + SCENE_GENERATOR_EMISSIVE_MATERIALS)
+
+// --------------------------------------------------------
+// Everything but the instances - the same for every setting.
+// Materials come from their own generator so the palette
+// doesn't change with the seed.
+// --------------------------------------------------------
+static void AddGeneratedTables(SceneData& scene, float extent)
+{
+	for (const char* mesh : GeneratedMeshes)
+	{
+		scene.MeshPathStorage.push_back((unsigned int)scene.StringStorage.size());
+		scene.StringStorage.insert(scene.StringStorage.end(), mesh, mesh + strlen(mesh) + 1);
+	}
+	for (const char* texture : GeneratedTextures)
+	{
+		scene.TexturePathStorage.push_back((unsigned int)scene.StringStorage.size());
+		scene.StringStorage.insert(scene.StringStorage.end(), texture, texture + strlen(texture) + 1);
+	}
+
+	std::mt19937 palette(0);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (unsigned int i = 0; i <= GENERATED_GROUND_MATERIAL; i++)
+	{
+		SceneMaterial material = {};
+		material.UVScale = DirectX::XMFLOAT2(1, 1);
+		for (unsigned int t = 0; t < SCENE_MATERIAL_TEXTURES; t++)
+			material.Textures[t] = t;
+
+		// Emissive materials are light sources, so their colors go well past 1
+		bool emissive = i >= SCENE_GENERATOR_SOLID_MATERIALS && i < GENERATED_GROUND_MATERIAL;
+		float brightness = emissive ? 10.0f : 1.0f;
+		material.ColorTint = DirectX::XMFLOAT4(
+			unit(palette) * brightness,
+			unit(palette) * brightness,
+			unit(palette) * brightness,
+			unit(palette));
+		if (emissive)
+			material.LightHue = DirectX::XMFLOAT4(1, 1, 1, 0);
+		if (i == GENERATED_GROUND_MATERIAL)
+			material.ColorTint.w = 0.0f;
+
+		scene.MaterialStorage.push_back(material);
+	}
+
+	Light sun = {};
+	sun.type = LIGHT_DIRECTION;
+	sun.directiton = DirectX::XMFLOAT3(0.0f, -1.0f, 0.2f);
+	sun.color = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+	sun.intensity = 10.0f;
+	sun.spotFalloff = 0.3f;
+	scene.LightStorage.push_back(sun);
+
+	// Above one edge, looking down across the whole area
+	scene.HasCamera = true;
+	scene.Camera.Position = DirectX::XMFLOAT3(0.0f, extent * 0.5f + 5.0f, -extent - 10.0f);
+	scene.Camera.Rotation = DirectX::XMFLOAT3(0.45f, 0.0f, 0.0f);
+	scene.Camera.FOV = 1.0f;
+	scene.Camera.MoveSpeed = 1.0f + extent * 0.1f;
+	scene.Camera.SprintSpeed = 20.0f + extent;
+	scene.Camera.LookSpeed = 0.1f;
+	scene.Camera.NearClip = 0.01f;
+	scene.Camera.FarClip = 1000.0f + extent * 4.0f;
+}
+
+void GenerateScene(const SceneGeneratorSettings& settings, SceneData& scene)
+{
+	scene = SceneData();
+
+	float extent = settings.Extent > 0.0f ?
+		settings.Extent :
+		sqrtf(settings.InstanceCount * SCENE_GENERATOR_AREA_PER_INSTANCE) * 0.5f + 5.0f;
+	AddGeneratedTables(scene, extent);
+
+	std::mt19937 random(settings.Seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> area(-extent, extent);
+	std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+	std::uniform_real_distribution<float> scale(0.5f, 1.5f);
+	std::uniform_int_distribution<unsigned int> mesh(0, GENERATED_CYLINDER_MESH);
+	std::uniform_int_distribution<unsigned int> solid(0, SCENE_GENERATOR_SOLID_MATERIALS - 1);
+	std::uniform_int_distribution<unsigned int> emissive(SCENE_GENERATOR_SOLID_MATERIALS, GENERATED_GROUND_MATERIAL - 1);
+
+	// Cluster centers, and how far instances stray from them
+	std::vector<DirectX::XMFLOAT2> clusters(settings.ClusterCount > 0 ? settings.ClusterCount : 1);
+	for (DirectX::XMFLOAT2& center : clusters)
+		center = DirectX::XMFLOAT2(area(random), area(random));
+	std::uniform_int_distribution<size_t> cluster(0, clusters.size() - 1);
+	std::normal_distribution<float> spread(0.0f, extent * settings.ClusterSpread);
+
+	// Side length of the grid, and the distance between its cells
+	unsigned int gridSide = (unsigned int)ceil(sqrt((double)settings.InstanceCount));
+	float gridSpacing = gridSide > 1 ? extent * 2.0f / (gridSide - 1) : 0.0f;
+
+	scene.InstanceStorage.resize(settings.InstanceCount + 1);
+	for (unsigned int i = 0; i < settings.InstanceCount; i++)
+	{
+		SceneInstance& instance = scene.InstanceStorage[i];
+		instance.Mesh = mesh(random);
+		instance.Material = unit(random) < settings.EmissiveFraction ? emissive(random) : solid(random);
+		instance.Rotation = DirectX::XMFLOAT3(angle(random), angle(random), angle(random));
+		float s = scale(random);
+		instance.Scale = DirectX::XMFLOAT3(s, s, s);
+
+		switch (settings.Distribution)
+		{
+		case SCENE_DISTRIBUTION_CLUSTERED:
+		{
+			DirectX::XMFLOAT2 center = clusters[cluster(random)];
+			instance.Position = DirectX::XMFLOAT3(center.x + spread(random), 0.0f, center.y + spread(random));
+			break;
+		}
+
+		case SCENE_DISTRIBUTION_GRID:
+			instance.Position = DirectX::XMFLOAT3(
+				-extent + (i % gridSide) * gridSpacing,
+				0.0f,
+				-extent + (i / gridSide) * gridSpacing);
+			break;
+
+		default:
+			instance.Position = DirectX::XMFLOAT3(area(random), 0.0f, area(random));
+			break;
+		}
+	}
+
+	// Ground, under everything
+	SceneInstance& ground = scene.InstanceStorage[settings.InstanceCount];
+	ground = SceneInstance();
+	ground.Mesh = GENERATED_CYLINDER_MESH;
+	ground.Material = GENERATED_GROUND_MATERIAL;
+	ground.Position = DirectX::XMFLOAT3(0.0f, -3.0f, 0.0f);
+	ground.Scale = DirectX::XMFLOAT3(extent * 2.0f + 100.0f, 1.0f, extent * 2.0f + 100.0f);
+
+	scene.UseStorage();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "SceneFile.h"
+
+// How generated instances are spread over the ground
+#define SCENE_DISTRIBUTION_UNIFORM		0	// Evenly at random over the whole area
+#define SCENE_DISTRIBUTION_CLUSTERED	1	// Gaussian blobs around a few random centers
+#define SCENE_DISTRIBUTION_GRID			2	// A square grid filling the area
+
+// Materials every generated scene has, so scenes of any size or
+// distribution can share one set of Materials
+#define SCENE_GENERATOR_SOLID_MATERIALS		12
+#define SCENE_GENERATOR_EMISSIVE_MATERIALS	4
+
+struct SceneGeneratorSettings
+{
+	unsigned int InstanceCount = 1000;
+	unsigned int Distribution = SCENE_DISTRIBUTION_UNIFORM;
+
+	// Share of instances using a light emitting material, 0 - 1
+	float EmissiveFraction = 0.05f;
+
+	// Instances are placed in a square this far from the origin each way,
+	// which grows with the instance count unless set
+	float Extent = 0.0f;
+
+	// Clustered only: how many clusters, and their size as a share of the extent
+	unsigned int ClusterCount = 16;
+	float ClusterSpread = 0.05f;
+
+	unsigned int Seed = 1;
+};
+
+// --------------------------------------------------------
+// Fills a scene with InstanceCount copies of the stock
+// torus, helix, sphere and cylinder meshes, plus one more
+// instance for the ground, for seeing how everything scales
+// with scene size.
+//
+// Mesh, texture and material tables (and a camera and lights)
+// are identical for every setting; only the instances differ.
+// The same settings always give the same scene.
+// --------------------------------------------------------
+void GenerateScene(const SceneGeneratorSettings& settings, SceneData& scene);
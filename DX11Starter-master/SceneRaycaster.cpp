@@ -0,0 +1,398 @@
+#include "SceneRaycaster.h"
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// A node waiting to be visited, and where the ray enters its box
+struct TraversalEntry
+{
+	unsigned int Node;
+	float Entry;
+};
+
+// --------------------------------------------------------
+// Slab test.  Where the ray enters the box (0 if it starts
+// inside), or false if it misses or only gets there past
+// maxDistance.  Axes the ray runs parallel to give infinite
+// slab distances, which the comparisons handle as they are.
+// --------------------------------------------------------
+static bool IntersectBox(const float origin[3], const float inverseDirection[3], const float boxMin[3], const float boxMax[3], float maxDistance, float& entry)
+{
+	float tMin = 0.0f;
+	float tMax = maxDistance;
+	for (int a = 0; a < 3; a++)
+	{
+		float t0 = (boxMin[a] - origin[a]) * inverseDirection[a];
+		float t1 = (boxMax[a] - origin[a]) * inverseDirection[a];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tMin = t0 > tMin ? t0 : tMin;
+		tMax = t1 < tMax ? t1 : tMax;
+	}
+
+	entry = tMin;
+	return tMin <= tMax;
+}
+
+// --------------------------------------------------------
+// Moller-Trumbore against four triangles at once, one per
+// SIMD lane.  Both sides of a triangle count, as they do for
+// the GPU rays.  Returns a lane mask of the triangles hit
+// before maxDistance, with each one's distance and
+// barycentrics.  Empty lanes have a zero determinant, which
+// makes u and v infinite or NaN so the tests reject them.
+// --------------------------------------------------------
+static int IntersectTrianglePacket(
+	const MeshletTrianglePacket& packet,
+	FXMVECTOR ox, FXMVECTOR oy, FXMVECTOR oz,
+	GXMVECTOR dx, HXMVECTOR dy, HXMVECTOR dz,
+	float maxDistance,
+	XMFLOAT4& distances, XMFLOAT4& us, XMFLOAT4& vs)
+{
+	XMVECTOR e1x = XMLoadFloat4(&packet.Edge1[0]);
+	XMVECTOR e1y = XMLoadFloat4(&packet.Edge1[1]);
+	XMVECTOR e1z = XMLoadFloat4(&packet.Edge1[2]);
+	XMVECTOR e2x = XMLoadFloat4(&packet.Edge2[0]);
+	XMVECTOR e2y = XMLoadFloat4(&packet.Edge2[1]);
+	XMVECTOR e2z = XMLoadFloat4(&packet.Edge2[2]);
+
+	// p = d x e2, det = e1 . p
+	XMVECTOR px = XMVectorSubtract(XMVectorMultiply(dy, e2z), XMVectorMultiply(dz, e2y));
+	XMVECTOR py = XMVectorSubtract(XMVectorMultiply(dz, e2x), XMVectorMultiply(dx, e2z));
+	XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(dx, e2y), XMVectorMultiply(dy, e2x));
+	XMVECTOR det = XMVectorMultiplyAdd(e1z, pz, XMVectorMultiplyAdd(e1y, py, XMVectorMultiply(e1x, px)));
+	XMVECTOR inverseDet = XMVectorReciprocal(det);
+
+	// s = o - corner, u = (s . p) / det
+	XMVECTOR sx = XMVectorSubtract(ox, XMLoadFloat4(&packet.Corner[0]));
+	XMVECTOR sy = XMVectorSubtract(oy, XMLoadFloat4(&packet.Corner[1]));
+	XMVECTOR sz = XMVectorSubtract(oz, XMLoadFloat4(&packet.Corner[2]));
+	XMVECTOR u = XMVectorMultiply(XMVectorMultiplyAdd(sz, pz, XMVectorMultiplyAdd(sy, py, XMVectorMultiply(sx, px))), inverseDet);
+
+	// q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+	XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(sy, e1z), XMVectorMultiply(sz, e1y));
+	XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(sz, e1x), XMVectorMultiply(sx, e1z));
+	XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(sx, e1y), XMVectorMultiply(sy, e1x));
+	XMVECTOR v = XMVectorMultiply(XMVectorMultiplyAdd(dz, qz, XMVectorMultiplyAdd(dy, qy, XMVectorMultiply(dx, qx))), inverseDet);
+	XMVECTOR t = XMVectorMultiply(XMVectorMultiplyAdd(e2z, qz, XMVectorMultiplyAdd(e2y, qy, XMVectorMultiply(e2x, qx))), inverseDet);
+
+	XMVECTOR zero = XMVectorZero();
+	XMVECTOR hit = XMVectorAndInt(
+		XMVectorAndInt(XMVectorGreaterOrEqual(u, zero), XMVectorGreaterOrEqual(v, zero)),
+		XMVectorAndInt(XMVectorLessOrEqual(XMVectorAdd(u, v), XMVectorSplatOne()),
+			XMVectorAndInt(XMVectorGreaterOrEqual(t, zero), XMVectorLess(t, XMVectorReplicate(maxDistance)))));
+
+	XMUINT4 lanes;
+	XMStoreUInt4(&lanes, hit);
+	int mask = (lanes.x ? 1 : 0) | (lanes.y ? 2 : 0) | (lanes.z ? 4 : 0) | (lanes.w ? 8 : 0);
+	if (mask)
+	{
+		XMStoreFloat4(&distances, t);
+		XMStoreFloat4(&us, u);
+		XMStoreFloat4(&vs, v);
+	}
+	return mask;
+}
+
+// --------------------------------------------------------
+// Takes a snapshot of every renderable that has triangles
+// to hit.  The inverse transpose's transpose is the inverse
+// world matrix, so nothing needs inverting here.
+// --------------------------------------------------------
+void SceneRaycaster::Build(EntityStore& scene)
+{
+	scene.UpdateBounds();
+
+	TransformStore& transforms = TransformStore::GetInstance();
+	const RenderComponent* renderables = scene.GetRenderComponents().GetData();
+	const unsigned int* entities = scene.GetRenderComponents().GetEntities();
+	const BoundsComponent* bounds = scene.GetBoundsComponents().GetData();
+	unsigned int renderableCount = scene.GetRenderComponents().GetCount();
+
+	instances.clear();
+	instances.reserve(renderableCount);
+	for (unsigned int i = 0; i < renderableCount; i++)
+	{
+		Mesh* mesh = renderables[i].RenderMesh;
+		if (mesh->GetMeshletBVH().empty())
+			continue;
+
+		const BoundingBox& box = bounds[i].WorldBox;
+		RaycastInstance instance = {};
+		instance.Min = XMFLOAT3(box.Center.x - box.Extents.x, box.Center.y - box.Extents.y, box.Center.z - box.Extents.z);
+		instance.Max = XMFLOAT3(box.Center.x + box.Extents.x, box.Center.y + box.Extents.y, box.Center.z + box.Extents.z);
+		instance.Entity = entities[i];
+		instance.InstanceMesh = mesh;
+		XMStoreFloat4x4(&instance.WorldToLocal, XMMatrixTranspose(
+			XMLoadFloat4x4(&transforms.GetWorldInverseTransposeMatrix(renderables[i].TransformIndex))));
+		instances.push_back(instance);
+	}
+
+	BuildBVH();
+}
+
+// --------------------------------------------------------
+// Same build as the meshlet BVH: split at the median center
+// along the longest axis, reordering the instances so each
+// leaf covers a contiguous range
+// --------------------------------------------------------
+void SceneRaycaster::BuildBVH()
+{
+	nodes.clear();
+	if (instances.empty())
+		return;
+
+	// Each node still to process, as [node, first instance, instance count]
+	struct BuildTask { unsigned int Node, First, Count; };
+	std::vector<BuildTask> stack;
+	stack.push_back({ 0, 0, (unsigned int)instances.size() });
+	nodes.push_back(RaycastBVHNode());
+
+	while (!stack.empty())
+	{
+		BuildTask task = stack.back();
+		stack.pop_back();
+
+		// Bounds of every instance box, and of their centers for picking a split
+		float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (unsigned int i = task.First; i < task.First + task.Count; i++)
+		{
+			const float* lo = &instances[i].Min.x;
+			const float* hi = &instances[i].Max.x;
+			for (int a = 0; a < 3; a++)
+			{
+				float center = (lo[a] + hi[a]) * 0.5f;
+				boundsMin[a] = min(boundsMin[a], lo[a]);
+				boundsMax[a] = max(boundsMax[a], hi[a]);
+				centerMin[a] = min(centerMin[a], center);
+				centerMax[a] = max(centerMax[a], center);
+			}
+		}
+
+		RaycastBVHNode& node = nodes[task.Node];
+		node.Min = XMFLOAT3(boundsMin[0], boundsMin[1], boundsMin[2]);
+		node.Max = XMFLOAT3(boundsMax[0], boundsMax[1], boundsMax[2]);
+
+		if (task.Count <= RAYCAST_BVH_LEAF_SIZE)
+		{
+			node.First = task.First;
+			node.Count = task.Count;
+			continue;
+		}
+
+		int axis = 0;
+		for (int a = 1; a < 3; a++)
+			if (centerMax[a] - centerMin[a] > centerMax[axis] - centerMin[axis])
+				axis = a;
+
+		// Comparing the sums of min and max is comparing centers
+		unsigned int half = task.Count / 2;
+		std::nth_element(
+			instances.begin() + task.First,
+			instances.begin() + task.First + half,
+			instances.begin() + task.First + task.Count,
+			[axis](const RaycastInstance& a, const RaycastInstance& b)
+			{
+				return (&a.Min.x)[axis] + (&a.Max.x)[axis] < (&b.Min.x)[axis] + (&b.Max.x)[axis];
+			});
+
+		// Children are allocated as a pair ('node' is invalid after this)
+		unsigned int firstChild = (unsigned int)nodes.size();
+		node.First = firstChild;
+		node.Count = 0;
+		nodes.push_back(RaycastBVHNode());
+		nodes.push_back(RaycastBVHNode());
+
+		stack.push_back({ firstChild + 1, task.First + half, task.Count - half });
+		stack.push_back({ firstChild, task.First, half });
+	}
+}
+
+// --------------------------------------------------------
+// Walks the scene BVH nearest child first, so once a hit is
+// found most of what's left starts beyond it and is skipped
+// --------------------------------------------------------
+bool SceneRaycaster::RaycastScene(XMFLOAT3 origin, XMFLOAT3 direction, float maxDistance, RaycastHit& hit) const
+{
+	hit.Entity = ENTITY_NONE;
+	hit.Triangle = 0;
+	hit.Distance = maxDistance;
+	hit.Barycentrics = XMFLOAT2(0, 0);
+
+	// Normalized, so distances come out in world units
+	float length = sqrtf(direction.x * direction.x + direction.y * direction.y + direction.z * direction.z);
+	if (nodes.empty() || length == 0.0f)
+		return false;
+
+	float o[3] = { origin.x, origin.y, origin.z };
+	float d[3] = { direction.x / length, direction.y / length, direction.z / length };
+	float inverseDirection[3] = { 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+	float entry = 0.0f;
+	if (!IntersectBox(o, inverseDirection, &nodes[0].Min.x, &nodes[0].Max.x, hit.Distance, entry))
+		return false;
+
+	TraversalEntry stack[RAYCAST_STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { 0, entry };
+
+	while (stackSize > 0)
+	{
+		TraversalEntry current = stack[--stackSize];
+		if (current.Entry > hit.Distance)
+			continue;
+
+		const RaycastBVHNode& node = nodes[current.Node];
+		if (node.Count == 0)
+		{
+			// Push the farther child first so the nearer one is visited first
+			float entries[2];
+			bool hits[2];
+			for (unsigned int c = 0; c < 2; c++)
+			{
+				const RaycastBVHNode& child = nodes[node.First + c];
+				hits[c] = IntersectBox(o, inverseDirection, &child.Min.x, &child.Max.x, hit.Distance, entries[c]);
+			}
+
+			unsigned int nearer = entries[1] < entries[0] ? 1 : 0;
+			if (hits[1 - nearer])
+				stack[stackSize++] = { node.First + 1 - nearer, entries[1 - nearer] };
+			if (hits[nearer])
+				stack[stackSize++] = { node.First + nearer, entries[nearer] };
+			continue;
+		}
+
+		for (unsigned int i = node.First; i < node.First + node.Count; i++)
+		{
+			const RaycastInstance& instance = instances[i];
+			if (!IntersectBox(o, inverseDirection, &instance.Min.x, &instance.Max.x, hit.Distance, entry))
+				continue;
+
+			// Into the mesh's space.  The direction isn't renormalized,
+			// so distances along it are still world distances.
+			const XMFLOAT4X4& m = instance.WorldToLocal;
+			float localOrigin[3];
+			float localDirection[3];
+			for (int a = 0; a < 3; a++)
+			{
+				localOrigin[a] = o[0] * m.m[0][a] + o[1] * m.m[1][a] + o[2] * m.m[2][a] + m.m[3][a];
+				localDirection[a] = d[0] * m.m[0][a] + d[1] * m.m[1][a] + d[2] * m.m[2][a];
+			}
+
+			if (RaycastMesh(instance.InstanceMesh, localOrigin, localDirection, hit.Distance, hit.Triangle, hit.Barycentrics))
+				hit.Entity = instance.Entity;
+		}
+	}
+
+	return hit.Entity != ENTITY_NONE;
+}
+
+// --------------------------------------------------------
+// The same traversal down one mesh's meshlet BVH.  Only
+// hits closer than distance count, and distance becomes
+// the closest one's.
+// --------------------------------------------------------
+bool SceneRaycaster::RaycastMesh(Mesh* mesh, const float origin[3], const float direction[3], float& distance, unsigned int& triangle, XMFLOAT2& barycentrics)
+{
+	const MeshletBVHNode* meshNodes = mesh->GetMeshletBVH().data();
+	const Meshlet* meshlets = mesh->GetMeshlets().data();
+	const MeshletTrianglePacket* packets = mesh->GetTrianglePackets().data();
+	const unsigned int* firstPackets = mesh->GetMeshletFirstPackets().data();
+	float inverseDirection[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+
+	// The ray in every lane, for the triangle packets
+	XMVECTOR ox = XMVectorReplicate(origin[0]);
+	XMVECTOR oy = XMVectorReplicate(origin[1]);
+	XMVECTOR oz = XMVectorReplicate(origin[2]);
+	XMVECTOR dx = XMVectorReplicate(direction[0]);
+	XMVECTOR dy = XMVectorReplicate(direction[1]);
+	XMVECTOR dz = XMVectorReplicate(direction[2]);
+
+	float entry = 0.0f;
+	if (!IntersectBox(origin, inverseDirection, &meshNodes[0].Min.x, &meshNodes[0].Max.x, distance, entry))
+		return false;
+
+	TraversalEntry stack[RAYCAST_STACK_SIZE];
+	unsigned int stackSize = 0;
+	stack[stackSize++] = { 0, entry };
+	bool found = false;
+
+	while (stackSize > 0)
+	{
+		TraversalEntry current = stack[--stackSize];
+		if (current.Entry > distance)
+			continue;
+
+		const MeshletBVHNode& node = meshNodes[current.Node];
+		if (node.Count == 0)
+		{
+			float entries[2];
+			bool hits[2];
+			for (unsigned int c = 0; c < 2; c++)
+			{
+				const MeshletBVHNode& child = meshNodes[node.First + c];
+				hits[c] = IntersectBox(origin, inverseDirection, &child.Min.x, &child.Max.x, distance, entries[c]);
+			}
+
+			unsigned int nearer = entries[1] < entries[0] ? 1 : 0;
+			if (hits[1 - nearer])
+				stack[stackSize++] = { node.First + 1 - nearer, entries[1 - nearer] };
+			if (hits[nearer])
+				stack[stackSize++] = { node.First + nearer, entries[nearer] };
+			continue;
+		}
+
+		for (unsigned int m = node.First; m < node.First + node.Count; m++)
+		{
+			const Meshlet& meshlet = meshlets[m];
+			float boxMin[3] = { meshlet.Center.x - meshlet.Extents.x, meshlet.Center.y - meshlet.Extents.y, meshlet.Center.z - meshlet.Extents.z };
+			float boxMax[3] = { meshlet.Center.x + meshlet.Extents.x, meshlet.Center.y + meshlet.Extents.y, meshlet.Center.z + meshlet.Extents.z };
+			if (!IntersectBox(origin, inverseDirection, boxMin, boxMax, distance, entry))
+				continue;
+
+			for (unsigned int p = firstPackets[m]; p < firstPackets[m + 1]; p++)
+			{
+				XMFLOAT4 distances, us, vs;
+				int mask = IntersectTrianglePacket(packets[p], ox, oy, oz, dx, dy, dz, distance, distances, us, vs);
+				for (unsigned int lane = 0; mask; lane++, mask >>= 1)
+				{
+					if (!(mask & 1) || (&distances.x)[lane] >= distance)
+						continue;
+
+					distance = (&distances.x)[lane];
+					triangle = meshlet.IndexOffset / 3 + (p - firstPackets[m]) * 4 + lane;
+					barycentrics = XMFLOAT2((&us.x)[lane], (&vs.x)[lane]);
+					found = true;
+				}
+			}
+		}
+	}
+
+	return found;
+}
+
+// --------------------------------------------------------
+// Rays are independent, so each batch just runs its share
+// --------------------------------------------------------
+void SceneRaycaster::RaycastBatch(const RaycastRay* rays, unsigned int count, RaycastHit* hits) const
+{
+	JobSystem::GetInstance().ParallelFor(count, RAYCAST_RAYS_PER_BATCH,
+		[this, rays, hits](unsigned int start, unsigned int end)
+	{
+		for (unsigned int i = start; i < end; i++)
+			RaycastScene(rays[i].Origin, rays[i].Direction, rays[i].MaxDistance, hits[i]);
+	});
+}
+
+unsigned int SceneRaycaster::GetInstanceCount() const
+{
+	return (unsigned int)instances.size();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+#include "EntityStore.h"
+
+// Most instances referenced by one leaf of the scene BVH
+#define RAYCAST_BVH_LEAF_SIZE 4
+
+// Deepest either BVH can get while traversing (median splits keep them far shallower)
+#define RAYCAST_STACK_SIZE 64
+
+// Rays per job system batch in RaycastBatch()
+#define RAYCAST_RAYS_PER_BATCH 64
+
+struct RaycastRay
+{
+	DirectX::XMFLOAT3 Origin;
+	DirectX::XMFLOAT3 Direction;	// Needn't be normalized
+	float MaxDistance;
+};
+
+// --------------------------------------------------------
+// The closest triangle a ray hit.  Entity is ENTITY_NONE
+// on a miss.  Triangle indexes the full-detail mesh's
+// index buffer (three indices per triangle), and the
+// barycentrics weight its second and third vertices, as
+// they would in a DXR hit shader.
+// --------------------------------------------------------
+struct RaycastHit
+{
+	unsigned int Entity;
+	unsigned int Triangle;
+	float Distance;
+	DirectX::XMFLOAT2 Barycentrics;
+};
+
+// Node of the BVH over a scene's instances, laid out like
+// MeshletBVHNode: interior nodes (Count == 0) have their
+// children at First and First + 1, leaves cover Count
+// instances starting at First
+struct RaycastBVHNode
+{
+	DirectX::XMFLOAT3 Min;
+	unsigned int First;
+	DirectX::XMFLOAT3 Max;
+	unsigned int Count;
+};
+
+// --------------------------------------------------------
+// Ray queries against a scene's triangles, on the CPU.
+//
+// Build() snapshots every renderable: its cached world box,
+// the inverse of its world matrix and its mesh.  A BVH over
+// those boxes finds the instances a ray passes through, and
+// the ray is moved into each one's local space to walk its
+// mesh's meshlet BVH down to the triangles.  Queries always
+// use the full-detail mesh, whatever LOD is being traced.
+//
+// Queries only read, so any number of threads may run them
+// at once, but nothing may call Build() meanwhile.  They see
+// the scene as it was at the last Build(), and the meshes
+// are only kept alive by the scene, so rebuild after
+// anything moves or is destroyed.
+// --------------------------------------------------------
+class SceneRaycaster
+{
+public:
+	// Snapshots the scene's renderables (updating their bounds first)
+	void Build(EntityStore& scene);
+
+	// The closest hit along the ray within maxDistance, or false
+	bool RaycastScene(DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 direction, float maxDistance, RaycastHit& hit) const;
+
+	// One hit per ray, spread across the job system
+	void RaycastBatch(const RaycastRay* rays, unsigned int count, RaycastHit* hits) const;
+
+	unsigned int GetInstanceCount() const;
+
+private:
+	struct RaycastInstance
+	{
+		DirectX::XMFLOAT3 Min;
+		unsigned int Entity;
+		DirectX::XMFLOAT3 Max;
+		Mesh* InstanceMesh;
+		DirectX::XMFLOAT4X4 WorldToLocal;
+	};
+
+	std::vector<RaycastInstance> instances;
+	std::vector<RaycastBVHNode> nodes;
+
+	void BuildBVH();
+	static bool RaycastMesh(Mesh* mesh, const float origin[3], const float direction[3], float& distance, unsigned int& triangle, DirectX::XMFLOAT2& barycentrics);
+};
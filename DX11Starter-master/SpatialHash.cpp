@@ -0,0 +1,367 @@
+#include "SpatialHash.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Cell coordinates run from -limit to limit - 1 on each axis
+static const int CellCoordinateLimit = 1 << (SPATIAL_HASH_CELL_BITS - 1);
+
+static float GetCellSize(unsigned int level)
+{
+	return SPATIAL_HASH_BASE_CELL_SIZE * (float)(1u << level);
+}
+
+// Which cell along one axis, clamped to what a key can hold
+static int GetCellCoordinate(float value, float cellSize)
+{
+	float cell = floorf(value / cellSize);
+	if (!(cell >= (float)-CellCoordinateLimit))
+		return -CellCoordinateLimit;
+	if (cell > (float)(CellCoordinateLimit - 1))
+		return CellCoordinateLimit - 1;
+	return (int)cell;
+}
+
+// Level in the top bits, then the three coordinates
+static unsigned long long MakeCellKey(unsigned int level, int x, int y, int z)
+{
+	const unsigned long long mask = (1ull << SPATIAL_HASH_CELL_BITS) - 1;
+	return
+		((unsigned long long)level << (SPATIAL_HASH_CELL_BITS * 3)) |
+		(((unsigned long long)(x + CellCoordinateLimit) & mask) << (SPATIAL_HASH_CELL_BITS * 2)) |
+		(((unsigned long long)(y + CellCoordinateLimit) & mask) << SPATIAL_HASH_CELL_BITS) |
+		((unsigned long long)(z + CellCoordinateLimit) & mask);
+}
+
+SpatialHash::SpatialHash() :
+	updateCount(0)
+{
+	Clear();
+}
+
+// --------------------------------------------------------
+// Staying in the same cell (the usual case for anything
+// moving a little each frame) is just a copy of the bounds.
+// --------------------------------------------------------
+void SpatialHash::Insert(unsigned int id, const BoundingSphere& bounds)
+{
+	unsigned int slot = id & ENTITY_INDEX_MASK;
+	if (slot >= items.size())
+	{
+		SpatialItem empty = {};
+		empty.Level = SPATIAL_HASH_NONE;
+		items.resize(slot + 1, empty);
+	}
+
+	// A different ID in the same slot is something else entirely
+	SpatialItem& item = items[slot];
+	if (item.Level != SPATIAL_HASH_NONE && item.ID != id)
+		Remove(item.ID);
+
+	// The finest level whose cells the sphere fits across
+	unsigned int level = 0;
+	while (level < SPATIAL_HASH_LEVELS - 1 && GetCellSize(level) < bounds.Radius * 2.0f)
+		level++;
+
+	float cellSize = GetCellSize(level);
+	unsigned long long cell = MakeCellKey(level,
+		GetCellCoordinate(bounds.Center.x, cellSize),
+		GetCellCoordinate(bounds.Center.y, cellSize),
+		GetCellCoordinate(bounds.Center.z, cellSize));
+
+	item.Center = bounds.Center;
+	item.Radius = bounds.Radius;
+	item.ID = id;
+	levelMaxRadii[level] = max(levelMaxRadii[level], bounds.Radius);
+
+	if (item.Level != SPATIAL_HASH_NONE)
+	{
+		if (item.Level == level && item.Cell == cell)
+			return;
+
+		Unlink(slot);
+		levelCounts[item.Level]--;
+	}
+	else
+	{
+		item.DensePosition = (unsigned int)occupied.size();
+		occupied.push_back(slot);
+	}
+
+	item.Level = level;
+	item.Cell = cell;
+	levelCounts[level]++;
+	Link(slot);
+}
+
+void SpatialHash::Remove(unsigned int id)
+{
+	unsigned int slot = id & ENTITY_INDEX_MASK;
+	if (slot >= items.size() || items[slot].Level == SPATIAL_HASH_NONE || items[slot].ID != id)
+		return;
+
+	SpatialItem& item = items[slot];
+	Unlink(slot);
+	levelCounts[item.Level]--;
+	item.Level = SPATIAL_HASH_NONE;
+
+	// Fill the hole in the dense list with the last one
+	unsigned int last = occupied.back();
+	occupied[item.DensePosition] = last;
+	items[last].DensePosition = item.DensePosition;
+	occupied.pop_back();
+}
+
+void SpatialHash::Clear()
+{
+	items.clear();
+	occupied.clear();
+	cells.clear();
+	for (unsigned int level = 0; level < SPATIAL_HASH_LEVELS; level++)
+	{
+		levelCounts[level] = 0;
+		levelMaxRadii[level] = 0.0f;
+	}
+}
+
+// --------------------------------------------------------
+// The bounds cache already knows which entities moved: the
+// transform version their bounds were built from changed.
+// Everything else is skipped without touching the cells.
+// --------------------------------------------------------
+void SpatialHash::Update(const EntityStore& scene)
+{
+	updateCount++;
+
+	const BoundsComponent* bounds = scene.GetBoundsComponents().GetData();
+	const unsigned int* entities = scene.GetBoundsComponents().GetEntities();
+	unsigned int count = scene.GetBoundsComponents().GetCount();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int slot = entities[i] & ENTITY_INDEX_MASK;
+		bool present =
+			slot < items.size() &&
+			items[slot].Level != SPATIAL_HASH_NONE &&
+			items[slot].ID == entities[i];
+
+		// Versions only ever grow per transform slot, so together with
+		// the slot they can't match bounds built from anything else
+		if (!present ||
+			items[slot].Transform != bounds[i].TransformIndex ||
+			items[slot].Version != bounds[i].TransformVersion)
+		{
+			Insert(entities[i], bounds[i].WorldSphere);
+			items[slot].Transform = bounds[i].TransformIndex;
+			items[slot].Version = bounds[i].TransformVersion;
+		}
+		items[slot].Seen = updateCount;
+	}
+
+	// Drop whatever the scene no longer has (backwards, since removing swaps the last one in)
+	for (size_t i = occupied.size(); i-- > 0;)
+	{
+		if (items[occupied[i]].Seen != updateCount)
+			Remove(items[occupied[i]].ID);
+	}
+}
+
+void SpatialHash::QuerySphere(const BoundingSphere& range, std::vector<unsigned int>& results) const
+{
+	results.clear();
+
+	float rangeMin[3] = { range.Center.x - range.Radius, range.Center.y - range.Radius, range.Center.z - range.Radius };
+	float rangeMax[3] = { range.Center.x + range.Radius, range.Center.y + range.Radius, range.Center.z + range.Radius };
+	std::vector<unsigned int> slots;
+	GatherCandidates(rangeMin, rangeMax, slots);
+
+	for (unsigned int slot : slots)
+	{
+		const SpatialItem& item = items[slot];
+		float dx = item.Center.x - range.Center.x;
+		float dy = item.Center.y - range.Center.y;
+		float dz = item.Center.z - range.Center.z;
+		float reach = item.Radius + range.Radius;
+		if (dx * dx + dy * dy + dz * dz <= reach * reach)
+			results.push_back(item.ID);
+	}
+}
+
+void SpatialHash::QueryBox(const BoundingBox& range, std::vector<unsigned int>& results) const
+{
+	results.clear();
+
+	float center[3] = { range.Center.x, range.Center.y, range.Center.z };
+	float extents[3] = { range.Extents.x, range.Extents.y, range.Extents.z };
+	float rangeMin[3] = { center[0] - extents[0], center[1] - extents[1], center[2] - extents[2] };
+	float rangeMax[3] = { center[0] + extents[0], center[1] + extents[1], center[2] + extents[2] };
+	std::vector<unsigned int> slots;
+	GatherCandidates(rangeMin, rangeMax, slots);
+
+	for (unsigned int slot : slots)
+	{
+		// Squared distance from the sphere's center to the box
+		const SpatialItem& item = items[slot];
+		const float* c = &item.Center.x;
+		float distanceSquared = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			float outside = max(fabsf(c[a] - center[a]) - extents[a], 0.0f);
+			distanceSquared += outside * outside;
+		}
+
+		if (distanceSquared <= item.Radius * item.Radius)
+			results.push_back(item.ID);
+	}
+}
+
+// --------------------------------------------------------
+// Searches a growing range around the point until it holds
+// k items (or everything, or reaches maxDistance).  Every
+// item within the range is found, so the k closest of those
+// are the k closest overall.
+// --------------------------------------------------------
+void SpatialHash::QueryNearest(XMFLOAT3 point, unsigned int k, float maxDistance, std::vector<SpatialNeighbor>& results) const
+{
+	results.clear();
+	if (k == 0 || occupied.empty())
+		return;
+
+	std::vector<unsigned int> slots;
+	float radius = SPATIAL_HASH_BASE_CELL_SIZE;
+	while (true)
+	{
+		float reach = min(radius, maxDistance);
+		float rangeMin[3] = { point.x - reach, point.y - reach, point.z - reach };
+		float rangeMax[3] = { point.x + reach, point.y + reach, point.z + reach };
+		slots.clear();
+		GatherCandidates(rangeMin, rangeMax, slots);
+
+		results.clear();
+		for (unsigned int slot : slots)
+		{
+			const SpatialItem& item = items[slot];
+			float dx = item.Center.x - point.x;
+			float dy = item.Center.y - point.y;
+			float dz = item.Center.z - point.z;
+			float distance = max(sqrtf(dx * dx + dy * dy + dz * dz) - item.Radius, 0.0f);
+			if (distance <= reach)
+				results.push_back({ item.ID, distance });
+		}
+
+		if (results.size() >= k || reach >= maxDistance || results.size() == occupied.size())
+			break;
+		radius *= 2.0f;
+	}
+
+	auto nearer = [](const SpatialNeighbor& a, const SpatialNeighbor& b) { return a.Distance < b.Distance; };
+	if (results.size() > k)
+	{
+		std::partial_sort(results.begin(), results.begin() + k, results.end(), nearer);
+		results.resize(k);
+	}
+	else
+	{
+		std::sort(results.begin(), results.end(), nearer);
+	}
+}
+
+unsigned int SpatialHash::GetCount() const
+{
+	return (unsigned int)occupied.size();
+}
+
+void SpatialHash::Link(unsigned int slot)
+{
+	SpatialItem& item = items[slot];
+	unsigned int& head = cells.emplace(item.Cell, SPATIAL_HASH_NONE).first->second;
+	item.Previous = SPATIAL_HASH_NONE;
+	item.Next = head;
+	if (head != SPATIAL_HASH_NONE)
+		items[head].Previous = slot;
+	head = slot;
+}
+
+void SpatialHash::Unlink(unsigned int slot)
+{
+	SpatialItem& item = items[slot];
+	if (item.Previous != SPATIAL_HASH_NONE)
+	{
+		items[item.Previous].Next = item.Next;
+	}
+	else
+	{
+		// It was the first in its cell, and empty cells are dropped
+		auto cell = cells.find(item.Cell);
+		if (item.Next == SPATIAL_HASH_NONE)
+			cells.erase(cell);
+		else
+			cell->second = item.Next;
+	}
+
+	if (item.Next != SPATIAL_HASH_NONE)
+		items[item.Next].Previous = item.Previous;
+}
+
+// --------------------------------------------------------
+// Slots of everything that might touch the range: on each
+// level, the cells the range covers once it's widened by
+// the largest radius stored there.  A level with fewer
+// items than that many cells has all its items checked
+// instead, which keeps huge ranges from visiting millions
+// of empty cells.
+// --------------------------------------------------------
+void SpatialHash::GatherCandidates(const float rangeMin[3], const float rangeMax[3], std::vector<unsigned int>& slots) const
+{
+	unsigned int scanLevels = 0;
+	for (unsigned int level = 0; level < SPATIAL_HASH_LEVELS; level++)
+	{
+		if (levelCounts[level] == 0)
+			continue;
+
+		float cellSize = GetCellSize(level);
+		float reach = levelMaxRadii[level];
+		int low[3];
+		int high[3];
+		double cellCount = 1.0;
+		for (int a = 0; a < 3; a++)
+		{
+			low[a] = GetCellCoordinate(rangeMin[a] - reach, cellSize);
+			high[a] = GetCellCoordinate(rangeMax[a] + reach, cellSize);
+			cellCount *= (double)(high[a] - low[a] + 1);
+		}
+
+		if (cellCount > (double)levelCounts[level])
+		{
+			scanLevels |= 1u << level;
+			continue;
+		}
+
+		for (int x = low[0]; x <= high[0]; x++)
+		{
+			for (int y = low[1]; y <= high[1]; y++)
+			{
+				for (int z = low[2]; z <= high[2]; z++)
+				{
+					auto cell = cells.find(MakeCellKey(level, x, y, z));
+					if (cell == cells.end())
+						continue;
+
+					for (unsigned int slot = cell->second; slot != SPATIAL_HASH_NONE; slot = items[slot].Next)
+						slots.push_back(slot);
+				}
+			}
+		}
+	}
+
+	if (scanLevels)
+	{
+		for (unsigned int slot : occupied)
+		{
+			if (scanLevels & (1u << items[slot].Level))
+				slots.push_back(slot);
+		}
+	}
+}
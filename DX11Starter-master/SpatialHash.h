@@ -0,0 +1,102 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <DirectXCollision.h>
+
+#include "EntityStore.h"
+
+// Cell size of the finest level - each level's cells are twice the size of the one below
+#define SPATIAL_HASH_BASE_CELL_SIZE 0.5f
+#define SPATIAL_HASH_LEVELS 16
+
+// Cells per axis of each level (centered on the origin) - anything further out shares the edge cells
+#define SPATIAL_HASH_CELL_BITS 20
+
+// No item, or an item that isn't in the hash
+#define SPATIAL_HASH_NONE 0xFFFFFFFF
+
+// Something a nearest query found, and how far its bounds are from the point
+struct SpatialNeighbor
+{
+	unsigned int ID;
+	float Distance;
+};
+
+// --------------------------------------------------------
+// A spatial index over bounding spheres, for neighborhood
+// and proximity queries that shouldn't wait on (or go
+// through) a full acceleration structure build.
+//
+// It's a multi-level loose hash grid.  Each sphere lives in
+// the finest level whose cells are at least its diameter,
+// in the one cell holding its center, so moving costs just
+// recomputing that cell - and when it changes, unlinking
+// from one cell's list and linking into another's.  Queries
+// widen their range by each level's largest radius to catch
+// spheres that reach in from neighboring cells.
+//
+// IDs are entity IDs (or anything else whose low
+// ENTITY_INDEX_BITS are unique).  Either keep the hash in
+// step with a scene through Update(), or manage IDs directly
+// with Insert()/Remove() - Update() drops anything the scene
+// doesn't have.  Queries only read, so any number of threads
+// may run them while nothing changes the hash.
+// --------------------------------------------------------
+class SpatialHash
+{
+public:
+	SpatialHash();
+
+	// Adds an ID, or moves it if it's already here
+	void Insert(unsigned int id, const DirectX::BoundingSphere& bounds);
+	void Remove(unsigned int id);
+	void Clear();
+
+	// Matches the hash to the scene's renderables, moving only the ones whose
+	// bounds were rebuilt since the last call (call UpdateBounds() first)
+	void Update(const EntityStore& scene);
+
+	// Everything whose sphere touches the range.  Results replace what the vector held.
+	void QuerySphere(const DirectX::BoundingSphere& range, std::vector<unsigned int>& results) const;
+	void QueryBox(const DirectX::BoundingBox& range, std::vector<unsigned int>& results) const;
+
+	// The k closest within maxDistance of the point (0 if the point is
+	// inside a sphere), nearest first.  Results replace what the vector held.
+	void QueryNearest(DirectX::XMFLOAT3 point, unsigned int k, float maxDistance, std::vector<SpatialNeighbor>& results) const;
+
+	unsigned int GetCount() const;
+
+private:
+	// One per ID slot, linked into its cell's list
+	struct SpatialItem
+	{
+		DirectX::XMFLOAT3 Center;
+		float Radius;
+		unsigned int ID;
+		unsigned int Level;				// SPATIAL_HASH_NONE when the slot is empty
+		unsigned long long Cell;
+		unsigned int Previous;			// Slots of the neighbors in the cell's list
+		unsigned int Next;
+		unsigned int DensePosition;		// Where this slot is in occupied
+		unsigned int Transform;			// Its bounds' transform and version, for Update()
+		unsigned int Version;
+		unsigned int Seen;				// The last Update() that found it in the scene
+	};
+
+	std::vector<SpatialItem> items;
+	std::vector<unsigned int> occupied;
+
+	// Cell key -> first slot in the cell's list
+	std::unordered_map<unsigned long long, unsigned int> cells;
+
+	// Per level: how many items, and the largest radius ever stored there
+	unsigned int levelCounts[SPATIAL_HASH_LEVELS];
+	float levelMaxRadii[SPATIAL_HASH_LEVELS];
+
+	unsigned int updateCount;
+
+	void Link(unsigned int slot);
+	void Unlink(unsigned int slot);
+	void GatherCandidates(const float rangeMin[3], const float rangeMax[3], std::vector<unsigned int>& slots) const;
+};
@@ -0,0 +1,223 @@
+#include "AnimCurves.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// DirectXMath's vector sin/cos/exp2 are approximations, so
+// the vector curves only match the scalar ones this closely
+#define VECTOR_TOLERANCE 1e-5f
+
+// Inputs 0 to 1 in steps of 1/VECTOR_STEPS, so exactly 0, 0.5 and 1 are among them
+#define VECTOR_STEPS 1024
+
+// --------------------------------------------------------
+// EaseVector<Curve> against Ease<Curve> over [0, 1].  Each
+// input goes through every lane, so a lane that's handled
+// differently (or a select that picks the wrong piece) shows.
+// --------------------------------------------------------
+template<int Curve> static void CheckVectorCurve()
+{
+	float largestError = 0.0f;
+	for (int i = 0; i <= VECTOR_STEPS; i++)
+	{
+		float x = (float)i / VECTOR_STEPS;
+		float expected = Ease<Curve>(x);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			// The other lanes hold inputs from the other half
+			XMFLOAT4 inputs(1.0f - x, 1.0f - x, 1.0f - x, 1.0f - x);
+			(&inputs.x)[lane] = x;
+
+			XMFLOAT4 results;
+			XMStoreFloat4(&results, EaseVector<Curve>(XMLoadFloat4(&inputs)));
+			float error = fabsf((&results.x)[lane] - expected);
+			largestError = (std::max)(largestError, error);
+		}
+	}
+
+	if (largestError >= VECTOR_TOLERANCE)
+		printf("Curve %d: vector version is off by %g\n", Curve, largestError);
+	CHECK(largestError < VECTOR_TOLERANCE);
+}
+
+// Runs CheckVectorCurve() for every curve from First on
+template<int First> struct CheckVectorCurvesFrom
+{
+	static void Run()
+	{
+		CheckVectorCurve<First>();
+		CheckVectorCurvesFrom<First + 1>::Run();
+	}
+};
+
+template<> struct CheckVectorCurvesFrom<EASE_CURVE_COUNT>
+{
+	static void Run() {}
+};
+
+static void VectorCurvesMatchScalar()
+{
+	CheckVectorCurvesFrom<0>::Run();
+}
+
+// --------------------------------------------------------
+// Batches of every size up to a few vectors, so every tail
+// length is covered, starting at every alignment.  Nothing
+// past the end of the batch is written.
+// --------------------------------------------------------
+static void BatchesHandleTails()
+{
+	const float sentinel = -12345.0f;
+	const unsigned int maxCount = 13;
+
+	float inputs[maxCount + 3];
+	for (unsigned int i = 0; i < maxCount + 3; i++)
+		inputs[i] = (float)i / (maxCount + 2);
+
+	for (int curve = 0; curve < EASE_CURVE_COUNT; curve++)
+	{
+		for (unsigned int offset = 0; offset < 3; offset++)
+		{
+			for (unsigned int count = 0; count <= maxCount; count++)
+			{
+				float results[maxCount + 1];
+				for (unsigned int i = 0; i <= maxCount; i++)
+					results[i] = sentinel;
+
+				GetCurveBatchByIndex(curve, inputs + offset, results, count);
+
+				for (unsigned int i = 0; i < count; i++)
+					CHECK(fabsf(results[i] - GetCurveByIndex(curve, inputs[offset + i])) < VECTOR_TOLERANCE);
+				CHECK(results[count] == sentinel);
+			}
+		}
+	}
+}
+
+// Inputs checked against a table's MaxError - a prime, so
+// they don't line up with the samples or the points baking checks
+#define TABLE_SWEEP_STEPS 100003
+
+// --------------------------------------------------------
+// The bounds on MaxError documented above EaseTable, by
+// curve: cubic tables, then linear ones (1.5x cubic, or 1e-4
+// for the smooth families).  The in and out polynomials and
+// back are far better than their in-out versions.
+// --------------------------------------------------------
+static float DocumentedTableError(int curve, unsigned int interpolation)
+{
+	int family = curve / 3;
+	bool inOut = curve % 3 == 2;
+
+	float cubic;
+	bool smooth = true;
+	switch (family)
+	{
+	case EASE_IN_SINE / 3: cubic = 1e-6f; break;
+	case EASE_IN_QUAD / 3:
+	case EASE_IN_CUBIC / 3:
+	case EASE_IN_QUART / 3:
+	case EASE_IN_QUINT / 3:
+	case EASE_IN_BACK / 3: cubic = inOut ? 5e-5f : 1e-6f; break;
+	case EASE_IN_EXPO / 3: cubic = 1.1e-3f; smooth = false; break;
+	case EASE_IN_CIRC / 3: cubic = 2e-2f; smooth = false; break;
+	case EASE_IN_ELASTIC / 3: cubic = 5.5e-4f; smooth = false; break;
+	default: cubic = 7e-3f; smooth = false; break;
+	}
+
+	if (interpolation == EASE_TABLE_CUBIC)
+		return cubic;
+	return smooth ? 1e-4f : 1.5f * cubic;
+}
+
+// Every curve, baked both ways, is as close as documented
+static void TablesMeetDocumentedError()
+{
+	for (int curve = 0; curve < EASE_CURVE_COUNT; curve++)
+	{
+		for (unsigned int interpolation = EASE_TABLE_LINEAR; interpolation <= EASE_TABLE_CUBIC; interpolation++)
+		{
+			EaseTable table;
+			BakeEaseTable(curve, interpolation, table);
+			float bound = DocumentedTableError(curve, interpolation);
+			if (table.MaxError >= bound)
+				printf("Curve %d (interpolation %u): MaxError %g, documented under %g\n", curve, interpolation, table.MaxError, bound);
+			CHECK(table.MaxError > 0.0f);
+			CHECK(table.MaxError < bound);
+		}
+	}
+}
+
+// --------------------------------------------------------
+// MaxError really is a bound: a much denser sweep than the
+// one baking does never finds a bigger difference
+// --------------------------------------------------------
+static void TablesStayWithinMaxError()
+{
+	for (int curve = 0; curve < EASE_CURVE_COUNT; curve++)
+	{
+		for (unsigned int interpolation = EASE_TABLE_LINEAR; interpolation <= EASE_TABLE_CUBIC; interpolation++)
+		{
+			EaseTable table;
+			BakeEaseTable(curve, interpolation, table);
+
+			float largestError = 0.0f;
+			for (int i = 0; i <= TABLE_SWEEP_STEPS; i++)
+			{
+				float x = (float)i / TABLE_SWEEP_STEPS;
+				float error = fabsf(EvaluateEaseTable(table, x) - GetCurveByIndex(curve, x));
+				largestError = (std::max)(largestError, error);
+			}
+
+			if (largestError > table.MaxError)
+				printf("Curve %d (interpolation %u): off by %g, MaxError %g\n", curve, interpolation, largestError, table.MaxError);
+			CHECK(largestError <= table.MaxError);
+		}
+	}
+}
+
+// Equal, or both NaN (circ outside [0, 1])
+static bool SameValue(float a, float b)
+{
+	return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+// Outside [0, 1] there are no samples, so it's the curve itself
+static void TablesEvaluateExactlyOutsideRange()
+{
+	const float outside[] = { -1.0f, -0.25f, -FLT_MIN, 1.0f + FLT_EPSILON, 1.25f, 2.0f };
+	const unsigned int count = sizeof(outside) / sizeof(outside[0]);
+
+	for (int curve = 0; curve < EASE_CURVE_COUNT; curve++)
+	{
+		for (unsigned int interpolation = EASE_TABLE_LINEAR; interpolation <= EASE_TABLE_CUBIC; interpolation++)
+		{
+			EaseTable table;
+			BakeEaseTable(curve, interpolation, table);
+
+			float results[count];
+			EvaluateEaseTableBatch(table, outside, results, count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				float expected = GetCurveByIndex(curve, outside[i]);
+				CHECK(SameValue(EvaluateEaseTable(table, outside[i]), expected));
+				CHECK(SameValue(results[i], expected));
+			}
+		}
+	}
+}
+
+int main()
+{
+	RUN_TEST(VectorCurvesMatchScalar);
+	RUN_TEST(BatchesHandleTails);
+	RUN_TEST(TablesMeetDocumentedError);
+	RUN_TEST(TablesStayWithinMaxError);
+	RUN_TEST(TablesEvaluateExactlyOutsideRange);
+	return TEST_RESULT();
+}
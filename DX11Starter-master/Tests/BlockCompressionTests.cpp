@@ -0,0 +1,407 @@
+#include "BlockCompression.h"
+#include "TextureCooker.h"
+#include "TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// --------------------------------------------------------
+// Decoders written from the format specs, independently of
+// the encoders, to round trip blocks through.  All of them
+// decode to 16 RGBA pixels.
+// --------------------------------------------------------
+
+static unsigned int ReadBits(const unsigned char* block, int& offset, int count)
+{
+	unsigned int value = 0;
+	for (int i = 0; i < count; i++, offset++)
+		value |= (unsigned int)((block[offset >> 3] >> (offset & 7)) & 1) << i;
+	return value;
+}
+
+static void DecodeRGB565(unsigned short packed, int color[3])
+{
+	int r = (packed >> 11) & 31;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+static void DecodeBC1(const unsigned char block[8], unsigned char rgba[64])
+{
+	unsigned short c0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short c1 = (unsigned short)(block[2] | (block[3] << 8));
+	int palette[4][4];
+	DecodeRGB565(c0, palette[0]);
+	DecodeRGB565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = 255;
+	palette[3][3] = c0 > c1 ? 255 : 0;
+	for (int c = 0; c < 3; c++)
+	{
+		if (c0 > c1)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else
+		{
+			palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+			palette[3][c] = 0;
+		}
+	}
+
+	int offset = 32;
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned int index = ReadBits(block, offset, 2);
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = (unsigned char)palette[index][c];
+	}
+}
+
+// Into one channel of rgba
+static void DecodeBC4(const unsigned char block[8], unsigned char rgba[64], int channel)
+{
+	int palette[8];
+	palette[0] = block[0];
+	palette[1] = block[1];
+	if (palette[0] > palette[1])
+	{
+		for (int p = 1; p < 7; p++)
+			palette[p + 1] = ((7 - p) * palette[0] + p * palette[1] + 3) / 7;
+	}
+	else
+	{
+		for (int p = 1; p < 5; p++)
+			palette[p + 1] = ((5 - p) * palette[0] + p * palette[1] + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	int offset = 16;
+	for (int i = 0; i < 16; i++)
+		rgba[i * 4 + channel] = (unsigned char)palette[ReadBits(block, offset, 3)];
+}
+
+static bool DecodeBC7Mode6(const unsigned char block[16], unsigned char rgba[64])
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	int offset = 0;
+	if (ReadBits(block, offset, 7) != (1u << 6))
+		return false;
+
+	int endpoints[2][4];
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] = (int)ReadBits(block, offset, 7) << 1;
+		endpoints[1][c] = (int)ReadBits(block, offset, 7) << 1;
+	}
+	unsigned int p0 = ReadBits(block, offset, 1);
+	unsigned int p1 = ReadBits(block, offset, 1);
+	for (int c = 0; c < 4; c++)
+	{
+		endpoints[0][c] |= p0;
+		endpoints[1][c] |= p1;
+	}
+
+	for (int i = 0; i < 16; i++)
+	{
+		int w = weights[ReadBits(block, offset, i == 0 ? 3 : 4)];
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = (unsigned char)(((64 - w) * endpoints[0][c] + w * endpoints[1][c] + 32) >> 6);
+	}
+	return true;
+}
+
+// --------------------------------------------------------
+// Test blocks, and how far the round trip strays from them
+// --------------------------------------------------------
+
+struct BlockError
+{
+	int Max;		// Largest difference in any one channel
+	double RMS;
+};
+
+static BlockError CompareBlocks(const unsigned char* a, const unsigned char* b, int firstChannel, int channels)
+{
+	BlockError error = {};
+	double sum = 0.0;
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = firstChannel; c < firstChannel + channels; c++)
+		{
+			int d = std::abs((int)a[i * 4 + c] - (int)b[i * 4 + c]);
+			error.Max = (std::max)(error.Max, d);
+			sum += d * d;
+		}
+	}
+	error.RMS = sqrt(sum / (16.0 * channels));
+	return error;
+}
+
+static void MakeSolidBlock(std::mt19937& random, unsigned char rgba[64])
+{
+	unsigned char color[4];
+	for (int c = 0; c < 4; c++)
+		color[c] = (unsigned char)(random() & 255);
+	for (int i = 0; i < 16; i++)
+		memcpy(&rgba[i * 4], color, 4);
+}
+
+// A ramp between two random colors, in a random direction across the block
+static void MakeGradientBlock(std::mt19937& random, unsigned char rgba[64])
+{
+	unsigned char from[4], to[4];
+	for (int c = 0; c < 4; c++)
+	{
+		from[c] = (unsigned char)(random() & 255);
+		to[c] = (unsigned char)(random() & 255);
+	}
+	float dx = (float)(random() % 4), dy = (float)(random() % 4);
+	if (dx == 0.0f && dy == 0.0f)
+		dx = 1.0f;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = ((i % 4) * dx + (i / 4) * dy) / (3.0f * (dx + dy));
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = (unsigned char)(from[c] + (to[c] - from[c]) * t + 0.5f);
+	}
+}
+
+static void MakeNoiseBlock(std::mt19937& random, unsigned char rgba[64])
+{
+	for (int i = 0; i < 64; i++)
+		rgba[i] = (unsigned char)(random() & 255);
+}
+
+// Worst errors over many blocks of one kind
+struct RoundTrip
+{
+	int Max;
+	double WorstRMS;
+};
+
+typedef void (*MakeBlock)(std::mt19937& random, unsigned char rgba[64]);
+
+// BC4 spans each block's range in sevenths, so nothing is more than
+// half a step (and a rounding) off
+static int GetBC4ErrorBound(const unsigned char* rgba, int channel)
+{
+	int low = 255, high = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		low = (std::min)(low, (int)rgba[i * 4 + channel]);
+		high = (std::max)(high, (int)rgba[i * 4 + channel]);
+	}
+	return (high - low) / 14 + 1;
+}
+
+static RoundTrip RoundTripBC1(MakeBlock make)
+{
+	std::mt19937 random(1);
+	RoundTrip result = {};
+	for (int b = 0; b < 500; b++)
+	{
+		unsigned char source[64], decoded[64], block[8];
+		make(random, source);
+		CompressBlockBC1(source, block);
+		DecodeBC1(block, decoded);
+
+		// Always the opaque (4 color) mode
+		for (int i = 0; i < 16; i++)
+			CHECK(decoded[i * 4 + 3] == 255);
+
+		BlockError error = CompareBlocks(source, decoded, 0, 3);
+		result.Max = (std::max)(result.Max, error.Max);
+		result.WorstRMS = (std::max)(result.WorstRMS, error.RMS);
+	}
+	return result;
+}
+
+static RoundTrip RoundTripBC4(MakeBlock make)
+{
+	std::mt19937 random(2);
+	RoundTrip result = {};
+	for (int b = 0; b < 500; b++)
+	{
+		unsigned char source[64], decoded[64] = {}, red[16], block[8];
+		make(random, source);
+		for (int i = 0; i < 16; i++)
+			red[i] = source[i * 4];
+		CompressBlockBC4(red, block);
+		DecodeBC4(block, decoded, 0);
+
+		BlockError error = CompareBlocks(source, decoded, 0, 1);
+		CHECK(error.Max <= GetBC4ErrorBound(source, 0));
+		result.Max = (std::max)(result.Max, error.Max);
+		result.WorstRMS = (std::max)(result.WorstRMS, error.RMS);
+	}
+	return result;
+}
+
+static RoundTrip RoundTripBC5(MakeBlock make)
+{
+	std::mt19937 random(3);
+	RoundTrip result = {};
+	for (int b = 0; b < 500; b++)
+	{
+		unsigned char source[64], decoded[64] = {}, block[16];
+		make(random, source);
+		CompressBlockBC5(source, block);
+		DecodeBC4(block, decoded, 0);
+		DecodeBC4(block + 8, decoded, 1);
+
+		for (int c = 0; c < 2; c++)
+			CHECK(CompareBlocks(source, decoded, c, 1).Max <= GetBC4ErrorBound(source, c));
+
+		BlockError error = CompareBlocks(source, decoded, 0, 2);
+		result.Max = (std::max)(result.Max, error.Max);
+		result.WorstRMS = (std::max)(result.WorstRMS, error.RMS);
+	}
+	return result;
+}
+
+static RoundTrip RoundTripBC7(MakeBlock make)
+{
+	std::mt19937 random(4);
+	RoundTrip result = {};
+	for (int b = 0; b < 500; b++)
+	{
+		unsigned char source[64], decoded[64], block[16];
+		make(random, source);
+		CompressBlockBC7(source, block);
+		CHECK(DecodeBC7Mode6(block, decoded));
+
+		BlockError error = CompareBlocks(source, decoded, 0, 4);
+		result.Max = (std::max)(result.Max, error.Max);
+		result.WorstRMS = (std::max)(result.WorstRMS, error.RMS);
+	}
+	return result;
+}
+
+// --------------------------------------------------------
+// Limits are the worst seen over 500 blocks of each kind,
+// rounded up.  Solid blocks are bound by endpoint precision
+// (5:6:5 for BC1, 7 bits and a p-bit for BC7), the rest by
+// how many palette entries there are to share.  BC4 and BC5
+// are also held to their per-block bound as they go.
+// --------------------------------------------------------
+static void BC1StaysWithinLimits()
+{
+	RoundTrip solid = RoundTripBC1(MakeSolidBlock);
+	RoundTrip gradient = RoundTripBC1(MakeGradientBlock);
+	RoundTrip noise = RoundTripBC1(MakeNoiseBlock);
+	CHECK(solid.Max <= 4);
+	CHECK(gradient.Max <= 40 && gradient.WorstRMS <= 18.0);
+	CHECK(noise.WorstRMS <= 75.0);
+}
+
+static void BC4StaysWithinLimits()
+{
+	RoundTrip solid = RoundTripBC4(MakeSolidBlock);
+	RoundTrip gradient = RoundTripBC4(MakeGradientBlock);
+	RoundTrip noise = RoundTripBC4(MakeNoiseBlock);
+	CHECK(solid.Max == 0);
+	CHECK(gradient.Max <= 19 && gradient.WorstRMS <= 11.0);
+	CHECK(noise.Max <= 18 && noise.WorstRMS <= 13.0);
+}
+
+static void BC5StaysWithinLimits()
+{
+	RoundTrip solid = RoundTripBC5(MakeSolidBlock);
+	RoundTrip gradient = RoundTripBC5(MakeGradientBlock);
+	RoundTrip noise = RoundTripBC5(MakeNoiseBlock);
+	CHECK(solid.Max == 0);
+	CHECK(gradient.Max <= 19 && gradient.WorstRMS <= 11.0);
+	CHECK(noise.Max <= 18 && noise.WorstRMS <= 13.0);
+}
+
+static void BC7StaysWithinLimits()
+{
+	RoundTrip solid = RoundTripBC7(MakeSolidBlock);
+	RoundTrip gradient = RoundTripBC7(MakeGradientBlock);
+	RoundTrip noise = RoundTripBC7(MakeNoiseBlock);
+	CHECK(solid.Max <= 1);
+	CHECK(gradient.Max <= 8 && gradient.WorstRMS <= 4.0);
+	CHECK(noise.WorstRMS <= 75.0);
+}
+
+// --------------------------------------------------------
+// Whatever the size, the layout read back from a cooked
+// file finds every mip where CompressToDDS wrote it: each
+// mip's first and last blocks are the ones compressing that
+// mip on its own gives
+// --------------------------------------------------------
+static void LayoutMatchesCompressedMips()
+{
+	const unsigned int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 37, 19 }, { 300, 7 }, { 6, 129 }, { 64, 64 } };
+	const int formats[] = { TEXTURE_COOK_BC1, TEXTURE_COOK_BC4, TEXTURE_COOK_BC5, TEXTURE_COOK_BC7 };
+
+	std::mt19937 random(5);
+	for (const unsigned int* size : sizes)
+	{
+		std::vector<unsigned char> pixels((size_t)size[0] * size[1] * 4);
+		for (unsigned char& p : pixels)
+			p = (unsigned char)(random() & 255);
+		std::vector<TextureMip> mips;
+		GenerateMipChain(pixels.data(), size[0], size[1], false, mips);
+
+		for (int format : formats)
+		{
+			std::vector<unsigned char> dds;
+			CompressToDDS(mips, format, dds);
+
+			CookedTextureLayout layout = {};
+			CHECK(ReadCookedTextureLayout(dds.data(), dds.size(), layout));
+			CHECK(layout.Width == size[0] && layout.Height == size[1]);
+			CHECK(layout.MipCount == mips.size());
+			if (layout.MipCount != mips.size())
+				continue;
+
+			unsigned int blockBytes = (format == TEXTURE_COOK_BC1 || format == TEXTURE_COOK_BC4) ? 8 : 16;
+			for (unsigned int m = 0; m < layout.MipCount; m++)
+			{
+				const TextureMip& mip = mips[m];
+				unsigned int blocksX = (mip.Width + 3) / 4;
+				unsigned int blocksY = (mip.Height + 3) / 4;
+				CHECK(layout.MipRowPitches[m] == blocksX * blockBytes);
+				CHECK(layout.MipSizes[m] == (unsigned long long)blocksX * blocksY * blockBytes);
+				CHECK(layout.MipOffsets[m] + layout.MipSizes[m] <= dds.size());
+				if (m + 1 < layout.MipCount)
+					CHECK(layout.MipOffsets[m + 1] == layout.MipOffsets[m] + layout.MipSizes[m]);
+				else
+					CHECK(layout.MipOffsets[m] + layout.MipSizes[m] == dds.size());
+
+				// A mip of its own holds exactly the blocks this one should
+				std::vector<TextureMip> single(1, mip);
+				std::vector<unsigned char> alone;
+				CompressToDDS(single, format, alone);
+				CookedTextureLayout aloneLayout = {};
+				CHECK(ReadCookedTextureLayout(alone.data(), alone.size(), aloneLayout));
+				CHECK(aloneLayout.MipSizes[0] == layout.MipSizes[m]);
+				CHECK(memcmp(&dds[(size_t)layout.MipOffsets[m]], &alone[(size_t)aloneLayout.MipOffsets[0]], (size_t)layout.MipSizes[m]) == 0);
+			}
+
+			// A truncated file is turned away
+			CHECK(!ReadCookedTextureLayout(dds.data(), dds.size() - 1, layout));
+		}
+	}
+}
+
+int main()
+{
+	RUN_TEST(BC1StaysWithinLimits);
+	RUN_TEST(BC4StaysWithinLimits);
+	RUN_TEST(BC5StaysWithinLimits);
+	RUN_TEST(BC7StaysWithinLimits);
+	RUN_TEST(LayoutMatchesCompressedMips);
+	return TEST_RESULT();
+}
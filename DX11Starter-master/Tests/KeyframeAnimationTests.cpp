@@ -0,0 +1,289 @@
+#include "KeyframeAnimation.h"
+#include "AnimCurves.h"
+#include "TransformStore.h"
+#include "TestHarness.h"
+
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+#define TEST_TOLERANCE 0.01f
+
+// What 16-bit times and values can add on top of the tolerance, for
+// these clips (values within a few units, a few seconds long)
+#define TEST_QUANTIZATION_ERROR 0.0002f
+
+static float GetError(const XMFLOAT4& a, const XMFLOAT4& b, unsigned int components)
+{
+	const float* x = &a.x;
+	const float* y = &b.x;
+	float error = 0.0f;
+	for (unsigned int c = 0; c < components; c++)
+		error = (std::max)(error, fabsf(x[c] - y[c]));
+	return error;
+}
+
+// A position wandering smoothly over four seconds, keyed every tenth of one
+static void BuildWave(std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT])
+{
+	for (unsigned int k = 0; k <= 40; k++)
+	{
+		Keyframe key = {};
+		key.Time = k * 0.1f;
+		key.Value = XMFLOAT4(sinf(key.Time * 2.0f), cosf(key.Time * 0.5f) * 3.0f, key.Time * 0.25f, 0.0f);
+		key.Curve = KEYFRAME_CURVE_LINEAR;
+		keys[KEYFRAME_CHANNEL_POSITION].push_back(key);
+	}
+}
+
+// The authored (uncompressed) position at a time, blending linearly between keys
+static XMFLOAT4 SampleAuthored(const std::vector<Keyframe>& keys, float time)
+{
+	if (time <= keys.front().Time)
+		return keys.front().Value;
+	for (size_t k = 0; k + 1 < keys.size(); k++)
+	{
+		const Keyframe& a = keys[k];
+		const Keyframe& b = keys[k + 1];
+		if (time < b.Time)
+		{
+			float t = (time - a.Time) / (b.Time - a.Time);
+			return XMFLOAT4(
+				a.Value.x + (b.Value.x - a.Value.x) * t,
+				a.Value.y + (b.Value.y - a.Value.y) * t,
+				a.Value.z + (b.Value.z - a.Value.z) * t,
+				0.0f);
+		}
+	}
+	return keys.back().Value;
+}
+
+static void RejectsBadKeys()
+{
+	KeyframeClip clip;
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	Keyframe key = {};
+	key.Curve = KEYFRAME_CURVE_LINEAR;
+
+	key.Time = 1.0f;
+	keys[KEYFRAME_CHANNEL_SCALE].push_back(key);
+	key.Time = 0.5f;
+	keys[KEYFRAME_CHANNEL_SCALE].push_back(key);
+	CHECK(!clip.Build(keys, TEST_TOLERANCE));
+	CHECK(clip.GetKeyCount() == 0);
+
+	keys[KEYFRAME_CHANNEL_SCALE].clear();
+	key.Time = -1.0f;
+	keys[KEYFRAME_CHANNEL_SCALE].push_back(key);
+	CHECK(!clip.Build(keys, TEST_TOLERANCE));
+
+	keys[KEYFRAME_CHANNEL_SCALE].clear();
+	key.Time = 0.0f;
+	key.Curve = KEYFRAME_CURVE_LINEAR + 1;
+	keys[KEYFRAME_CHANNEL_SCALE].push_back(key);
+	CHECK(!clip.Build(keys, TEST_TOLERANCE));
+	CHECK(!clip.HasChannel(KEYFRAME_CHANNEL_SCALE));
+}
+
+// --------------------------------------------------------
+// Compressed, the clip still passes within the tolerance
+// (plus quantization) of every authored key, and of the
+// authored segments between them
+// --------------------------------------------------------
+static void SamplesNearAuthoredKeys()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	BuildWave(keys);
+	KeyframeClip clip;
+	CHECK(clip.Build(keys, TEST_TOLERANCE));
+	CHECK(clip.HasChannel(KEYFRAME_CHANNEL_POSITION));
+	CHECK(!clip.HasChannel(KEYFRAME_CHANNEL_ROTATION));
+	CHECK(fabsf(clip.GetDuration() - 4.0f) < 1e-6f);
+
+	// Some keys go, but a wave needs more than its ends
+	const std::vector<Keyframe>& position = keys[KEYFRAME_CHANNEL_POSITION];
+	CHECK(clip.GetKeyCount() > 2);
+	CHECK(clip.GetKeyCount() < position.size());
+
+	unsigned int cursor = 0;
+	float worst = 0.0f;
+	for (size_t k = 0; k < position.size(); k++)
+	{
+		float time = position[k].Time;
+		worst = (std::max)(worst, GetError(clip.Sample(KEYFRAME_CHANNEL_POSITION, time, cursor), position[k].Value, 3));
+
+		time += 0.05f;
+		worst = (std::max)(worst, GetError(clip.Sample(KEYFRAME_CHANNEL_POSITION, time, cursor), SampleAuthored(position, time), 3));
+	}
+	CHECK(worst <= TEST_TOLERANCE + TEST_QUANTIZATION_ERROR);
+
+	// Held before the first key and after the last
+	XMFLOAT4 before = clip.Sample(KEYFRAME_CHANNEL_POSITION, -1.0f, cursor);
+	XMFLOAT4 after = clip.Sample(KEYFRAME_CHANNEL_POSITION, 10.0f, cursor);
+	CHECK(GetError(before, position.front().Value, 3) <= TEST_QUANTIZATION_ERROR);
+	CHECK(GetError(after, position.back().Value, 3) <= TEST_QUANTIZATION_ERROR);
+}
+
+// A straight line needs only its ends
+static void DropsKeysALineReproduces()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	for (unsigned int k = 0; k <= 10; k++)
+	{
+		Keyframe key = {};
+		key.Time = (float)k;
+		key.Value = XMFLOAT4(k * 2.0f, 1.0f, -(float)k, 0.0f);
+		key.Curve = KEYFRAME_CURVE_LINEAR;
+		keys[KEYFRAME_CHANNEL_SCALE].push_back(key);
+	}
+
+	KeyframeClip clip;
+	CHECK(clip.Build(keys, TEST_TOLERANCE));
+	CHECK(clip.GetKeyCount() == 2);
+
+	unsigned int cursor = 0;
+	XMFLOAT4 middle = clip.Sample(KEYFRAME_CHANNEL_SCALE, 2.5f, cursor);
+	CHECK(GetError(middle, XMFLOAT4(5.0f, 1.0f, -2.5f, 0.0f), 3) <= TEST_QUANTIZATION_ERROR);
+}
+
+static void EasesSegments()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	Keyframe key = {};
+	key.Curve = EASE_IN_QUAD;
+	keys[KEYFRAME_CHANNEL_POSITION].push_back(key);
+	key.Time = 2.0f;
+	key.Value = XMFLOAT4(4.0f, 0.0f, 0.0f, 0.0f);
+	keys[KEYFRAME_CHANNEL_POSITION].push_back(key);
+
+	KeyframeClip clip;
+	CHECK(clip.Build(keys, TEST_TOLERANCE));
+	unsigned int cursor = 0;
+	XMFLOAT4 middle = clip.Sample(KEYFRAME_CHANNEL_POSITION, 1.0f, cursor);
+	CHECK(fabsf(middle.x - 4.0f * GetCurveByIndex(EASE_IN_QUAD, 0.5f)) <= TEST_QUANTIZATION_ERROR);
+}
+
+// --------------------------------------------------------
+// Rotations come back normalized, and keys on opposite
+// sides of the quaternion sphere blend the short way
+// --------------------------------------------------------
+static void BlendsRotationsTheShortWay()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	Keyframe key = {};
+	key.Curve = KEYFRAME_CURVE_LINEAR;
+	key.Value = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+	keys[KEYFRAME_CHANNEL_ROTATION].push_back(key);
+
+	// 90 degrees about y, written as its negation
+	float half = sqrtf(0.5f);
+	key.Time = 1.0f;
+	key.Value = XMFLOAT4(0.0f, -half, 0.0f, -half);
+	keys[KEYFRAME_CHANNEL_ROTATION].push_back(key);
+
+	KeyframeClip clip;
+	CHECK(clip.Build(keys, TEST_TOLERANCE));
+	unsigned int cursor = 0;
+	XMFLOAT4 middle = clip.Sample(KEYFRAME_CHANNEL_ROTATION, 0.5f, cursor);
+
+	// 45 degrees about y (sin and cos of 22.5), not the long way round
+	float length = sqrtf(middle.x * middle.x + middle.y * middle.y + middle.z * middle.z + middle.w * middle.w);
+	CHECK(fabsf(length - 1.0f) < 1e-4f);
+	CHECK(fabsf(middle.y - 0.38268343f) <= TEST_QUANTIZATION_ERROR);
+	CHECK(fabsf(middle.w - 0.92387953f) <= TEST_QUANTIZATION_ERROR);
+}
+
+// --------------------------------------------------------
+// Wherever the cursor was left - playing forward, jumping
+// back, seeking anywhere - sampling gives what a fresh
+// cursor would
+// --------------------------------------------------------
+static void CursorJumpsAnywhere()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	BuildWave(keys);
+	KeyframeClip clip;
+	clip.Build(keys, TEST_TOLERANCE);
+
+	unsigned int cursor = 0;
+	unsigned int mismatches = 0;
+	auto Compare = [&](float time)
+	{
+		unsigned int fresh = 0;
+		XMFLOAT4 expected = clip.Sample(KEYFRAME_CHANNEL_POSITION, time, fresh);
+		XMFLOAT4 sampled = clip.Sample(KEYFRAME_CHANNEL_POSITION, time, cursor);
+		if (GetError(sampled, expected, 3) > 0.0f || cursor != fresh)
+			mismatches++;
+	};
+
+	// Forward in small steps, then back to the start and forward again
+	for (float time = 0.0f; time < 4.0f; time += 1.0f / 60.0f)
+		Compare(time);
+	Compare(0.05f);
+	Compare(3.9f);
+	Compare(1.0f);
+	Compare(0.95f);
+
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> anywhere(0.0f, 4.0f);
+	for (unsigned int i = 0; i < 1000; i++)
+		Compare(anywhere(random));
+
+	CHECK(mismatches == 0);
+}
+
+// --------------------------------------------------------
+// Playing through the system: a looping clip wraps back to
+// the start (and its cursors with it), one that doesn't
+// holds its last key
+// --------------------------------------------------------
+static void LoopsThroughTheSystem()
+{
+	std::vector<Keyframe> keys[KEYFRAME_CHANNEL_COUNT];
+	BuildWave(keys);
+	KeyframeClip clip;
+	clip.Build(keys, TEST_TOLERANCE);
+
+	TransformStore& transforms = TransformStore::GetInstance();
+	ComponentArray<KeyframeComponent> components;
+	KeyframeComponent looping = {};
+	looping.TransformIndex = transforms.Add();
+	looping.Clip = &clip;
+	looping.StartTime = 1.0f;
+	looping.Speed = 1.0f;
+	looping.Loop = 1;
+	components.Add(0, looping);
+
+	KeyframeComponent once = looping;
+	once.TransformIndex = transforms.Add();
+	once.Loop = 0;
+	components.Add(1, once);
+
+	const std::vector<Keyframe>& position = keys[KEYFRAME_CHANNEL_POSITION];
+	for (float time = 1.0f; time < 13.0f; time += 0.25f)
+	{
+		UpdateKeyframeAnimations(components, time);
+
+		float local = fmodf(time - 1.0f, 4.0f);
+		XMFLOAT3 p = transforms.GetPosition(looping.TransformIndex);
+		XMFLOAT4 expected = SampleAuthored(position, local);
+		CHECK(GetError(XMFLOAT4(p.x, p.y, p.z, 0.0f), expected, 3) <= TEST_TOLERANCE + TEST_QUANTIZATION_ERROR);
+
+		p = transforms.GetPosition(once.TransformIndex);
+		expected = SampleAuthored(position, time - 1.0f);
+		CHECK(GetError(XMFLOAT4(p.x, p.y, p.z, 0.0f), expected, 3) <= TEST_TOLERANCE + TEST_QUANTIZATION_ERROR);
+	}
+}
+
+int main()
+{
+	RUN_TEST(RejectsBadKeys);
+	RUN_TEST(SamplesNearAuthoredKeys);
+	RUN_TEST(DropsKeysALineReproduces);
+	RUN_TEST(EasesSegments);
+	RUN_TEST(BlendsRotationsTheShortWay);
+	RUN_TEST(CursorJumpsAnywhere);
+	RUN_TEST(LoopsThroughTheSystem);
+	return TEST_RESULT();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdio>
+
+// --------------------------------------------------------
+// Just enough to write tests with: CHECK() reports where a
+// condition failed and keeps going, RUN_TEST() prints each
+// test's result, and main() returns TEST_RESULT().
+// --------------------------------------------------------
+static int testFailures = 0;
+
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+#define RUN_TEST(test) \
+	do \
+	{ \
+		int failuresBefore = testFailures; \
+		test(); \
+		printf("%s %s\n", testFailures == failuresBefore ? "passed" : "FAILED", #test); \
+	} while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
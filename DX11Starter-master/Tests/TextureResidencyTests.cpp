@@ -0,0 +1,194 @@
+#include "TextureResidency.h"
+#include "TestHarness.h"
+
+#include <cmath>
+
+// A 1024x1024 texture with four mips, so mip 3 (128x128) is the tail
+static const unsigned long long SmallMipBytes[4] = { 64, 16, 4, 1 };
+
+static unsigned int AddSmallTexture(TextureResidency& residency)
+{
+	return residency.AddTexture(1024, 1024, 4, SmallMipBytes, 3);
+}
+
+static void FindsTailMip()
+{
+	CHECK(TextureResidency::GetTailMip(1024, 1024, 11) == 3);
+	CHECK(TextureResidency::GetTailMip(2048, 512, 12) == 4);
+	CHECK(TextureResidency::GetTailMip(512, 2048, 12) == 4);
+	CHECK(TextureResidency::GetTailMip(128, 128, 8) == 0);
+	CHECK(TextureResidency::GetTailMip(64, 64, 7) == 0);
+
+	// Never past the last mip there is
+	CHECK(TextureResidency::GetTailMip(1024, 1024, 2) == 1);
+	CHECK(TextureResidency::GetTailMip(1024, 1024, 1) == 0);
+}
+
+static void CalculatesDesiredMip()
+{
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 1024.0f) == 0);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 4096.0f) == 0);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 512.0f) == 1);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 300.0f) == 1);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 256.0f) == 2);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 1.0f) == 10);
+
+	// The larger side decides
+	CHECK(TextureResidency::CalculateDesiredMip(256, 1024, 11, 512.0f) == 1);
+
+	// Off screen (or nonsense) wants the coarsest, clamped to the mips there are
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, 0.0f) == 10);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, -5.0f) == 10);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 11, nanf("")) == 10);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 4, 1.0f) == 3);
+	CHECK(TextureResidency::CalculateDesiredMip(1024, 1024, 1, 1.0f) == 0);
+}
+
+static void StreamsOneLevelPerUpdate()
+{
+	TextureResidency residency;
+	unsigned int texture = AddSmallTexture(residency);
+	CHECK(residency.GetResidentBytes() == 1);
+
+	std::vector<TextureResidencyChange> changes;
+	for (int level = 2; level >= 0; level--)
+	{
+		unsigned int expected = (unsigned int)level;
+		residency.ReportCoverage(texture, 1024.0f);
+		residency.Update(changes);
+		CHECK(changes.size() == 1);
+		if (changes.size() == 1)
+		{
+			CHECK(changes[0].Texture == texture);
+			CHECK(changes[0].OldMip == expected + 1);
+			CHECK(changes[0].NewMip == expected);
+		}
+		CHECK(residency.GetResidentMip(texture) == expected);
+	}
+	CHECK(residency.GetResidentBytes() == 85);
+
+	// All there - nothing more to do
+	residency.ReportCoverage(texture, 1024.0f);
+	residency.Update(changes);
+	CHECK(changes.empty());
+}
+
+static void CapsBytesPerUpdate()
+{
+	// Three textures each one 20MB mip away from what they want
+	const unsigned long long mb = 1024ull * 1024;
+	unsigned long long mipBytes[2] = { 20 * mb, 1 };
+	TextureResidency residency;
+	residency.SetBudget(1024 * mb);
+	unsigned int textures[3];
+	for (unsigned int i = 0; i < 3; i++)
+		textures[i] = residency.AddTexture(1024, 1024, 2, mipBytes, 1);
+
+	std::vector<TextureResidencyChange> changes;
+	for (unsigned int update = 0; update < 3; update++)
+	{
+		for (unsigned int i = 0; i < 3; i++)
+			residency.ReportCoverage(textures[i], 1024.0f);
+		residency.Update(changes);
+
+		// 40MB would go over TEXTURE_RESIDENCY_MAX_UPLOAD_PER_UPDATE, so one at a time, in order
+		CHECK(changes.size() == 1);
+		if (changes.size() == 1)
+			CHECK(changes[0].Texture == textures[update]);
+	}
+
+	// A single mip bigger than the cap still gets through on its own
+	unsigned long long hugeBytes[2] = { TEXTURE_RESIDENCY_MAX_UPLOAD_PER_UPDATE * 2, 1 };
+	unsigned int huge = residency.AddTexture(1024, 1024, 2, hugeBytes, 1);
+	residency.ReportCoverage(huge, 1024.0f);
+	residency.Update(changes);
+	CHECK(residency.GetResidentMip(huge) == 0);
+}
+
+// --------------------------------------------------------
+// Over budget, mips finer than their texture needs go
+// first, then the least recently used texture's - never
+// the ones in use this frame that still need them
+// --------------------------------------------------------
+static void EvictsWastefulThenLeastRecentlyUsed()
+{
+	TextureResidency residency;
+	unsigned int a = AddSmallTexture(residency);
+	unsigned int b = AddSmallTexture(residency);
+	unsigned int c = AddSmallTexture(residency);
+	unsigned int d = AddSmallTexture(residency);
+
+	std::vector<TextureResidencyChange> changes;
+	for (unsigned int update = 0; update < 3; update++)
+	{
+		residency.ReportCoverage(a, 1024.0f);
+		residency.ReportCoverage(b, 1024.0f);
+		residency.ReportCoverage(c, 1024.0f);
+		residency.Update(changes);
+	}
+	CHECK(residency.GetResidentMip(a) == 0);
+	CHECK(residency.GetResidentMip(b) == 0);
+	CHECK(residency.GetResidentMip(c) == 0);
+	CHECK(residency.GetResidentBytes() == 85 * 3 + 1);
+
+	// From here on: a is unused, b still needs everything, c only needs
+	// mip 2, and d wants it all - with no room to spare for it
+	for (unsigned int update = 0; update < 3; update++)
+	{
+		residency.SetBudget(residency.GetResidentBytes());
+		residency.ReportCoverage(b, 1024.0f);
+		residency.ReportCoverage(c, 256.0f);
+		residency.ReportCoverage(d, 1024.0f);
+		residency.Update(changes);
+		CHECK(residency.GetResidentMip(d) == 2 - update);
+
+		if (update == 0)
+		{
+			// c's mip 0 was the waste
+			CHECK(residency.GetResidentMip(c) == 1);
+			CHECK(residency.GetResidentMip(a) == 0);
+		}
+		else if (update == 1)
+		{
+			// Then its mip 1
+			CHECK(residency.GetResidentMip(c) == 2);
+			CHECK(residency.GetResidentMip(a) == 0);
+		}
+		else
+		{
+			// c has nothing left to spare, so a (unused) pays
+			CHECK(residency.GetResidentMip(c) == 2);
+			CHECK(residency.GetResidentMip(a) == 1);
+		}
+		CHECK(residency.GetResidentMip(b) == 0);
+		CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+	}
+}
+
+static void CorrectsResidentMip()
+{
+	TextureResidency residency;
+	unsigned int texture = AddSmallTexture(residency);
+
+	residency.SetResidentMip(texture, 1);
+	CHECK(residency.GetResidentMip(texture) == 1);
+	CHECK(residency.GetResidentBytes() == 21);
+
+	residency.SetResidentMip(texture, 99);
+	CHECK(residency.GetResidentMip(texture) == 3);
+	CHECK(residency.GetResidentBytes() == 1);
+
+	residency.RemoveTexture(texture);
+	CHECK(residency.GetResidentBytes() == 0);
+}
+
+int main()
+{
+	RUN_TEST(FindsTailMip);
+	RUN_TEST(CalculatesDesiredMip);
+	RUN_TEST(StreamsOneLevelPerUpdate);
+	RUN_TEST(CapsBytesPerUpdate);
+	RUN_TEST(EvictsWastefulThenLeastRecentlyUsed);
+	RUN_TEST(CorrectsResidentMip);
+	return TEST_RESULT();
+}
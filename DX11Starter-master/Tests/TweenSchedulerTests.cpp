@@ -0,0 +1,214 @@
+#include "TweenScheduler.h"
+#include "TransformStore.h"
+#include "TestHarness.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+static bool Near(float a, float b)
+{
+	return fabsf(a - b) < 1e-4f;
+}
+
+// Moves a transform along x from 0 to 10 over a second, linearly
+static TweenDesc MoveX(unsigned int transform)
+{
+	TweenDesc desc = {};
+	desc.TransformIndex = transform;
+	desc.Target = TWEEN_TARGET_POSITION;
+	desc.Start = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	desc.End = XMFLOAT4(10.0f, 0.0f, 0.0f, 0.0f);
+	desc.Duration = 1.0f;
+	desc.Curve = TWEEN_CURVE_LINEAR;
+	desc.Repeat = TWEEN_REPEAT_RESTART;
+	desc.Cycles = 1;
+	return desc;
+}
+
+static float GetX(unsigned int transform)
+{
+	return TransformStore::GetInstance().GetPosition(transform).x;
+}
+
+static void CountCompletion(unsigned int tween, void* userData)
+{
+	(*(unsigned int*)userData)++;
+}
+
+static void RejectsUnknownDescriptions()
+{
+	TweenScheduler scheduler;
+	TweenDesc desc = MoveX(TransformStore::GetInstance().Add());
+
+	desc.Target = TWEEN_TARGET_COUNT;
+	CHECK(scheduler.Start(desc) == TWEEN_NONE);
+	desc.Target = TWEEN_TARGET_POSITION;
+	desc.Curve = TWEEN_CURVE_LINEAR + 1;
+	CHECK(scheduler.Start(desc) == TWEEN_NONE);
+	desc.Curve = TWEEN_CURVE_LINEAR;
+	desc.Repeat = TWEEN_REPEAT_PING_PONG + 1;
+	CHECK(scheduler.Start(desc) == TWEEN_NONE);
+	CHECK(scheduler.GetCount() == 0);
+}
+
+// --------------------------------------------------------
+// Every other cycle plays backwards, and the last one ends
+// wherever its direction takes it
+// --------------------------------------------------------
+static void PingPongsAndEnds()
+{
+	unsigned int transform = TransformStore::GetInstance().Add();
+	TweenScheduler scheduler;
+	TweenDesc desc = MoveX(transform);
+	desc.Repeat = TWEEN_REPEAT_PING_PONG;
+	desc.Cycles = 3;
+	unsigned int tween = scheduler.Start(desc);
+	CHECK(tween != TWEEN_NONE);
+
+	scheduler.Update(0.25f);
+	CHECK(Near(GetX(transform), 2.5f));
+	scheduler.Update(1.25f);
+	CHECK(Near(GetX(transform), 7.5f));
+	scheduler.Update(1.75f);
+	CHECK(Near(GetX(transform), 2.5f));
+	scheduler.Update(2.5f);
+	CHECK(Near(GetX(transform), 5.0f));
+	CHECK(scheduler.IsPlaying(tween));
+
+	// Three cycles: there, back and there again
+	scheduler.Update(3.5f);
+	CHECK(Near(GetX(transform), 10.0f));
+	CHECK(!scheduler.IsPlaying(tween));
+	CHECK(scheduler.GetCount() == 0);
+
+	// An even number of cycles ends back at the start
+	desc.Cycles = 2;
+	tween = scheduler.Start(desc);
+	scheduler.Update(3.75f);
+	CHECK(Near(GetX(transform), 2.5f));
+	scheduler.Update(10.0f);
+	CHECK(Near(GetX(transform), 0.0f));
+	CHECK(!scheduler.IsPlaying(tween));
+}
+
+static void WaitsForDelay()
+{
+	unsigned int transform = TransformStore::GetInstance().Add();
+	TransformStore::GetInstance().SetPosition(transform, XMFLOAT3(-1.0f, 0.0f, 0.0f));
+	TweenScheduler scheduler;
+	TweenDesc desc = MoveX(transform);
+	desc.Delay = 1.0f;
+	scheduler.Start(desc);
+
+	scheduler.Update(0.5f);
+	CHECK(Near(GetX(transform), -1.0f));
+	scheduler.Update(1.5f);
+	CHECK(Near(GetX(transform), 5.0f));
+}
+
+// --------------------------------------------------------
+// The callback runs once, with the tween's handle, when it
+// finishes - not on later updates, and not when stopped
+// --------------------------------------------------------
+static void CompletesOnce()
+{
+	unsigned int transform = TransformStore::GetInstance().Add();
+	TweenScheduler scheduler;
+	unsigned int completions = 0;
+	TweenDesc desc = MoveX(transform);
+	desc.Cycles = 2;
+	desc.OnComplete = CountCompletion;
+	desc.UserData = &completions;
+	unsigned int tween = scheduler.Start(desc);
+
+	scheduler.Update(0.5f);
+	scheduler.Update(1.5f);
+	CHECK(completions == 0);
+	scheduler.Update(2.0f);
+	CHECK(completions == 1);
+	scheduler.Update(2.5f);
+	scheduler.Update(5.0f);
+	CHECK(completions == 1);
+	CHECK(!scheduler.IsPlaying(tween));
+
+	// Stopping isn't finishing
+	unsigned int stopped = scheduler.Start(desc);
+	scheduler.Update(5.5f);
+	scheduler.Stop(stopped);
+	scheduler.Update(10.0f);
+	CHECK(completions == 1);
+
+	// Nor is playing forever
+	desc.Cycles = 0;
+	unsigned int looping = scheduler.Start(desc);
+	scheduler.Update(100.0f);
+	CHECK(scheduler.IsPlaying(looping));
+	CHECK(completions == 1);
+}
+
+// --------------------------------------------------------
+// Stopped tweens are packed out without changing the order
+// the rest are written in, and their slots come back with
+// new handles
+// --------------------------------------------------------
+static void CompactsInOrder()
+{
+	unsigned int transform = TransformStore::GetInstance().Add();
+	TweenScheduler scheduler;
+	TweenDesc desc = MoveX(transform);
+	desc.Duration = 10.0f;
+	desc.End.x = 1.0f;
+	unsigned int first = scheduler.Start(desc);
+	desc.End.x = 2.0f;
+	unsigned int second = scheduler.Start(desc);
+	desc.End.x = 3.0f;
+	unsigned int third = scheduler.Start(desc);
+	CHECK(scheduler.GetCount() == 3);
+
+	// The last one started wins
+	scheduler.Update(5.0f);
+	CHECK(Near(GetX(transform), 1.5f));
+
+	// So with it gone the second does
+	scheduler.Stop(third);
+	CHECK(!scheduler.IsPlaying(third));
+	CHECK(scheduler.GetCount() == 2);
+	scheduler.Update(6.0f);
+	CHECK(Near(GetX(transform), 1.2f));
+
+	// A new tween reuses the stopped one's slot, under a new handle
+	desc.End.x = 4.0f;
+	unsigned int fourth = scheduler.Start(desc);
+	CHECK(fourth != third);
+	CHECK((fourth & TWEEN_INDEX_MASK) == (third & TWEEN_INDEX_MASK));
+	CHECK(!scheduler.IsPlaying(third));
+
+	// Stopping one from the middle keeps the others in order
+	scheduler.Stop(second);
+	scheduler.Update(7.0f);
+	CHECK(scheduler.IsPlaying(first) && scheduler.IsPlaying(fourth));
+	CHECK(Near(GetX(transform), 0.4f));
+
+	scheduler.Stop(fourth);
+	scheduler.Update(9.0f);
+	CHECK(Near(GetX(transform), 0.9f));
+	CHECK(scheduler.GetCount() == 1);
+
+	// Stopping twice does nothing
+	scheduler.Stop(fourth);
+	CHECK(scheduler.GetCount() == 1);
+	scheduler.Clear();
+	CHECK(scheduler.GetCount() == 0);
+	CHECK(!scheduler.IsPlaying(first));
+}
+
+int main()
+{
+	RUN_TEST(RejectsUnknownDescriptions);
+	RUN_TEST(PingPongsAndEnds);
+	RUN_TEST(WaitsForDelay);
+	RUN_TEST(CompletesOnce);
+	RUN_TEST(CompactsInOrder);
+	return TEST_RESULT();
+}
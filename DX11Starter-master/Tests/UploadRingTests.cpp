@@ -0,0 +1,181 @@
+#include "UploadRing.h"
+#include "TestHarness.h"
+
+#include <random>
+#include <vector>
+
+// --------------------------------------------------------
+// Stands in for an ID3D12Fence and the queue signaling it:
+// Signal() is the value the CPU puts at the end of a frame,
+// Complete() is the GPU catching up to one
+// --------------------------------------------------------
+struct MockFence
+{
+	unsigned long long Signaled;
+	unsigned long long Completed;
+
+	MockFence() : Signaled(0), Completed(0) {}
+	unsigned long long Signal() { return ++Signaled; }
+	void Complete(unsigned long long value) { if (value > Completed) Completed = value; }
+};
+
+static void AllocatesInOrder()
+{
+	UploadRing ring;
+	ring.Initialize(1024);
+	CHECK(ring.GetCapacity() == 1024);
+	CHECK(ring.Allocate(100) == 0);
+	CHECK(ring.Allocate(100) == 100);
+	CHECK(ring.GetUsed() == 200);
+	CHECK(ring.Allocate(0) == UPLOAD_RING_NONE);
+	CHECK(ring.Allocate(1025) == UPLOAD_RING_NONE);
+}
+
+static void AlignsAndCountsPadding()
+{
+	UploadRing ring;
+	ring.Initialize(1024);
+	CHECK(ring.Allocate(10) == 0);
+	CHECK(ring.Allocate(256, 256) == 256);
+	CHECK(ring.GetUsed() == 512);
+	CHECK(ring.Allocate(1, 256) == 512);
+}
+
+static void WrapsAroundAfterRetiring()
+{
+	MockFence fence;
+	UploadRing ring;
+	ring.Initialize(10);
+
+	CHECK(ring.Allocate(6) == 0);
+	ring.FinishFrame(fence.Signal());
+	CHECK(ring.Allocate(3) == 6);
+	ring.FinishFrame(fence.Signal());
+	CHECK(ring.GetFramesInFlight() == 2);
+
+	// Doesn't fit in the last 1, and the start is still in use
+	CHECK(ring.Allocate(5) == UPLOAD_RING_NONE);
+
+	// Once the first frame is done, it skips the end and starts over
+	fence.Complete(1);
+	ring.Retire(fence.Completed);
+	CHECK(ring.GetFramesInFlight() == 1);
+	CHECK(ring.GetUsed() == 3);
+	CHECK(ring.Allocate(5) == 0);
+	CHECK(ring.GetUsed() == 9);
+
+	// Only 6 - 5 = 1 left before the second frame's space
+	CHECK(ring.Allocate(2) == UPLOAD_RING_NONE);
+	CHECK(ring.Allocate(1) == 5);
+}
+
+static void FullUntilOldestFrameRetires()
+{
+	MockFence fence;
+	UploadRing ring;
+	ring.Initialize(4);
+
+	for (unsigned int frame = 0; frame < 4; frame++)
+	{
+		CHECK(ring.Allocate(1) == frame);
+		ring.FinishFrame(fence.Signal());
+	}
+	CHECK(ring.Allocate(1) == UPLOAD_RING_NONE);
+	CHECK(ring.GetOldestFenceValue() == 1);
+
+	// Nothing is freed until the GPU reaches the oldest frame's value
+	ring.Retire(fence.Completed);
+	CHECK(ring.Allocate(1) == UPLOAD_RING_NONE);
+
+	fence.Complete(ring.GetOldestFenceValue());
+	ring.Retire(fence.Completed);
+	CHECK(ring.GetOldestFenceValue() == 2);
+	CHECK(ring.Allocate(1) == 0);
+	CHECK(ring.Allocate(1) == UPLOAD_RING_NONE);
+
+	// Everything done empties it
+	ring.FinishFrame(fence.Signal());
+	fence.Complete(fence.Signaled);
+	ring.Retire(fence.Completed);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.GetOldestFenceValue() == 0);
+	CHECK(ring.Allocate(4) == 0);
+}
+
+static void EmptyFramesAreNotTracked()
+{
+	MockFence fence;
+	UploadRing ring;
+	ring.Initialize(16);
+	ring.FinishFrame(fence.Signal());
+	CHECK(ring.GetFramesInFlight() == 0);
+	CHECK(ring.GetOldestFenceValue() == 0);
+}
+
+// --------------------------------------------------------
+// Frames of random sizes with the GPU a few frames behind,
+// tracking who owns every unit: nothing handed out may
+// still belong to a frame the GPU hasn't finished
+// --------------------------------------------------------
+static void NeverReusesSpaceInFlight()
+{
+	const unsigned long long capacity = 64 * 256;
+	MockFence fence;
+	UploadRing ring;
+	ring.Initialize(capacity);
+
+	std::vector<unsigned long long> owner(capacity, 0);
+	std::mt19937 random(7);
+	unsigned int overlaps = 0;
+	unsigned int waits = 0;
+	for (unsigned int frame = 0; frame < 2000; frame++)
+	{
+		unsigned long long frameFence = fence.Signaled + 1;
+		unsigned int count = random() % 16;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned long long size = (random() % 600 + 1 + 255) / 256 * 256;
+			unsigned long long offset = ring.Allocate(size, 256);
+			while (offset == UPLOAD_RING_NONE && ring.GetOldestFenceValue() != 0)
+			{
+				waits++;
+				fence.Complete(ring.GetOldestFenceValue());
+				ring.Retire(fence.Completed);
+				offset = ring.Allocate(size, 256);
+			}
+			CHECK(offset != UPLOAD_RING_NONE);
+			if (offset == UPLOAD_RING_NONE)
+				return;
+
+			CHECK(offset % 256 == 0);
+			CHECK(offset + size <= capacity);
+			for (unsigned long long u = offset; u < offset + size && u < capacity; u++)
+			{
+				if (owner[u] != 0 && owner[u] > fence.Completed)
+					overlaps++;
+				owner[u] = frameFence;
+			}
+		}
+		ring.FinishFrame(fence.Signal());
+
+		// The GPU runs up to three frames behind
+		unsigned long long lag = random() % 4;
+		if (fence.Signaled > lag)
+			fence.Complete(fence.Signaled - lag);
+		ring.Retire(fence.Completed);
+	}
+
+	CHECK(overlaps == 0);
+	CHECK(waits > 0);
+}
+
+int main()
+{
+	RUN_TEST(AllocatesInOrder);
+	RUN_TEST(AlignsAndCountsPadding);
+	RUN_TEST(WrapsAroundAfterRetiring);
+	RUN_TEST(FullUntilOldestFrameRetires);
+	RUN_TEST(EmptyFramesAreNotTracked);
+	RUN_TEST(NeverReusesSpaceInFlight);
+	return TEST_RESULT();
+}
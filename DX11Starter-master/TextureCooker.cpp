@@ -0,0 +1,397 @@
+#include "TextureCooker.h"
+#include "BlockCompression.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cwctype>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <wincodec.h>
+#include <wrl/client.h>
+#include <fstream>
+#include <cstdio>
+#include "MeshCache.h"
+#include "PathHelpers.h"
+#endif
+
+// DXGI_FORMAT values, spelled out so this builds without the DirectX headers
+#define DDS_DXGI_FORMAT_BC1_UNORM 71
+#define DDS_DXGI_FORMAT_BC4_UNORM 80
+#define DDS_DXGI_FORMAT_BC5_UNORM 83
+#define DDS_DXGI_FORMAT_BC7_UNORM 98
+
+// Header flags (see the DDS_HEADER docs)
+#define DDS_FLAGS_TEXTURE 0x1007		// Caps | Height | Width | PixelFormat
+#define DDS_FLAG_MIPMAPCOUNT 0x20000
+#define DDS_FLAG_LINEARSIZE 0x80000
+#define DDS_CAPS_TEXTURE 0x1000
+#define DDS_CAPS_MIPMAP 0x400008		// Complex | MipMap
+#define DDS_PIXELFORMAT_FOURCC 0x4
+#define DDS_DIMENSION_TEXTURE2D 3
+
+// --------------------------------------------------------
+// Downsamples one level by 2x2 with a separable [1 3 3 1]/8
+// tent filter, clamping at the edges.  Much less aliasing
+// than a plain box filter at the same cost.
+// --------------------------------------------------------
+static void DownsampleLevel(const TextureMip& src, TextureMip& dst, bool normalMap)
+{
+	static const float weights[4] = { 1.0f / 8, 3.0f / 8, 3.0f / 8, 1.0f / 8 };
+
+	dst.Width = std::max(1u, src.Width / 2);
+	dst.Height = std::max(1u, src.Height / 2);
+	dst.Pixels.resize((size_t)dst.Width * dst.Height * 4);
+
+	// A dimension that's already 1 is just carried over
+	int srcW = (int)src.Width;
+	int srcH = (int)src.Height;
+	bool filterX = src.Width > 1;
+	bool filterY = src.Height > 1;
+
+	JobSystem::GetInstance().ParallelFor(dst.Height, 8, [&](unsigned int start, unsigned int end)
+	{
+		for (unsigned int y = start; y < end; y++)
+		{
+			for (unsigned int x = 0; x < dst.Width; x++)
+			{
+				float sum[4] = {};
+				for (int j = 0; j < 4; j++)
+				{
+					int sy = filterY ? std::min(std::max((int)y * 2 - 1 + j, 0), srcH - 1) : (int)y;
+					float wy = filterY ? weights[j] : (j == 0 ? 1.0f : 0.0f);
+					if (wy == 0.0f) continue;
+
+					for (int i = 0; i < 4; i++)
+					{
+						int sx = filterX ? std::min(std::max((int)x * 2 - 1 + i, 0), srcW - 1) : (int)x;
+						float wx = filterX ? weights[i] : (i == 0 ? 1.0f : 0.0f);
+						if (wx == 0.0f) continue;
+
+						const unsigned char* p = &src.Pixels[((size_t)sy * srcW + sx) * 4];
+						for (int c = 0; c < 4; c++)
+							sum[c] += p[c] * wx * wy;
+					}
+				}
+
+				// Averaged normals get shorter, so push them back out to unit length
+				if (normalMap)
+				{
+					float n[3];
+					for (int c = 0; c < 3; c++)
+						n[c] = sum[c] / 255.0f * 2.0f - 1.0f;
+
+					float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length > 0.0001f)
+					{
+						for (int c = 0; c < 3; c++)
+							sum[c] = (n[c] / length * 0.5f + 0.5f) * 255.0f;
+					}
+				}
+
+				unsigned char* out = &dst.Pixels[((size_t)y * dst.Width + x) * 4];
+				for (int c = 0; c < 4; c++)
+					out[c] = (unsigned char)std::min(std::max(sum[c] + 0.5f, 0.0f), 255.0f);
+			}
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Builds the full chain down to 1x1.  Each level is filtered
+// from the one above it, not from the original.
+// --------------------------------------------------------
+void GenerateMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	bool normalMap,
+	std::vector<TextureMip>& mips)
+{
+	mips.clear();
+	mips.resize(1);
+	mips[0].Width = width;
+	mips[0].Height = height;
+	mips[0].Pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+	while (mips.back().Width > 1 || mips.back().Height > 1)
+	{
+		TextureMip next;
+		DownsampleLevel(mips.back(), next, normalMap);
+		mips.push_back(std::move(next));
+	}
+}
+
+// Bytes per 4x4 block for each cooked format
+static unsigned int GetBlockBytes(int format)
+{
+	return (format == TEXTURE_COOK_BC1 || format == TEXTURE_COOK_BC4) ? 8 : 16;
+}
+
+static unsigned int GetDXGIFormat(int format)
+{
+	switch (format)
+	{
+	case TEXTURE_COOK_BC1: return DDS_DXGI_FORMAT_BC1_UNORM;
+	case TEXTURE_COOK_BC4: return DDS_DXGI_FORMAT_BC4_UNORM;
+	case TEXTURE_COOK_BC5: return DDS_DXGI_FORMAT_BC5_UNORM;
+	default: return DDS_DXGI_FORMAT_BC7_UNORM;
+	}
+}
+
+// --------------------------------------------------------
+// Compresses a single level into the given output, one row
+// of blocks per job.  Blocks hanging off the edge of small
+// (or odd sized) levels repeat the last row/column.
+// --------------------------------------------------------
+static void CompressLevel(const TextureMip& mip, int format, unsigned char* out)
+{
+	unsigned int blocksX = std::max(1u, (mip.Width + 3) / 4);
+	unsigned int blocksY = std::max(1u, (mip.Height + 3) / 4);
+	unsigned int blockBytes = GetBlockBytes(format);
+
+	JobSystem::GetInstance().ParallelFor(blocksY, 1, [&](unsigned int start, unsigned int end)
+	{
+		unsigned char block[64];
+		unsigned char channel[16];
+
+		for (unsigned int by = start; by < end; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksX; bx++)
+			{
+				for (unsigned int p = 0; p < 16; p++)
+				{
+					unsigned int x = std::min(bx * 4 + p % 4, mip.Width - 1);
+					unsigned int y = std::min(by * 4 + p / 4, mip.Height - 1);
+					memcpy(&block[p * 4], &mip.Pixels[((size_t)y * mip.Width + x) * 4], 4);
+					channel[p] = block[p * 4];
+				}
+
+				unsigned char* dest = out + ((size_t)by * blocksX + bx) * blockBytes;
+				switch (format)
+				{
+				case TEXTURE_COOK_BC1: CompressBlockBC1(block, dest); break;
+				case TEXTURE_COOK_BC4: CompressBlockBC4(channel, dest); break;
+				case TEXTURE_COOK_BC5: CompressBlockBC5(block, dest); break;
+				default: CompressBlockBC7(block, dest); break;
+				}
+			}
+		}
+	});
+}
+
+// --------------------------------------------------------
+// Lays out a .dds file: magic, the 124 byte header, the DX10
+// extension header and then every level's blocks back to back
+// --------------------------------------------------------
+void CompressToDDS(const std::vector<TextureMip>& mips, int format, std::vector<unsigned char>& dds)
+{
+	dds.clear();
+	if (mips.empty())
+		return;
+
+	unsigned int blockBytes = GetBlockBytes(format);
+	std::vector<size_t> levelOffsets(mips.size());
+
+	// Headers are all 32-bit fields: magic (1) + header (31) + DX10 (5)
+	const size_t headerBytes = (1 + 31 + 5) * 4;
+	size_t totalBytes = headerBytes;
+	for (size_t i = 0; i < mips.size(); i++)
+	{
+		levelOffsets[i] = totalBytes;
+		totalBytes += (size_t)std::max(1u, (mips[i].Width + 3) / 4) * std::max(1u, (mips[i].Height + 3) / 4) * blockBytes;
+	}
+	dds.resize(totalBytes, 0);
+
+	unsigned int header[1 + 31 + 5] = {};
+	header[0] = 0x20534444; // "DDS "
+	header[1] = 124; // Header size
+	header[2] = DDS_FLAGS_TEXTURE | DDS_FLAG_LINEARSIZE | (mips.size() > 1 ? DDS_FLAG_MIPMAPCOUNT : 0);
+	header[3] = mips[0].Height;
+	header[4] = mips[0].Width;
+	header[5] = (unsigned int)(levelOffsets.size() > 1 ? levelOffsets[1] - levelOffsets[0] : totalBytes - headerBytes);
+	header[7] = (unsigned int)mips.size();
+	header[19] = 32; // Pixel format size
+	header[20] = DDS_PIXELFORMAT_FOURCC;
+	header[21] = 0x30315844; // "DX10"
+	header[27] = DDS_CAPS_TEXTURE | (mips.size() > 1 ? DDS_CAPS_MIPMAP : 0);
+	header[32] = GetDXGIFormat(format);
+	header[33] = DDS_DIMENSION_TEXTURE2D;
+	header[35] = 1; // Array size
+	memcpy(dds.data(), header, sizeof(header));
+
+	for (size_t i = 0; i < mips.size(); i++)
+		CompressLevel(mips[i], format, dds.data() + levelOffsets[i]);
+}
+
+// --------------------------------------------------------
+// Validates the headers and works out where each mip is, so
+// individual mips can be read straight out of a mapped file
+// --------------------------------------------------------
+bool ReadCookedTextureLayout(const unsigned char* dds, unsigned long long size, CookedTextureLayout& layout)
+{
+	const size_t headerBytes = (1 + 31 + 5) * 4;
+	if (!dds || size < headerBytes)
+		return false;
+
+	unsigned int header[1 + 31 + 5];
+	memcpy(header, dds, sizeof(header));
+	if (header[0] != 0x20534444 || header[1] != 124 ||
+		!(header[20] & DDS_PIXELFORMAT_FOURCC) || header[21] != 0x30315844 ||
+		header[33] != DDS_DIMENSION_TEXTURE2D || header[35] != 1)
+		return false;
+
+	unsigned int blockBytes;
+	switch (header[32])
+	{
+	case DDS_DXGI_FORMAT_BC1_UNORM: case DDS_DXGI_FORMAT_BC4_UNORM: blockBytes = 8; break;
+	case DDS_DXGI_FORMAT_BC5_UNORM: case DDS_DXGI_FORMAT_BC7_UNORM: blockBytes = 16; break;
+	default: return false;
+	}
+
+	layout.Width = header[4];
+	layout.Height = header[3];
+	layout.MipCount = (header[2] & DDS_FLAG_MIPMAPCOUNT) ? std::max(header[7], 1u) : 1;
+	layout.DXGIFormat = header[32];
+	if (layout.Width == 0 || layout.Height == 0 || layout.MipCount > TEXTURE_COOK_MAX_MIPS)
+		return false;
+
+	unsigned long long offset = headerBytes;
+	for (unsigned int i = 0; i < layout.MipCount; i++)
+	{
+		unsigned int blocksX = std::max(1u, (std::max(1u, layout.Width >> i) + 3) / 4);
+		unsigned int blocksY = std::max(1u, (std::max(1u, layout.Height >> i) + 3) / 4);
+		layout.MipOffsets[i] = offset;
+		layout.MipRowPitches[i] = blocksX * blockBytes;
+		layout.MipSizes[i] = (unsigned long long)layout.MipRowPitches[i] * blocksY;
+		offset += layout.MipSizes[i];
+	}
+
+	// Truncated files are rejected rather than read past
+	return offset <= size;
+}
+
+// --------------------------------------------------------
+// Format from the file name, following the naming used by
+// the assets (e.g. floor_normals.png, floor_roughness.png)
+// --------------------------------------------------------
+int GuessTextureCookFormat(const wchar_t* file)
+{
+	std::wstring name(file);
+	for (wchar_t& c : name)
+		c = (wchar_t)towlower(c);
+
+	// Only look at the file name itself, not the folders above it
+	size_t slash = name.find_last_of(L"\\/");
+	if (slash != std::wstring::npos)
+		name = name.substr(slash + 1);
+
+	if (name.find(L"normal") != std::wstring::npos)
+		return TEXTURE_COOK_BC5;
+	if (name.find(L"rough") != std::wstring::npos ||
+		name.find(L"metal") != std::wstring::npos ||
+		name.find(L"_ao") != std::wstring::npos)
+		return TEXTURE_COOK_BC4;
+	return TEXTURE_COOK_BC7;
+}
+
+#ifdef _WIN32
+// --------------------------------------------------------
+// Decodes any WIC supported image to 8-bit RGBA.  Needs COM,
+// which the job system sets up on each of its workers.
+// --------------------------------------------------------
+static bool DecodeImageRGBA(const wchar_t* file, std::vector<unsigned char>& pixels, unsigned int& width, unsigned int& height)
+{
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+
+	if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()))) ||
+		FAILED(factory->CreateDecoderFromFilename(file, 0, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())) ||
+		FAILED(frame->GetSize(&width, &height)) ||
+		FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, 0, 0, WICBitmapPaletteTypeCustom)))
+		return false;
+
+	pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(0, width * 4, (UINT)pixels.size(), pixels.data()));
+}
+
+// --------------------------------------------------------
+// Cooked files live in TextureCache, named by the source's
+// contents and everything that affects the output.  The file
+// is written under a temporary name and then moved into
+// place, so a half written file is never picked up.
+// --------------------------------------------------------
+std::wstring GetCookedTexture(const wchar_t* sourceFile, bool generateMips)
+{
+	// Already compressed, nothing to do
+	std::wstring source(sourceFile);
+	if (source.size() > 4 && _wcsicmp(source.c_str() + source.size() - 4, L".dds") == 0)
+		return source;
+
+	unsigned long long sourceHash = HashFileContents(sourceFile);
+	if (sourceHash == 0)
+		return std::wstring();
+
+	int format = GuessTextureCookFormat(sourceFile);
+
+	std::wstring folder = FixPath(L"TextureCache");
+	CreateDirectoryW(folder.c_str(), 0); // Fails harmlessly if it already exists
+
+	wchar_t name[64] = {};
+	swprintf_s(name, L"%016llx_%d%s_v%d.dds", sourceHash, format, generateMips ? L"m" : L"", TEXTURE_COOKER_VERSION);
+	std::wstring cookedPath = folder + L"\\" + name;
+
+	if (GetFileAttributesW(cookedPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+		return cookedPath;
+
+	std::vector<unsigned char> pixels;
+	unsigned int width = 0;
+	unsigned int height = 0;
+	if (!DecodeImageRGBA(sourceFile, pixels, width, height) || width == 0 || height == 0)
+		return std::wstring();
+
+	std::vector<TextureMip> mips;
+	if (generateMips)
+	{
+		GenerateMipChain(pixels.data(), width, height, format == TEXTURE_COOK_BC5, mips);
+	}
+	else
+	{
+		mips.resize(1);
+		mips[0].Width = width;
+		mips[0].Height = height;
+		mips[0].Pixels = std::move(pixels);
+	}
+
+	std::vector<unsigned char> dds;
+	CompressToDDS(mips, format, dds);
+
+	std::wstring tempPath = cookedPath + L".tmp";
+	{
+		std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return std::wstring();
+		out.write((const char*)dds.data(), dds.size());
+		if (!out)
+			return std::wstring();
+	}
+
+	if (!MoveFileExW(tempPath.c_str(), cookedPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileW(tempPath.c_str());
+		return std::wstring();
+	}
+
+#if defined(DEBUG) || defined(_DEBUG)
+	printf("Cooked texture %ls (%zu mips, %zu bytes)\n", sourceFile, mips.size(), dds.size());
+#endif
+
+	return cookedPath;
+}
+#endif
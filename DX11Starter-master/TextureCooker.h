@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <string>
+
+// Bump whenever the cooked output changes, so old cooked files are ignored
+#define TEXTURE_COOKER_VERSION 2
+
+// Block compressed formats the cooker can produce
+#define TEXTURE_COOK_BC1 0	// Color without alpha, 4 bits per pixel
+#define TEXTURE_COOK_BC4 1	// Single channel (roughness, metalness), 4 bits per pixel
+#define TEXTURE_COOK_BC5 2	// Two channel tangent space normals, 8 bits per pixel
+#define TEXTURE_COOK_BC7 3	// Color and alpha, 8 bits per pixel
+
+// One level of an uncompressed RGBA8 image
+struct TextureMip
+{
+	unsigned int Width;
+	unsigned int Height;
+	std::vector<unsigned char> Pixels;
+};
+
+// Builds the full mip chain (tent filtered) below the given image.
+// Normal maps are renormalized after every downsample.
+void GenerateMipChain(
+	const unsigned char* rgba,
+	unsigned int width,
+	unsigned int height,
+	bool normalMap,
+	std::vector<TextureMip>& mips);
+
+// Most mips a cooked texture can have (a 32k texture)
+#define TEXTURE_COOK_MAX_MIPS 16
+
+// Where each mip of a cooked .dds lives in the file
+struct CookedTextureLayout
+{
+	unsigned int Width;
+	unsigned int Height;
+	unsigned int MipCount;
+	unsigned int DXGIFormat;
+	unsigned long long MipOffsets[TEXTURE_COOK_MAX_MIPS];
+	unsigned long long MipSizes[TEXTURE_COOK_MAX_MIPS];
+	unsigned int MipRowPitches[TEXTURE_COOK_MAX_MIPS];	// Bytes per row of blocks
+};
+
+// Block compresses every level (in parallel) and lays out a
+// complete .dds file, using the DX10 header extension
+void CompressToDDS(const std::vector<TextureMip>& mips, int format, std::vector<unsigned char>& dds);
+
+// Reads the layout of a .dds written by CompressToDDS (or any
+// other single 2D BC1/4/5/7 texture).  False for anything else.
+bool ReadCookedTextureLayout(const unsigned char* dds, unsigned long long size, CookedTextureLayout& layout);
+
+// Picks a format from the file name: normal maps get BC5, single
+// channel maps (roughness, metalness, ...) get BC4, the rest BC7
+int GuessTextureCookFormat(const wchar_t* file);
+
+#ifdef _WIN32
+// Path of the cooked .dds for a source image, decoding and cooking
+// it first if that hasn't happened yet.  Empty if it can't be cooked.
+std::wstring GetCookedTexture(const wchar_t* sourceFile, bool generateMips);
+#endif
@@ -0,0 +1,260 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+TextureResidency::TextureResidency() :
+	budget(TEXTURE_RESIDENCY_DEFAULT_BUDGET),
+	residentBytes(0),
+	frame(1)
+{
+}
+
+void TextureResidency::SetBudget(unsigned long long bytes) { budget = bytes; }
+unsigned long long TextureResidency::GetBudget() { return budget; }
+unsigned long long TextureResidency::GetResidentBytes() { return residentBytes; }
+
+// --------------------------------------------------------
+// Registers a texture, reusing the slot of a removed one
+// when possible so ids stay small
+// --------------------------------------------------------
+unsigned int TextureResidency::AddTexture(
+	unsigned int width,
+	unsigned int height,
+	unsigned int mipCount,
+	const unsigned long long* mipBytes,
+	unsigned int residentMip)
+{
+	mipCount = std::max(1u, std::min(mipCount, (unsigned int)TEXTURE_RESIDENCY_MAX_MIPS));
+
+	Entry entry = {};
+	entry.Width = width;
+	entry.Height = height;
+	entry.MipCount = mipCount;
+	entry.TailMip = GetTailMip(width, height, mipCount);
+	entry.ResidentMip = std::min(residentMip, mipCount - 1);
+	entry.DesiredMip = entry.ResidentMip;
+	entry.RequestedMip = entry.ResidentMip;
+	entry.LastUsedFrame = 0;
+	entry.Active = true;
+	for (unsigned int i = 0; i < mipCount; i++)
+	{
+		entry.MipBytes[i] = mipBytes[i];
+		if (i >= entry.ResidentMip)
+			residentBytes += mipBytes[i];
+	}
+
+	if (!freeSlots.empty())
+	{
+		unsigned int slot = freeSlots.back();
+		freeSlots.pop_back();
+		textures[slot] = entry;
+		return slot;
+	}
+
+	textures.push_back(entry);
+	return (unsigned int)textures.size() - 1;
+}
+
+void TextureResidency::RemoveTexture(unsigned int texture)
+{
+	if (texture >= textures.size() || !textures[texture].Active)
+		return;
+
+	Entry& entry = textures[texture];
+	for (unsigned int i = entry.ResidentMip; i < entry.MipCount; i++)
+		residentBytes -= entry.MipBytes[i];
+
+	entry.Active = false;
+	freeSlots.push_back(texture);
+}
+
+// --------------------------------------------------------
+// Several things can use the same texture in a frame, so
+// the most detailed request wins
+// --------------------------------------------------------
+void TextureResidency::ReportCoverage(unsigned int texture, float pixelsAcross)
+{
+	if (texture >= textures.size() || !textures[texture].Active)
+		return;
+
+	Entry& entry = textures[texture];
+	unsigned int mip = CalculateDesiredMip(entry.Width, entry.Height, entry.MipCount, pixelsAcross);
+
+	if (entry.LastUsedFrame != frame)
+		entry.RequestedMip = mip;
+	else
+		entry.RequestedMip = std::min(entry.RequestedMip, mip);
+	entry.LastUsedFrame = frame;
+}
+
+// --------------------------------------------------------
+// Moves every texture toward the mip it wants.  Textures
+// missing the most detail go first, each gaining at most one
+// level per update.  Anything that doesn't fit in the budget
+// (even after evicting) waits for a later frame.
+// --------------------------------------------------------
+void TextureResidency::Update(std::vector<TextureResidencyChange>& changes)
+{
+	changes.clear();
+
+	std::vector<unsigned int> oldMips(textures.size());
+	std::vector<unsigned int> wanting;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		Entry& entry = textures[i];
+		oldMips[i] = entry.ResidentMip;
+		if (!entry.Active || entry.LastUsedFrame != frame)
+			continue;
+
+		entry.DesiredMip = entry.RequestedMip;
+		if (entry.DesiredMip < entry.ResidentMip)
+			wanting.push_back(i);
+	}
+
+	// The budget may have shrunk since last time
+	while (residentBytes > budget && EvictOneMip(UINT_MAX)) {}
+
+	std::sort(wanting.begin(), wanting.end(), [&](unsigned int a, unsigned int b)
+	{
+		unsigned int missingA = textures[a].ResidentMip - textures[a].DesiredMip;
+		unsigned int missingB = textures[b].ResidentMip - textures[b].DesiredMip;
+		if (missingA != missingB)
+			return missingA > missingB;
+		return a < b;
+	});
+
+	unsigned long long uploaded = 0;
+	for (unsigned int i : wanting)
+	{
+		Entry& entry = textures[i];
+		unsigned long long cost = entry.MipBytes[entry.ResidentMip - 1];
+		if (uploaded > 0 && uploaded + cost > TEXTURE_RESIDENCY_MAX_UPLOAD_PER_UPDATE)
+			break;
+
+		while (residentBytes + cost > budget && EvictOneMip(i)) {}
+		if (residentBytes + cost > budget)
+			continue; // A smaller mip further down may still fit
+
+		entry.ResidentMip--;
+		residentBytes += cost;
+		uploaded += cost;
+	}
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].Active && textures[i].ResidentMip != oldMips[i])
+			changes.push_back({ i, oldMips[i], textures[i].ResidentMip });
+	}
+
+	frame++;
+}
+
+// --------------------------------------------------------
+// Drops the finest resident mip of one texture.  Mips finer
+// than their texture currently needs go first, then those of
+// the least recently used textures.  Textures in use this
+// frame never lose mips they need, so nothing ping-pongs.
+// --------------------------------------------------------
+bool TextureResidency::EvictOneMip(unsigned int keep)
+{
+	unsigned int victim = UINT_MAX;
+	bool victimWasteful = false;
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		const Entry& entry = textures[i];
+		if (i == keep || !entry.Active || entry.ResidentMip >= entry.TailMip)
+			continue;
+
+		bool wasteful = entry.ResidentMip < entry.DesiredMip;
+		if (!wasteful && entry.LastUsedFrame == frame)
+			continue;
+
+		if (victim == UINT_MAX)
+		{
+			victim = i;
+			victimWasteful = wasteful;
+			continue;
+		}
+
+		// Prefer wasteful, then least recently used, then biggest
+		const Entry& best = textures[victim];
+		bool better;
+		if (wasteful != victimWasteful)
+			better = wasteful;
+		else if (entry.LastUsedFrame != best.LastUsedFrame)
+			better = entry.LastUsedFrame < best.LastUsedFrame;
+		else
+			better = entry.MipBytes[entry.ResidentMip] > best.MipBytes[best.ResidentMip];
+
+		if (better)
+		{
+			victim = i;
+			victimWasteful = wasteful;
+		}
+	}
+
+	if (victim == UINT_MAX)
+		return false;
+
+	Entry& entry = textures[victim];
+	residentBytes -= entry.MipBytes[entry.ResidentMip];
+	entry.ResidentMip++;
+	return true;
+}
+
+void TextureResidency::SetResidentMip(unsigned int texture, unsigned int mip)
+{
+	if (texture >= textures.size() || !textures[texture].Active)
+		return;
+
+	Entry& entry = textures[texture];
+	mip = std::min(mip, entry.MipCount - 1);
+	for (; entry.ResidentMip < mip; entry.ResidentMip++)
+		residentBytes -= entry.MipBytes[entry.ResidentMip];
+	for (; entry.ResidentMip > mip; entry.ResidentMip--)
+		residentBytes += entry.MipBytes[entry.ResidentMip - 1];
+}
+
+unsigned int TextureResidency::GetResidentMip(unsigned int texture)
+{
+	return texture < textures.size() ? textures[texture].ResidentMip : 0;
+}
+
+unsigned int TextureResidency::GetDesiredMip(unsigned int texture)
+{
+	return texture < textures.size() ? textures[texture].DesiredMip : 0;
+}
+
+// --------------------------------------------------------
+// Mip tails are tiny (a 128x128 BC7 tail is ~22KB), so they
+// stay resident and there's always something to sample
+// --------------------------------------------------------
+unsigned int TextureResidency::GetTailMip(unsigned int width, unsigned int height, unsigned int mipCount)
+{
+	unsigned int mip = 0;
+	while (mip + 1 < mipCount && std::max(width >> mip, height >> mip) > TEXTURE_RESIDENCY_TAIL_SIZE)
+		mip++;
+	return mip;
+}
+
+// --------------------------------------------------------
+// One texel per pixel across the larger side is enough, so
+// each halving of on screen size drops one mip
+// --------------------------------------------------------
+unsigned int TextureResidency::CalculateDesiredMip(unsigned int width, unsigned int height, unsigned int mipCount, float pixelsAcross)
+{
+	if (mipCount <= 1)
+		return 0;
+
+	float texels = (float)std::max(width, height);
+	if (!(pixelsAcross > 0.0f))
+		return mipCount - 1;
+	if (pixelsAcross >= texels)
+		return 0;
+
+	int mip = (int)floorf(log2f(texels / pixelsAcross));
+	return (unsigned int)std::min(std::max(mip, 0), (int)mipCount - 1);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vector>
+
+// Default amount of memory streamed mips may use
+#define TEXTURE_RESIDENCY_DEFAULT_BUDGET (256ull * 1024 * 1024)
+
+// Mips this size (or smaller) are loaded up front and never evicted
+#define TEXTURE_RESIDENCY_TAIL_SIZE 128
+
+// Most bytes streamed in by a single Update(), so a big camera
+// move spreads its uploads over a few frames
+#define TEXTURE_RESIDENCY_MAX_UPLOAD_PER_UPDATE (32ull * 1024 * 1024)
+
+#define TEXTURE_RESIDENCY_MAX_MIPS 16
+
+// Id for "not streamed"
+#define TEXTURE_RESIDENCY_NONE 0xFFFFFFFF
+
+// A texture whose most detailed resident mip changed during an Update()
+struct TextureResidencyChange
+{
+	unsigned int Texture;
+	unsigned int OldMip;
+	unsigned int NewMip;
+};
+
+// --------------------------------------------------------
+// Decides which mips of each streamed texture should be in
+// memory.  Knows nothing about D3D12 - the owner reports how
+// much of the screen each texture covers, calls Update() once
+// a frame, and then loads or drops mips to match the changes
+// it hands back.
+//
+// Textures always keep their mip tail.  Finer mips stream in
+// one level at a time, most needed first, and when that would
+// go over budget, mips finer than needed (then the least
+// recently used ones) are evicted to make room.
+// --------------------------------------------------------
+class TextureResidency
+{
+public:
+	TextureResidency();
+
+	void SetBudget(unsigned long long bytes);
+	unsigned long long GetBudget();
+	unsigned long long GetResidentBytes();
+
+	// Registers a texture with mips [residentMip, mipCount) already loaded.
+	// mipBytes holds the size of every mip, finest first.
+	unsigned int AddTexture(
+		unsigned int width,
+		unsigned int height,
+		unsigned int mipCount,
+		const unsigned long long* mipBytes,
+		unsigned int residentMip);
+	void RemoveTexture(unsigned int texture);
+
+	// The texture spans about this many pixels across on screen this frame
+	void ReportCoverage(unsigned int texture, float pixelsAcross);
+
+	// Applies this frame's coverage reports and the budget
+	void Update(std::vector<TextureResidencyChange>& changes);
+
+	// Corrects the most detailed resident mip when the owner couldn't load
+	// what Update() asked for (or loaded a different mip instead)
+	void SetResidentMip(unsigned int texture, unsigned int mip);
+
+	unsigned int GetResidentMip(unsigned int texture);
+	unsigned int GetDesiredMip(unsigned int texture);
+
+	// First mip that's part of the always resident tail
+	static unsigned int GetTailMip(unsigned int width, unsigned int height, unsigned int mipCount);
+
+	// Coarsest mip that still gives at least one texel per pixel
+	static unsigned int CalculateDesiredMip(unsigned int width, unsigned int height, unsigned int mipCount, float pixelsAcross);
+
+private:
+	struct Entry
+	{
+		unsigned int Width;
+		unsigned int Height;
+		unsigned int MipCount;
+		unsigned int TailMip;
+		unsigned int ResidentMip;
+		unsigned int DesiredMip;
+		unsigned int RequestedMip;	// Finest mip asked for this frame
+		unsigned long long LastUsedFrame;
+		unsigned long long MipBytes[TEXTURE_RESIDENCY_MAX_MIPS];
+		bool Active;
+	};
+
+	std::vector<Entry> textures;
+	std::vector<unsigned int> freeSlots;
+
+	unsigned long long budget;
+	unsigned long long residentBytes;
+	unsigned long long frame;
+
+	bool EvictOneMip(unsigned int keep);
+};
@@ -1,185 +1,160 @@
 #include "Transform.h"
+#include "TransformStore.h"
 
-Transform::Transform() :
-	position(std::make_shared<DirectX::XMFLOAT3>(0.0f, 0.0f, 0.0f)),
-	eulerRotation(0.0f, 0.0f, 0.0f),
-	scale(1.0f, 1.0f, 1.0f)
-{
-	DirectX::XMStoreFloat4x4(&world, DirectX::XMMatrixIdentity());
-	DirectX::XMStoreFloat4x4(&worldTranspose, DirectX::XMMatrixIdentity());
-
-	matIsDirty = true;
-	dirIsDirty = true;
+#include <algorithm>
+#include <cmath>
 
-	parent = nullptr;
-
-	CleanVectors();
+Transform::Transform()
+{
+	index = TransformStore::GetInstance().Add();
 }
 
-#pragma region HELPERS
-
-void Transform::CleanMatrices()
+Transform::~Transform()
 {
-	// Create a new world if transform has been mutated 
-	if (matIsDirty)
+	// A parent holds its children, so only they can need letting go of
+	for (std::shared_ptr<Transform>& child : children)
 	{
-		// Get each of parts that represent the world matrix 
-		DirectX::XMMATRIX pos =
-			DirectX::XMMatrixTranslationFromVector(
-				DirectX::XMLoadFloat3(position.get()));
-
-		DirectX::XMMATRIX rot =
-			DirectX::XMMatrixRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
-
-		DirectX::XMMATRIX sc =
-			DirectX::XMMatrixScalingFromVector(
-				XMLoadFloat3(&scale));
-
-		// Update the matricies 
-		DirectX::XMMATRIX wm = sc * rot * pos;
-		DirectX::XMStoreFloat4x4(&world, wm);
-		DirectX::XMStoreFloat4x4(&worldTranspose,
-			DirectX::XMMatrixInverse(0, DirectX::XMMatrixTranspose(wm)));
-
-		matIsDirty = false;
+		child->parent.reset();
+		TransformStore::GetInstance().SetParent(child->index, TRANSFORM_NO_PARENT);
 	}
+	TransformStore::GetInstance().Remove(index);
 }
 
-void Transform::CleanVectors()
+unsigned int Transform::GetIndex()
 {
-	if (!dirIsDirty)
-		return;
-
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(DirectX::XMLoadFloat3(&eulerRotation));
-	DirectX::XMStoreFloat3(&right, DirectX::XMVector3Rotate(DirectX::XMVectorSet(1, 0, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&up, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 1, 0, 0), rotQuat));
-	DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 0, 1, 0), rotQuat));
-
-	dirIsDirty = false;
+	return index;
 }
-#pragma endregion 
 
 #pragma region SETTERS
 
 void Transform::SetPosition(float x, float y, float z)
 {
-	// Was there a XMFloat function for this? 
-	position.get()->x = x;
-	position.get()->y = y;
-	position.get()->z = z;
-
-	matIsDirty = true;
+	TransformStore::GetInstance().SetPosition(index, DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
-	*(this->position.get()) = position;
+	TransformStore::GetInstance().SetPosition(index, position);
+}
 
-	matIsDirty = true;
+void Transform::SetRotation(DirectX::XMFLOAT4 rotation)
+{
+	TransformStore::GetInstance().SetRotation(index, rotation);
 }
 
 void Transform::SetEulerRotation(float pitch, float yaw, float roll)
 {
-	eulerRotation.x = pitch;
-	eulerRotation.y = yaw;
-	eulerRotation.z = roll;
-
-	matIsDirty = true;
-	dirIsDirty = true;
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	SetRotation(rotation);
 }
 
 void Transform::SetEulerRotation(DirectX::XMFLOAT3 rotation)
 {
-	this->eulerRotation = rotation;
-
-	matIsDirty = true;
-	dirIsDirty = true;
+	SetEulerRotation(rotation.x, rotation.y, rotation.z);
 }
 
 void Transform::SetScale(float x, float y, float z)
 {
-	scale.x = x;
-	scale.y = y;
-	scale.z = z;
-
-	matIsDirty = true;
+	TransformStore::GetInstance().SetScale(index, DirectX::XMFLOAT3(x, y, z));
 }
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
-	this->scale = scale;
-
-	matIsDirty = true;
+	TransformStore::GetInstance().SetScale(index, scale);
 }
 
 void Transform::SetScale(float s)
 {
 	SetScale(s, s, s);
-
-	matIsDirty = true;
 }
 
 #pragma endregion
 
 #pragma region GETTERS
-std::shared_ptr<DirectX::XMFLOAT3> Transform::GetPosition()
+DirectX::XMFLOAT3 Transform::GetPosition()
+{
+	return TransformStore::GetInstance().GetPosition(index);
+}
+
+DirectX::XMFLOAT4 Transform::GetRotation()
 {
-	return position;
+	return TransformStore::GetInstance().GetRotation(index);
 }
 
+// Reads the angles back out of the rotation matrix's terms (roll, then
+// pitch, then yaw, as XMQuaternionRotationRollPitchYaw applies them)
 DirectX::XMFLOAT3 Transform::GetEulerRotation()
 {
-	return eulerRotation;
+	DirectX::XMFLOAT4 q = GetRotation();
+	float sinPitch = -2.0f * (q.y * q.z - q.w * q.x);
+
+	// Looking straight up or down, yaw and roll turn around the same
+	// axis, so it's all put in yaw
+	if (fabsf(sinPitch) > 0.99999f)
+	{
+		return DirectX::XMFLOAT3(
+			copysignf(DirectX::XM_PIDIV2, sinPitch),
+			atan2f(-2.0f * (q.x * q.z - q.w * q.y), 1.0f - 2.0f * (q.y * q.y + q.z * q.z)),
+			0.0f);
+	}
+
+	return DirectX::XMFLOAT3(
+		asinf(sinPitch),
+		atan2f(2.0f * (q.x * q.z + q.w * q.y), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)),
+		atan2f(2.0f * (q.x * q.y + q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z)));
 }
 
 DirectX::XMFLOAT3 Transform::GetScale()
 {
-	return scale;
+	return TransformStore::GetInstance().GetScale(index);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldMatrix()
 {
-	CleanMatrices();
-	return world;
+	return TransformStore::GetInstance().GetWorldMatrix(index);
 }
 
 DirectX::XMFLOAT4X4 Transform::GetWorldInverseTransposeMatrix()
 {
-	CleanMatrices();
-	return worldTranspose;
+	return TransformStore::GetInstance().GetWorldInverseTransposeMatrix(index);
 }
 
+// Direction vectors are worked out when asked for, rather than stored per transform
 DirectX::XMFLOAT3 Transform::GetRight()
 {
-	if (dirIsDirty)
-		CleanVectors();
-
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMFLOAT3 right;
+	DirectX::XMStoreFloat3(&right, DirectX::XMVector3Rotate(DirectX::XMVectorSet(1, 0, 0, 0), DirectX::XMLoadFloat4(&rotation)));
 	return right;
 }
 
 DirectX::XMFLOAT3 Transform::GetUp()
 {
-	if (dirIsDirty)
-		CleanVectors();
-
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMFLOAT3 up;
+	DirectX::XMStoreFloat3(&up, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 1, 0, 0), DirectX::XMLoadFloat4(&rotation)));
 	return up;
 }
 
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	if (dirIsDirty)
-		CleanVectors();
-
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMFLOAT3 forward;
+	DirectX::XMStoreFloat3(&forward, DirectX::XMVector3Rotate(DirectX::XMVectorSet(0, 0, 1, 0), DirectX::XMLoadFloat4(&rotation)));
 	return forward;
 }
 
 std::shared_ptr<Transform> Transform::GetParent()
 {
-	return parent;
+	return parent.lock();
 }
 
 std::shared_ptr<Transform> Transform::GetChild(unsigned int index)
 {
+	if (index >= children.size())
+		return nullptr;
+
 	return children[index];
 }
 
@@ -210,112 +185,91 @@ unsigned int Transform::GetChildCount()
 #pragma region MUTATORS 
 void Transform::MoveAbs(float x, float y, float z)
 {
-	this->position.get()->x += x;
-	this->position.get()->y += y;
-	this->position.get()->z += z;
-	matIsDirty = true;
+	DirectX::XMFLOAT3 position = GetPosition();
+	SetPosition(position.x + x, position.y + y, position.z + z);
 }
 
 void Transform::MoveAbs(DirectX::XMFLOAT3 offset)
 {
-	this->position.get()->x += offset.x;
-	this->position.get()->y += offset.y;
-	this->position.get()->z += offset.z;
-	matIsDirty = true;
+	MoveAbs(offset.x, offset.y, offset.z);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYawFromVector(
-		DirectX::XMLoadFloat3(&eulerRotation)
-	);
-	
-	// Creat the movement variable 
-	DirectX::XMVECTOR toMove = DirectX::XMVectorSet(x, y, z, 0);
-
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
-
-	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
-
-	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
-	matIsDirty = true;
+	MoveRelative(DirectX::XMFLOAT3(x, y, z));
 }
 
-void Transform::MoveRelative(DirectX::XMFLOAT3 vec)
+void Transform::MoveRelative(DirectX::XMFLOAT3 offset)
 {
-	// Setup 
-	DirectX::XMVECTOR rotEuler = DirectX::XMLoadFloat3(&eulerRotation);
-	
-	// Turn the euler angles into a quaternion 
-	DirectX::XMVECTOR rotQuat = DirectX::XMQuaternionRotationRollPitchYaw(
-		(float)DirectX::XMVectorGetIntX(rotEuler),
-		(float)DirectX::XMVectorGetIntY(rotEuler),
-		(float)DirectX::XMVectorGetIntZ(rotEuler)
-	);
-	
-	DirectX::XMVECTOR toMove = DirectX::XMLoadFloat3(&vec);
-
-	// Convert to local space 
-	toMove = DirectX::XMVector3Rotate(toMove, rotQuat);
+	// Turn the offset by the rotation to get it in world space 
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMVECTOR toMove = DirectX::XMVector3Rotate(DirectX::XMLoadFloat3(&offset), DirectX::XMLoadFloat4(&rotation));
 
 	// Add in local space 
-	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(position.get()), toMove);
+	DirectX::XMFLOAT3 position = GetPosition();
+	toMove = DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&position), toMove);
 
 	// Store 
-	DirectX::XMStoreFloat3(position.get(), toMove);
-
-	matIsDirty = true;
+	DirectX::XMStoreFloat3(&position, toMove);
+	SetPosition(position);
 }
 
 void Transform::RotateEuler(float pitch, float yaw, float roll)
 {
-	eulerRotation.x += pitch;
-	eulerRotation.y += yaw;
-	eulerRotation.z += roll;
+	// Local turns go before the current rotation, world ones after
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMVECTOR result = DirectX::XMQuaternionMultiply(
+		DirectX::XMQuaternionMultiply(
+			DirectX::XMQuaternionRotationRollPitchYaw(pitch, 0, roll),
+			DirectX::XMLoadFloat4(&rotation)),
+		DirectX::XMQuaternionRotationRollPitchYaw(0, yaw, 0));
 
-	matIsDirty = true;
-	dirIsDirty = true;
+	// Renormalized so many small turns don't drift away from unit length
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionNormalize(result));
+	SetRotation(rotation);
 }
 
 void Transform::RotateEuler(DirectX::XMFLOAT3 rotation)
 {
-	eulerRotation.x += rotation.x;
-	eulerRotation.y += rotation.y;
-	eulerRotation.z += rotation.z;
+	RotateEuler(rotation.x, rotation.y, rotation.z);
+}
 
-	matIsDirty = true;
-	dirIsDirty = true;
+void Transform::Rotate(DirectX::XMFLOAT4 rotation)
+{
+	DirectX::XMFLOAT4 current = GetRotation();
+	DirectX::XMVECTOR result = DirectX::XMQuaternionMultiply(DirectX::XMLoadFloat4(&rotation), DirectX::XMLoadFloat4(&current));
+	DirectX::XMStoreFloat4(&current, DirectX::XMQuaternionNormalize(result));
+	SetRotation(current);
 }
 
-void Transform::Scale(float x, float y, float z)
+void Transform::RotateAxis(DirectX::XMFLOAT3 axis, float angle)
+{
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axis), angle));
+	Rotate(rotation);
+}
+
+void Transform::SlerpRotation(DirectX::XMFLOAT4 target, float t)
 {
-	scale.x += x;
-	scale.y += y;
-	scale.z += z;
+	DirectX::XMFLOAT4 rotation = GetRotation();
+	DirectX::XMStoreFloat4(&rotation, DirectX::XMQuaternionSlerp(DirectX::XMLoadFloat4(&rotation), DirectX::XMLoadFloat4(&target), t));
+	SetRotation(rotation);
+}
 
-	matIsDirty = true;
+void Transform::Scale(float x, float y, float z)
+{
+	DirectX::XMFLOAT3 scale = GetScale();
+	SetScale(scale.x + x, scale.y + y, scale.z + z);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
-	this->scale.x += scale.x;
-	this->scale.y += scale.y;
-	this->scale.z += scale.z;
-
-	matIsDirty = true;
+	Scale(scale.x, scale.y, scale.z);
 }
 
 void Transform::Scale(float scale)
 {
-	this->scale.x += scale;
-	this->scale.y += scale;
-	this->scale.z += scale;
-
-	matIsDirty = true;
+	Scale(scale, scale, scale);
 }
 
 #pragma endregion
@@ -324,28 +278,44 @@ void Transform::Scale(float scale)
 
 void Transform::AddChild(std::shared_ptr<Transform> child)
 {
-	children.push_back(child);
+	if (child)
+		child->SetParent(shared_from_this());
 }
 
 void Transform::RemoveChild(std::shared_ptr<Transform> child)
 {
-	int index = GetChildIndex(child);
-	children[index]->SetParent(nullptr);
-	children.erase(children.begin() + index);
+	if (GetChildIndex(child) >= 0)
+		child->SetParent(nullptr);
 }
 
 void Transform::RemoveChild(int childIndex)
 {
-	children.erase(children.begin() + childIndex);
+	if (childIndex >= 0 && childIndex < (int)children.size())
+		children[childIndex]->SetParent(nullptr);
 }
 
-void Transform::SetParent(std::shared_ptr<Transform> parent)
+// The store keeps the hierarchy that matrices are built from,
+// while these pointers just let it be walked from here
+void Transform::SetParent(std::shared_ptr<Transform> newParent)
 {
-	//// Check if currently a child 
-	//if (parent != nullptr)
-	//{
-	//	parent->RemoveChild()
-	//}
+	std::shared_ptr<Transform> oldParent = parent.lock();
+	if (newParent == oldParent)
+		return;
+
+	if (!TransformStore::GetInstance().SetParent(index, newParent ? newParent->index : TRANSFORM_NO_PARENT))
+		return;
+
+	// Held here since the old parent may have had the only reference
+	std::shared_ptr<Transform> self = shared_from_this();
+	if (oldParent)
+	{
+		std::vector<std::shared_ptr<Transform>>& siblings = oldParent->children;
+		siblings.erase(std::find(siblings.begin(), siblings.end(), self));
+	}
+
+	parent = newParent;
+	if (newParent)
+		newParent->children.push_back(self);
 }
 
 #pragma endregion
@@ -3,43 +3,25 @@
 #include <memory>
 #include <vector>
 
-class Transform
+// --------------------------------------------------------
+// A handle to one transform in the TransformStore, which
+// holds the actual position, rotation, scale and matrices
+//
+// Position, rotation and scale are relative to the parent,
+// if there is one.  Transforms in a hierarchy must be owned
+// by a shared_ptr, and a parent keeps its children alive.
+// --------------------------------------------------------
+class Transform : public std::enable_shared_from_this<Transform>
 {
 private:
 
 	/// <summary>
-	/// Represents this objects scale in x, y, and z components 
+	/// This transform's slot in the TransformStore 
 	/// </summary>
-	DirectX::XMFLOAT3 scale;
-	/// <summary>
-	/// Represents this objects rotation as a euler 
-	/// </summary>
-	DirectX::XMFLOAT3 eulerRotation;
-
-	DirectX::XMFLOAT4X4 world;
-	DirectX::XMFLOAT4X4 worldTranspose;
-
-	/// <summary>
-	/// Set the matricies so that they accomodate mutations 
-	/// </summary>
-	void CleanMatrices();
-	void CleanVectors();
-
-	bool matIsDirty;
-	bool dirIsDirty;
-
-	// Local Vectors 
-	DirectX::XMFLOAT3 right;
-	DirectX::XMFLOAT3 up;
-	DirectX::XMFLOAT3 forward;
-
-	/// <summary>
-	/// Represents this objects position in x, y, and z components 
-	/// </summary>
-	std::shared_ptr<DirectX::XMFLOAT3> position;
+	unsigned int index;
 
 	std::vector<std::shared_ptr<Transform>> children;
-	std::shared_ptr<Transform> parent;
+	std::weak_ptr<Transform> parent;
 
 public:
 
@@ -48,6 +30,16 @@ public:
 	/// Create a transform that represents a position, scale, and rotation in 3D space 
 	/// </summary>
 	Transform();
+	~Transform();
+
+	// Each transform owns its slot, so they can't be copied
+	Transform(Transform const&) = delete;
+	void operator=(Transform const&) = delete;
+
+	/// <summary>
+	/// This transform's slot in the TransformStore 
+	/// </summary>
+	unsigned int GetIndex();
 
 	#pragma region SETTERS
 	/// <summary>
@@ -60,6 +52,11 @@ public:
 	/// <param name="position"></param>
 	void SetPosition(DirectX::XMFLOAT3 position);
 	/// <summary>
+	/// Sets the rotation of this transform to the given quaternion 
+	/// </summary>
+	/// <param name="rotation"></param>
+	void SetRotation(DirectX::XMFLOAT4 rotation);
+	/// <summary>
 	/// Sets the rotation of this transform to the given euler angles 
 	/// </summary>
 	void SetEulerRotation(float pitch, float yaw, float roll);
@@ -88,9 +85,14 @@ public:
 	/// Get this transform's current x, y, and z position in 3D space
 	/// </summary>
 	/// <returns></returns>
-	std::shared_ptr<DirectX::XMFLOAT3> GetPosition();
+	DirectX::XMFLOAT3 GetPosition();
+	/// <summary>
+	/// Get this transform's current rotation as a quaternion 
+	/// </summary>
+	/// <returns></returns>
+	DirectX::XMFLOAT4 GetRotation();
 	/// <summary>
-	/// Get this transform's current euler rotation 
+	/// Get this transform's current rotation as euler angles, worked out from its quaternion 
 	/// </summary>
 	/// <returns></returns>
 	DirectX::XMFLOAT3 GetEulerRotation();
@@ -169,13 +171,29 @@ public:
 	void MoveRelative(DirectX::XMFLOAT3 offset);
 	/// <summary>
 	/// Rotate this transform by the given euler angles
+	/// Pitch and roll turn around its own axes, yaw around the world's up, like a first person camera
 	/// </summary>
 	void RotateEuler(float pitch, float yaw, float roll);
 	/// <summary>
 	/// Rotate this transform by the given euler angles
+	/// Pitch and roll turn around its own axes, yaw around the world's up, like a first person camera
 	/// </summary>
 	void RotateEuler(DirectX::XMFLOAT3);
 	/// <summary>
+	/// Rotate this transform by the given quaternion, in its own space 
+	/// </summary>
+	void Rotate(DirectX::XMFLOAT4 rotation);
+	/// <summary>
+	/// Rotate this transform around one of its own axes 
+	/// </summary>
+	void RotateAxis(DirectX::XMFLOAT3 axis, float angle);
+	/// <summary>
+	/// Move this transform's rotation part of the way to another, along the shortest arc 
+	/// </summary>
+	/// <param name="target"></param>
+	/// <param name="t">0 keeps the current rotation, 1 reaches the target</param>
+	void SlerpRotation(DirectX::XMFLOAT4 target, float t);
+	/// <summary>
 	/// Scale this transform for each axis 
 	/// </summary>
 	void Scale(float x, float y, float z);
@@ -207,7 +225,8 @@ public:
 	/// <param name="childIndex"></param>
 	void RemoveChild(int childIndex);
 	/// <summary>
-	/// Link this transform to a new parent 
+	/// Link this transform to a new parent, keeping its local position, rotation and scale 
+	/// Does nothing if the new parent is below this transform 
 	/// </summary>
 	/// <param name="parent"></param>
 	void SetParent(std::shared_ptr<Transform> parent);
@@ -0,0 +1,437 @@
+#include "TransformStore.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace DirectX;
+
+// Singleton requirement
+TransformStore* TransformStore::instance;
+
+// --------------------------------------------------------
+// Reuses a removed transform's slot when there is one, and
+// otherwise grows every array by a group of four
+// --------------------------------------------------------
+unsigned int TransformStore::Add()
+{
+	unsigned int index;
+	if (!freeSlots.empty())
+	{
+		index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		index = count++;
+		if (index >= positionX.size())
+		{
+			size_t capacity = index + 4;
+			for (std::vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ })
+				component->resize(capacity, 0.0f);
+			for (std::vector<float>* component : { &rotationW, &scaleX, &scaleY, &scaleZ })
+				component->resize(capacity, 1.0f);
+			worlds.resize(capacity);
+			worldInverseTransposes.resize(capacity);
+			versions.resize(capacity, 0);
+			dirty.resize((capacity + 63) / 64, 0);
+			rebuilt.resize(dirty.size(), 0);
+			parents.resize(capacity, TRANSFORM_NO_PARENT);
+		}
+	}
+
+	positionX[index] = positionY[index] = positionZ[index] = 0.0f;
+	rotationX[index] = rotationY[index] = rotationZ[index] = 0.0f;
+	rotationW[index] = 1.0f;
+	scaleX[index] = scaleY[index] = scaleZ[index] = 1.0f;
+	MarkDirty(index);
+	return index;
+}
+
+void TransformStore::Remove(unsigned int index)
+{
+	SetParent(index, TRANSFORM_NO_PARENT);
+	freeSlots.push_back(index);
+}
+
+#pragma region GETTERS/SETTERS
+
+XMFLOAT3 TransformStore::GetPosition(unsigned int index)
+{
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT4 TransformStore::GetRotation(unsigned int index)
+{
+	return XMFLOAT4(rotationX[index], rotationY[index], rotationZ[index], rotationW[index]);
+}
+
+XMFLOAT3 TransformStore::GetScale(unsigned int index)
+{
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+void TransformStore::SetPosition(unsigned int index, XMFLOAT3 position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+	MarkDirty(index);
+}
+
+void TransformStore::SetRotation(unsigned int index, XMFLOAT4 rotation)
+{
+	rotationX[index] = rotation.x;
+	rotationY[index] = rotation.y;
+	rotationZ[index] = rotation.z;
+	rotationW[index] = rotation.w;
+	MarkDirty(index);
+}
+
+void TransformStore::SetScale(unsigned int index, XMFLOAT3 scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+	MarkDirty(index);
+}
+
+// --------------------------------------------------------
+// A dirty transform is rebuilt along with the rest of its
+// group of four, since that costs the same as one alone.
+// A child depends on everything above it though, so asking
+// for one after any change runs the whole update instead.
+// --------------------------------------------------------
+const XMFLOAT4X4& TransformStore::GetWorldMatrix(unsigned int index)
+{
+	if (parents[index] != TRANSFORM_NO_PARENT)
+	{
+		if (changedSinceUpdate)
+			UpdateWorldMatrices();
+		return worlds[index];
+	}
+
+	unsigned long long groupBits = 0xFull << (index & 60);
+	unsigned long long& word = dirty[index / 64];
+	if (word & groupBits)
+	{
+		UpdateGroup(index & ~3u);
+		for (unsigned long long bits = word & groupBits; bits; bits &= bits - 1)
+			dirtyCount--;
+		word &= ~groupBits;
+		rebuilt[index / 64] |= groupBits;
+	}
+	return worlds[index];
+}
+
+const XMFLOAT4X4& TransformStore::GetWorldInverseTransposeMatrix(unsigned int index)
+{
+	GetWorldMatrix(index);
+	return worldInverseTransposes[index];
+}
+
+unsigned int TransformStore::GetCount()
+{
+	return count - (unsigned int)freeSlots.size();
+}
+
+unsigned int TransformStore::GetParent(unsigned int index)
+{
+	return parents[index];
+}
+
+unsigned int TransformStore::GetVersion(unsigned int index)
+{
+	return versions[index];
+}
+
+#pragma endregion
+
+void TransformStore::MarkDirty(unsigned int index)
+{
+	unsigned long long bit = 1ull << (index & 63);
+	unsigned long long& word = dirty[index / 64];
+	if (!(word & bit))
+	{
+		word |= bit;
+		dirtyCount++;
+	}
+	changedSinceUpdate = true;
+}
+
+// --------------------------------------------------------
+// Only records the new parent - the flat arrays are sorted
+// again at the next update, however many changes there were
+// --------------------------------------------------------
+bool TransformStore::SetParent(unsigned int index, unsigned int parent)
+{
+	// Walking up from the new parent must never reach this transform
+	for (unsigned int ancestor = parent; ancestor != TRANSFORM_NO_PARENT; ancestor = parents[ancestor])
+	{
+		if (ancestor == index)
+			return false;
+	}
+
+	if (parents[index] == parent)
+		return true;
+
+	if (parents[index] == TRANSFORM_NO_PARENT)
+		parentedCount++;
+	else if (parent == TRANSFORM_NO_PARENT)
+		parentedCount--;
+
+	parents[index] = parent;
+	hierarchyOrderStale = true;
+	MarkDirty(index);
+	return true;
+}
+
+// --------------------------------------------------------
+// Each batch owns whole words of the bitset, so jobs never
+// touch the same bits or the same matrices
+// --------------------------------------------------------
+unsigned int TransformStore::UpdateWorldMatrices()
+{
+	if (hierarchyOrderStale)
+		SortHierarchy();
+
+	if (!changedSinceUpdate)
+		return 0;
+
+	unsigned int updated = dirtyCount;
+	auto job = [this](unsigned int start, unsigned int end)
+	{
+		for (unsigned int w = start; w < end; w++)
+		{
+			unsigned long long word = dirty[w];
+			if (word == 0)
+				continue;
+
+			unsigned long long groups = 0;
+			for (unsigned int group = 0; group < 64; group += 4)
+			{
+				if ((word >> group) & 0xF)
+				{
+					UpdateGroup(w * 64 + group);
+					groups |= 0xFull << group;
+				}
+			}
+			dirty[w] = 0;
+			rebuilt[w] |= groups;
+		}
+	};
+
+	unsigned int wordCount = (unsigned int)dirty.size();
+	if (updated < TRANSFORM_STORE_PARALLEL_THRESHOLD)
+		job(0, wordCount);
+	else
+		JobSystem::GetInstance().ParallelFor(wordCount, TRANSFORM_STORE_WORDS_PER_BATCH, job);
+
+	if (!hierarchyTransforms.empty())
+		UpdateHierarchy();
+
+	std::fill(rebuilt.begin(), rebuilt.end(), 0);
+	dirtyCount = 0;
+	changedSinceUpdate = false;
+	return updated;
+}
+
+// --------------------------------------------------------
+// Rebuilds the flat hierarchy arrays, ordered by depth so
+// every parent comes before its children.  Depths are found
+// once each by walking up to the nearest known one, so deep
+// chains stay linear.
+//
+// Cached local matrices don't survive the reorder, so every
+// transform in a hierarchy is marked dirty to rebuild them.
+// --------------------------------------------------------
+void TransformStore::SortHierarchy()
+{
+	hierarchyOrderStale = false;
+	hierarchyTransforms.clear();
+	hierarchyParents.clear();
+
+	// Roots are depth 0, everything else unknown until reached
+	std::vector<unsigned int> depths(count, 0);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (parents[i] != TRANSFORM_NO_PARENT)
+			depths[i] = TRANSFORM_NO_PARENT;
+	}
+
+	std::vector<unsigned int> chain;
+	unsigned int maxDepth = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int t = i;
+		while (depths[t] == TRANSFORM_NO_PARENT)
+		{
+			chain.push_back(t);
+			t = parents[t];
+		}
+		for (unsigned int depth = depths[t] + 1; !chain.empty(); depth++)
+		{
+			depths[chain.back()] = depth;
+			maxDepth = std::max(maxDepth, depth);
+			chain.pop_back();
+		}
+	}
+
+	// Counting sort by depth
+	std::vector<unsigned int> starts(maxDepth + 2, 0);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (parents[i] != TRANSFORM_NO_PARENT)
+			starts[depths[i] + 1]++;
+	}
+	for (unsigned int d = 1; d < starts.size(); d++)
+		starts[d] += starts[d - 1];
+
+	hierarchyTransforms.resize(parentedCount);
+	hierarchyParents.resize(parentedCount);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (parents[i] == TRANSFORM_NO_PARENT)
+			continue;
+
+		unsigned int node = starts[depths[i]]++;
+		hierarchyTransforms[node] = i;
+		hierarchyParents[node] = parents[i];
+		MarkDirty(i);
+	}
+
+	hierarchyLocals.resize(parentedCount);
+	hierarchyLocalInverseTransposes.resize(parentedCount);
+}
+
+// --------------------------------------------------------
+// One pass down the flat arrays.  A transform whose group
+// was just rebuilt has its fresh local matrices in place of
+// its world ones, so those are kept first.  Then if it or
+// its parent changed, the parent's world matrices (already
+// final, being earlier in the order) are multiplied in, and
+// its rebuilt bit passes the change on to its own children.
+// --------------------------------------------------------
+void TransformStore::UpdateHierarchy()
+{
+	for (size_t node = 0; node < hierarchyTransforms.size(); node++)
+	{
+		unsigned int index = hierarchyTransforms[node];
+		unsigned int parent = hierarchyParents[node];
+		unsigned long long bit = 1ull << (index & 63);
+
+		if (rebuilt[index / 64] & bit)
+		{
+			hierarchyLocals[node] = worlds[index];
+			hierarchyLocalInverseTransposes[node] = worldInverseTransposes[index];
+		}
+		else if (!(rebuilt[parent / 64] & (1ull << (parent & 63))))
+		{
+			continue;
+		}
+
+		XMStoreFloat4x4(&worlds[index], XMMatrixMultiply(
+			XMLoadFloat4x4(&hierarchyLocals[node]),
+			XMLoadFloat4x4(&worlds[parent])));
+		XMStoreFloat4x4(&worldInverseTransposes[index], XMMatrixMultiply(
+			XMLoadFloat4x4(&hierarchyLocalInverseTransposes[node]),
+			XMLoadFloat4x4(&worldInverseTransposes[parent])));
+		rebuilt[index / 64] |= bit;
+		versions[index]++;
+	}
+}
+
+// --------------------------------------------------------
+// Builds world (scale * rotation * translation) and inverse
+// transpose matrices for four transforms at once, one per
+// SIMD lane, then transposes them out to one matrix each.
+//
+// The rotation is XMMatrixRotationQuaternion written out,
+// so there's no trig at all, and since the rotation rows are orthonormal the inverse
+// transpose is just those rows divided by the scale, with
+// the translation folded into the last column - no general
+// 4x4 inverse needed.
+// --------------------------------------------------------
+void TransformStore::UpdateGroup(unsigned int first)
+{
+	XMVECTOR px = XMLoadFloat4((const XMFLOAT4*)&positionX[first]);
+	XMVECTOR py = XMLoadFloat4((const XMFLOAT4*)&positionY[first]);
+	XMVECTOR pz = XMLoadFloat4((const XMFLOAT4*)&positionZ[first]);
+	XMVECTOR sx = XMLoadFloat4((const XMFLOAT4*)&scaleX[first]);
+	XMVECTOR sy = XMLoadFloat4((const XMFLOAT4*)&scaleY[first]);
+	XMVECTOR sz = XMLoadFloat4((const XMFLOAT4*)&scaleZ[first]);
+
+	XMVECTOR qx = XMLoadFloat4((const XMFLOAT4*)&rotationX[first]);
+	XMVECTOR qy = XMLoadFloat4((const XMFLOAT4*)&rotationY[first]);
+	XMVECTOR qz = XMLoadFloat4((const XMFLOAT4*)&rotationZ[first]);
+	XMVECTOR qw = XMLoadFloat4((const XMFLOAT4*)&rotationW[first]);
+
+	// Doubled products of the quaternion's components
+	XMVECTOR x2 = XMVectorAdd(qx, qx);
+	XMVECTOR y2 = XMVectorAdd(qy, qy);
+	XMVECTOR z2 = XMVectorAdd(qz, qz);
+	XMVECTOR xx = XMVectorMultiply(qx, x2);
+	XMVECTOR yy = XMVectorMultiply(qy, y2);
+	XMVECTOR zz = XMVectorMultiply(qz, z2);
+	XMVECTOR xy = XMVectorMultiply(qx, y2);
+	XMVECTOR xz = XMVectorMultiply(qx, z2);
+	XMVECTOR yz = XMVectorMultiply(qy, z2);
+	XMVECTOR wx = XMVectorMultiply(qw, x2);
+	XMVECTOR wy = XMVectorMultiply(qw, y2);
+	XMVECTOR wz = XMVectorMultiply(qw, z2);
+	XMVECTOR one = XMVectorSplatOne();
+
+	// Rotation rows
+	XMVECTOR r00 = XMVectorSubtract(one, XMVectorAdd(yy, zz));
+	XMVECTOR r01 = XMVectorAdd(xy, wz);
+	XMVECTOR r02 = XMVectorSubtract(xz, wy);
+	XMVECTOR r10 = XMVectorSubtract(xy, wz);
+	XMVECTOR r11 = XMVectorSubtract(one, XMVectorAdd(xx, zz));
+	XMVECTOR r12 = XMVectorAdd(yz, wx);
+	XMVECTOR r20 = XMVectorAdd(xz, wy);
+	XMVECTOR r21 = XMVectorSubtract(yz, wx);
+	XMVECTOR r22 = XMVectorSubtract(one, XMVectorAdd(xx, yy));
+
+	// Translation against each rotation row, for the inverse
+	XMVECTOR t0 = XMVectorMultiplyAdd(pz, r02, XMVectorMultiplyAdd(py, r01, XMVectorMultiply(px, r00)));
+	XMVECTOR t1 = XMVectorMultiplyAdd(pz, r12, XMVectorMultiplyAdd(py, r11, XMVectorMultiply(px, r10)));
+	XMVECTOR t2 = XMVectorMultiplyAdd(pz, r22, XMVectorMultiplyAdd(py, r21, XMVectorMultiply(px, r20)));
+
+	XMVECTOR isx = XMVectorReciprocal(sx);
+	XMVECTOR isy = XMVectorReciprocal(sy);
+	XMVECTOR isz = XMVectorReciprocal(sz);
+	XMVECTOR zero = XMVectorZero();
+
+	// Each of these holds one row of four matrices, lane by lane
+	XMMATRIX worldRows[4] =
+	{
+		XMMATRIX(XMVectorMultiply(r00, sx), XMVectorMultiply(r01, sx), XMVectorMultiply(r02, sx), zero),
+		XMMATRIX(XMVectorMultiply(r10, sy), XMVectorMultiply(r11, sy), XMVectorMultiply(r12, sy), zero),
+		XMMATRIX(XMVectorMultiply(r20, sz), XMVectorMultiply(r21, sz), XMVectorMultiply(r22, sz), zero),
+		XMMATRIX(px, py, pz, one),
+	};
+	XMMATRIX inverseRows[3] =
+	{
+		XMMATRIX(XMVectorMultiply(r00, isx), XMVectorMultiply(r01, isx), XMVectorMultiply(r02, isx), XMVectorNegate(XMVectorMultiply(t0, isx))),
+		XMMATRIX(XMVectorMultiply(r10, isy), XMVectorMultiply(r11, isy), XMVectorMultiply(r12, isy), XMVectorNegate(XMVectorMultiply(t1, isy))),
+		XMMATRIX(XMVectorMultiply(r20, isz), XMVectorMultiply(r21, isz), XMVectorMultiply(r22, isz), XMVectorNegate(XMVectorMultiply(t2, isz))),
+	};
+
+	// Transposing turns "one row of four matrices" into "four rows of one matrix each"
+	for (unsigned int row = 0; row < 4; row++)
+	{
+		XMMATRIX lanes = XMMatrixTranspose(worldRows[row]);
+		for (unsigned int i = 0; i < 4; i++)
+			XMStoreFloat4((XMFLOAT4*)worlds[first + i].m[row], lanes.r[i]);
+	}
+	for (unsigned int row = 0; row < 3; row++)
+	{
+		XMMATRIX lanes = XMMatrixTranspose(inverseRows[row]);
+		for (unsigned int i = 0; i < 4; i++)
+			XMStoreFloat4((XMFLOAT4*)worldInverseTransposes[first + i].m[row], lanes.r[i]);
+	}
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		XMStoreFloat4((XMFLOAT4*)worldInverseTransposes[first + i].m[3], XMVectorSet(0, 0, 0, 1));
+		versions[first + i]++;
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Transforms below this many dirty ones are updated on the calling thread
+#define TRANSFORM_STORE_PARALLEL_THRESHOLD 4096
+
+// Words (of 64 transforms) per job system batch
+#define TRANSFORM_STORE_WORDS_PER_BATCH 16
+
+// Parent of a transform that isn't in a hierarchy
+#define TRANSFORM_NO_PARENT 0xFFFFFFFF
+
+// --------------------------------------------------------
+// Every Transform's data, stored as structure-of-arrays.
+//
+// Position, rotation (as a quaternion) and scale live in one
+// array per component (so four transforms fill one SIMD
+// register), and a bitset tracks which transforms changed
+// since their matrices were last built.  UpdateWorldMatrices() rebuilds
+// all the dirty ones four at a time, across the job system.
+//
+// Transforms with a parent are also kept in flat arrays,
+// sorted so parents come before their children.  After the
+// batch above builds local matrices, one pass down those
+// arrays multiplies in the parent's world matrix wherever
+// the transform or anything above it changed.
+//
+// A Transform is just an index in here.  Main thread only,
+// apart from the work UpdateWorldMatrices() hands out.
+// --------------------------------------------------------
+class TransformStore
+{
+#pragma region Singleton
+public:
+	// Gets the one and only instance of this class
+	static TransformStore& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new TransformStore();
+		}
+
+		return *instance;
+	}
+
+	// Remove these functions (C++ 11 version)
+	TransformStore(TransformStore const&) = delete;
+	void operator=(TransformStore const&) = delete;
+
+private:
+	static TransformStore* instance;
+	TransformStore() {};
+#pragma endregion
+
+public:
+	// A new identity transform's index
+	unsigned int Add();
+	void Remove(unsigned int index);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int index);
+	DirectX::XMFLOAT4 GetRotation(unsigned int index);
+	DirectX::XMFLOAT3 GetScale(unsigned int index);
+	void SetPosition(unsigned int index, DirectX::XMFLOAT3 position);
+	void SetRotation(unsigned int index, DirectX::XMFLOAT4 rotation);
+	void SetScale(unsigned int index, DirectX::XMFLOAT3 scale);
+
+	// Matrices for one transform, rebuilding just it if it's dirty
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int index);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int index);
+
+	// Rebuilds the matrices of every dirty transform, returning how many there were
+	unsigned int UpdateWorldMatrices();
+
+	// Makes a transform's matrices relative to another's, or to nothing with
+	// TRANSFORM_NO_PARENT.  False (and no change) if that would make a loop.
+	bool SetParent(unsigned int index, unsigned int parent);
+	unsigned int GetParent(unsigned int index);
+
+	// Changes whenever the transform's world matrix is rebuilt, so anything
+	// cached from that matrix can tell it's stale.  Updates nothing itself.
+	unsigned int GetVersion(unsigned int index);
+
+	unsigned int GetCount();
+
+private:
+	// One array per component, padded to a multiple of four
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+
+	std::vector<DirectX::XMFLOAT4X4> worlds;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+	std::vector<unsigned int> versions;
+
+	// One bit per transform, set when its matrices are out of date
+	std::vector<unsigned long long> dirty;
+	unsigned int dirtyCount = 0;
+
+	// One bit per transform whose world matrix was rebuilt in this update,
+	// which is how changes are passed down to children
+	std::vector<unsigned long long> rebuilt;
+
+	// Set by any change, so a child's world matrix is known to be current
+	bool changedSinceUpdate = false;
+
+	std::vector<unsigned int> freeSlots;
+	unsigned int count = 0;
+
+	// Each transform's parent, or TRANSFORM_NO_PARENT
+	std::vector<unsigned int> parents;
+	unsigned int parentedCount = 0;
+
+	// Every transform with a parent, parents before children, along
+	// with its local matrices (its world matrices hold the parent's too)
+	std::vector<unsigned int> hierarchyTransforms;
+	std::vector<unsigned int> hierarchyParents;
+	std::vector<DirectX::XMFLOAT4X4> hierarchyLocals;
+	std::vector<DirectX::XMFLOAT4X4> hierarchyLocalInverseTransposes;
+	bool hierarchyOrderStale = false;
+
+	void MarkDirty(unsigned int index);
+	void UpdateGroup(unsigned int first);
+	void SortHierarchy();
+	void UpdateHierarchy();
+};
@@ -0,0 +1,235 @@
+#include "TweenScheduler.h"
+#include "AnimCurves.h"
+#include "JobSystem.h"
+#include "TransformStore.h"
+
+#include <cmath>
+
+using namespace DirectX;
+
+static void NormalizeTweenRotation(XMFLOAT4& rotation)
+{
+	float length = sqrtf(
+		rotation.x * rotation.x + rotation.y * rotation.y +
+		rotation.z * rotation.z + rotation.w * rotation.w);
+	if (length > 0.0f)
+	{
+		rotation.x /= length;
+		rotation.y /= length;
+		rotation.z /= length;
+		rotation.w /= length;
+	}
+}
+
+TweenScheduler::TweenScheduler() :
+	time(0.0f)
+{
+}
+
+void TweenScheduler::Reserve(unsigned int capacity)
+{
+	tweens.reserve(capacity);
+	results.reserve(capacity);
+	positions.reserve(capacity);
+	generations.reserve(capacity);
+	freeSlots.reserve(capacity);
+}
+
+unsigned int TweenScheduler::Start(const TweenDesc& desc)
+{
+	bool valid =
+		desc.Target < TWEEN_TARGET_COUNT &&
+		(desc.Curve < EASE_CURVE_COUNT || desc.Curve == TWEEN_CURVE_LINEAR) &&
+		desc.Repeat <= TWEEN_REPEAT_PING_PONG;
+	if (!valid)
+		return TWEEN_NONE;
+
+	// Reuse a slot if we can
+	unsigned int slot;
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (unsigned int)positions.size();
+		positions.push_back(TWEEN_NONE);
+		generations.push_back(0);
+	}
+
+	Tween tween = {};
+	tween.Desc = desc;
+	tween.StartTime = time + desc.Delay;
+	tween.Handle = ((unsigned int)generations[slot] << TWEEN_INDEX_BITS) | slot;
+
+	// Rotations take the short way round, like keyframes do
+	if (desc.Target == TWEEN_TARGET_ROTATION)
+	{
+		XMFLOAT4& start = tween.Desc.Start;
+		XMFLOAT4& end = tween.Desc.End;
+		NormalizeTweenRotation(start);
+		NormalizeTweenRotation(end);
+		if (start.x * end.x + start.y * end.y + start.z * end.z + start.w * end.w < 0.0f)
+			end = XMFLOAT4(-end.x, -end.y, -end.z, -end.w);
+	}
+
+	positions[slot] = (unsigned int)tweens.size();
+	tweens.push_back(tween);
+	return tween.Handle;
+}
+
+// --------------------------------------------------------
+// Frees the handle right away, but leaves the tween in the
+// array (with no handle) for the next Update() to compact
+// out, so stopping never shuffles anything.
+// --------------------------------------------------------
+void TweenScheduler::Stop(unsigned int tween)
+{
+	if (!IsPlaying(tween))
+		return;
+
+	unsigned int slot = tween & TWEEN_INDEX_MASK;
+	tweens[positions[slot]].Handle = TWEEN_NONE;
+	positions[slot] = TWEEN_NONE;
+	generations[slot]++;
+	freeSlots.push_back(slot);
+}
+
+void TweenScheduler::StopTransform(unsigned int transformIndex)
+{
+	for (size_t i = 0; i < tweens.size(); i++)
+	{
+		if (tweens[i].Handle != TWEEN_NONE && tweens[i].Desc.TransformIndex == transformIndex)
+			Stop(tweens[i].Handle);
+	}
+}
+
+void TweenScheduler::Clear()
+{
+	for (size_t i = 0; i < tweens.size(); i++)
+	{
+		if (tweens[i].Handle != TWEEN_NONE)
+			Stop(tweens[i].Handle);
+	}
+	tweens.clear();
+}
+
+bool TweenScheduler::IsPlaying(unsigned int tween) const
+{
+	unsigned int slot = tween & TWEEN_INDEX_MASK;
+	return
+		tween != TWEEN_NONE &&
+		slot < generations.size() &&
+		positions[slot] != TWEEN_NONE &&
+		generations[slot] == (tween >> TWEEN_INDEX_BITS);
+}
+
+unsigned int TweenScheduler::GetCount() const
+{
+	return (unsigned int)(positions.size() - freeSlots.size());
+}
+
+// --------------------------------------------------------
+// One pass across the job system to ease every tween, then
+// one on this thread to write them, drop the finished ones
+// and keep the rest packed in order, then the callbacks.
+// --------------------------------------------------------
+void TweenScheduler::Update(float totalTime, const EaseTable* curveTables)
+{
+	time = totalTime;
+
+	unsigned int count = (unsigned int)tweens.size();
+	if (count == 0)
+		return;
+
+	results.resize(count);
+	const Tween* source = &tweens[0];
+	TweenResult* output = &results[0];
+
+	JobSystem::GetInstance().ParallelFor(count, TWEENS_PER_BATCH,
+		[=](unsigned int start, unsigned int end)
+		{
+			for (unsigned int i = start; i < end; i++)
+			{
+				const TweenDesc& desc = source[i].Desc;
+				TweenResult& result = output[i];
+
+				// Waiting on its delay (or stopped) - leave the transform alone
+				float elapsed = totalTime - source[i].StartTime;
+				result.Write = source[i].Handle != TWEEN_NONE && elapsed >= 0.0f;
+				result.Finished = false;
+				if (!result.Write)
+					continue;
+
+				// How far through which cycle
+				float progress = desc.Duration > 0.0f ? elapsed / desc.Duration : (float)desc.Cycles;
+				float cycle = floorf(progress);
+				float x = progress - cycle;
+				if (desc.Cycles > 0 && progress >= (float)desc.Cycles)
+				{
+					result.Finished = true;
+					cycle = (float)(desc.Cycles - 1);
+					x = 1.0f;
+				}
+				if (desc.Repeat == TWEEN_REPEAT_PING_PONG && cycle != 2.0f * floorf(cycle * 0.5f))
+					x = 1.0f - x;
+
+				float t = x;
+				if (desc.Curve != TWEEN_CURVE_LINEAR)
+					t = curveTables ? EvaluateEaseTable(curveTables[desc.Curve], x) : GetCurveByIndex((int)desc.Curve, x);
+
+				result.Value = XMFLOAT4(
+					desc.Start.x + (desc.End.x - desc.Start.x) * t,
+					desc.Start.y + (desc.End.y - desc.Start.y) * t,
+					desc.Start.z + (desc.End.z - desc.Start.z) * t,
+					desc.Start.w + (desc.End.w - desc.Start.w) * t);
+				if (desc.Target == TWEEN_TARGET_ROTATION)
+					NormalizeTweenRotation(result.Value);
+			}
+		});
+
+	// Write in start order, packing the survivors down over the rest
+	TransformStore& transforms = TransformStore::GetInstance();
+	completed.clear();
+	unsigned int kept = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Tween& tween = tweens[i];
+		if (tween.Handle == TWEEN_NONE)
+			continue;
+
+		const TweenResult& result = results[i];
+		if (result.Write)
+		{
+			const XMFLOAT4& value = result.Value;
+			switch (tween.Desc.Target)
+			{
+			case TWEEN_TARGET_POSITION: transforms.SetPosition(tween.Desc.TransformIndex, XMFLOAT3(value.x, value.y, value.z)); break;
+			case TWEEN_TARGET_ROTATION: transforms.SetRotation(tween.Desc.TransformIndex, value); break;
+			case TWEEN_TARGET_SCALE: transforms.SetScale(tween.Desc.TransformIndex, XMFLOAT3(value.x, value.y, value.z)); break;
+			}
+		}
+
+		unsigned int slot = tween.Handle & TWEEN_INDEX_MASK;
+		if (result.Finished)
+		{
+			if (tween.Desc.OnComplete)
+				completed.push_back(tween);
+			positions[slot] = TWEEN_NONE;
+			generations[slot]++;
+			freeSlots.push_back(slot);
+			continue;
+		}
+
+		positions[slot] = kept;
+		if (kept != i)
+			tweens[kept] = tween;
+		kept++;
+	}
+	tweens.resize(kept);
+
+	// Last, since these may start and stop tweens themselves
+	for (size_t i = 0; i < completed.size(); i++)
+		completed[i].Desc.OnComplete(completed[i].Handle, completed[i].Desc.UserData);
+}
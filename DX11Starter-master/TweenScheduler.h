@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+
+struct EaseTable;
+
+// What part of a transform a tween moves
+#define TWEEN_TARGET_POSITION	0
+#define TWEEN_TARGET_ROTATION	1
+#define TWEEN_TARGET_SCALE		2
+#define TWEEN_TARGET_COUNT		3
+
+// Curves are the EASE_ values from AnimCurves.h, or this for a constant speed
+#define TWEEN_CURVE_LINEAR 30
+
+// How a tween repeats: from Start to End each time, or there and back again
+#define TWEEN_REPEAT_RESTART	0
+#define TWEEN_REPEAT_PING_PONG	1
+
+// Tween handles are a slot in the low bits and an 8 bit generation in the high
+// ones, so a handle kept after its tween finishes doesn't match the slot's next
+// one - until the slot has been reused 256 times and the generation wraps
+#define TWEEN_INDEX_BITS 24
+#define TWEEN_INDEX_MASK ((1u << TWEEN_INDEX_BITS) - 1)
+
+// No tween
+#define TWEEN_NONE 0xFFFFFFFF
+
+// Tweens per job system batch
+#define TWEENS_PER_BATCH 1024
+
+// Called once a tween has played all its cycles (not when it's stopped)
+typedef void (*TweenCallback)(unsigned int tween, void* userData);
+
+// --------------------------------------------------------
+// A value moving from Start to End over Duration seconds.
+// Start and End are xyz for position and scale, or a
+// quaternion for rotation (blended as a normalized lerp).
+// Cycles is how many times it plays - each one the other
+// way round with ping-pong - or 0 to play until stopped.
+// --------------------------------------------------------
+struct TweenDesc
+{
+	unsigned int TransformIndex;	// Slot in the TransformStore
+	unsigned int Target;
+	DirectX::XMFLOAT4 Start;
+	DirectX::XMFLOAT4 End;
+	float Duration;
+	float Delay;					// Seconds from now before it starts
+	unsigned int Curve;
+	unsigned int Repeat;
+	unsigned int Cycles;
+	TweenCallback OnComplete;		// Optional
+	void* UserData;					// Handed to OnComplete
+};
+
+// --------------------------------------------------------
+// Runs any number of tweens on transforms, all of them
+// stepped together once per frame.
+//
+// Tweens live in one pooled array, in the order they were
+// started.  Values are eased across the job system, then
+// written to the TransformStore in that order - so when two
+// tweens move the same thing, the later one wins, however
+// many threads there are.  Finished and stopped tweens are
+// compacted out in the same pass, keeping the order, and
+// their slots are reused.  Once the pool has grown to the
+// most tweens ever running at once (or Reserve() has made
+// room), starting one allocates nothing.
+//
+// Completion callbacks run on the updating thread after
+// every tween has been written, in start order.  They may
+// start or stop tweens; new ones first play next Update().
+//
+// The scheduler doesn't know about entities: stop the tweens
+// on a transform before its slot goes back to the store.
+// --------------------------------------------------------
+class TweenScheduler
+{
+public:
+	TweenScheduler();
+
+	void Reserve(unsigned int capacity);
+
+	// A handle to the new tween, or TWEEN_NONE if the description
+	// has an unknown target, curve or repeat mode
+	unsigned int Start(const TweenDesc& desc);
+	void Stop(unsigned int tween);
+	void StopTransform(unsigned int transformIndex);
+	void Clear();
+
+	bool IsPlaying(unsigned int tween) const;
+	unsigned int GetCount() const;
+
+	// Steps everything to this time (the same time each frame's other
+	// animation gets).  Given EASE_CURVE_COUNT baked tables, in curve
+	// order, curves are evaluated through them instead.
+	void Update(float totalTime, const EaseTable* curveTables = 0);
+
+private:
+	struct Tween
+	{
+		TweenDesc Desc;
+		float StartTime;
+		unsigned int Handle;			// TWEEN_NONE once stopped
+	};
+
+	// What a tween does to its transform this frame, and whether it's the last
+	struct TweenResult
+	{
+		DirectX::XMFLOAT4 Value;
+		bool Write;
+		bool Finished;
+	};
+
+	std::vector<Tween> tweens;
+	std::vector<TweenResult> results;
+
+	// Per slot: where its tween is in tweens (TWEEN_NONE if free), and its generation
+	std::vector<unsigned int> positions;
+	std::vector<unsigned char> generations;
+	std::vector<unsigned int> freeSlots;
+
+	// Tweens that finished this update, waiting on their callbacks
+	std::vector<Tween> completed;
+
+	float time;
+};
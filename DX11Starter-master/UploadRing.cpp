@@ -0,0 +1,104 @@
+#include "UploadRing.h"
+
+UploadRing::UploadRing()
+{
+	Initialize(0);
+}
+
+void UploadRing::Initialize(unsigned long long capacity)
+{
+	this->capacity = capacity;
+	frames.clear();
+	head = 0;
+	tail = 0;
+	used = 0;
+	pending = 0;
+}
+
+// --------------------------------------------------------
+// The free space is everything from head around to tail.
+// That's one stretch when head is behind tail, or two when
+// it's ahead - up to the end, then from 0 up to tail.
+// --------------------------------------------------------
+unsigned long long UploadRing::Allocate(unsigned long long size, unsigned long long alignment)
+{
+	if (size == 0 || size > capacity)
+		return UPLOAD_RING_NONE;
+
+	// Nothing in use, so start from the beginning with the whole ring
+	if (used == 0)
+	{
+		head = 0;
+		tail = 0;
+	}
+
+	unsigned long long start = (head + alignment - 1) & ~(alignment - 1);
+	unsigned long long end = start + size;
+	if (head < tail)
+	{
+		if (end > tail)
+			return UPLOAD_RING_NONE;
+	}
+	else if (used == capacity)
+	{
+		return UPLOAD_RING_NONE;
+	}
+	else if (end > capacity)
+	{
+		// Skip what's left at the end
+		start = 0;
+		end = size;
+		if (used > 0 && end > tail)
+			return UPLOAD_RING_NONE;
+	}
+
+	// Whatever the alignment (or the wrap) skipped is used up too
+	unsigned long long consumed = end >= head ? end - head : capacity - head + end;
+	used += consumed;
+	pending += consumed;
+	head = end == capacity ? 0 : end;
+	return start;
+}
+
+void UploadRing::FinishFrame(unsigned long long fenceValue)
+{
+	if (pending == 0)
+		return;
+
+	RingFrame frame = {};
+	frame.FenceValue = fenceValue;
+	frame.End = head;
+	frame.Size = pending;
+	frames.push_back(frame);
+	pending = 0;
+}
+
+void UploadRing::Retire(unsigned long long completedFenceValue)
+{
+	while (!frames.empty() && frames.front().FenceValue <= completedFenceValue)
+	{
+		tail = frames.front().End;
+		used -= frames.front().Size;
+		frames.pop_front();
+	}
+}
+
+unsigned long long UploadRing::GetOldestFenceValue() const
+{
+	return frames.empty() ? 0 : frames.front().FenceValue;
+}
+
+unsigned long long UploadRing::GetCapacity() const
+{
+	return capacity;
+}
+
+unsigned long long UploadRing::GetUsed() const
+{
+	return used;
+}
+
+unsigned int UploadRing::GetFramesInFlight() const
+{
+	return (unsigned int)frames.size();
+}
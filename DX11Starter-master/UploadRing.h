@@ -0,0 +1,64 @@
+#pragma once
+
+#include <deque>
+
+// What Allocate() gives back when there isn't room
+#define UPLOAD_RING_NONE 0xFFFFFFFFFFFFFFFFull
+
+// --------------------------------------------------------
+// Hands out space from a fixed-size ring (bytes of an upload
+// heap, slots of a descriptor heap - the units don't matter)
+// that the GPU reads after the CPU writes it.  Knows nothing
+// about D3D12: the owner closes off each frame's allocations
+// with the fence value it signals after submitting them,
+// and passes in the fence's completed value to retire
+// frames the GPU is done with.
+//
+// Only retired space is handed out again, so any number of
+// frames can be in flight.  When there isn't enough, the
+// owner waits on GetOldestFenceValue() and retires again.
+// Allocations never straddle the end: one that doesn't fit
+// in the space left there skips it and starts over at 0.
+// --------------------------------------------------------
+class UploadRing
+{
+public:
+	UploadRing();
+
+	// Empties the ring and sets its size
+	void Initialize(unsigned long long capacity);
+
+	// Where a block of size (at a multiple of alignment, a power of two)
+	// starts, or UPLOAD_RING_NONE if the frames in flight hold too much
+	unsigned long long Allocate(unsigned long long size, unsigned long long alignment = 1);
+
+	// Everything allocated since the last call is in use until the fence reaches this value
+	void FinishFrame(unsigned long long fenceValue);
+
+	// Frees every finished frame whose fence value has been reached
+	void Retire(unsigned long long completedFenceValue);
+
+	// The fence value that frees the oldest finished frame, or 0 if none are in flight
+	unsigned long long GetOldestFenceValue() const;
+
+	unsigned long long GetCapacity() const;
+	unsigned long long GetUsed() const;
+	unsigned int GetFramesInFlight() const;
+
+private:
+	// One finished frame's share of the ring, oldest first
+	struct RingFrame
+	{
+		unsigned long long FenceValue;
+		unsigned long long End;		// Where the next frame's space begins
+		unsigned long long Size;	// Including anything skipped at the end
+	};
+
+	std::deque<RingFrame> frames;
+
+	unsigned long long capacity;
+	unsigned long long head;		// Where the next allocation goes
+	unsigned long long tail;		// Where the oldest in-use space begins
+	unsigned long long used;
+	unsigned long long pending;		// Allocated since the last FinishFrame()
+};